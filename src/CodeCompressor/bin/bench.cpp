@@ -1,10 +1,26 @@
 #include <iostream>
+#include <fstream>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
 
 #include "elfio/elfio.hpp"
 
 #include "../lib/utils.h"
 #include "../lib/encode_table.h"
+#include "../lib/dict_batch.h"
+#include "../lib/exec_profile.h"
+#include "../lib/workload_model.h"
+#include "../lib/rv32i_interp.h"
+#include "../runtime/decomp_rt.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC
+#endif
 
 using namespace utils;
 
@@ -13,6 +29,7 @@ namespace utils
 
 ELFIO::section *get_section_with_name(const ELFIO::elfio *file, const std::string &name);
 std::vector<command> rv32i_get_commands(const ELFIO::section *sec_text);
+compressed_section get_compressed_section(const ELFIO::section *sec_text, encode_type &etype);
 
 }
 
@@ -37,12 +54,14 @@ void default_bench()
         encode_type::DICT,
         encode_type::MASK_SINGLE,
         encode_type::MASK_DUO,
+        encode_type::FIXED16,
         encode_type::MASK_DUO_QUAD,
         encode_type::MASK_QUAD,
-        encode_type::MASK_OPERANDS_OPCODE
+        encode_type::MASK_OPERANDS_OPCODE,
+        encode_type::RV32I_FIELDS
     };
 
-    std::cout << "\t\t\t" << "DICT" << "\t" << "MASKS" << "\t" << "MASKD" << "\t" << "MASKDQ" << "\t" << "MASKQ" << "\t" << "MASKOO" << std::endl;
+    std::cout << "\t\t\t" << "DICT" << "\t" << "MASKS" << "\t" << "MASKD" << "\t" << "FIXED" << "\t" << "MASKDQ" << "\t" << "MASKQ" << "\t" << "MASKOO" << "\t" << "FIELDS" << std::endl;
 
     for (const auto & ifilename : filenames) {
 
@@ -76,123 +95,1541 @@ void default_bench()
     std::cout << "Bench finished" << std::endl;
 }
 
-void nullate_bit7(ELFIO::elfio *f)
+void entropy_bench()
 {
-    ELFIO::section *s = get_section_with_name(f, ".text");
-    const char *sd = s->get_data();
-    size_t ssz = s->get_size();
+    std::cout << "Bench started" << std::endl;
 
-    char *data_cpy = new char[ssz];
-    memcpy(data_cpy, sd, ssz);
-    for (size_t i = 0; i < ssz; i += 4)
-    {
-        //data_cpy[i] = data_cpy[i] & 0x7f;
-        data_cpy[i + 2] = data_cpy[i + 2] & 0xff;
+    std::string ofilename = "result.out";
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_SINGLE
+    };
+
+    std::cout << "\t\t\t" << "DICT" << "\t" << "DICT+H" << "\t" << "MASKS" << "\t" << "MASKS+H" << "\t(decode, us)" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+
+        std::cout << ifilename << "\t";
+
+        for (const auto &entype : encode_types)
+        {
+            for (bool entropy : { false, true })
+            {
+                ELFIO::elfio reader;
+                if (!reader.load(ifilename))
+                {
+                    std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                    assert(false);
+                }
+
+                config_builder cfg_builder;
+                cfg_builder.set_etype(entype);
+                cfg_builder.set_entropy_coding(entropy);
+
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                config cfg = cfg_builder.build();
+                compress_executable(sz_stat, dict_infos, &reader, cfg);
+
+                auto start = std::chrono::steady_clock::now();
+                decompress_executable(&reader);
+                auto end = std::chrono::steady_clock::now();
+                auto decode_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+                std::cout << sz_stat.final_code_size + sz_stat.dict_32_bit_size + sz_stat.entropy_table_size
+                          << "(" << decode_us << ")" << "\t" << std::flush;
+            }
+        }
+
+        std::cout << std::endl;
     }
 
-    s->set_data(data_cpy, ssz);
-    delete [] data_cpy;
+    std::cout << "Bench finished" << std::endl;
 }
 
-void bit7_nullable_bench()
+void fetch_model_bench()
 {
     std::cout << "Bench started" << std::endl;
 
-    std::string ofilename = "result.out";
-    std::string ifilename = "./rv32i_programms/src/bellman_ford/a.out";
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
 
-    utils::size_stat sz_stat;
-    std::vector<std::string> dict_infos;
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_SINGLE,
+        encode_type::MASK_DUO,
+        encode_type::MASK_DUO_QUAD,
+        encode_type::MASK_QUAD,
+        encode_type::MASK_OPERANDS_OPCODE,
+        encode_type::RV32I_FIELDS
+    };
 
-    ELFIO::elfio reader;
-    if (!reader.load(ifilename))
-    {
-        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
-        assert(false);
-    }
-    config_builder cfg_builder;
-    cfg_builder.set_etype(encode_type::MASK_DUO);
-    config cfg = cfg_builder.build();
-    compress_executable(sz_stat, dict_infos, &reader, cfg);
+    fetch_params params;
+    params.buffer_bits = 128;
+    params.bus_bits = 32;
+    params.refill_latency = 1;
+    params.dict_latency = 1;
+    params.mask_latency = 1;
 
-    /*
-    std::cout << dict_infos[0] << std::endl;
-    std::cout << "===" << std::endl;
-    std::cout << dict_infos[1] << std::endl;
-    std::cout << "===" << std::endl;
-    */
+    std::cout << "buffer " << params.buffer_bits << " bits, bus " << params.bus_bits << " bits, dict latency "
+              << params.dict_latency << ", mask latency " << params.mask_latency << std::endl;
+    std::cout << "cpi / stall rate / refill bits per cycle" << std::endl;
+    std::cout << "\t\t\t" << "DICT" << "\t\t" << "MASKS" << "\t\t" << "MASKD" << "\t\t" << "MASKDQ" << "\t\t"
+              << "MASKQ" << "\t\t" << "MASKOO" << "\t\t" << "FIELDS" << std::endl;
 
-    std::cout << "MASK_DUO: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+    for (const auto & ifilename : filenames) {
 
-    if (!reader.load(ifilename))
-    {
-        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
-        assert(false);
-    }
+        std::cout << ifilename << "\t";
 
-    nullate_bit7(&reader);
-    compress_executable(sz_stat, dict_infos, &reader, cfg);
+        for (const auto &entype : encode_types)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
 
-    /*
-    std::cout << dict_infos[0] << std::endl;
-    std::cout << "===" << std::endl;
-    std::cout << dict_infos[1] << std::endl;
-    */
+            config_builder cfg_builder;
+            cfg_builder.set_etype(entype);
 
-    std::cout << "MASK_DUO*: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            config cfg = cfg_builder.build();
+            compress_executable(sz_stat, dict_infos, &reader, cfg);
 
-    if (!reader.load(ifilename))
-    {
-        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
-        assert(false);
+            fetch_stat fstat = simulate_fetch(trace_executable(&reader), params);
+
+            std::cout.precision(3);
+            std::cout << fstat.cpi() << "/" << fstat.stall_rate() << "/" << fstat.refill_bandwidth() << "\t" << std::flush;
+        }
+
+        std::cout << std::endl;
     }
-    cfg_builder.set_etype(encode_type::MASK_OPERANDS_OPCODE);
-    cfg = cfg_builder.build();
-    compress_executable(sz_stat, dict_infos, &reader, cfg);
-    std::cout << "MASKOO: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
 
-    if (!reader.load(ifilename))
-    {
-        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
-        assert(false);
+    std::cout << "Bench finished" << std::endl;
+}
+
+void dict_batch_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    constexpr size_t indx_size = 14;
+    constexpr size_t repeats = 20;
+
+    std::cout << "avx2: " << (dict_decode_batch_has_avx2() ? "yes" : "no") << std::endl;
+    std::cout << "\t\t\t" << "BLOCK" << "\t" << "SCALAR" << "\t" << "AVX2" << "\t(MB/s of restored code)" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+
+        std::cout << ifilename << "\t";
+
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_type::DICT);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+        encode_type etype;
+        compressed_section csec = get_compressed_section(get_section_with_name(&reader, ".text"), etype);
+        const ELFIO::section *dict_sec = get_section_with_name(&reader, ".dict");
+        std::vector<command> entries;
+        std::vector<uint32_t> dict(dict_sec->get_size() / 4);
+        for (size_t i = 0; i < dict.size(); ++i)
+        {
+            command cmd;
+            cmd.add(dict_sec->get_data() + i * 4, 32);
+            entries.push_back(cmd);
+            dict[i] = cmd.to_size_t();
+        }
+        encode_table<4, indx_size> entab(entries);
+
+        size_t csec_end = csec.get_data_sz_bits();
+        std::vector<uint32_t> out(csec_end / (indx_size + 1) + 1);
+        size_t restored_bytes = sz_stat.initial_code_size * repeats;
+
+        auto mbps = [restored_bytes](std::chrono::steady_clock::time_point start) {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            return us == 0 ? 0.0 : double(restored_bytes) / us;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; ++r)
+        {
+            size_t cnt = 0;
+            for (size_t pos = 0; pos < csec_end; ++cnt)
+                out[cnt] = restore_block_dict<4, indx_size>(csec, pos, entab).to_size_t();
+        }
+        std::cout << (size_t)mbps(start) << "\t";
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; ++r)
+            dict_decode_batch_scalar(csec.data(), csec_end, dict.data(), dict.size(), indx_size, out.data(), out.size());
+        std::cout << (size_t)mbps(start) << "\t";
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; ++r)
+            dict_decode_batch(csec.data(), csec_end, dict.data(), dict.size(), indx_size, out.data(), out.size());
+        std::cout << (size_t)mbps(start) << std::endl;
     }
-    nullate_bit7(&reader);
-    compress_executable(sz_stat, dict_infos, &reader, cfg);
-    std::cout << "MASKOO*:" << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
 
     std::cout << "Bench finished" << std::endl;
 }
 
-void custom_bisect_bench()
+// Compress and decompress times without callback and with no-op callback
+// and cancel token, they should differ only by noise
+void progress_overhead_bench()
 {
     std::cout << "Bench started" << std::endl;
 
-    std::string ofilename = "result.out";
-    std::string ifilename = "./rv32i_programms/src/bellman_ford/a.out";
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
 
-    ELFIO::elfio reader;
-    if (!reader.load(ifilename))
-    {
-        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
-        assert(false);
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_SINGLE,
+        encode_type::FIXED16
+    };
+
+    constexpr size_t repeats = 5;
+
+    std::cout << "\t\t\t" << "DICT" << "\t\t" << "MASKS" << "\t\t" << "FIXED" << "\t(compress/decompress us, plain -> with callback)" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+
+        std::cout << ifilename << "\t";
+
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+        for (const auto &entype : encode_types)
+        {
+            size_t progress_calls = 0;
+            cancel_token cancel;
+            for (bool with_progress : { false, true })
+            {
+                config_builder cfg_builder;
+                cfg_builder.set_etype(entype);
+                if (with_progress)
+                {
+                    cfg_builder.set_progress([&progress_calls](progress_phase, size_t, size_t) { progress_calls++; });
+                    cfg_builder.set_cancel_token(cancel);
+                }
+                config cfg = cfg_builder.build();
+
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                code_image image;
+                auto start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < repeats; ++r)
+                    image = compress_code(sz_stat, dict_infos, text, cfg);
+                auto compress_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+                dict_views dicts = image.get_dict_views();
+                start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < repeats; ++r)
+                    decompress_code(image.code, dicts, cfg);
+                auto decompress_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+                std::cout << compress_us << "/" << decompress_us << (with_progress ? "\t" : " -> ");
+            }
+            std::cout << std::flush;
+            assert(progress_calls != 0);
+        }
+
+        std::cout << std::endl;
     }
 
-    config_builder cfg_builder;
-    cfg_builder.set_etype(encode_type::MASK_DUO);
+    std::cout << "Bench finished" << std::endl;
+}
 
-    utils::size_stat sz_stat;
-    std::vector<std::string> dict_infos;
-    config cfg = cfg_builder.build();
-    compress_executable(sz_stat, dict_infos, &reader, cfg);
+// Estimated peak memory against .text size: corpus .text repeated to grow
+// the input, without and with memory budget. Rows are ready for plotting
+void memory_bench()
+{
+    std::cout << "Bench started" << std::endl;
 
-    std::cout << sz_stat.final_code_size + sz_stat.dict_32_bit_size << "(" << sz_stat.initial_code_size << ")" << "\t" << std::flush;
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_QUAD,
+        encode_type::RV32I_FIELDS
+    };
+
+    const size_t repeats[] = { 1, 4, 16, 64 };
+
+    std::cout << "file\tetype\ttext\thist\tdict\tencode\tpeak\tbudget_hist\tbudget_peak\t(bytes)" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+
+        for (size_t repeat : repeats)
+        {
+            std::vector<uint8_t> text;
+            for (size_t r = 0; r < repeat; ++r)
+                text.insert(text.end(), (const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+            for (size_t i = 0; i < encode_types.size(); ++i)
+            {
+                config_builder cfg_builder;
+                cfg_builder.set_etype(encode_types[i]);
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+
+                // Budget that holds input, commands and output, but not std::map histograms
+                cfg_builder.set_memory_budget(sz_stat.peak_encode_memory);
+                utils::size_stat budget_stat;
+                compress_code(budget_stat, dict_infos, text, cfg_builder.build());
+
+                std::cout << ifilename << "\t" << i << "\t" << text.size() << "\t"
+                          << sz_stat.peak_histogram_memory << "\t" << sz_stat.peak_dictionary_memory << "\t"
+                          << sz_stat.peak_encode_memory << "\t" << sz_stat.peak_memory << "\t"
+                          << budget_stat.peak_histogram_memory << "\t" << budget_stat.peak_memory << std::endl;
+            }
+        }
+    }
 
     std::cout << "Bench finished" << std::endl;
 }
 
-int main(int argc, char *argv[])
+// Throughput, peak memory and thread scaling on synthetic workloads learned
+// from the corpus. Every thread compresses its own copy of .text, so rows of
+// one size show how encoders share the machine. bin/workload_gen.exe makes
+// larger workloads, up to 1 GB
+void workload_scaling_bench()
 {
-    default_bench();
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_QUAD,
+        encode_type::RV32I_FIELDS
+    };
+
+    const size_t text_sizes[] = { 1 << 20, 1 << 22, 1 << 24 };
+    const size_t thread_cnts[] = { 1, 2, 4, 8 };
+    const std::string workload_filename = "./bin/workload.exe";
+
+    workload_model model;
+    for (const auto & ifilename : filenames) {
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        model.learn(std::span<const uint8_t>((const uint8_t *)text_sec->get_data(), text_sec->get_size()));
+    }
+    std::cout << "Learned " << model.get_learned_cnt() << " instructions, " << model.get_class_cnt() << " classes" << std::endl;
+
+    std::cout << "text\tetype\tthreads\tcompressed\tpeak\tMB/s\t(bytes)" << std::endl;
+
+    for (size_t text_size : text_sizes)
+    {
+        workload_write_elf(workload_filename, model.generate(text_size, text_size));
+
+        ELFIO::elfio reader;
+        if (!reader.load(workload_filename))
+        {
+            std::cout << "Can't find or process ELF file " << workload_filename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            config cfg = cfg_builder.build();
+
+            for (size_t thread_cnt : thread_cnts)
+            {
+                std::vector<utils::size_stat> sz_stats(thread_cnt);
+                std::vector<std::thread> threads;
+                auto start = std::chrono::steady_clock::now();
+                for (size_t t = 0; t < thread_cnt; ++t)
+                {
+                    threads.emplace_back([&text, &cfg, &sz_stat = sz_stats[t]]() {
+                        std::vector<std::string> dict_infos;
+                        compress_code(sz_stat, dict_infos, text, cfg);
+                    });
+                }
+                for (auto &thread : threads)
+                    thread.join();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                std::cout << text.size() << "\t" << i << "\t" << thread_cnt << "\t"
+                          << sz_stats[0].final_code_size + sz_stats[0].dict_32_bit_size << "\t" << sz_stats[0].peak_memory << "\t"
+                          << thread_cnt * text.size() / seconds / (1 << 20) << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Execution counts guessed from loops: every backward branch or jump makes
+// the code it jumps over 10 times hotter, nested loops multiply
+std::vector<uint64_t> estimate_loop_counts(const ELFIO::section *text_sec)
+{
+    const uint8_t *data = (const uint8_t *)text_sec->get_data();
+    size_t cmds_cnt = text_sec->get_size() / 4;
+    std::vector<uint64_t> counts(cmds_cnt, 1);
+    for (size_t i = 0; i < cmds_cnt; ++i)
+    {
+        uint32_t instr = data[i * 4] | (data[i * 4 + 1] << 8) | (data[i * 4 + 2] << 16) | ((uint32_t)data[i * 4 + 3] << 24);
+        int32_t offset = 0;
+        if ((instr & 0x7f) == 0x63)
+            offset = (((int32_t)instr >> 31) << 12) | (((instr >> 7) & 0x1) << 11) | (((instr >> 25) & 0x3f) << 5) | (((instr >> 8) & 0xf) << 1);
+        else if ((instr & 0x7f) == 0x6f && ((instr >> 7) & 0x1f) == 0)
+            offset = (((int32_t)instr >> 31) << 20) | (((instr >> 12) & 0xff) << 12) | (((instr >> 20) & 0x1) << 11) | (((instr >> 21) & 0x3ff) << 1);
+
+        if (offset < 0 && (size_t)(-offset / 4) <= i)
+        {
+            for (size_t j = i + offset / 4; j <= i; ++j)
+                counts[j] *= 10;
+        }
+    }
+    return counts;
+}
+
+// Static size against dynamic decode work with and without execution
+// profile. Profile is read from a.prof next to the program (PC histogram or
+// simulator trace), loops are estimated when there is none
+void profile_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_QUAD,
+        encode_type::RV32I_FIELDS,
+        encode_type::FIXED16
+    };
+
+    std::cout << "file\tetype\tsize\tbits/exec\tdict reads/exec\t(static -> profiled)" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+
+        std::string profile_filename = ifilename.substr(0, ifilename.rfind('/')) + "/a.prof";
+        std::vector<uint64_t> counts;
+        if (std::ifstream(profile_filename))
+            counts = exec_profile::load(profile_filename).get_counts(text_sec->get_address(), text_sec->get_size() / 4);
+        else
+            counts = estimate_loop_counts(text_sec);
+
+        uint64_t executed = 0;
+        for (uint64_t count : counts)
+            executed += count;
+
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            std::cout << ifilename << "\t" << i << "\t";
+            for (bool with_profile : { false, true })
+            {
+                if (!reader.load(ifilename))
+                    assert(false);
+
+                config_builder cfg_builder;
+                cfg_builder.set_etype(encode_types[i]);
+                if (with_profile)
+                    cfg_builder.set_exec_counts(counts);
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+                block_trace work = total_decode_work(trace_executable(&reader), counts);
+                std::cout << sz_stat.final_code_size + sz_stat.dict_32_bit_size << " "
+                          << double(work.bits) / executed << " "
+                          << double(work.dict_reads) / executed << (with_profile ? "" : " -> ");
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Function units: size of .dict.func, latency of the first function against
+// the whole section and whole section decoded by units on several threads
+void function_units_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_QUAD,
+        encode_type::RV32I_FIELDS,
+        encode_type::FIXED16
+    };
+
+    const size_t thread_cnts[] = { 1, 2, 4, 8 };
+
+    std::cout << "file\tetype\tunits\ttable\tcompressed\tfirst us\tfull us\tunits us by threads" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            cfg_builder.set_function_units(true);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+            std::span<const uint8_t> code((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+            dict_views dicts = get_dict_views(&reader);
+            const std::vector<func_unit> units = get_func_table(dicts).get_units();
+            if (units.empty())
+                continue;
+
+            auto start = std::chrono::steady_clock::now();
+            decompress_function(code, dicts, reader.get_entry() - text_sec->get_address());
+            double first = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            decompress_code(code, dicts);
+            double full = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << ifilename << "\t" << i << "\t" << units.size() << "\t" << sz_stat.func_table_size << "\t"
+                      << sz_stat.final_code_size + sz_stat.dict_32_bit_size << "\t" << first << "\t" << full;
+
+            for (size_t thread_cnt : thread_cnts)
+            {
+                std::vector<std::thread> threads;
+                start = std::chrono::steady_clock::now();
+                for (size_t t = 0; t < thread_cnt; ++t)
+                {
+                    threads.emplace_back([&, t]() {
+                        for (size_t u = t; u < units.size(); u += thread_cnt)
+                            decompress_function(code, dicts, units[u].text_offset);
+                    });
+                }
+                for (auto &thread : threads)
+                    thread.join();
+                std::cout << "\t" << std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Execution of compressed corpus by rv32i interpreter with decode on fetch:
+// runtime, decoder work per retired instruction and line cache hit rate
+void interp_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_SINGLE,
+        encode_type::MASK_DUO,
+        encode_type::MASK_QUAD,
+        encode_type::MASK_OPERANDS_OPCODE,
+        encode_type::MASK_DUO_QUAD,
+        encode_type::RV32I_FIELDS,
+        encode_type::FIXED16
+    };
+
+    std::cout << "file\tetype\tinstructions\tseconds\tbits/instr\tdict reads/instr\thit rate" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        interp_stat base = rv32i_run(&reader);
+        std::cout << ifilename << "\t-\t" << base.instructions << "\t" << base.seconds << std::endl;
+
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            if (!reader.load(ifilename))
+                assert(false);
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            interp_stat stat = rv32i_run(&reader);
+            assert(stat.output == base.output && stat.exit_code == base.exit_code);
+            std::cout << ifilename << "\t" << i << "\t" << stat.instructions << "\t" << stat.seconds << "\t"
+                      << stat.bits_per_instruction() << "\t" << stat.dict_reads_per_instruction() << "\t" << stat.hit_rate() << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Cold and warm runs of corpus compression through on-disk result cache,
+// warm run only hashes .text and reads the entry
+void result_cache_bench(const std::string &cache_dir = "./bench_cache")
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT,
+        encode_type::MASK_QUAD,
+        encode_type::MASK_DUO_QUAD,
+        encode_type::RV32I_FIELDS
+    };
+
+    std::filesystem::remove_all(cache_dir);
+    std::cout << "file\tetype\tcold ms\twarm ms\thits" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            cfg_builder.set_cache_dir(cache_dir);
+
+            double ms[2] = { 0, 0 };
+            size_t hits = 0;
+            for (size_t run = 0; run < 2; ++run)
+            {
+                ELFIO::elfio reader;
+                if (!reader.load(ifilename))
+                {
+                    std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                    assert(false);
+                }
+
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                auto start = std::chrono::steady_clock::now();
+                compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+                ms[run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                hits += sz_stat.cache_hits;
+            }
+            std::cout << ifilename << "\t" << i << "\t" << ms[0] << "\t" << ms[1] << "\t" << hits << std::endl;
+        }
+    }
+
+    std::filesystem::remove_all(cache_dir);
+    std::cout << "Bench finished" << std::endl;
+}
+
+void nullate_bit7(ELFIO::elfio *f)
+{
+    ELFIO::section *s = get_section_with_name(f, ".text");
+    const char *sd = s->get_data();
+    size_t ssz = s->get_size();
+
+    char *data_cpy = new char[ssz];
+    memcpy(data_cpy, sd, ssz);
+    for (size_t i = 0; i < ssz; i += 4)
+    {
+        //data_cpy[i] = data_cpy[i] & 0x7f;
+        data_cpy[i + 2] = data_cpy[i + 2] & 0xff;
+    }
+
+    s->set_data(data_cpy, ssz);
+    delete [] data_cpy;
+}
+
+void bit7_nullable_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::string ofilename = "result.out";
+    std::string ifilename = "./rv32i_programms/src/bellman_ford/a.out";
+
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+
+    ELFIO::elfio reader;
+    if (!reader.load(ifilename))
+    {
+        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+        assert(false);
+    }
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::MASK_DUO);
+    config cfg = cfg_builder.build();
+    compress_executable(sz_stat, dict_infos, &reader, cfg);
+
+    /*
+    std::cout << dict_infos[0] << std::endl;
+    std::cout << "===" << std::endl;
+    std::cout << dict_infos[1] << std::endl;
+    std::cout << "===" << std::endl;
+    */
+
+    std::cout << "MASK_DUO: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+
+    if (!reader.load(ifilename))
+    {
+        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+        assert(false);
+    }
+
+    nullate_bit7(&reader);
+    compress_executable(sz_stat, dict_infos, &reader, cfg);
+
+    /*
+    std::cout << dict_infos[0] << std::endl;
+    std::cout << "===" << std::endl;
+    std::cout << dict_infos[1] << std::endl;
+    */
+
+    std::cout << "MASK_DUO*: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+
+    if (!reader.load(ifilename))
+    {
+        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+        assert(false);
+    }
+    cfg_builder.set_etype(encode_type::MASK_OPERANDS_OPCODE);
+    cfg = cfg_builder.build();
+    compress_executable(sz_stat, dict_infos, &reader, cfg);
+    std::cout << "MASKOO: " << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+
+    if (!reader.load(ifilename))
+    {
+        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+        assert(false);
+    }
+    nullate_bit7(&reader);
+    compress_executable(sz_stat, dict_infos, &reader, cfg);
+    std::cout << "MASKOO*:" << sz_stat.final_code_size + sz_stat.dict_32_bit_size << std::endl;
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+void custom_bisect_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::string ofilename = "result.out";
+    std::string ifilename = "./rv32i_programms/src/bellman_ford/a.out";
+
+    ELFIO::elfio reader;
+    if (!reader.load(ifilename))
+    {
+        std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+        assert(false);
+    }
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::MASK_DUO);
+
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    config cfg = cfg_builder.build();
+    compress_executable(sz_stat, dict_infos, &reader, cfg);
+
+    std::cout << sz_stat.final_code_size + sz_stat.dict_32_bit_size << "(" << sz_stat.initial_code_size << ")" << "\t" << std::flush;
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Code size of freestanding runtime per format, from its object file (host
+// runtime/decomp_rt.o or rv32i runtime/decomp_rt-rv32i.o), and host decode
+// cost per instruction: TSC cycles where available and ns
+void runtime_bench(const std::string &rt_object = "./runtime/decomp_rt.o")
+{
+    std::cout << "Bench started" << std::endl;
+
+    ELFIO::elfio rt_reader;
+    if (!rt_reader.load(rt_object))
+    {
+        std::cout << "Can't find or process runtime object " << rt_object << std::endl;
+        assert(false);
+    }
+
+    std::map<std::string, size_t> func_sizes;
+    size_t text_size = 0;
+    for (size_t i = 0; i < rt_reader.sections.size(); ++i)
+    {
+        const ELFIO::section *sec = rt_reader.sections[i];
+        if (sec->get_name().rfind(".text", 0) == 0)
+            text_size += sec->get_size();
+        if (sec->get_type() != ELFIO::SHT_SYMTAB)
+            continue;
+
+        ELFIO::const_symbol_section_accessor symbols(rt_reader, sec);
+        for (ELFIO::Elf_Xword j = 0; j < symbols.get_symbols_num(); ++j)
+        {
+            std::string name;
+            ELFIO::Elf64_Addr value = 0;
+            ELFIO::Elf_Xword size = 0;
+            unsigned char bind = 0, type = 0, other = 0;
+            ELFIO::Elf_Half section_index = 0;
+            symbols.get_symbol(j, name, value, size, bind, type, section_index, other);
+            if (type == ELFIO::STT_FUNC)
+                func_sizes[name] = size;
+        }
+    }
+
+    size_t formats_size = 0;
+    for (const auto &func : func_sizes)
+    {
+        if (func.first.rfind("drt_decode_", 0) == 0)
+            formats_size += func.second;
+    }
+    std::cout << rt_object << ": .text " << text_size << " bytes, shared " << text_size - formats_size << " bytes" << std::endl;
+
+    struct rt_format { const char *name; encode_type etype; bool entropy; std::vector<std::string> funcs; size_t hot_dict = 0; };
+    std::vector<rt_format> formats = {
+        { "DICT", encode_type::DICT, false, { "drt_decode_dict" } },
+        { "DICT_H", encode_type::DICT, true, { "drt_decode_dict_entropy" } },
+        { "MASKS", encode_type::MASK_SINGLE, false, { "drt_decode_mask_single" } },
+        { "MASKS_H", encode_type::MASK_SINGLE, true, { "drt_decode_mask_single_entropy" } },
+        { "MASKD", encode_type::MASK_DUO, false, { "drt_decode_mask_duo" } },
+        { "FIXED", encode_type::FIXED16, false, { "drt_decode_fixed16" } },
+        { "MASKDQ", encode_type::MASK_DUO_QUAD, false, { "drt_decode_mask_duo_quad" } },
+        { "MASKQ", encode_type::MASK_QUAD, false, { "drt_decode_mask_quad" } },
+        { "MASKOO", encode_type::MASK_OPERANDS_OPCODE, false, { "drt_decode_mask_operands_opcode" } },
+        { "FIELDS", encode_type::RV32I_FIELDS, false, { "drt_decode_fields" } },
+        { "DICTB", encode_type::DICT_BLOCKS, false, { "drt_decode_dict_blocks" } },
+        { "DICT_HOT", encode_type::DICT, false, { "drt_decode_dict_hot" }, 32 },
+        { "MASKS_HOT", encode_type::MASK_SINGLE, false, { "drt_decode_mask_single_hot" }, 32 },
+        { "MASKM", encode_type::MASK_MULTI, false, { "drt_decode_mask_multi" } },
+    };
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    constexpr size_t repeats = 20;
+
+    std::cout << "\t\t" << "BYTES";
+    for (const auto & ifilename : filenames)
+        std::cout << "\t" << ifilename;
+    std::cout << "\t(cycles/ns per instruction)" << std::endl;
+
+    for (const auto &format : formats)
+    {
+        size_t format_size = 0;
+        for (const auto &func : format.funcs)
+            format_size += func_sizes[func];
+        std::cout << format.name << "\t\t" << format_size;
+
+        for (const auto & ifilename : filenames)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
+            const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+            std::span<const uint8_t> text((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(format.etype);
+            cfg_builder.set_entropy_coding(format.entropy);
+            cfg_builder.set_hot_dict(format.hot_dict);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+
+            drt_image img = { { image.code.data(), image.code.size() }, { } };
+            for (const auto &dict : image.get_dicts())
+            {
+                int slot = drt_dict_slot(dict.first.c_str());
+                if (slot >= 0)
+                    img.dicts[slot] = { dict.second.data(), dict.second.size() };
+            }
+
+            std::vector<uint32_t> work(drt_work_words(&img));
+            std::vector<uint32_t> out(text.size() / 4);
+            size_t out_cnt = 0;
+
+            auto start = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+            uint64_t tsc_start = __rdtsc();
+#endif
+            for (size_t r = 0; r < repeats; ++r)
+                drt_decompress(&img, out.data(), out.size(), &out_cnt, work.data(), work.size());
+#ifdef BENCH_HAS_TSC
+            double cycles = double(__rdtsc() - tsc_start) / (repeats * out.size());
+#else
+            double cycles = 0;
+#endif
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "\t" << (size_t)cycles << "/" << (size_t)(double(ns) / (repeats * out.size()));
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Block-adaptive dictionaries against single dictionary codecs: code,
+// dictionaries and block map size, full decode time per instruction
+void block_dicts_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    struct block_config { const char *name; encode_type etype; size_t block_dicts; };
+    const block_config configs[] = {
+        { "DICT", encode_type::DICT, 1 },
+        { "FIXED", encode_type::FIXED16, 1 },
+        { "DICTB1", encode_type::DICT_BLOCKS, 1 },
+        { "DICTB2", encode_type::DICT_BLOCKS, 2 },
+        { "DICTB4", encode_type::DICT_BLOCKS, 4 },
+        { "DICTB8", encode_type::DICT_BLOCKS, 8 }
+    };
+    const size_t decode_rounds = 16;
+
+    std::cout << "file\tformat\tdicts\tcode\tdict\tmap\ttotal\tdecode ns/instr" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (const auto &cfg : configs)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
+            size_t cmds_cnt = get_section_with_name(&reader, ".text")->get_size() / 4;
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(cfg.etype);
+            cfg_builder.set_block_dicts(cfg.block_dicts);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+            std::span<const uint8_t> code((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+            dict_views dicts = get_dict_views(&reader);
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < decode_rounds; ++r)
+                decompress_code(code, dicts);
+            double decode = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            size_t dict_size = sz_stat.dict_32_bit_size;
+            std::cout << ifilename << "\t" << cfg.name << "\t" << dict_infos.size() << "\t" << sz_stat.final_code_size << "\t"
+                      << dict_size << "\t" << sz_stat.block_map_size << "\t"
+                      << sz_stat.final_code_size + dict_size + sz_stat.block_map_size << "\t"
+                      << decode / decode_rounds / cmds_cnt << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Two-level dictionaries: code and hot table size, share of instructions
+// coded with hot and cold tier, full decode time per instruction
+void hot_dict_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = { encode_type::DICT, encode_type::MASK_SINGLE };
+    const size_t hot_sizes[] = { 0, 16, 32, 64 };
+    const size_t decode_rounds = 16;
+
+    std::cout << "file\tetype\thot\tcode\ttable\thot %\tcold %\tdecode ns/instr" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            for (size_t hot_size : hot_sizes)
+            {
+                ELFIO::elfio reader;
+                if (!reader.load(ifilename))
+                {
+                    std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                    assert(false);
+                }
+                const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+                std::span<const uint8_t> text((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+                double cmds_cnt = text.size() / 4;
+
+                config_builder cfg_builder;
+                cfg_builder.set_etype(encode_types[i]);
+                cfg_builder.set_hot_dict(hot_size);
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+                dict_views dicts = image.get_dict_views();
+
+                auto start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < decode_rounds; ++r)
+                    decompress_code(image.code, dicts);
+                double decode = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+                std::cout << ifilename << "\t" << i << "\t" << hot_size << "\t" << sz_stat.final_code_size << "\t"
+                          << sz_stat.hot_table_size << "\t" << 100 * sz_stat.hot_dict_hits / cmds_cnt << "\t"
+                          << 100 * sz_stat.cold_dict_hits / cmds_cnt << "\t" << decode / decode_rounds / cmds_cnt << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Single nibble masks against multi-window masks of several shapes: code
+// size, instructions coded as literals and as masked entries, encode time
+void mask_multi_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = { encode_type::MASK_SINGLE, encode_type::MASK_MULTI };
+
+    std::cout << "file\tetype\tcode\tliterals\tmasked\tencode ms" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            auto start = std::chrono::steady_clock::now();
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+            double encode = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            size_t literals = 0, masked = 0;
+            for (const auto &trace : trace_executable(&reader))
+            {
+                literals += trace.dict_reads == 0;
+                masked += trace.mask_applies != 0;
+            }
+
+            std::cout << ifilename << "\t" << i << "\t" << sz_stat.final_code_size << "\t" << literals << "\t"
+                      << masked << "\t" << encode << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Dictionary histograms counted on several threads on synthetic workloads:
+// time until histogram is counted and of the whole compression, dictionaries
+// must be the same as with one thread
+void histogram_threads_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    std::vector<encode_type> encode_types = { encode_type::DICT, encode_type::MASK_DUO, encode_type::MASK_QUAD };
+    const size_t text_sizes[] = { 1 << 22, 1 << 24, 1 << 26 };
+    const size_t thread_cnts[] = { 1, 2, 4, 8 };
+
+    workload_model model;
+    for (const auto & ifilename : filenames) {
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        model.learn(std::span<const uint8_t>((const uint8_t *)text_sec->get_data(), text_sec->get_size()));
+    }
+
+    std::cout << "text\tetype\tthreads\thistogram ms\ttotal ms\tspeedup\tsame dicts" << std::endl;
+
+    for (size_t text_size : text_sizes)
+    {
+        std::vector<uint8_t> text = model.generate(text_size, text_size);
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            std::vector<std::string> serial_infos;
+            double serial_histogram = 0;
+            for (size_t thread_cnt : thread_cnts)
+            {
+                auto start = std::chrono::steady_clock::now();
+                double histogram = 0;
+                config_builder cfg_builder;
+                cfg_builder.set_etype(encode_types[i]);
+                cfg_builder.set_histogram_threads(thread_cnt);
+                cfg_builder.set_progress([&](progress_phase phase, size_t processed, size_t total) {
+                    if (phase == progress_phase::HISTOGRAM && processed == total)
+                        histogram = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                });
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+                double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (thread_cnt == 1)
+                {
+                    serial_infos = dict_infos;
+                    serial_histogram = histogram;
+                }
+
+                std::cout << text.size() << "\t" << i << "\t" << thread_cnt << "\t" << histogram << "\t" << total << "\t"
+                          << serial_histogram / histogram << "\t" << (dict_infos == serial_infos) << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Literal fallbacks of codeword map by opcode, the worst functions by share
+// of literals and time of map_executable
+void codeword_map_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    for (const auto & ifilename : filenames) {
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_type::MASK_SINGLE);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+        auto start = std::chrono::steady_clock::now();
+        codeword_map map = map_executable(&reader);
+        double map_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << ifilename << ": " << map.get_records().size() << " instructions, " << map.serialize().size()
+                  << " bytes of map, " << map_time << " ms" << std::endl;
+
+        std::map<uint8_t, std::pair<size_t, size_t>> opcodes;                 // all, literals
+        std::map<std::string, std::pair<size_t, size_t>> functions;
+        for (size_t i = 0; i < map.get_records().size(); ++i)
+        {
+            const auto &rec = map.get_records()[i];
+            const codeword_func *func = map.find_function(i * map.get_cmdlen());
+            bool literal = rec.cls == codeword_class::LITERAL;
+            opcodes[rec.opcode].first++;
+            opcodes[rec.opcode].second += literal;
+            auto &f = functions[func != nullptr ? func->name : "?"];
+            f.first++;
+            f.second += literal;
+        }
+
+        std::cout << "opcode\tcmds\tliterals" << std::endl;
+        for (const auto &op : opcodes)
+            std::cout << "0x" << std::hex << (unsigned)op.first << std::dec << "\t" << op.second.first << "\t" << op.second.second << std::endl;
+
+        std::vector<std::pair<std::string, std::pair<size_t, size_t>>> worst(functions.begin(), functions.end());
+        std::sort(worst.begin(), worst.end(), [](const auto &f1, const auto &f2) { return f1.second.second > f2.second.second; });
+        worst.resize(std::min<size_t>(worst.size(), 10));
+        std::cout << "function\tcmds\tliterals" << std::endl;
+        for (const auto &f : worst)
+            std::cout << f.first << "\t" << f.second.first << "\t" << f.second.second << std::endl;
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Every encode type on rv64i corpus: sizes and round trip through the same
+// codec as rv32i
+void rv64i_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv64i_programms/bellman_ford/a.out",
+    };
+
+    std::vector<encode_type> encode_types = {
+        encode_type::DICT, encode_type::MASK_SINGLE, encode_type::MASK_DUO, encode_type::MASK_QUAD, encode_type::MASK_OPERANDS_OPCODE,
+        encode_type::MASK_DUO_QUAD, encode_type::RV32I_FIELDS, encode_type::FIXED16, encode_type::DICT_BLOCKS, encode_type::MASK_MULTI
+    };
+
+    std::cout << "file\tetype\ttext\tcode\tdicts\tratio" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        for (size_t i = 0; i < encode_types.size(); ++i)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(ifilename))
+            {
+                std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+                assert(false);
+            }
+            assert(reader.get_class() == ELFIO::ELFCLASS64);
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            ELFIO::elfio original;
+            original.load(ifilename);
+            const ELFIO::section *text_sec = get_section_with_name(&original, ".text");
+            decompress_executable(&reader);
+            const ELFIO::section *restored_sec = get_section_with_name(&reader, ".text");
+            assert(restored_sec->get_size() == text_sec->get_size() && memcmp(restored_sec->get_data(), text_sec->get_data(), text_sec->get_size()) == 0);
+
+            size_t total = sz_stat.final_code_size + sz_stat.dict_32_bit_size;
+            std::cout << ifilename << "\t" << (size_t)encode_types[i] << "\t" << sz_stat.initial_code_size << "\t" << sz_stat.final_code_size << "\t"
+                      << sz_stat.dict_32_bit_size << "\t" << double(sz_stat.initial_code_size) / total << std::endl;
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+// Misses of LRU cache of lines_cnt 64 byte lines of .dict, entries are read
+// in order of straight-line decode of text, literals read none
+static size_t dict_cache_misses(std::span<const uint8_t> text, const std::vector<uint8_t> &dict, size_t lines_cnt)
+{
+    const size_t line_entries = 16;
+    std::unordered_map<uint32_t, size_t> positions;
+    for (size_t i = 0; i + 4 <= dict.size(); i += 4)
+    {
+        uint32_t entry = 0;
+        std::memcpy(&entry, dict.data() + i, sizeof(entry));
+        positions[entry] = i / 4;
+    }
+
+    std::vector<size_t> lines;  // the most recent first
+    size_t misses = 0;
+    for (size_t i = 0; i + 4 <= text.size(); i += 4)
+    {
+        uint32_t word = 0;
+        std::memcpy(&word, text.data() + i, sizeof(word));
+        auto it = positions.find(word);
+        if (it == positions.end())
+            continue;
+
+        size_t line = it->second / line_entries;
+        auto hit = std::find(lines.begin(), lines.end(), line);
+        if (hit != lines.end())
+        {
+            lines.erase(hit);
+        }
+        else
+        {
+            misses++;
+            if (lines.size() == lines_cnt)
+                lines.pop_back();
+        }
+        lines.insert(lines.begin(), line);
+    }
+    return misses;
+}
+
+// DICT with dictionary renumbered by value, uses and adjacency, indices
+// written whole, as delta or move-to-front rank: code size, short codes,
+// decode time and misses of small dictionary caches
+void index_order_bench()
+{
+    std::cout << "Bench started" << std::endl;
+
+    std::vector<std::string> filenames = {
+        "./rv32i_programms/src/bellman_ford/a.out",
+        "./rv32i_programms/src/blur_image/a.out",
+        "./rv32i_programms/src/dijkastra/a.out",
+        "./rv32i_programms/src/fft/a.out",
+        "./rv32i_programms/src/mersenne_twister/a.out",
+        "./rv32i_programms/src/negative_image/a.out",
+        "./rv32i_programms/src/qsort/a.out",
+        "./rv32i_programms/src/rgb_to_gray/a.out",
+        "./rv32i_programms/src/sha256/a.out",
+    };
+
+    const dict_order orders[] = { dict_order::VALUE, dict_order::FREQUENCY, dict_order::ADJACENCY };
+    const index_coding codings[] = { index_coding::FIXED, index_coding::DELTA, index_coding::MTF };
+    const size_t cache_lines[] = { 4, 16 };
+    const size_t decode_rounds = 16;
+
+    std::cout << "file\torder\tcoding\tcode\tshort %\tshort bits\tdecode ns/instr\tmisses 4 lines\tmisses 16 lines" << std::endl;
+
+    for (const auto & ifilename : filenames) {
+        ELFIO::elfio reader;
+        if (!reader.load(ifilename))
+        {
+            std::cout << "Can't find or process ELF file " << ifilename << std::endl;
+            assert(false);
+        }
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        std::span<const uint8_t> text((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+        double cmds_cnt = text.size() / 4;
+
+        for (dict_order order : orders)
+        {
+            for (index_coding coding : codings)
+            {
+                config_builder cfg_builder;
+                cfg_builder.set_etype(encode_type::DICT);
+                cfg_builder.set_dict_order(order);
+                cfg_builder.set_index_coding(coding);
+                utils::size_stat sz_stat;
+                std::vector<std::string> dict_infos;
+                code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+                dict_views dicts = image.get_dict_views();
+
+                auto start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < decode_rounds; ++r)
+                    decompress_code(image.code, dicts);
+                double decode = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+                const std::vector<uint8_t> *idx_data = image.find_dict(".dict.idx");
+                std::cout << ifilename << "\t" << (size_t)order << "\t" << (size_t)coding << "\t" << sz_stat.final_code_size << "\t"
+                          << 100 * sz_stat.short_index_hits / cmds_cnt << "\t" << (idx_data != nullptr ? (size_t)(*idx_data)[2] : 0) << "\t"
+                          << decode / decode_rounds / cmds_cnt;
+                for (size_t lines_cnt : cache_lines)
+                    std::cout << "\t" << dict_cache_misses(text, *image.find_dict(".dict"), lines_cnt);
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Bench finished" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    default_bench();
+
+    //entropy_bench();
+
+    //fetch_model_bench();
+
+    //dict_batch_bench();
+
+    //progress_overhead_bench();
+
+    //memory_bench();
+
+    //workload_scaling_bench();
+
+    //profile_bench();
+
+    //function_units_bench();
+
+    //interp_bench();
+
+    //result_cache_bench();
+
+    //runtime_bench();
+
+    //block_dicts_bench();
+
+    //hot_dict_bench();
+
+    //mask_multi_bench();
+
+    //histogram_threads_bench();
+
+    //codeword_map_bench();
+
+    //rv64i_bench();
+
+    //index_order_bench();
 
     //bit7_nullable_bench();
 
@@ -0,0 +1,65 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "elfio/elfio.hpp"
+
+#include "../lib/utils.h"
+
+using namespace utils;
+
+// Codeword of every instruction of compressed file:
+// codeword_map.exe <compressed ELF> <output map> - binary map,
+// codeword_map.exe --csv <map> <output csv> - its CSV view
+int main(int argc, char *argv[])
+{
+    if (argc != 3 && !(argc == 4 && std::strcmp(argv[1], "--csv") == 0))
+    {
+        std::cout << "Usage: " << argv[0] << " <compressed ELF> <output map>" << std::endl;
+        std::cout << "       " << argv[0] << " --csv <map> <output csv>" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        if (argc == 4)
+        {
+            codeword_map map = codeword_map::load(argv[2]);
+            std::ofstream out(argv[3], std::ios::trunc);
+            if (!out)
+            {
+                std::cout << "Can't write " << argv[3] << std::endl;
+                return 1;
+            }
+            map.write_csv(out);
+            std::cout << "Written " << map.get_records().size() << " instructions to " << argv[3] << std::endl;
+            return 0;
+        }
+
+        ELFIO::elfio reader;
+        if (!reader.load(argv[1]))
+        {
+            std::cout << "Can't find or process ELF file " << argv[1] << std::endl;
+            return 1;
+        }
+
+        codeword_map map = map_executable(&reader);
+        map.save(argv[2]);
+
+        size_t counts[CODEWORD_CLASSES_CNT] = { };
+        for (const auto &rec : map.get_records())
+            counts[(size_t)rec.cls]++;
+        for (size_t cls = 0; cls < CODEWORD_CLASSES_CNT; ++cls)
+            std::cout << codeword_class_name((codeword_class)cls) << ": " << counts[cls] << std::endl;
+        std::cout << "Written " << map.get_records().size() << " instructions, "
+                  << map.get_functions().size() << " functions to " << argv[2] << std::endl;
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "elfio/elfio.hpp"
+
+#include "../lib/utils.h"
+#include "../lib/rv32i_interp.h"
+
+using namespace utils;
+
+struct run_config
+{
+    const char *name;
+    encode_type etype;
+    bool entropy;
+};
+
+// Runs rv32i executable as is and compressed by every encode type, output
+// and exit code of compressed runs must be the same:
+// rv32i_run.exe <ELF> [cache sets] [cache ways]
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <ELF> [cache sets] [cache ways]" << std::endl;
+        return 1;
+    }
+
+    const run_config configs[] = {
+        { "DICT", encode_type::DICT, false },
+        { "DICT+H", encode_type::DICT, true },
+        { "MASKS", encode_type::MASK_SINGLE, false },
+        { "MASKS+H", encode_type::MASK_SINGLE, true },
+        { "MASKD", encode_type::MASK_DUO, false },
+        { "MASKQ", encode_type::MASK_QUAD, false },
+        { "MASKOO", encode_type::MASK_OPERANDS_OPCODE, false },
+        { "MASKDQ", encode_type::MASK_DUO_QUAD, false },
+        { "FIELDS", encode_type::RV32I_FIELDS, false },
+        { "FIXED", encode_type::FIXED16, false },
+        { "DICTB", encode_type::DICT_BLOCKS, false },
+        { "MASKM", encode_type::MASK_MULTI, false }
+    };
+
+    bool all_match = true;
+    try
+    {
+        interp_params params;
+        if (argc > 2)
+            params.cache_sets = std::stoull(argv[2]);
+        if (argc > 3)
+            params.cache_ways = std::stoull(argv[3]);
+
+        ELFIO::elfio reader;
+        if (!reader.load(argv[1]))
+        {
+            std::cout << "Can't find or process ELF file " << argv[1] << std::endl;
+            return 1;
+        }
+        interp_stat base = rv32i_run(&reader, params);
+        std::cout << base.output;
+        std::cout << "Exit code " << base.exit_code << ", " << base.instructions << " instructions, "
+                  << base.seconds << " s" << std::endl;
+
+        std::cout << "etype\tsize\tseconds\tbits/instr\tdict reads/instr\thit rate\toutput" << std::endl;
+        for (const auto &cfg : configs)
+        {
+            if (!reader.load(argv[1]))
+                return 1;
+
+            config_builder cfg_builder;
+            cfg_builder.set_etype(cfg.etype);
+            cfg_builder.set_entropy_coding(cfg.entropy);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            interp_stat stat = rv32i_run(&reader, params);
+            bool match = stat.output == base.output && stat.exit_code == base.exit_code && stat.instructions == base.instructions;
+            all_match = all_match && match;
+
+            std::cout << cfg.name << "\t" << sz_stat.final_code_size + sz_stat.dict_32_bit_size + sz_stat.entropy_table_size << "\t"
+                      << stat.seconds << "\t" << stat.bits_per_instruction() << "\t" << stat.dict_reads_per_instruction() << "\t"
+                      << stat.hit_rate() << "\t" << (match ? "ok" : "MISMATCH") << std::endl;
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "elfio/elfio.hpp"
+
+#include "../lib/workload_model.h"
+
+using namespace utils;
+
+namespace utils
+{
+
+ELFIO::section *get_section_with_name(const ELFIO::elfio *file, const std::string &name);
+
+}
+
+// Synthetic rv32i executable learned from corpus ELFs:
+// workload_gen.exe <output> <size in MB> <seed> <corpus ELF>...
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        std::cout << "Usage: " << argv[0] << " <output> <size in MB> <seed> <corpus ELF>..." << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        size_t text_size = std::stoull(argv[2]) << 20;
+        uint64_t seed = std::stoull(argv[3]);
+
+        workload_model model;
+        for (int i = 4; i < argc; ++i)
+        {
+            ELFIO::elfio reader;
+            if (!reader.load(argv[i]))
+            {
+                std::cout << "Can't find or process ELF file " << argv[i] << std::endl;
+                return 1;
+            }
+            const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+            model.learn(std::span<const uint8_t>((const uint8_t *)text_sec->get_data(), text_sec->get_size()));
+        }
+
+        std::vector<uint8_t> text = model.generate(text_size, seed);
+        workload_write_elf(argv[1], text);
+
+        std::cout << "Learned " << model.get_learned_cnt() << " instructions, "
+                  << model.get_class_cnt() << " classes" << std::endl;
+        std::cout << "Written " << text.size() << " bytes of .text to " << argv[1] << std::endl;
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "addr_table.h"
+
+#include <stdexcept>
+
+namespace utils
+{
+
+static void put_le(std::vector<char> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static size_t get_le(const char *data, size_t size, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > size)
+        throw std::runtime_error("Address table is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)(unsigned char)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+static size_t count_targets(uint16_t targets_map)
+{
+    size_t cnt = 0;
+    for (; targets_map != 0; targets_map &= targets_map - 1)
+        cnt++;
+    return cnt;
+}
+
+addr_table::addr_table() { }
+
+addr_table::addr_table(const std::vector<size_t> &block_offsets, const std::vector<size_t> &targets, size_t cmdlen)
+    : _cmdlen(cmdlen)
+{
+    const size_t line_size = (size_t)1 << LINE_SHIFT;
+    const size_t line_slots = line_size / cmdlen;
+    if (line_slots == 0 || line_slots > MAX_LINE_SLOTS)
+        throw std::runtime_error("Command length doesn't fit address table line");
+
+    size_t lines_cnt = (block_offsets.size() + line_slots - 1) / line_slots;
+    _bases.resize(lines_cnt);
+    _targets_maps.assign(lines_cnt, 0);
+    _first_delta.assign(lines_cnt, 0);
+
+    for (size_t line = 0; line < lines_cnt; ++line)
+    {
+        if (block_offsets[line * line_slots] > 0xffffffff)
+            throw std::runtime_error("Address table offset overflow");
+        _bases[line] = block_offsets[line * line_slots];
+    }
+
+    auto it = targets.begin();
+    for (size_t line = 0; line < lines_cnt; ++line)
+    {
+        _first_delta[line] = _deltas.size();
+        size_t line_end = (line + 1) * line_size;
+        for (; it != targets.end() && *it < line_end; ++it)
+        {
+            size_t slot = (*it % line_size) / cmdlen;
+            size_t cmd_indx = *it / cmdlen;
+            if (*it % cmdlen != 0 || cmd_indx >= block_offsets.size() || slot == 0)
+                continue;
+
+            size_t delta = block_offsets[cmd_indx] - _bases[line];
+            if (delta > 0xffff)
+                throw std::runtime_error("Address table delta overflow");
+
+            _targets_maps[line] |= 1 << slot;
+            _deltas.push_back(delta);
+        }
+    }
+}
+
+size_t addr_table::get_lines_cnt() const
+{
+    return _bases.size();
+}
+
+bool addr_table::lookup(size_t offset, size_t &bitpos) const
+{
+    size_t line = offset >> LINE_SHIFT;
+    size_t slot = (offset & (((size_t)1 << LINE_SHIFT) - 1)) / _cmdlen;
+    if (line >= _bases.size() || offset % _cmdlen != 0)
+        return false;
+
+    if (slot == 0)
+    {
+        bitpos = _bases[line];
+        return true;
+    }
+
+    uint16_t targets_map = _targets_maps[line];
+    if (((targets_map >> slot) & 0x1) == 0)
+        return false;
+
+    size_t rank = count_targets(targets_map & ((1 << slot) - 1));
+    bitpos = _bases[line] + _deltas[_first_delta[line] + rank];
+    return true;
+}
+
+bool addr_table::lookup_line(size_t offset, size_t &bitpos, size_t &skip_cnt) const
+{
+    size_t line = offset >> LINE_SHIFT;
+    if (line >= _bases.size() || offset % _cmdlen != 0)
+        return false;
+
+    bitpos = _bases[line];
+    skip_cnt = (offset & (((size_t)1 << LINE_SHIFT) - 1)) / _cmdlen;
+    return true;
+}
+
+std::vector<char> addr_table::serialize() const
+{
+    std::vector<char> data;
+    put_le(data, _bases.size(), 4);
+    put_le(data, LINE_SHIFT, 1);
+    put_le(data, _cmdlen, 1);
+
+    for (size_t line = 0; line < _bases.size(); ++line)
+    {
+        put_le(data, _bases[line], 4);
+        put_le(data, _targets_maps[line], 2);
+        size_t cnt = count_targets(_targets_maps[line]);
+        for (size_t i = 0; i < cnt; ++i)
+            put_le(data, _deltas[_first_delta[line] + i], 2);
+    }
+    return data;
+}
+
+addr_table addr_table::deserialize(const char *data, size_t size)
+{
+    addr_table atab;
+    size_t pos = 0;
+    size_t lines_cnt = get_le(data, size, pos, 4);
+    if (get_le(data, size, pos, 1) != LINE_SHIFT)
+        throw std::runtime_error("Unsupported address table line size");
+    atab._cmdlen = get_le(data, size, pos, 1);
+    if (atab._cmdlen == 0)
+        throw std::runtime_error("Bad address table command length");
+
+    for (size_t line = 0; line < lines_cnt; ++line)
+    {
+        atab._bases.push_back(get_le(data, size, pos, 4));
+        uint16_t targets_map = get_le(data, size, pos, 2);
+        atab._targets_maps.push_back(targets_map);
+        atab._first_delta.push_back(atab._deltas.size());
+
+        size_t cnt = count_targets(targets_map);
+        for (size_t i = 0; i < cnt; ++i)
+            atab._deltas.push_back(get_le(data, size, pos, 2));
+    }
+    return atab;
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils
+{
+
+// Line address table: maps offsets in original code section to bit offsets
+// in compressed one. Every cache line keeps bit offset of its first command,
+// jump targets inside the line are stored as deltas from it
+class addr_table
+{
+public:
+    static const size_t LINE_SHIFT = 6;     // 64 byte lines
+    static const size_t MAX_LINE_SLOTS = 16;
+
+    addr_table();
+
+    // block_offsets - compressed bit offset of every command,
+    // targets - sorted offsets (bytes) of jump targets in original section
+    addr_table(const std::vector<size_t> &block_offsets, const std::vector<size_t> &targets, size_t cmdlen);
+
+    size_t get_lines_cnt() const;
+
+    // Exact position of a jump target
+    bool lookup(size_t offset, size_t &bitpos) const;
+
+    // Position of the first command of line containing offset and number
+    // of commands to skip from it
+    bool lookup_line(size_t offset, size_t &bitpos, size_t &skip_cnt) const;
+
+    // u32 lines count, u8 line shift, u8 cmdlen, then for every line:
+    // u32 base, u16 targets bitmap, u16 delta for every target except slot 0
+    std::vector<char> serialize() const;
+    static addr_table deserialize(const char *data, size_t size);
+
+private:
+    size_t _cmdlen { 4 };
+    std::vector<uint32_t> _bases;
+    std::vector<uint16_t> _targets_maps;
+    std::vector<uint32_t> _first_delta;     // index in _deltas for every line
+    std::vector<uint16_t> _deltas;
+};
+
+}
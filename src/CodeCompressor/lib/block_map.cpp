@@ -0,0 +1,211 @@
+#include "block_map.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace utils
+{
+
+static void put_le(std::vector<char> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static size_t get_le(const char *data, size_t size, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > size)
+        throw std::runtime_error("Block map is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)(unsigned char)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+block_map::block_map() { }
+
+block_map::block_map(size_t block_shift, std::vector<size_t> dict_sizes, std::vector<uint8_t> block_dicts)
+    : _block_shift(block_shift), _dict_sizes(std::move(dict_sizes)), _block_dicts(std::move(block_dicts))
+{
+    if (_block_shift >= 32 || _dict_sizes.size() > 0xff)
+        throw std::runtime_error("Bad block map layout");
+
+    size_t start = 0;
+    for (size_t dict_size : _dict_sizes)
+    {
+        if (dict_size > 0xffff)
+            throw std::runtime_error("Bad block map layout");
+        _dict_starts.push_back(start);
+        start += dict_size;
+    }
+    for (uint8_t dict : _block_dicts)
+    {
+        if (dict >= _dict_sizes.size())
+            throw std::runtime_error("Block map refers to missing dictionary");
+    }
+}
+
+size_t block_map::get_block_shift() const
+{
+    return _block_shift;
+}
+
+size_t block_map::get_blocks_cnt() const
+{
+    return _block_dicts.size();
+}
+
+const std::vector<size_t> &block_map::get_dict_sizes() const
+{
+    return _dict_sizes;
+}
+
+const std::vector<uint8_t> &block_map::get_block_dicts() const
+{
+    return _block_dicts;
+}
+
+size_t block_map::get_dict(size_t indx) const
+{
+    size_t block = indx >> _block_shift;
+    if (block >= _block_dicts.size())
+        throw std::runtime_error("Command is out of block map");
+    return _block_dicts[block];
+}
+
+size_t block_map::get_dict_start(size_t dict) const
+{
+    return _dict_starts.at(dict);
+}
+
+std::vector<char> block_map::serialize() const
+{
+    std::vector<char> data;
+    put_le(data, _block_shift, 1);
+    put_le(data, _dict_sizes.size(), 1);
+    for (size_t dict_size : _dict_sizes)
+        put_le(data, dict_size, 2);
+    data.insert(data.end(), _block_dicts.begin(), _block_dicts.end());
+    return data;
+}
+
+block_map block_map::deserialize(const char *data, size_t size)
+{
+    size_t pos = 0;
+    size_t block_shift = get_le(data, size, pos, 1);
+    std::vector<size_t> dict_sizes(get_le(data, size, pos, 1));
+    for (auto &dict_size : dict_sizes)
+        dict_size = get_le(data, size, pos, 2);
+    return block_map(block_shift, std::move(dict_sizes), std::vector<uint8_t>(data + pos, data + size));
+}
+
+const size_t CLUSTER_ITERATIONS = 16;
+
+// opcode and funct3 of rv32i command
+static size_t command_class(const command &cmd)
+{
+    size_t value = cmd.to_size_t();
+    return (value & 0x7f) | ((value >> 12) & 0x7) << 7;
+}
+
+static double squared_distance(const double *a, const double *b, size_t dims_cnt)
+{
+    double sum = 0;
+    for (size_t i = 0; i < dims_cnt; ++i)
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    return sum;
+}
+
+std::vector<uint8_t> cluster_blocks(const std::vector<command> &commands, size_t block_shift, size_t clusters_cnt)
+{
+    if (clusters_cnt > 0x100)
+        throw std::runtime_error("Too many block clusters");
+
+    size_t block_cmds = (size_t)1 << block_shift;
+    size_t blocks_cnt = (commands.size() + block_cmds - 1) >> block_shift;
+    clusters_cnt = std::min(clusters_cnt, blocks_cnt);
+    std::vector<uint8_t> clusters(blocks_cnt, 0);
+    if (clusters_cnt <= 1)
+        return clusters;
+
+    // Only classes present in .text are dimensions of features
+    std::vector<size_t> dims(1 << 10, SIZE_MAX);
+    size_t dims_cnt = 0;
+    for (const auto &cmd : commands)
+    {
+        size_t cls = command_class(cmd);
+        if (dims[cls] == SIZE_MAX)
+            dims[cls] = dims_cnt++;
+    }
+
+    std::vector<double> features(blocks_cnt * dims_cnt, 0.0);
+    for (size_t i = 0; i < commands.size(); ++i)
+        features[(i >> block_shift) * dims_cnt + dims[command_class(commands[i])]] += 1;
+    for (size_t b = 0; b < blocks_cnt; ++b)
+    {
+        double cnt = std::min(block_cmds, commands.size() - (b << block_shift));
+        for (size_t d = 0; d < dims_cnt; ++d)
+            features[b * dims_cnt + d] /= cnt;
+    }
+
+    // Every next center is the block farthest from centers chosen before
+    std::vector<double> centers;
+    std::vector<double> nearest(blocks_cnt, std::numeric_limits<double>::max());
+    size_t next = 0;
+    for (size_t c = 0; c < clusters_cnt; ++c)
+    {
+        const double *center = &features[next * dims_cnt];
+        centers.insert(centers.end(), center, center + dims_cnt);
+        for (size_t b = 0; b < blocks_cnt; ++b)
+        {
+            nearest[b] = std::min(nearest[b], squared_distance(&features[b * dims_cnt], &centers[c * dims_cnt], dims_cnt));
+            if (nearest[b] > nearest[next])
+                next = b;
+        }
+    }
+
+    for (size_t iter = 0; iter < CLUSTER_ITERATIONS; ++iter)
+    {
+        bool changed = false;
+        for (size_t b = 0; b < blocks_cnt; ++b)
+        {
+            size_t best = 0;
+            double best_distance = std::numeric_limits<double>::max();
+            for (size_t c = 0; c < clusters_cnt; ++c)
+            {
+                double distance = squared_distance(&features[b * dims_cnt], &centers[c * dims_cnt], dims_cnt);
+                if (distance < best_distance)
+                {
+                    best = c;
+                    best_distance = distance;
+                }
+            }
+            changed |= clusters[b] != best;
+            clusters[b] = best;
+        }
+        if (!changed && iter != 0)
+            break;
+
+        // Empty cluster keeps its center
+        std::vector<double> sums(clusters_cnt * dims_cnt, 0.0);
+        std::vector<size_t> sizes(clusters_cnt, 0);
+        for (size_t b = 0; b < blocks_cnt; ++b)
+        {
+            sizes[clusters[b]]++;
+            for (size_t d = 0; d < dims_cnt; ++d)
+                sums[clusters[b] * dims_cnt + d] += features[b * dims_cnt + d];
+        }
+        for (size_t c = 0; c < clusters_cnt; ++c)
+        {
+            for (size_t d = 0; sizes[c] != 0 && d < dims_cnt; ++d)
+                centers[c * dims_cnt + d] = sums[c * dims_cnt + d] / sizes[c];
+        }
+    }
+
+    return clusters;
+}
+
+}
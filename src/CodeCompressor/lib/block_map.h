@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "command.h"
+
+namespace utils
+{
+
+// Dictionary of every block of DICT_BLOCKS code: .text is split into blocks
+// of 1 << block_shift commands, all commands of a block are encoded with one
+// of the dictionaries. Dictionaries are stored one after another in .dict
+class block_map
+{
+public:
+    block_map();
+
+    // dict_sizes - entries of every dictionary, block_dicts - dictionary of every block
+    block_map(size_t block_shift, std::vector<size_t> dict_sizes, std::vector<uint8_t> block_dicts);
+
+    size_t get_block_shift() const;
+    size_t get_blocks_cnt() const;
+    const std::vector<size_t> &get_dict_sizes() const;
+    const std::vector<uint8_t> &get_block_dicts() const;
+
+    // Dictionary of command with index indx of original section
+    size_t get_dict(size_t indx) const;
+
+    // Index of the first entry of dictionary in .dict
+    size_t get_dict_start(size_t dict) const;
+
+    // u8 block shift, u8 dictionaries count, u16 entries count of every
+    // dictionary, then u8 dictionary of every block
+    std::vector<char> serialize() const;
+    static block_map deserialize(const char *data, size_t size);
+
+private:
+    size_t _block_shift { 0 };
+    std::vector<size_t> _dict_sizes;
+    std::vector<size_t> _dict_starts;
+    std::vector<uint8_t> _block_dicts;
+};
+
+// Initial clusters of blocks for dictionary training: k-means of normalized
+// opcode and funct3 histograms of blocks, centers start from the farthest
+// blocks. Deterministic, returns cluster of every block, clusters_cnt is at
+// most 256
+std::vector<uint8_t> cluster_blocks(const std::vector<command> &commands, size_t block_shift, size_t clusters_cnt);
+
+}
@@ -0,0 +1,182 @@
+#include "code_header.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils
+{
+
+static void put_le(std::vector<uint8_t> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static size_t get_le(std::span<const uint8_t> data, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > data.size())
+        throw std::runtime_error("Compressed section is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+uint32_t adler32(std::span<const uint8_t> data)
+{
+    const uint32_t mod = 65521;
+    const size_t chunk = 5552;      // longest run without overflow of b
+
+    uint32_t a = 1, b = 0;
+    for (size_t start = 0; start < data.size(); start += chunk)
+    {
+        size_t end = std::min(data.size(), start + chunk);
+        for (size_t i = start; i < end; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= mod;
+        b %= mod;
+    }
+    return b << 16 | a;
+}
+
+// Position tables are built from the stream, not needed to decode it
+static bool is_stream_dict(const std::string &name)
+{
+    return name != ".dict.addr" && name != ".dict.func";
+}
+
+void code_header::add_dicts(const dict_views &views)
+{
+    for (const auto &view : views)
+    {
+        if (is_stream_dict(view.first))
+            dicts.push_back({ view.first, view.second.size(), adler32(view.second) });
+    }
+}
+
+std::vector<uint8_t> code_header::serialize() const
+{
+    if (parts.size() > 0xff || dicts.size() > 0xff || cmds_cnt > 0xffffffff)
+        throw std::runtime_error("Compressed section header overflow");
+
+    std::vector<uint8_t> data;
+    size_t pad_bits = (8 - stream_bits % 8) % 8;
+    put_le(data, ((size_t)etype & 0x1f) | pad_bits << 5, 1);
+    put_le(data, CODE_HEADER_VERSION, 1);
+    put_le(data, 0, 2);
+    put_le(data, cmds_cnt, 4);
+    put_le(data, stream_checksum, 4);
+
+    put_le(data, cmdlen, 1);
+    put_le(data, parts.size(), 1);
+    for (const auto &part : parts)
+    {
+        put_le(data, part.cmdlen, 1);
+        put_le(data, part.pos_size, 1);
+        put_le(data, part.mask_size, 1);
+        put_le(data, part.indx_size, 1);
+    }
+
+    put_le(data, dicts.size(), 1);
+    for (const auto &dict : dicts)
+    {
+        if (dict.name.size() > 0xff || dict.size > 0xffffffff)
+            throw std::runtime_error("Compressed section header overflow");
+        put_le(data, dict.name.size(), 1);
+        data.insert(data.end(), dict.name.begin(), dict.name.end());
+        put_le(data, dict.size, 4);
+        put_le(data, dict.checksum, 4);
+    }
+
+    size_t header_size = data.size() + 4;
+    if (header_size > 0xffff)
+        throw std::runtime_error("Compressed section header overflow");
+    data[2] = header_size & 0xff;
+    data[3] = header_size >> 8;
+    put_le(data, adler32(data), 4);
+    return data;
+}
+
+code_header code_header::deserialize(std::span<const uint8_t> code, size_t &header_size)
+{
+    code_header header;
+    size_t pos = 0;
+    size_t metadata = get_le(code, pos, 1);
+    if (get_le(code, pos, 1) != CODE_HEADER_VERSION)
+        throw std::runtime_error("Unsupported compressed section version");
+    header_size = get_le(code, pos, 2);
+    if (header_size < 8 || header_size > code.size())
+        throw std::runtime_error("Compressed section is truncated");
+    std::span<const uint8_t> data = code.first(header_size - 4);
+    size_t checksum_pos = header_size - 4;
+    if (adler32(data) != get_le(code, checksum_pos, 4))
+        throw std::runtime_error("Compressed section header is damaged");
+
+    header.etype = (encode_type)(metadata & 0x1f);
+    header.cmds_cnt = get_le(data, pos, 4);
+    header.stream_checksum = get_le(data, pos, 4);
+
+    size_t stream_bytes = code.size() - header_size;
+    size_t pad_bits = metadata >> 5;
+    if (stream_bytes == 0 && pad_bits != 0)
+        throw std::runtime_error("Compressed section is truncated");
+    header.stream_bits = stream_bytes * 8 - pad_bits;
+
+    header.cmdlen = get_le(data, pos, 1);
+    header.parts.resize(get_le(data, pos, 1));
+    for (auto &part : header.parts)
+    {
+        part.cmdlen = get_le(data, pos, 1);
+        part.pos_size = get_le(data, pos, 1);
+        part.mask_size = get_le(data, pos, 1);
+        part.indx_size = get_le(data, pos, 1);
+    }
+
+    header.dicts.resize(get_le(data, pos, 1));
+    for (auto &dict : header.dicts)
+    {
+        size_t name_size = get_le(data, pos, 1);
+        if (pos + name_size > data.size())
+            throw std::runtime_error("Compressed section is truncated");
+        dict.name.assign((const char *)data.data() + pos, name_size);
+        pos += name_size;
+        dict.size = get_le(data, pos, 4);
+        dict.checksum = get_le(data, pos, 4);
+    }
+    if (pos != data.size())
+        throw std::runtime_error("Compressed section header is damaged");
+    return header;
+}
+
+bool code_header::check(std::span<const uint8_t> stream, const dict_views &views) const
+{
+    if (adler32(stream) != stream_checksum)
+        return false;
+
+    for (const auto &dict : dicts)
+    {
+        auto view = views.find(dict.name);
+        if (view == views.end() || view->second.size() != dict.size || adler32(view->second) != dict.checksum)
+            return false;
+    }
+    return true;
+}
+
+void code_header::check_dict_sizes(const dict_views &views) const
+{
+    for (const auto &dict : dicts)
+    {
+        auto view = views.find(dict.name);
+        if (view == views.end())
+            throw std::runtime_error("No section with name: " + dict.name);
+        if (view->second.size() != dict.size)
+            throw std::runtime_error("Dictionary " + dict.name + " doesn't match compressed section");
+    }
+}
+
+}
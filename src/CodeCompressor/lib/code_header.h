@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "code_image.h"
+#include "config.h"
+
+namespace utils
+{
+
+const size_t CODE_HEADER_VERSION = 1;
+
+// Codeword of one part of command: part length in bytes, widths of mask
+// position, mask and dictionary index. Formats without masks have 0 widths
+struct codeword_part
+{
+    size_t cmdlen;
+    size_t pos_size;
+    size_t mask_size;
+    size_t indx_size;
+
+    bool operator==(const codeword_part &other) const = default;
+};
+
+// Dictionary the stream is decoded with
+struct header_dict
+{
+    std::string name;
+    size_t size;
+    uint32_t checksum;
+};
+
+// Adler-32, fast checksum of stream and dictionaries
+uint32_t adler32(std::span<const uint8_t> data);
+
+// Header of compressed .text, describes everything needed to decode the
+// stream after it and to check it without decoding
+class code_header
+{
+public:
+    encode_type etype { encode_type::DICT };
+    size_t cmdlen { 4 };                    // bytes of original command
+    size_t cmds_cnt { 0 };
+    size_t stream_bits { 0 };
+    uint32_t stream_checksum { 0 };
+    std::vector<codeword_part> parts;
+    std::vector<header_dict> dicts;
+
+    // Dictionaries of .dict.addr kind are not part of the stream and skipped
+    void add_dicts(const dict_views &views);
+
+    // u8 etype (low 5 bits) and unused bits of the last stream byte (high 3 bits),
+    // u8 version, u16 header size, u32 commands count, u32 stream checksum,
+    // u8 cmdlen, u8 parts count, then u8 cmdlen, pos, mask, indx of every part,
+    // u8 dicts count, then u8 name length, name, u32 size, u32 checksum of
+    // every dictionary, u32 checksum of the header bytes before it
+    std::vector<uint8_t> serialize() const;
+
+    // Header at the start of code, its size goes to header_size. Version and
+    // header checksum are checked, stream and dictionaries are not
+    static code_header deserialize(std::span<const uint8_t> code, size_t &header_size);
+
+    // Stream and every dictionary have recorded sizes and checksums
+    bool check(std::span<const uint8_t> stream, const dict_views &views) const;
+
+    // Every dictionary is present and has recorded size
+    void check_dict_sizes(const dict_views &views) const;
+};
+
+}
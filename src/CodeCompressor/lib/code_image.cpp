@@ -0,0 +1,34 @@
+#include "code_image.h"
+
+namespace utils
+{
+
+void code_image::add_dict(const std::string &name, std::vector<uint8_t> data)
+{
+    _dicts.emplace_back(name, std::move(data));
+}
+
+const std::vector<uint8_t> *code_image::find_dict(const std::string &name) const
+{
+    for (const auto &dict : _dicts)
+    {
+        if (dict.first == name)
+            return &dict.second;
+    }
+    return nullptr;
+}
+
+const std::vector<std::pair<std::string, std::vector<uint8_t>>> &code_image::get_dicts() const
+{
+    return _dicts;
+}
+
+dict_views code_image::get_dict_views() const
+{
+    dict_views views;
+    for (const auto &dict : _dicts)
+        views[dict.first] = std::span<const uint8_t>(dict.second);
+    return views;
+}
+
+}
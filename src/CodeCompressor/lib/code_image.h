@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+
+// Non owning view of named dictionaries, blobs may live in ELF sections or
+// in any other container of compressed code
+using dict_views = std::map<std::string, std::span<const uint8_t>>;
+
+// Compressed code independent of container format: .text bitstream with
+// header and dictionary blobs named after sections of compressed ELF file
+class code_image
+{
+public:
+    std::vector<uint8_t> code;
+
+    // Adds dictionary, order of addition is kept
+    void add_dict(const std::string &name, std::vector<uint8_t> data);
+
+    // nullptr if there is no dictionary with such name
+    const std::vector<uint8_t> *find_dict(const std::string &name) const;
+
+    const std::vector<std::pair<std::string, std::vector<uint8_t>>> &get_dicts() const;
+
+    dict_views get_dict_views() const;
+
+private:
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> _dicts;
+};
+
+}
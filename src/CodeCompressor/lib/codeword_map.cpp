@@ -0,0 +1,232 @@
+#include "codeword_map.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace utils
+{
+
+const char CODEWORD_MAP_MAGIC[] = "CWMP";
+const size_t CODEWORD_MAP_VERSION = 1;
+
+static void put_le(std::vector<char> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static size_t get_le(const char *data, size_t size, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > size)
+        throw std::runtime_error("Codeword map is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)(unsigned char)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+const char *codeword_class_name(codeword_class cls)
+{
+    switch (cls)
+    {
+        case codeword_class::DICT:
+            return "DICT";
+        case codeword_class::MASK:
+            return "MASK";
+        case codeword_class::LITERAL:
+            return "LITERAL";
+    }
+    return "UNKNOWN";
+}
+
+codeword_map::codeword_map() { }
+
+codeword_map::codeword_map(encode_type etype, uint64_t text_addr, size_t cmdlen, std::vector<codeword_record> records, std::vector<codeword_func> functions)
+    : _etype(etype), _text_addr(text_addr), _cmdlen(cmdlen), _records(std::move(records)), _functions(std::move(functions))
+{
+    if (_cmdlen == 0 || _cmdlen > 0xff)
+        throw std::runtime_error("Bad command length of codeword map");
+
+    std::sort(_functions.begin(), _functions.end(), [](const codeword_func &f1, const codeword_func &f2) {
+        return f1.offset != f2.offset ? f1.offset < f2.offset : f1.name < f2.name;
+    });
+}
+
+encode_type codeword_map::get_etype() const
+{
+    return _etype;
+}
+
+uint64_t codeword_map::get_text_addr() const
+{
+    return _text_addr;
+}
+
+size_t codeword_map::get_cmdlen() const
+{
+    return _cmdlen;
+}
+
+const std::vector<codeword_record> &codeword_map::get_records() const
+{
+    return _records;
+}
+
+const std::vector<codeword_func> &codeword_map::get_functions() const
+{
+    return _functions;
+}
+
+const codeword_func *codeword_map::find_function(size_t offset) const
+{
+    auto it = std::upper_bound(_functions.begin(), _functions.end(), offset, [](size_t value, const codeword_func &f) {
+        return value < f.offset;
+    });
+
+    if (it == _functions.begin() || offset >= std::prev(it)->offset + std::prev(it)->size)
+        return nullptr;
+    return &*std::prev(it);
+}
+
+std::vector<codeword_bucket> codeword_map::get_buckets(size_t bucket_cmds) const
+{
+    if (bucket_cmds == 0)
+        throw std::runtime_error("Empty heatmap bucket");
+
+    std::vector<codeword_bucket> buckets;
+    for (size_t i = 0; i < _records.size(); ++i)
+    {
+        if (i % bucket_cmds == 0)
+            buckets.push_back({ i * _cmdlen });
+        auto &bucket = buckets.back();
+        bucket.cmds++;
+        bucket.counts[(size_t)_records[i].cls]++;
+        bucket.bits += _records[i].bits;
+    }
+    return buckets;
+}
+
+std::vector<char> codeword_map::serialize() const
+{
+    if (_records.size() > 0xffffffff || _functions.size() > 0xffffffff)
+        throw std::runtime_error("Codeword map overflow");
+
+    std::vector<char> data(CODEWORD_MAP_MAGIC, CODEWORD_MAP_MAGIC + 4);
+    put_le(data, CODEWORD_MAP_VERSION, 1);
+    put_le(data, (size_t)_etype, 1);
+    put_le(data, _cmdlen, 1);
+    put_le(data, 0, 1);
+    put_le(data, _text_addr, 8);
+    put_le(data, _records.size(), 4);
+    put_le(data, _functions.size(), 4);
+
+    data.reserve(data.size() + _records.size() * 8);
+    for (const auto &rec : _records)
+    {
+        if (rec.mask_pos > 0x3f)
+            throw std::runtime_error("Codeword map overflow");
+        put_le(data, (size_t)rec.cls | (size_t)rec.mask_pos << 2, 1);
+        put_le(data, rec.opcode, 1);
+        put_le(data, rec.bits, 2);
+        put_le(data, rec.indx, 4);
+    }
+
+    for (const auto &f : _functions)
+    {
+        if (f.offset > 0xffffffff || f.size > 0xffffffff)
+            throw std::runtime_error("Codeword map overflow");
+        put_le(data, f.offset, 4);
+        put_le(data, f.size, 4);
+        size_t name_size = std::min<size_t>(f.name.size(), 0xff);
+        put_le(data, name_size, 1);
+        data.insert(data.end(), f.name.begin(), f.name.begin() + name_size);
+    }
+    return data;
+}
+
+codeword_map codeword_map::deserialize(const char *data, size_t size)
+{
+    if (size < 4 || !std::equal(CODEWORD_MAP_MAGIC, CODEWORD_MAP_MAGIC + 4, data))
+        throw std::runtime_error("Not a codeword map");
+
+    size_t pos = 4;
+    if (get_le(data, size, pos, 1) != CODEWORD_MAP_VERSION)
+        throw std::runtime_error("Unsupported codeword map version");
+    encode_type etype = (encode_type)get_le(data, size, pos, 1);
+    size_t cmdlen = get_le(data, size, pos, 1);
+    get_le(data, size, pos, 1);
+    uint64_t text_addr = get_le(data, size, pos, 8);
+    size_t records_cnt = get_le(data, size, pos, 4);
+    size_t functions_cnt = get_le(data, size, pos, 4);
+    if (records_cnt > (size - pos) / 8)
+        throw std::runtime_error("Codeword map is truncated");
+
+    std::vector<codeword_record> records(records_cnt);
+    for (auto &rec : records)
+    {
+        size_t cls = get_le(data, size, pos, 1);
+        if ((cls & 0x3) >= CODEWORD_CLASSES_CNT)
+            throw std::runtime_error("Bad codeword class");
+        rec.cls = (codeword_class)(cls & 0x3);
+        rec.mask_pos = cls >> 2;
+        rec.opcode = get_le(data, size, pos, 1);
+        rec.bits = get_le(data, size, pos, 2);
+        rec.indx = get_le(data, size, pos, 4);
+    }
+
+    std::vector<codeword_func> functions;
+    for (size_t i = 0; i < functions_cnt; ++i)
+    {
+        codeword_func f;
+        f.offset = get_le(data, size, pos, 4);
+        f.size = get_le(data, size, pos, 4);
+        size_t name_size = get_le(data, size, pos, 1);
+        if (pos + name_size > size)
+            throw std::runtime_error("Codeword map is truncated");
+        f.name.assign(data + pos, name_size);
+        pos += name_size;
+        functions.push_back(std::move(f));
+    }
+    if (pos != size)
+        throw std::runtime_error("Codeword map is damaged");
+
+    return codeword_map(etype, text_addr, cmdlen, std::move(records), std::move(functions));
+}
+
+void codeword_map::save(const std::string &filename) const
+{
+    std::vector<char> data = serialize();
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.write(data.data(), data.size()))
+        throw std::runtime_error("Can't write codeword map " + filename);
+}
+
+codeword_map codeword_map::load(const std::string &filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Can't open codeword map " + filename);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return deserialize(data.data(), data.size());
+}
+
+void codeword_map::write_csv(std::ostream &out) const
+{
+    std::ios_base::fmtflags f(out.flags());
+    out << "address,function,opcode,class,mask_pos,index,bits\n";
+    for (size_t i = 0; i < _records.size(); ++i)
+    {
+        const auto &rec = _records[i];
+        const codeword_func *func = find_function(i * _cmdlen);
+        out << "0x" << std::hex << _text_addr + i * _cmdlen << "," << (func != nullptr ? func->name : "") << ",0x"
+            << (unsigned)rec.opcode << std::dec << "," << codeword_class_name(rec.cls) << "," << (unsigned)rec.mask_pos << ","
+            << rec.indx << "," << rec.bits << "\n";
+    }
+    out.flags(f);
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace utils
+{
+
+// Worse classes go later
+enum class codeword_class : uint8_t
+{
+    DICT,
+    MASK,
+    LITERAL,
+};
+
+const size_t CODEWORD_CLASSES_CNT = 3;
+
+const char *codeword_class_name(codeword_class cls);
+
+// Codeword of one instruction. Instruction of several parts gets the worst
+// class of them, mask position and index are of the first part of that class
+struct codeword_record
+{
+    codeword_class cls { codeword_class::DICT };
+    uint8_t mask_pos { 0 };     // MASK: mask position, MASK_MULTI: first window
+    uint8_t opcode { 0 };       // bits 0-6 of original instruction
+    uint16_t bits { 0 };        // whole codeword
+    uint32_t indx { 0 };        // dictionary index, 0 for literal
+};
+
+// Function of original .text, bytes
+struct codeword_func
+{
+    size_t offset;
+    size_t size;
+    std::string name;
+};
+
+// Instructions of every heatmap bucket by codeword class
+struct codeword_bucket
+{
+    size_t offset;              // bytes of original .text
+    size_t cmds { 0 };
+    size_t counts[CODEWORD_CLASSES_CNT] { };
+    size_t bits { 0 };
+};
+
+// Codeword of every instruction address of compressed .text for analysis,
+// see map_executable
+class codeword_map
+{
+public:
+    codeword_map();
+    codeword_map(encode_type etype, uint64_t text_addr, size_t cmdlen, std::vector<codeword_record> records, std::vector<codeword_func> functions);
+
+    encode_type get_etype() const;
+    uint64_t get_text_addr() const;
+    size_t get_cmdlen() const;
+    const std::vector<codeword_record> &get_records() const;
+    const std::vector<codeword_func> &get_functions() const;
+
+    // Function containing offset of original .text, nullptr if there is none
+    const codeword_func *find_function(size_t offset) const;
+
+    // Consecutive buckets of bucket_cmds instructions
+    std::vector<codeword_bucket> get_buckets(size_t bucket_cmds) const;
+
+    // "CWMP", u8 version, u8 etype, u8 cmdlen, u8 0, u64 .text address,
+    // u32 records count, u32 functions count. Every record is 8 bytes:
+    // u8 class | mask position << 2, u8 opcode, u16 bits, u32 index. Every
+    // function: u32 offset, u32 size, u8 name length, name
+    std::vector<char> serialize() const;
+    static codeword_map deserialize(const char *data, size_t size);
+
+    void save(const std::string &filename) const;
+    static codeword_map load(const std::string &filename);
+
+    // Header line, then address,function,opcode,class,mask_pos,index,bits
+    // of every instruction
+    void write_csv(std::ostream &out) const;
+
+private:
+    encode_type _etype { encode_type::DICT };
+    uint64_t _text_addr { 0 };
+    size_t _cmdlen { 4 };
+    std::vector<codeword_record> _records;
+    std::vector<codeword_func> _functions;
+};
+
+}
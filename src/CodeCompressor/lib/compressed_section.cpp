@@ -3,4 +3,22 @@
 namespace utils
 {
 
+void compressed_section::mark_block()
+{
+    if (_progress && _block_offsets.size() % PROGRESS_STEP == 0)
+        _progress(progress_phase::ENCODE, _block_offsets.size(), _progress_total);
+    _block_offsets.push_back(get_data_sz_bits());
+}
+
+const std::vector<size_t> &compressed_section::get_block_offsets() const
+{
+    return _block_offsets;
+}
+
+void compressed_section::set_progress(const progress_callback &progress, size_t total)
+{
+    _progress = progress;
+    _progress_total = total;
+}
+
 }
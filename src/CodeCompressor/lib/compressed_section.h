@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+
+#include "config.h"
 #include "dynbitset.h"
 
 namespace utils
@@ -7,7 +10,19 @@ namespace utils
 
 class compressed_section : public dynbitset
 {
-    
+public:
+    // Remembers current bit position as start of next instruction, reports
+    // ENCODE progress every PROGRESS_STEP instructions
+    void mark_block();
+
+    const std::vector<size_t> &get_block_offsets() const;
+
+    void set_progress(const progress_callback &progress, size_t total);
+
+private:
+    std::vector<size_t> _block_offsets;
+    progress_callback _progress;
+    size_t _progress_total { 0 };
 };
 
 }
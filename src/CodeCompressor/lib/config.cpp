@@ -3,16 +3,120 @@
 namespace utils
 {
 
+operation_cancelled::operation_cancelled()
+    : std::runtime_error("Operation is cancelled")
+{
+}
+
+cancel_token::cancel_token()
+    : _cancelled(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+void cancel_token::cancel()
+{
+    _cancelled->store(true, std::memory_order_relaxed);
+}
+
+bool cancel_token::is_cancelled() const
+{
+    return _cancelled->load(std::memory_order_relaxed);
+}
+
 encode_type config::get_etype() const
 {
     return _etype;
 }
 
+bool config::get_entropy_coding() const
+{
+    return _entropy_coding;
+}
+
+const progress_callback &config::get_progress() const
+{
+    return _progress;
+}
+
+size_t config::get_memory_budget() const
+{
+    return _memory_budget;
+}
+
+std::span<const uint64_t> config::get_exec_counts() const
+{
+    if (!_exec_counts)
+        return { };
+    return *_exec_counts;
+}
+
+bool config::get_function_units() const
+{
+    return _function_units;
+}
+
+const std::string &config::get_cache_dir() const
+{
+    return _cache_dir;
+}
+
+size_t config::get_block_dicts() const
+{
+    return _block_dicts;
+}
+
+size_t config::get_hot_dict() const
+{
+    return _hot_dict;
+}
+
+size_t config::get_histogram_threads() const
+{
+    return _histogram_threads;
+}
+
+dict_order config::get_dict_order() const
+{
+    return _dict_order;
+}
+
+index_coding config::get_index_coding() const
+{
+    return _index_coding;
+}
+
+void config::report_progress(progress_phase phase, size_t processed, size_t total) const
+{
+    if (_progress)
+        _progress(phase, processed, total);
+}
+
 config config_builder::build() const
 {
     config cfg;
 
     cfg._etype = _etype;
+    cfg._entropy_coding = _entropy_coding;
+    cfg._progress = _progress;
+    cfg._memory_budget = _memory_budget;
+    cfg._exec_counts = _exec_counts;
+    cfg._function_units = _function_units;
+    cfg._cache_dir = _cache_dir;
+    cfg._block_dicts = _block_dicts;
+    cfg._hot_dict = _hot_dict;
+    cfg._histogram_threads = _histogram_threads;
+    cfg._dict_order = _dict_order;
+    cfg._index_coding = _index_coding;
+    if (_cancel)
+    {
+        cfg._progress = [progress = _progress, cancel = *_cancel](progress_phase phase, size_t processed, size_t total)
+        {
+            if (cancel.is_cancelled())
+                throw operation_cancelled();
+            if (progress)
+                progress(phase, processed, total);
+        };
+    }
 
     return cfg;
 }
@@ -21,4 +125,65 @@ void config_builder::set_etype(encode_type etype)
 {
     _etype = etype;
 }
+
+void config_builder::set_entropy_coding(bool entropy_coding)
+{
+    _entropy_coding = entropy_coding;
+}
+
+void config_builder::set_progress(progress_callback progress)
+{
+    _progress = std::move(progress);
+}
+
+void config_builder::set_cancel_token(cancel_token token)
+{
+    _cancel = std::move(token);
+}
+
+void config_builder::set_memory_budget(size_t bytes)
+{
+    _memory_budget = bytes;
+}
+
+void config_builder::set_exec_counts(std::vector<uint64_t> counts)
+{
+    _exec_counts = std::make_shared<const std::vector<uint64_t>>(std::move(counts));
+}
+
+void config_builder::set_function_units(bool function_units)
+{
+    _function_units = function_units;
+}
+
+void config_builder::set_cache_dir(std::string dir)
+{
+    _cache_dir = std::move(dir);
+}
+
+void config_builder::set_block_dicts(size_t cnt)
+{
+    _block_dicts = cnt;
+}
+
+void config_builder::set_hot_dict(size_t entries)
+{
+    _hot_dict = entries;
+}
+
+void config_builder::set_histogram_threads(size_t threads)
+{
+    _histogram_threads = threads;
+}
+
+void config_builder::set_dict_order(dict_order order)
+{
+    _dict_order = order;
+}
+
+void config_builder::set_index_coding(index_coding coding)
+{
+    _index_coding = coding;
+}
+
 }
@@ -1,6 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 enum class encode_type
 {
@@ -10,22 +19,120 @@ enum class encode_type
     MASK_QUAD,
     MASK_OPERANDS_OPCODE,
     MASK_DUO_QUAD,
+    RV32I_FIELDS,
+    FIXED16,
+    DICT_BLOCKS,
+    MASK_MULTI,
 };
 
 namespace utils
 {
 
+// Bumped on every change of compressed output, part of result cache keys
+const uint32_t LIBCOMPRESS_VERSION = 7;
+
+enum class progress_phase
+{
+    HISTOGRAM,
+    DICTIONARY,
+    ENCODE,
+    DECODE,
+};
+
+// Instructions processed of total in phase. Callback may throw to abort
+// the operation, the exception goes out of compress/decompress functions
+using progress_callback = std::function<void(progress_phase phase, size_t processed, size_t total)>;
+
+// Loops report progress and check cancellation once per PROGRESS_STEP instructions
+const size_t PROGRESS_STEP = 4096;
+
+class operation_cancelled : public std::runtime_error
+{
+public:
+    operation_cancelled();
+};
+
+// Copies share one flag, so token kept by caller cancels operation running
+// with config built from it. cancel() may be called from any thread
+class cancel_token
+{
+public:
+    cancel_token();
+
+    void cancel();
+    bool is_cancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> _cancelled;
+};
+
+// Order of DICT dictionary entries: by value, by uses, or chains of
+// entries used one after another
+enum class dict_order
+{
+    VALUE,
+    FREQUENCY,
+    ADJACENCY,
+};
+
+// DICT index codeword: the whole index, or a short difference from the
+// previous index, or a short rank in the list of recently used indices
+enum class index_coding
+{
+    FIXED,
+    DELTA,
+    MTF,
+};
+
 class config_builder;
 
 class config
 {
 public:
     encode_type get_etype() const;
+    bool get_entropy_coding() const;
+    // Progress callback with cancellation check, empty if neither is set
+    const progress_callback &get_progress() const;
+
+    // Throws operation_cancelled if cancel was requested
+    void report_progress(progress_phase phase, size_t processed, size_t total) const;
+
+    size_t get_memory_budget() const;
+
+    // Empty if no profile is set
+    std::span<const uint64_t> get_exec_counts() const;
+
+    bool get_function_units() const;
+
+    // Empty if results are not cached
+    const std::string &get_cache_dir() const;
+
+    size_t get_block_dicts() const;
+
+    // 0 if dictionary has one level
+    size_t get_hot_dict() const;
+
+    // 0 is hardware concurrency
+    size_t get_histogram_threads() const;
+
+    dict_order get_dict_order() const;
+    index_coding get_index_coding() const;
 
     friend class config_builder;
 
 private:
-    encode_type _etype;
+    encode_type _etype { encode_type::DICT };
+    bool _entropy_coding { false };
+    progress_callback _progress;
+    size_t _memory_budget { 0 };
+    std::shared_ptr<const std::vector<uint64_t>> _exec_counts;
+    bool _function_units { false };
+    std::string _cache_dir;
+    size_t _block_dicts { 4 };
+    size_t _hot_dict { 0 };
+    size_t _histogram_threads { 1 };
+    dict_order _dict_order { dict_order::VALUE };
+    index_coding _index_coding { index_coding::FIXED };
 };
 
 class config_builder
@@ -35,8 +142,71 @@ public:
 
     void set_etype(encode_type etype);
 
+    // Huffman coding of dictionary indices and codeword classes (DICT, MASK_SINGLE)
+    void set_entropy_coding(bool entropy_coding);
+
+    // Called at phase boundaries and every PROGRESS_STEP instructions
+    void set_progress(progress_callback progress);
+
+    // Checked as often as progress is reported
+    void set_cancel_token(cancel_token token);
+
+    // Estimated working set limit in bytes, 0 is unlimited. Histograms that
+    // don't fit are counted with flat sorted windows, result is the same
+    void set_memory_budget(size_t bytes);
+
+    // Dynamic execution count of every .text instruction (exec_profile::get_counts).
+    // Dictionaries rank instructions by 1 + execution count instead of static
+    // count, so hot code gets dictionary codewords first
+    void set_exec_counts(std::vector<uint64_t> counts);
+
+    // compress_executable writes .dict.func table of functions from ELF
+    // symbol table (STT_FUNC, without size up to the next one), see decompress_function
+    void set_function_units(bool function_units);
+
+    // Directory of results keyed by hash of .text, options and library
+    // version. On hit stored code and dictionaries are returned without
+    // histogram and encode work, size_stat counts hits and misses
+    void set_cache_dir(std::string dir);
+
+    // Dictionaries of DICT_BLOCKS, at most 255. Blocks of .text are clustered
+    // by instruction statistics, every block is encoded with the dictionary
+    // trained on its cluster
+    void set_block_dicts(size_t cnt);
+
+    // Entries of hot table of two-level dictionary (DICT, MASK_SINGLE), from
+    // 2 to 256, 0 is one level. The most used entries get short indices in
+    // .dict.hot, index of any other goes after one more prefix bit
+    void set_hot_dict(size_t entries);
+
+    // Threads counting dictionary histograms over contiguous ranges of .text,
+    // 0 is hardware concurrency. Counts of threads are merged, dictionaries
+    // are the same for any count. HISTOGRAM progress is reported when all
+    // threads are done
+    void set_histogram_threads(size_t threads);
+
+    // Post-pass of DICT dictionary: entries are renumbered in order, so
+    // used indices are small and related entries are close
+    void set_dict_order(dict_order order);
+
+    // Coding of DICT indices, see index_predictor. DELTA and MTF are written
+    // with .dict.idx, predictor state is reset at every addr_table line
+    void set_index_coding(index_coding coding);
+
 private:
-    encode_type _etype;
+    encode_type _etype { encode_type::DICT };
+    bool _entropy_coding { false };
+    progress_callback _progress;
+    std::optional<cancel_token> _cancel;
+    size_t _memory_budget { 0 };
+    std::shared_ptr<const std::vector<uint64_t>> _exec_counts;
+    bool _function_units { false };
+    std::string _cache_dir;
+    size_t _block_dicts { 4 };
+    size_t _hot_dict { 0 };
+    size_t _histogram_threads { 1 };
+    dict_order _dict_order { dict_order::VALUE };
+    index_coding _index_coding { index_coding::FIXED };
 };
 
 }
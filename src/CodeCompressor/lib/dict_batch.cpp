@@ -0,0 +1,199 @@
+#include "dict_batch.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DICT_BATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace utils
+{
+
+const size_t DICT_LITERAL_BITS = 32;
+
+// Up to 57 stream bits starting from pos, zeros past the end
+static uint64_t load_window(const char *data, size_t bits, size_t pos)
+{
+    size_t byte = pos >> 3;
+    size_t bytes = (bits + 7) >> 3;
+    uint64_t window = 0;
+    if (byte + sizeof(window) <= bytes)
+    {
+        memcpy(&window, data + byte, sizeof(window));
+    }
+    else
+    {
+        for (size_t i = 0; byte + i < bytes; ++i)
+            window |= (uint64_t)(unsigned char)data[byte + i] << (i * 8);
+    }
+    return window >> (pos & 0x7);
+}
+
+static uint32_t dict_decode_one(const char *data, size_t bits, size_t &pos, const uint32_t *dict, size_t dict_cnt, size_t indx_size)
+{
+    uint64_t window = load_window(data, bits, pos);
+    if ((window & 0x1) != 0)
+    {
+        size_t indx = (window >> 1) & ((1 << indx_size) - 1);
+        pos += 1 + indx_size;
+        if (pos > bits)
+            throw std::runtime_error("Truncated codeword in compressed section");
+        if (indx >= dict_cnt)
+            throw std::runtime_error("Dictionary index is out of range");
+        return dict[indx];
+    }
+
+    pos += 1 + DICT_LITERAL_BITS;
+    if (pos > bits)
+        throw std::runtime_error("Truncated codeword in compressed section");
+    return (uint32_t)(window >> 1);
+}
+
+static void check_args(size_t indx_size, size_t dict_cnt)
+{
+    if (indx_size == 0 || indx_size > 24 || dict_cnt > ((size_t)1 << indx_size))
+        throw std::runtime_error("Bad dictionary for batch decoder");
+}
+
+static size_t dict_decode_tail(const char *data, size_t bits, size_t pos, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t cnt, size_t out_cap)
+{
+    for (; pos < bits; ++cnt)
+    {
+        if (cnt >= out_cap)
+            throw std::runtime_error("Output buffer is too small");
+        out[cnt] = dict_decode_one(data, bits, pos, dict, dict_cnt, indx_size);
+    }
+    return cnt;
+}
+
+size_t dict_decode_batch_scalar(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap)
+{
+    check_args(indx_size, dict_cnt);
+    return dict_decode_tail(data, bits, 0, dict, dict_cnt, indx_size, out, 0, out_cap);
+}
+
+#ifdef DICT_BATCH_X86
+
+// Commits the prefix of dictionary hits among 8 extracted codewords
+__attribute__((target("avx2")))
+static inline size_t dict_commit_hits(__m256i words, const uint32_t *dict, size_t dict_cnt, size_t indx_size, uint32_t *out)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i indx = _mm256_and_si256(_mm256_srli_epi32(words, 1), _mm256_set1_epi32((1 << indx_size) - 1));
+    __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(words, one), one),
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(dict_cnt), indx));
+    unsigned hits_map = _mm256_movemask_ps(_mm256_castsi256_ps(hits));
+
+    size_t committed = __builtin_ctz(~hits_map);
+    if (committed != 0)
+    {
+        __m256i values = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)dict, indx, hits, 4);
+        _mm256_storeu_si256((__m256i *)out, values);
+    }
+    return committed;
+}
+
+__attribute__((target("avx2")))
+size_t dict_decode_batch_avx2(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap)
+{
+    check_args(indx_size, dict_cnt);
+
+    const size_t lanes = 8;
+    const size_t hit_bits = 1 + indx_size;
+    const size_t bytes = (bits + 7) >> 3;
+
+    // Short codewords: all 8 lanes fit one 16 byte load and are spread to
+    // lanes by byte shuffle, table per bit offset of current position
+    const bool fits_load = 7 + lanes * hit_bits <= 128;
+    alignas(32) int8_t shuffles[8][32];
+    alignas(32) int32_t shifts[8][8];
+    for (size_t bit = 0; bit < 8; ++bit)
+    {
+        for (size_t k = 0; k < lanes; ++k)
+        {
+            size_t rel = bit + k * hit_bits;
+            for (size_t b = 0; b < sizeof(uint32_t); ++b)
+            {
+                size_t byte = (rel >> 3) + b;
+                shuffles[bit][k * 4 + b] = byte < 16 ? byte : 0x80;
+            }
+            shifts[bit][k] = rel & 0x7;
+        }
+    }
+
+    // Long codewords: every lane loads its 4 bytes with gather
+    const size_t read_span = fits_load ? 16 : ((7 + (lanes - 1) * hit_bits) >> 3) + sizeof(uint32_t);
+    const __m256i steps = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(hit_bits));
+
+    size_t cnt = 0;
+    size_t pos = 0;
+    while (pos < bits && cnt + lanes <= out_cap && (pos >> 3) + read_span <= bytes)
+    {
+        const char *base = data + (pos >> 3);
+        size_t bit = pos & 0x7;
+
+        __m256i words;
+        if (fits_load)
+        {
+            __m256i raw = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)base));
+            raw = _mm256_shuffle_epi8(raw, _mm256_load_si256((const __m256i *)shuffles[bit]));
+            words = _mm256_srlv_epi32(raw, _mm256_load_si256((const __m256i *)shifts[bit]));
+        }
+        else
+        {
+            __m256i rel = _mm256_add_epi32(_mm256_set1_epi32(bit), steps);
+            __m256i raw = _mm256_i32gather_epi32((const int *)base, _mm256_srli_epi32(rel, 3), 1);
+            words = _mm256_srlv_epi32(raw, _mm256_and_si256(rel, _mm256_set1_epi32(7)));
+        }
+
+        // Lanes past the end of the stream may look like hits in padding bits
+        size_t committed = std::min(dict_commit_hits(words, dict, dict_cnt, indx_size, out + cnt), (bits - pos) / hit_bits);
+        if (committed == 0)
+        {
+            out[cnt++] = dict_decode_one(data, bits, pos, dict, dict_cnt, indx_size);
+            continue;
+        }
+
+        cnt += committed;
+        pos += committed * hit_bits;
+    }
+
+    return dict_decode_tail(data, bits, pos, dict, dict_cnt, indx_size, out, cnt, out_cap);
+}
+
+bool dict_decode_batch_has_avx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+size_t dict_decode_batch_avx2(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap)
+{
+    return dict_decode_batch_scalar(data, bits, dict, dict_cnt, indx_size, out, out_cap);
+}
+
+bool dict_decode_batch_has_avx2()
+{
+    return false;
+}
+
+#endif
+
+size_t dict_decode_batch(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap)
+{
+    static const bool has_avx2 = dict_decode_batch_has_avx2();
+    if (has_avx2)
+        return dict_decode_batch_avx2(data, bits, dict, dict_cnt, indx_size, out, out_cap);
+    return dict_decode_batch_scalar(data, bits, dict, dict_cnt, indx_size, out, out_cap);
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils
+{
+
+// Batch decoder of DICT codec stream: flag bit 1 + index (indx_size bits)
+// or flag bit 0 + 32 bit literal. Decoded instructions are written to out,
+// returns their count. indx_size must be at most 24, dict_cnt at most
+// 1 << indx_size
+size_t dict_decode_batch(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap);
+
+size_t dict_decode_batch_scalar(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap);
+
+// AVX2 speculative decoder: extracts 8 codewords at once assuming all of them
+// are dictionary hits and commits the prefix of hits. Literals and the stream
+// tail go through the scalar path
+size_t dict_decode_batch_avx2(const char *data, size_t bits, const uint32_t *dict, size_t dict_cnt,
+    size_t indx_size, uint32_t *out, size_t out_cap);
+
+bool dict_decode_batch_has_avx2();
+
+}
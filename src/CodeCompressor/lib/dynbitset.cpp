@@ -102,6 +102,29 @@ bool dynbitset::getbit(size_t pos) const
     return get_impl(pos);
 }
 
+// Same value as getseq(pos, pos + bitcnt).to_size_t(), but without
+// intermediate bitset. Bits past the end are read as zeros
+size_t dynbitset::getbits(size_t pos, size_t bitcnt) const
+{
+    size_t retval = 0;
+    size_t bytepos = pos >> 3;
+    size_t bitpos = pos & 0x7;
+    size_t readed = 0;
+
+    while (readed < bitcnt && bytepos < _data.size())
+    {
+        size_t byte = (unsigned char)_data[bytepos] >> bitpos;
+        retval |= byte << readed;
+        readed += 8 - bitpos;
+        bitpos = 0;
+        bytepos++;
+    }
+
+    if (bitcnt < sizeof(size_t) * 8)
+        retval &= ((size_t)1 << bitcnt) - 1;
+    return retval;
+}
+
 dynbitset dynbitset::getseq(size_t start, size_t end) const
 {
     dynbitset new_bitset;
@@ -27,6 +27,7 @@ public:
 
     void setbit(size_t pos, bool v);
     bool getbit(size_t pos) const;
+    size_t getbits(size_t pos, size_t bitcnt) const;
     dynbitset getseq(size_t start, size_t end) const;
 
     friend std::ostream &operator<<(std::ostream &os, const dynbitset &dset);
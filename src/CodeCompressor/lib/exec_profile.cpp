@@ -0,0 +1,68 @@
+#include "exec_profile.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace utils
+{
+
+void exec_profile::add(uint64_t pc, uint64_t count)
+{
+    _counts[pc] += count;
+}
+
+uint64_t exec_profile::get_count(uint64_t pc) const
+{
+    auto it = _counts.find(pc);
+    return it != _counts.end() ? it->second : 0;
+}
+
+size_t exec_profile::get_pc_cnt() const
+{
+    return _counts.size();
+}
+
+std::vector<uint64_t> exec_profile::get_counts(uint64_t text_addr, size_t instr_cnt, size_t instr_size) const
+{
+    std::vector<uint64_t> counts(instr_cnt, 0);
+    auto it = _counts.lower_bound(text_addr);
+    for (; it != _counts.end() && it->first < text_addr + instr_cnt * instr_size; ++it)
+    {
+        // Counts of addresses inside an instruction go to the instruction
+        counts[(it->first - text_addr) / instr_size] += it->second;
+    }
+    return counts;
+}
+
+exec_profile exec_profile::load(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("Can't open profile " + path);
+
+    exec_profile profile;
+    std::string line;
+    for (size_t line_num = 1; std::getline(in, line); ++line_num)
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        uint64_t pc = 0;
+        if (!(fields >> std::hex >> pc))
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                throw std::runtime_error("Bad profile line " + std::to_string(line_num) + " in " + path);
+            continue;
+        }
+
+        uint64_t count = 1;
+        fields >> std::ws;
+        if (!fields.eof() && !(fields >> std::dec >> count))
+            throw std::runtime_error("Bad profile line " + std::to_string(line_num) + " in " + path);
+        profile.add(pc, count);
+    }
+
+    return profile;
+}
+
+}
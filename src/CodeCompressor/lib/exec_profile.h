@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace utils
+{
+
+// Dynamic execution counts of instructions by address
+class exec_profile
+{
+public:
+    void add(uint64_t pc, uint64_t count = 1);
+
+    uint64_t get_count(uint64_t pc) const;
+    size_t get_pc_cnt() const;
+
+    // Counts of instr_cnt instructions instr_size bytes long from text_addr,
+    // input for config_builder::set_exec_counts
+    std::vector<uint64_t> get_counts(uint64_t text_addr, size_t instr_cnt, size_t instr_size = 4) const;
+
+    // PC histogram ("<pc> <count>" per line) or simulator trace (one "<pc>"
+    // per executed instruction), pc is hex, '#' starts a comment
+    static exec_profile load(const std::string &path);
+
+private:
+    std::map<uint64_t, uint64_t> _counts;
+};
+
+}
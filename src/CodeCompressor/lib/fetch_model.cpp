@@ -0,0 +1,125 @@
+#include "fetch_model.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils
+{
+
+double fetch_stat::cpi() const
+{
+    return instructions == 0 ? 0.0 : double(cycles) / instructions;
+}
+
+double fetch_stat::stall_rate() const
+{
+    return cycles == 0 ? 0.0 : double(stall_cycles) / cycles;
+}
+
+double fetch_stat::refill_bandwidth() const
+{
+    return cycles == 0 ? 0.0 : double(refill_bits) / cycles;
+}
+
+class fetch_unit
+{
+public:
+    fetch_unit(const fetch_params &params, size_t stream_bits)
+        : _params(params), _stream_bits(stream_bits) { }
+
+    // Stalled decoder waits for a codeword longer than the buffer holds, so
+    // a beat that doesn't fit whole fills the rest of the buffer
+    void tick(fetch_stat &stat, bool stalled = false)
+    {
+        stat.cycles++;
+
+        size_t beat_bits = std::min(_params.bus_bits, _params.buffer_bits - _buffered);
+        bool has_room = beat_bits == _params.bus_bits || (stalled && beat_bits != 0);
+        if (!has_room || _fetched >= _stream_bits)
+            return;
+
+        if (++_beat_progress >= _params.refill_latency)
+        {
+            _beat_progress = 0;
+            _buffered += beat_bits;
+            _fetched += beat_bits;
+            stat.refill_bits += beat_bits;
+        }
+    }
+
+    bool has_bits(size_t bits) const
+    {
+        return _buffered >= bits;
+    }
+
+    void consume(size_t bits)
+    {
+        _buffered -= bits;
+    }
+
+private:
+    const fetch_params &_params;
+    size_t _stream_bits;
+    size_t _fetched { 0 };
+    size_t _buffered { 0 };
+    size_t _beat_progress { 0 };
+};
+
+fetch_stat simulate_fetch(const std::vector<block_trace> &traces, const fetch_params &params)
+{
+    if (params.bus_bits == 0 || params.bus_bits > params.buffer_bits)
+        throw std::runtime_error("Bus width must be in (0, buffer width]");
+
+    size_t stream_bits = 0;
+    for (const auto &trace : traces)
+    {
+        if (trace.bits > params.buffer_bits)
+            throw std::runtime_error("Codeword doesn't fit in fetch buffer");
+        stream_bits += trace.bits;
+    }
+
+    fetch_stat stat;
+    fetch_unit unit(params, stream_bits);
+
+    for (const auto &trace : traces)
+    {
+        while (!unit.has_bits(trace.bits))
+        {
+            unit.tick(stat, true);
+            stat.stall_cycles++;
+        }
+        unit.consume(trace.bits);
+
+        size_t decode_cycles = 1 + trace.dict_levels * params.dict_latency
+            + trace.entropy_symbols * params.entropy_latency;
+        if (trace.mask_applies != 0)
+            decode_cycles += params.mask_latency;
+
+        for (size_t i = 0; i < decode_cycles; ++i)
+            unit.tick(stat);
+
+        stat.instructions++;
+    }
+
+    return stat;
+}
+
+block_trace total_decode_work(const std::vector<block_trace> &traces, std::span<const uint64_t> counts)
+{
+    if (!counts.empty() && counts.size() != traces.size())
+        throw std::runtime_error("Counts don't match traces");
+
+    block_trace total;
+    for (size_t i = 0; i < traces.size(); ++i)
+    {
+        size_t count = counts.empty() ? 1 : counts[i];
+        total.bits += traces[i].bits * count;
+        total.dict_reads += traces[i].dict_reads * count;
+        total.dict_levels += traces[i].dict_levels * count;
+        total.mask_applies += traces[i].mask_applies * count;
+        total.entropy_symbols += traces[i].entropy_symbols * count;
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "codeword_map.h"
+
+namespace utils
+{
+
+// Decoder work for one compressed instruction
+struct block_trace
+{
+    size_t bits { 0 };              // codeword length
+    size_t dict_reads { 0 };        // dictionary lookups (all parts)
+    size_t dict_levels { 0 };       // dependent lookups (next one needs result of previous)
+    size_t mask_applies { 0 };
+    size_t entropy_symbols { 0 };   // huffman symbols decoded
+    codeword_record codeword;       // opcode isn't known without decoding
+    size_t codeword_parts { 0 };
+};
+
+class fetch_params
+{
+public:
+    size_t buffer_bits { 128 };     // decoder bit buffer width
+    size_t bus_bits { 32 };         // bits delivered by one refill beat
+    size_t refill_latency { 1 };    // cycles per refill beat
+    size_t dict_latency { 1 };      // cycles per dependent dictionary read
+    size_t mask_latency { 1 };
+    size_t entropy_latency { 1 };   // cycles per huffman symbol
+};
+
+class fetch_stat
+{
+public:
+    size_t instructions { 0 };
+    size_t cycles { 0 };
+    size_t stall_cycles { 0 };      // decoder waits for bits in buffer
+    size_t refill_bits { 0 };
+
+    double cpi() const;
+    double stall_rate() const;
+    double refill_bandwidth() const;    // bits per cycle
+};
+
+// Straight-line fetch of the whole compressed section through a bit buffer,
+// refilled by a bus while there is room for one more beat, a stalled decoder
+// gets a partial beat up to the buffer width. Decode of the next instruction
+// starts when its codeword is fully in the buffer.
+fetch_stat simulate_fetch(const std::vector<block_trace> &traces, const fetch_params &params);
+
+// Decoder work summed over executions: trace i counts counts[i] times. Static
+// work (every instruction once) if counts are empty
+block_trace total_decode_work(const std::vector<block_trace> &traces, std::span<const uint64_t> counts = { });
+
+}
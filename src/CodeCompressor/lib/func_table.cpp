@@ -0,0 +1,116 @@
+#include "func_table.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils
+{
+
+static void put_le(std::vector<char> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static size_t get_le(const char *data, size_t size, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > size)
+        throw std::runtime_error("Function table is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)(unsigned char)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+func_table::func_table() { }
+
+func_table::func_table(std::vector<func_range> functions, const std::vector<size_t> &block_offsets, size_t stream_bits, size_t cmdlen)
+    : _cmdlen(cmdlen)
+{
+    std::sort(functions.begin(), functions.end(), [](const func_range &f1, const func_range &f2) {
+        return f1.offset < f2.offset || (f1.offset == f2.offset && f1.size > f2.size);
+    });
+
+    size_t text_size = block_offsets.size() * cmdlen;
+    size_t covered = 0;
+    for (const auto &f : functions)
+    {
+        if (f.size == 0 || f.offset % cmdlen != 0 || f.size % cmdlen != 0
+            || f.offset < covered || f.offset + f.size > text_size)
+            continue;
+
+        size_t first = f.offset / cmdlen;
+        size_t last = (f.offset + f.size) / cmdlen;
+        size_t bit_end = last < block_offsets.size() ? block_offsets[last] : stream_bits;
+
+        func_unit unit { f.offset, f.size, block_offsets[first], bit_end - block_offsets[first] };
+        if (unit.text_offset + unit.text_size > 0xffffffff || unit.bit_offset + unit.bit_size > 0xffffffff)
+            throw std::runtime_error("Function table offset overflow");
+        _units.push_back(unit);
+        covered = f.offset + f.size;
+    }
+}
+
+const std::vector<func_unit> &func_table::get_units() const
+{
+    return _units;
+}
+
+bool func_table::lookup(size_t offset, func_unit &unit) const
+{
+    auto it = std::upper_bound(_units.begin(), _units.end(), offset, [](size_t offset, const func_unit &u) {
+        return offset < u.text_offset;
+    });
+    if (it == _units.begin())
+        return false;
+
+    --it;
+    if (offset >= it->text_offset + it->text_size)
+        return false;
+
+    unit = *it;
+    return true;
+}
+
+std::vector<char> func_table::serialize() const
+{
+    std::vector<char> data;
+    put_le(data, _units.size(), 4);
+    put_le(data, _cmdlen, 1);
+
+    for (const auto &unit : _units)
+    {
+        put_le(data, unit.text_offset, 4);
+        put_le(data, unit.text_size, 4);
+        put_le(data, unit.bit_offset, 4);
+        put_le(data, unit.bit_size, 4);
+    }
+    return data;
+}
+
+func_table func_table::deserialize(const char *data, size_t size)
+{
+    func_table ftab;
+    size_t pos = 0;
+    size_t units_cnt = get_le(data, size, pos, 4);
+    ftab._cmdlen = get_le(data, size, pos, 1);
+    if (ftab._cmdlen == 0)
+        throw std::runtime_error("Bad function table command length");
+
+    for (size_t i = 0; i < units_cnt; ++i)
+    {
+        func_unit unit;
+        unit.text_offset = get_le(data, size, pos, 4);
+        unit.text_size = get_le(data, size, pos, 4);
+        unit.bit_offset = get_le(data, size, pos, 4);
+        unit.bit_size = get_le(data, size, pos, 4);
+        if (!ftab._units.empty() && unit.text_offset < ftab._units.back().text_offset + ftab._units.back().text_size)
+            throw std::runtime_error("Function table is not sorted");
+        ftab._units.push_back(unit);
+    }
+    return ftab;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils
+{
+
+// Function in original code section, bytes
+struct func_range
+{
+    size_t offset;
+    size_t size;
+};
+
+// Function as unit of compressed code section: codewords don't depend on
+// previous ones, so a function is decoded from its first bit on its own
+struct func_unit
+{
+    size_t text_offset;
+    size_t text_size;
+    size_t bit_offset;
+    size_t bit_size;
+};
+
+// Function table: compressed bit range of every function, sorted by offset
+class func_table
+{
+public:
+    func_table();
+
+    // functions - ranges from symbol table, unaligned, empty, out of section
+    // and overlapping ones are skipped. block_offsets - compressed bit
+    // offset of every command, stream_bits - size of compressed stream
+    func_table(std::vector<func_range> functions, const std::vector<size_t> &block_offsets, size_t stream_bits, size_t cmdlen);
+
+    const std::vector<func_unit> &get_units() const;
+
+    // Unit containing offset of original code section
+    bool lookup(size_t offset, func_unit &unit) const;
+
+    // u32 units count, u8 cmdlen, then for every unit:
+    // u32 text offset, u32 text size, u32 bit offset, u32 bit size
+    std::vector<char> serialize() const;
+    static func_table deserialize(const char *data, size_t size);
+
+private:
+    size_t _cmdlen { 4 };
+    std::vector<func_unit> _units;
+};
+
+}
@@ -0,0 +1,231 @@
+#include "huffman_table.h"
+
+#include <queue>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils
+{
+
+static uint32_t reverse_bits(uint32_t code, size_t len)
+{
+    uint32_t retval = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        retval = (retval << 1) | (code & 0x1);
+        code >>= 1;
+    }
+    return retval;
+}
+
+huffman_table::huffman_table() { }
+
+huffman_table::huffman_table(const std::vector<size_t> &freqs)
+{
+    build_lengths(freqs);
+    build_codes();
+}
+
+huffman_table huffman_table::from_lengths(const std::vector<uint8_t> &lengths)
+{
+    huffman_table htab;
+    for (auto len : lengths)
+    {
+        if (len > MAX_CODE_LEN)
+            throw std::runtime_error("Huffman code length is too big");
+    }
+    htab._lengths = lengths;
+    htab.build_codes();
+    return htab;
+}
+
+size_t huffman_table::get_symbols_cnt() const
+{
+    return _lengths.size();
+}
+
+size_t huffman_table::get_code_len(size_t sym) const
+{
+    return _lengths[sym];
+}
+
+void huffman_table::encode(dynbitset &out, size_t sym) const
+{
+    if (sym >= _lengths.size() || _lengths[sym] == 0)
+        throw std::logic_error("Symbol has no huffman code");
+    out.add(_codes[sym], _lengths[sym]);
+}
+
+size_t huffman_table::decode(const dynbitset &in, size_t &pos) const
+{
+    uint32_t entry = _fast[in.getbits(pos, FAST_BITS)];
+    if ((entry & 0xf) != 0)
+    {
+        pos += entry & 0xf;
+        return entry >> 4;
+    }
+
+    uint32_t code = 0;
+    for (size_t len = 1; len <= MAX_CODE_LEN; ++len)
+    {
+        code = (code << 1) | in.getbit(pos + len - 1);
+        if (code - _first_code[len] < _lens_cnt[len])
+        {
+            pos += len;
+            return _sorted_syms[_first_indx[len] + code - _first_code[len]];
+        }
+    }
+
+    throw std::runtime_error("Bad huffman code in compressed section");
+}
+
+std::vector<char> huffman_table::serialize() const
+{
+    std::vector<char> data;
+    uint32_t cnt = _lengths.size();
+    for (size_t i = 0; i < sizeof(cnt); ++i)
+        data.push_back((cnt >> (i * 8)) & 0xff);
+
+    for (size_t i = 0; i < cnt; i += 2)
+    {
+        uint8_t lo = _lengths[i];
+        uint8_t hi = i + 1 < cnt ? _lengths[i + 1] : 0;
+        data.push_back(lo | (hi << 4));
+    }
+    return data;
+}
+
+huffman_table huffman_table::deserialize(const char *data, size_t size, size_t &readed)
+{
+    if (size < sizeof(uint32_t))
+        throw std::runtime_error("Huffman table is truncated");
+
+    uint32_t cnt = 0;
+    for (size_t i = 0; i < sizeof(cnt); ++i)
+        cnt |= (uint32_t)(unsigned char)data[i] << (i * 8);
+
+    readed = sizeof(cnt) + (cnt + 1) / 2;
+    if (size < readed)
+        throw std::runtime_error("Huffman table is truncated");
+
+    std::vector<uint8_t> lengths(cnt);
+    for (size_t i = 0; i < cnt; ++i)
+    {
+        unsigned char byte = data[sizeof(cnt) + i / 2];
+        lengths[i] = (i % 2 == 0) ? (byte & 0xf) : (byte >> 4);
+    }
+    return from_lengths(lengths);
+}
+
+void huffman_table::build_lengths(const std::vector<size_t> &freqs)
+{
+    std::vector<size_t> weights = freqs;
+    _lengths.assign(freqs.size(), 0);
+
+    size_t used_cnt = std::count_if(weights.begin(), weights.end(), [](size_t w) { return w != 0; });
+    if (used_cnt == 0)
+        return;
+    if (used_cnt == 1)
+    {
+        for (size_t i = 0; i < weights.size(); ++i)
+            if (weights[i] != 0)
+                _lengths[i] = 1;
+        return;
+    }
+
+    // Rebuild with flattened weights until the longest code fits MAX_CODE_LEN
+    for (;;)
+    {
+        typedef std::pair<size_t, size_t> node;
+        std::priority_queue<node, std::vector<node>, std::greater<node>> queue;
+        std::vector<size_t> parents(weights.size(), 0);
+
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            if (weights[i] != 0)
+                queue.push({ weights[i], i });
+        }
+
+        while (queue.size() > 1)
+        {
+            node n1 = queue.top();
+            queue.pop();
+            node n2 = queue.top();
+            queue.pop();
+
+            size_t parent = parents.size();
+            parents.push_back(0);
+            parents[n1.second] = parent;
+            parents[n2.second] = parent;
+            queue.push({ n1.first + n2.first, parent });
+        }
+
+        size_t root = queue.top().second;
+        size_t max_len = 0;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            if (weights[i] == 0)
+                continue;
+
+            size_t len = 0;
+            for (size_t n = i; n != root; n = parents[n])
+                len++;
+            _lengths[i] = len;
+            max_len = std::max(max_len, len);
+        }
+
+        if (max_len <= MAX_CODE_LEN)
+            break;
+
+        for (auto &w : weights)
+        {
+            if (w != 0)
+                w = (w >> 1) | 1;
+        }
+    }
+}
+
+void huffman_table::build_codes()
+{
+    _codes.assign(_lengths.size(), 0);
+    _lens_cnt.assign(MAX_CODE_LEN + 1, 0);
+    _first_code.assign(MAX_CODE_LEN + 2, 0);
+    _first_indx.assign(MAX_CODE_LEN + 2, 0);
+    _fast.assign(1 << FAST_BITS, 0);
+
+    for (auto len : _lengths)
+        _lens_cnt[len]++;
+    _lens_cnt[0] = 0;
+
+    uint32_t code = 0;
+    uint32_t indx = 0;
+    for (size_t len = 1; len <= MAX_CODE_LEN; ++len)
+    {
+        code = (code + _lens_cnt[len - 1]) << 1;
+        _first_code[len] = code;
+        _first_indx[len] = indx;
+        indx += _lens_cnt[len];
+    }
+
+    _sorted_syms.assign(indx, 0);
+    std::vector<uint32_t> next_code(_first_code.begin(), _first_code.end());
+    std::vector<uint32_t> next_indx(_first_indx.begin(), _first_indx.end());
+    for (size_t sym = 0; sym < _lengths.size(); ++sym)
+    {
+        size_t len = _lengths[sym];
+        if (len == 0)
+            continue;
+
+        _sorted_syms[next_indx[len]++] = sym;
+        _codes[sym] = reverse_bits(next_code[len]++, len);
+
+        if (len <= FAST_BITS)
+        {
+            for (size_t i = _codes[sym]; i < _fast.size(); i += (size_t)1 << len)
+                _fast[i] = (sym << 4) | len;
+        }
+    }
+}
+
+}
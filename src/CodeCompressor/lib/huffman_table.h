@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "dynbitset.h"
+
+namespace utils
+{
+
+// Canonical length-limited Huffman code over symbols [0, symbols_cnt).
+// Codes are written to dynbitset starting from the most significant bit,
+// so decoder can use low bits of getbits() as index in lookup table
+class huffman_table
+{
+public:
+    static const size_t MAX_CODE_LEN = 15;
+    static const size_t FAST_BITS = 10;
+
+    huffman_table();
+
+    explicit huffman_table(const std::vector<size_t> &freqs);
+
+    static huffman_table from_lengths(const std::vector<uint8_t> &lengths);
+
+    size_t get_symbols_cnt() const;
+    size_t get_code_len(size_t sym) const;
+
+    void encode(dynbitset &out, size_t sym) const;
+    size_t decode(const dynbitset &in, size_t &pos) const;
+
+    // 4 bytes of symbols count, then code length of each symbol in 4 bits
+    std::vector<char> serialize() const;
+    static huffman_table deserialize(const char *data, size_t size, size_t &readed);
+
+private:
+    void build_lengths(const std::vector<size_t> &freqs);
+    void build_codes();
+
+private:
+    std::vector<uint8_t> _lengths;
+    std::vector<uint32_t> _codes;
+
+    std::vector<uint32_t> _fast;            // (sym << 4) | len, len == 0 - slow path
+    std::vector<uint32_t> _first_code;
+    std::vector<uint32_t> _first_indx;
+    std::vector<uint32_t> _lens_cnt;
+    std::vector<uint32_t> _sorted_syms;
+};
+
+}
@@ -0,0 +1,186 @@
+#include "index_coding.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace utils
+{
+
+index_predictor::index_predictor(index_coding coding, size_t short_size)
+    : _coding(coding), _short_size(short_size)
+{
+    if (_coding != index_coding::FIXED && (_short_size == 0 || _short_size > INDEX_SHORT_MAX_SIZE))
+        throw std::runtime_error("Short index size must be from 1 to " + std::to_string(INDEX_SHORT_MAX_SIZE));
+    if (_coding == index_coding::FIXED)
+        _short_size = 0;
+    reset();
+}
+
+index_coding index_predictor::get_coding() const
+{
+    return _coding;
+}
+
+size_t index_predictor::get_short_size() const
+{
+    return _short_size;
+}
+
+void index_predictor::reset()
+{
+    _prev = 0;
+    if (_coding == index_coding::MTF)
+    {
+        _recent.resize((size_t)1 << _short_size);
+        std::iota(_recent.begin(), _recent.end(), 0);
+    }
+}
+
+int index_predictor::find_short(size_t indx) const
+{
+    switch (_coding)
+    {
+        case index_coding::DELTA:
+        {
+            int64_t delta = (int64_t)indx - (int64_t)_prev;
+            int64_t half = (int64_t)1 << (_short_size - 1);
+            if (delta < -half || delta >= half)
+                return -1;
+            return delta & (((int64_t)1 << _short_size) - 1);
+        }
+        case index_coding::MTF:
+        {
+            auto it = std::find(_recent.begin(), _recent.end(), indx);
+            return it != _recent.end() ? it - _recent.begin() : -1;
+        }
+        default:
+            return -1;
+    }
+}
+
+size_t index_predictor::restore_short(size_t code) const
+{
+    switch (_coding)
+    {
+        case index_coding::DELTA:
+        {
+            size_t half = (size_t)1 << (_short_size - 1);
+            int64_t delta = (code & half) ? (int64_t)code - ((int64_t)1 << _short_size) : (int64_t)code;
+            return _prev + delta;
+        }
+        case index_coding::MTF:
+            return _recent[code];
+        default:
+            throw std::runtime_error("Index coding has no short codes");
+    }
+}
+
+void index_predictor::update(size_t indx)
+{
+    _prev = indx;
+    if (_coding != index_coding::MTF)
+        return;
+
+    auto it = std::find(_recent.begin(), _recent.end(), indx);
+    if (it == _recent.end())
+        it = std::prev(_recent.end());
+    std::move_backward(_recent.begin(), it, std::next(it));
+    _recent[0] = indx;
+}
+
+size_t choose_short_size(std::span<const int> indices, index_coding coding, size_t indx_size, size_t line_cmds)
+{
+    if (coding == index_coding::FIXED)
+        return 0;
+
+    size_t best_size = 1, best_bits = SIZE_MAX;
+    for (size_t short_size = 1; short_size <= INDEX_SHORT_MAX_SIZE; ++short_size)
+    {
+        index_predictor predictor(coding, short_size);
+        size_t bits = 0;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            if (i % line_cmds == 0)
+                predictor.reset();
+            if (indices[i] == -1)
+                continue;
+            bits += 1 + (predictor.find_short(indices[i]) != -1 ? short_size : indx_size);
+            predictor.update(indices[i]);
+        }
+        if (bits < best_bits)
+        {
+            best_bits = bits;
+            best_size = short_size;
+        }
+    }
+    return best_size;
+}
+
+std::vector<size_t> order_dict_entries(std::span<const int> indices, std::span<const uint64_t> weights, size_t entries_cnt, dict_order order)
+{
+    std::vector<size_t> retval(entries_cnt);
+    std::iota(retval.begin(), retval.end(), 0);
+    if (order == dict_order::VALUE)
+        return retval;
+
+    std::vector<uint64_t> uses(entries_cnt, 0);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] != -1)
+            uses[indices[i]] += weights[i];
+    }
+    std::stable_sort(retval.begin(), retval.end(), [&](size_t e1, size_t e2) {
+        return uses[e1] > uses[e2];
+    });
+    if (order == dict_order::FREQUENCY)
+        return retval;
+
+    // Successors of every entry, the most frequent first
+    std::unordered_map<uint64_t, uint64_t> pairs;
+    for (size_t i = 1; i < indices.size(); ++i)
+    {
+        if (indices[i - 1] != -1 && indices[i] != -1 && indices[i - 1] != indices[i])
+            pairs[(uint64_t)indices[i - 1] * entries_cnt + indices[i]] += weights[i];
+    }
+    std::vector<std::vector<std::pair<uint64_t, size_t>>> successors(entries_cnt);
+    for (const auto &[key, cnt] : pairs)
+        successors[key / entries_cnt].push_back({ cnt, key % entries_cnt });
+    for (auto &succ : successors)
+    {
+        std::sort(succ.begin(), succ.end(), [](const auto &s1, const auto &s2) {
+            return s1.first != s2.first ? s1.first > s2.first : s1.second < s2.second;
+        });
+    }
+
+    std::vector<size_t> by_uses = std::move(retval);
+    std::vector<bool> placed(entries_cnt, false);
+    retval.clear();
+    size_t next_start = 0;
+    while (retval.size() < entries_cnt)
+    {
+        while (placed[by_uses[next_start]])
+            next_start++;
+        size_t entry = by_uses[next_start];
+        while (true)
+        {
+            placed[entry] = true;
+            retval.push_back(entry);
+
+            const auto &succ = successors[entry];
+            size_t cursor = 0;
+            while (cursor < succ.size() && placed[succ[cursor].second])
+                cursor++;
+            if (cursor == succ.size())
+                break;
+            entry = succ[cursor].second;
+        }
+    }
+    return retval;
+}
+
+}
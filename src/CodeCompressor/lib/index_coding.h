@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "config.h"
+
+namespace utils
+{
+
+// Short codes are 1 to INDEX_SHORT_MAX_SIZE bits, MTF list has 2^short_size entries
+const size_t INDEX_SHORT_MAX_SIZE = 6;
+
+// Short codes of dictionary indices, encoder and decoders keep the same
+// state and reset it at the start of every addr_table line, so a line is
+// decoded without the lines before it:
+// DELTA - two's complement difference from the previous index, 0 after reset,
+// MTF - position in the list of recently used indices, 0, 1, 2, ... after reset
+class index_predictor
+{
+public:
+    index_predictor(index_coding coding, size_t short_size);
+
+    index_coding get_coding() const;
+    size_t get_short_size() const;
+
+    void reset();
+
+    // Short code of indx, -1 if the whole index has to be written
+    int find_short(size_t indx) const;
+    size_t restore_short(size_t code) const;
+
+    // Called with every index of the stream, short or not
+    void update(size_t indx);
+
+private:
+    index_coding _coding;
+    size_t _short_size;
+    size_t _prev { 0 };
+    std::vector<uint32_t> _recent;
+};
+
+// Bits of short code that make indices shortest: 1 flag bit and short code
+// or indx_size bits. indices - dictionary index of every command, -1 for
+// literals, line_cmds - commands of addr_table line
+size_t choose_short_size(std::span<const int> indices, index_coding coding, size_t indx_size, size_t line_cmds);
+
+// Old index of every new one. FREQUENCY - by weight of uses, ADJACENCY -
+// chains of entries that follow each other most often, chain starts with
+// the heaviest entry not placed yet. Ties go to lower old index, unused
+// entries go last. weights - weight of every command
+std::vector<size_t> order_dict_entries(std::span<const int> indices, std::span<const uint64_t> weights, size_t entries_cnt, dict_order order);
+
+}
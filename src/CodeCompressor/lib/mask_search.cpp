@@ -0,0 +1,278 @@
+#include "mask_search.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace utils
+{
+
+struct mask_field
+{
+    uint32_t shift;
+    uint32_t size;
+};
+
+// rv32i fields: opcode, rd, funct3, rs1, rs2, funct7
+static const mask_field FIELDS[] = { { 0, 7 }, { 7, 5 }, { 12, 3 }, { 15, 5 }, { 20, 5 }, { 25, 7 } };
+const size_t FIELDS_CNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+const size_t NIBBLES_CNT = 8;
+const size_t SHAPE_SIZE = 2;
+const size_t NIBBLE_POS_SIZE = 3;
+const size_t BIT_POS_SIZE = 5;
+const size_t FIELD_POS_SIZE = 3;
+
+static uint32_t field_mask(const mask_field &field)
+{
+    return (((uint32_t)1 << field.size) - 1) << field.shift;
+}
+
+static size_t count_size(size_t max_windows)
+{
+    return std::bit_width(max_windows - 1);
+}
+
+static bool push_window(mask_match &match, size_t max_windows, uint32_t pos, uint32_t value)
+{
+    if (match.windows_cnt == max_windows)
+        return false;
+    match.windows[match.windows_cnt++] = { pos, value };
+    return true;
+}
+
+bool get_mask_windows(uint32_t entry, uint32_t value, mask_shape shape, size_t max_windows, mask_match &match)
+{
+    if (max_windows == 0 || max_windows > MASK_MAX_WINDOWS)
+        throw std::runtime_error("Bad count of mask windows");
+
+    uint32_t diff = entry ^ value;
+    match.shape = shape;
+    match.windows_cnt = 0;
+    if (diff == 0)
+        return false;
+
+    switch (shape)
+    {
+        case mask_shape::NIBBLES:
+            for (uint32_t n = 0; n < NIBBLES_CNT; ++n)
+            {
+                if (((diff >> (n * 4)) & 0xf) && !push_window(match, max_windows, n, (value >> (n * 4)) & 0xf))
+                    return false;
+            }
+            return true;
+        case mask_shape::BITS:
+            if ((size_t)std::popcount(diff) > max_windows)
+                return false;
+            for (; diff != 0; diff &= diff - 1)
+                push_window(match, max_windows, std::countr_zero(diff), 0);
+            return true;
+        case mask_shape::FIELDS:
+            for (uint32_t f = 0; f < FIELDS_CNT; ++f)
+            {
+                if ((diff & field_mask(FIELDS[f])) && !push_window(match, max_windows, f, (value & field_mask(FIELDS[f])) >> FIELDS[f].shift))
+                    return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+uint32_t apply_mask_windows(uint32_t entry, const mask_match &match)
+{
+    for (size_t i = 0; i < match.windows_cnt; ++i)
+    {
+        const auto &window = match.windows[i];
+        switch (match.shape)
+        {
+            case mask_shape::NIBBLES:
+                entry = (entry & ~((uint32_t)0xf << (window.pos * 4))) | (window.value << (window.pos * 4));
+                break;
+            case mask_shape::BITS:
+                entry ^= (uint32_t)1 << window.pos;
+                break;
+            case mask_shape::FIELDS:
+                entry = (entry & ~field_mask(FIELDS[window.pos])) | (window.value << FIELDS[window.pos].shift);
+                break;
+        }
+    }
+    return entry;
+}
+
+size_t mask_windows_bits(const mask_match &match, size_t max_windows)
+{
+    size_t bits = SHAPE_SIZE + count_size(max_windows);
+    for (size_t i = 0; i < match.windows_cnt; ++i)
+    {
+        switch (match.shape)
+        {
+            case mask_shape::NIBBLES:
+                bits += NIBBLE_POS_SIZE + 4;
+                break;
+            case mask_shape::BITS:
+                bits += BIT_POS_SIZE;
+                break;
+            case mask_shape::FIELDS:
+                bits += FIELD_POS_SIZE + FIELDS[match.windows[i].pos].size;
+                break;
+        }
+    }
+    return bits;
+}
+
+void add_mask_windows(command &ccmd, const mask_match &match, size_t max_windows)
+{
+    ccmd.add((size_t)match.shape, SHAPE_SIZE);
+    ccmd.add(match.windows_cnt - 1, count_size(max_windows));
+    for (size_t i = 0; i < match.windows_cnt; ++i)
+    {
+        const auto &window = match.windows[i];
+        switch (match.shape)
+        {
+            case mask_shape::NIBBLES:
+                ccmd.add(window.pos, NIBBLE_POS_SIZE);
+                ccmd.add(window.value, 4);
+                break;
+            case mask_shape::BITS:
+                ccmd.add(window.pos, BIT_POS_SIZE);
+                break;
+            case mask_shape::FIELDS:
+                ccmd.add(window.pos, FIELD_POS_SIZE);
+                ccmd.add(window.value, FIELDS[window.pos].size);
+                break;
+        }
+    }
+}
+
+void read_mask_windows(const compressed_section &csec, size_t &pos, size_t max_windows, mask_match &match)
+{
+    size_t shape = csec.getbits(pos, SHAPE_SIZE);
+    pos += SHAPE_SIZE;
+    if (shape >= MASK_SHAPES_CNT)
+        throw std::runtime_error("Bad mask shape");
+    match.shape = (mask_shape)shape;
+    match.windows_cnt = csec.getbits(pos, count_size(max_windows)) + 1;
+    pos += count_size(max_windows);
+    if (match.windows_cnt > max_windows)
+        throw std::runtime_error("Bad count of mask windows");
+
+    for (size_t i = 0; i < match.windows_cnt; ++i)
+    {
+        auto &window = match.windows[i];
+        switch (match.shape)
+        {
+            case mask_shape::NIBBLES:
+                window.pos = csec.getbits(pos, NIBBLE_POS_SIZE);
+                window.value = csec.getbits(pos + NIBBLE_POS_SIZE, 4);
+                pos += NIBBLE_POS_SIZE + 4;
+                break;
+            case mask_shape::BITS:
+                window.pos = csec.getbits(pos, BIT_POS_SIZE);
+                window.value = 0;
+                pos += BIT_POS_SIZE;
+                break;
+            case mask_shape::FIELDS:
+                window.pos = csec.getbits(pos, FIELD_POS_SIZE);
+                pos += FIELD_POS_SIZE;
+                if (window.pos >= FIELDS_CNT)
+                    throw std::runtime_error("Bad mask field");
+                window.value = csec.getbits(pos, FIELDS[window.pos].size);
+                pos += FIELDS[window.pos].size;
+                break;
+        }
+    }
+}
+
+// Unions of every windows_cnt windows from windows
+static void add_key_masks(std::vector<uint32_t> &key_masks, const std::vector<uint32_t> &windows, size_t windows_cnt)
+{
+    windows_cnt = std::min(windows_cnt, windows.size());
+    for (uint32_t set = 0; set < ((uint32_t)1 << windows.size()); ++set)
+    {
+        if ((size_t)std::popcount(set) != windows_cnt)
+            continue;
+        uint32_t cleared = 0;
+        for (size_t w = 0; w < windows.size(); ++w)
+        {
+            if ((set >> w) & 1)
+                cleared |= windows[w];
+        }
+        key_masks.push_back(~cleared);
+    }
+}
+
+mask_index::mask_index(std::vector<uint32_t> entries, size_t max_windows)
+    : _max_windows(max_windows), _entries(std::move(entries))
+{
+    if (_max_windows == 0 || _max_windows > MASK_MAX_WINDOWS)
+        throw std::runtime_error("Bad count of mask windows");
+
+    // Flips of at most N bits are within at most N nibbles
+    std::vector<uint32_t> nibbles, fields;
+    for (size_t n = 0; n < NIBBLES_CNT; ++n)
+        nibbles.push_back((uint32_t)0xf << (n * 4));
+    for (const auto &field : FIELDS)
+        fields.push_back(field_mask(field));
+    add_key_masks(_key_masks, nibbles, _max_windows);
+    add_key_masks(_key_masks, fields, _max_windows);
+    std::sort(_key_masks.begin(), _key_masks.end());
+    _key_masks.erase(std::unique(_key_masks.begin(), _key_masks.end()), _key_masks.end());
+
+    for (uint32_t key_mask : _key_masks)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> table;
+        table.reserve(_entries.size());
+        for (size_t i = 0; i < _entries.size(); ++i)
+            table.push_back({ _entries[i] & key_mask, i });
+        std::sort(table.begin(), table.end());
+        _tables.push_back(std::move(table));
+    }
+}
+
+bool mask_index::find(uint32_t value, mask_match &match) const
+{
+    size_t best_bits = SIZE_MAX;
+    for (size_t t = 0; t < _tables.size(); ++t)
+    {
+        const auto &table = _tables[t];
+        auto it = std::lower_bound(table.begin(), table.end(), std::make_pair(value & _key_masks[t], (uint32_t)0));
+        for (size_t checked = 0; it != table.end() && it->first == (value & _key_masks[t]) && checked < MASK_SEARCH_BUCKET; ++it, ++checked)
+        {
+            for (size_t shape = 0; shape < MASK_SHAPES_CNT; ++shape)
+            {
+                mask_match candidate;
+                if (!get_mask_windows(_entries[it->second], value, (mask_shape)shape, _max_windows, candidate))
+                    continue;
+                size_t bits = mask_windows_bits(candidate, _max_windows);
+                if (bits < best_bits || (bits == best_bits && it->second < match.indx))
+                {
+                    candidate.indx = it->second;
+                    match = candidate;
+                    best_bits = bits;
+                }
+            }
+        }
+    }
+    return best_bits != SIZE_MAX;
+}
+
+uint32_t restore_value_mask_multi(const compressed_section &csec, size_t &pos, std::span<const uint32_t> values, size_t indx_size, size_t max_windows)
+{
+    if (!csec.getbit(pos++))
+    {
+        uint32_t value = csec.getbits(pos, 32);
+        pos += 32;
+        return value;
+    }
+
+    mask_match match;
+    bool masked = !csec.getbit(pos++);
+    if (masked)
+        read_mask_windows(csec, pos, max_windows, match);
+    size_t indx = csec.getbits(pos, indx_size);
+    pos += indx_size;
+    if (indx >= values.size())
+        throw std::runtime_error("Dictionary index is out of range");
+    return masked ? apply_mask_windows(values[indx], match) : values[indx];
+}
+
+}
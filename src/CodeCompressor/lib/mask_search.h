@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "command.h"
+#include "compressed_section.h"
+
+namespace utils
+{
+
+// Shapes of MASK_MULTI codewords, every one lists changed windows of
+// dictionary entry in ascending order:
+// NIBBLES - u3 nibble number and its u4 value,
+// BITS - u5 number of flipped bit,
+// FIELDS - u3 rv32i field (opcode, rd, funct3, rs1, rs2, funct7) and its value
+enum class mask_shape
+{
+    NIBBLES,
+    BITS,
+    FIELDS,
+};
+
+const size_t MASK_SHAPES_CNT = 3;
+const size_t MASK_MAX_WINDOWS = 4;
+
+struct mask_window
+{
+    uint32_t pos;
+    uint32_t value;
+};
+
+// Dictionary entry with changed windows
+struct mask_match
+{
+    size_t indx { 0 };
+    mask_shape shape { mask_shape::NIBBLES };
+    size_t windows_cnt { 0 };
+    std::array<mask_window, MASK_MAX_WINDOWS> windows;
+};
+
+// Windows of shape that make entry equal to value, false if more than max_windows differ
+bool get_mask_windows(uint32_t entry, uint32_t value, mask_shape shape, size_t max_windows, mask_match &match);
+
+uint32_t apply_mask_windows(uint32_t entry, const mask_match &match);
+
+// Bits of shape class (u2 shape, then windows count - 1) and windows,
+// dictionary index isn't counted
+size_t mask_windows_bits(const mask_match &match, size_t max_windows);
+
+// Shape class and windows, dictionary index goes after them
+void add_mask_windows(command &ccmd, const mask_match &match, size_t max_windows);
+void read_mask_windows(const compressed_section &csec, size_t &pos, size_t max_windows, mask_match &match);
+
+// MASK_MULTI codeword of rv32i command: 1 1 index - dictionary entry,
+// 1 0 shape class windows index - entry with changed windows, 0 u32 - command
+uint32_t restore_value_mask_multi(const compressed_section &csec, size_t &pos, std::span<const uint32_t> values, size_t indx_size, size_t max_windows);
+
+// Search of dictionary entries that differ from value in at most max_windows
+// windows of some shape. If at most N windows differ, the rest of command
+// is the same, so entries are sorted by command with every N windows
+// cleared, one table per combination of windows. Lookup checks at most
+// MASK_SEARCH_BUCKET entries with equal key per table, it never scans the
+// whole dictionary
+class mask_index
+{
+public:
+    static const size_t MASK_SEARCH_BUCKET = 32;
+
+    mask_index(std::vector<uint32_t> entries, size_t max_windows);
+
+    // Match with the shortest codeword, ties go to the entry with lower
+    // index. False if no entry is close enough
+    bool find(uint32_t value, mask_match &match) const;
+
+private:
+    size_t _max_windows;
+    std::vector<uint32_t> _entries;
+    std::vector<uint32_t> _key_masks;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> _tables;   // key, entry index
+};
+
+}
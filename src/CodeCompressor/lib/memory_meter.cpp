@@ -0,0 +1,85 @@
+#include "memory_meter.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "command.h"
+
+namespace utils
+{
+
+void memory_meter::alloc(size_t bytes)
+{
+    _allocated += bytes;
+    update_peaks();
+}
+
+void memory_meter::release(size_t bytes)
+{
+    _allocated -= std::min(bytes, _allocated);
+}
+
+void memory_meter::set_phase(progress_phase phase)
+{
+    _phase = phase;
+    update_peaks();
+}
+
+size_t memory_meter::get_allocated() const
+{
+    return _allocated;
+}
+
+size_t memory_meter::get_peak() const
+{
+    return _peak;
+}
+
+size_t memory_meter::get_peak(progress_phase phase) const
+{
+    return _phase_peaks[(size_t)phase];
+}
+
+void memory_meter::update_peaks()
+{
+    _peak = std::max(_peak, _allocated);
+    size_t &phase_peak = _phase_peaks[(size_t)_phase];
+    phase_peak = std::max(phase_peak, _allocated);
+}
+
+memory_scope::memory_scope(memory_meter *meter, size_t bytes)
+    : _meter(meter)
+    , _bytes(0)
+{
+    resize(bytes);
+}
+
+memory_scope::~memory_scope()
+{
+    resize(0);
+}
+
+void memory_scope::resize(size_t bytes)
+{
+    if (_meter == nullptr)
+        return;
+
+    if (bytes > _bytes)
+        _meter->alloc(bytes - _bytes);
+    else
+        _meter->release(_bytes - bytes);
+    _bytes = bytes;
+}
+
+size_t commands_memory(size_t cnt, size_t cmdlen)
+{
+    return cnt * (sizeof(command) + cmdlen);
+}
+
+size_t histogram_node_memory(size_t cmdlen)
+{
+    // Red-black tree node: color, parent, left and right links
+    return 4 * sizeof(void *) + sizeof(std::pair<const command, uint64_t>) + cmdlen;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "config.h"
+
+namespace utils
+{
+
+// Estimated working set of compressor. Containers are accounted by element
+// count and payload when they are built and released when freed, allocator
+// overhead isn't counted. Peaks are kept for the whole run and per phase
+class memory_meter
+{
+public:
+    void alloc(size_t bytes);
+    void release(size_t bytes);
+
+    // Bytes allocated at phase switch count for the new phase too
+    void set_phase(progress_phase phase);
+
+    size_t get_allocated() const;
+    size_t get_peak() const;
+    size_t get_peak(progress_phase phase) const;
+
+private:
+    void update_peaks();
+
+    progress_phase _phase { progress_phase::HISTOGRAM };
+    size_t _allocated { 0 };
+    size_t _peak { 0 };
+    std::array<size_t, 4> _phase_peaks { };
+};
+
+// Bytes of one container accounted until the end of scope, meter may be null
+class memory_scope
+{
+public:
+    memory_scope(memory_meter *meter, size_t bytes);
+    ~memory_scope();
+
+    memory_scope(const memory_scope &) = delete;
+    memory_scope &operator=(const memory_scope &) = delete;
+
+    // Container has grown or shrunk to bytes
+    void resize(size_t bytes);
+
+private:
+    memory_meter *_meter;
+    size_t _bytes;
+};
+
+// Vector of cnt commands cmdlen bytes long, every command owns heap buffer
+size_t commands_memory(size_t cnt, size_t cmdlen);
+
+// Node of std::map<command, uint64_t> histogram
+size_t histogram_node_memory(size_t cmdlen);
+
+}
@@ -0,0 +1,274 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace utils
+{
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t value, unsigned cnt)
+{
+    return (value >> cnt) | (value << (32 - cnt));
+}
+
+sha256::sha256()
+    : _state { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
+}
+
+void sha256::transform(const uint8_t *block)
+{
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; ++i)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    for (size_t i = 16; i < 64; ++i)
+    {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+    uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+    for (size_t i = 0; i < 64; ++i)
+    {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    _state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+    _state[4] += e; _state[5] += f; _state[6] += g; _state[7] += h;
+}
+
+void sha256::update(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    _total_len += size;
+    while (size > 0)
+    {
+        size_t part = std::min(size, sizeof(_block) - _block_len);
+        std::memcpy(_block + _block_len, bytes, part);
+        _block_len += part;
+        bytes += part;
+        size -= part;
+        if (_block_len == sizeof(_block))
+        {
+            transform(_block);
+            _block_len = 0;
+        }
+    }
+}
+
+void sha256::update_u64(uint64_t value)
+{
+    uint8_t bytes[8];
+    for (size_t i = 0; i < 8; ++i)
+        bytes[i] = value >> (i * 8);
+    update(bytes, sizeof(bytes));
+}
+
+std::string sha256::hex_digest()
+{
+    uint64_t bit_len = _total_len * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (_block_len != 56)
+        update(&pad, 1);
+    uint8_t len_bytes[8];
+    for (size_t i = 0; i < 8; ++i)
+        len_bytes[i] = bit_len >> (56 - i * 8);
+    update(len_bytes, sizeof(len_bytes));
+
+    static const char hex[] = "0123456789abcdef";
+    std::string digest;
+    for (uint32_t word : _state)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            digest.push_back(hex[(word >> shift) & 0xf]);
+    }
+    return digest;
+}
+
+static const char CACHE_MAGIC[8] = { 'I', 'S', 'A', 'C', 'A', 'C', 'H', 'E' };
+static const size_t DIGEST_SIZE = 64;
+
+static void put_le(std::vector<char> &data, size_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static void put_blob(std::vector<char> &data, const void *blob, size_t size)
+{
+    put_le(data, size, 8);
+    data.insert(data.end(), (const char *)blob, (const char *)blob + size);
+}
+
+static size_t get_le(const char *data, size_t size, size_t &pos, size_t bytes)
+{
+    if (pos + bytes > size)
+        throw std::runtime_error("Cache entry is truncated");
+
+    size_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (size_t)(unsigned char)data[pos + i] << (i * 8);
+    pos += bytes;
+    return value;
+}
+
+static const char *get_blob(const char *data, size_t size, size_t &pos, size_t &blob_size)
+{
+    blob_size = get_le(data, size, pos, 8);
+    if (blob_size > size - pos)
+        throw std::runtime_error("Cache entry is truncated");
+    const char *blob = data + pos;
+    pos += blob_size;
+    return blob;
+}
+
+result_cache::result_cache(std::string dir)
+    : _dir(std::move(dir))
+{
+}
+
+std::string result_cache::get_entry_path(const std::string &key) const
+{
+    return (std::filesystem::path(_dir) / key.substr(0, 2) / key).string();
+}
+
+bool result_cache::load(const std::string &key, code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos) const
+{
+    std::ifstream in(get_entry_path(key), std::ios::binary);
+    if (!in)
+        return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Magic, payload, digest of payload
+    if (data.size() < sizeof(CACHE_MAGIC) + DIGEST_SIZE || std::memcmp(data.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+        return false;
+    size_t size = data.size() - DIGEST_SIZE;
+    sha256 hasher;
+    hasher.update(data.data(), size);
+    if (hasher.hex_digest() != std::string(data.data() + size, DIGEST_SIZE))
+        return false;
+
+    try
+    {
+        size_t pos = sizeof(CACHE_MAGIC);
+        size_stat stat;
+        stat.initial_code_size = get_le(data.data(), size, pos, 8);
+        stat.final_code_size = get_le(data.data(), size, pos, 8);
+        stat.dict_32_bit_size = get_le(data.data(), size, pos, 8);
+        stat.dict_addr_bit_size = get_le(data.data(), size, pos, 8);
+        stat.entropy_table_size = get_le(data.data(), size, pos, 8);
+        stat.func_table_size = get_le(data.data(), size, pos, 8);
+        stat.block_map_size = get_le(data.data(), size, pos, 8);
+        stat.hot_table_size = get_le(data.data(), size, pos, 8);
+        stat.hot_dict_hits = get_le(data.data(), size, pos, 8);
+        stat.cold_dict_hits = get_le(data.data(), size, pos, 8);
+        stat.short_index_hits = get_le(data.data(), size, pos, 8);
+
+        std::vector<std::string> infos(get_le(data.data(), size, pos, 4));
+        for (auto &info : infos)
+        {
+            size_t info_size = 0;
+            const char *blob = get_blob(data.data(), size, pos, info_size);
+            info.assign(blob, info_size);
+        }
+
+        code_image loaded;
+        size_t code_size = 0;
+        const char *code = get_blob(data.data(), size, pos, code_size);
+        loaded.code.assign(code, code + code_size);
+        size_t dicts_cnt = get_le(data.data(), size, pos, 4);
+        for (size_t i = 0; i < dicts_cnt; ++i)
+        {
+            size_t name_size = 0, dict_size = 0;
+            const char *name = get_blob(data.data(), size, pos, name_size);
+            const char *dict = get_blob(data.data(), size, pos, dict_size);
+            loaded.add_dict(std::string(name, name_size), std::vector<uint8_t>(dict, dict + dict_size));
+        }
+        if (pos != size)
+            return false;
+
+        image = std::move(loaded);
+        szstat = stat;
+        dict_infos.insert(dict_infos.end(), infos.begin(), infos.end());
+    }
+    catch (std::runtime_error &)
+    {
+        return false;
+    }
+    return true;
+}
+
+void result_cache::store(const std::string &key, const code_image &image, const size_stat &szstat, const std::vector<std::string> &dict_infos) const
+{
+    std::vector<char> data(CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+    put_le(data, szstat.initial_code_size, 8);
+    put_le(data, szstat.final_code_size, 8);
+    put_le(data, szstat.dict_32_bit_size, 8);
+    put_le(data, szstat.dict_addr_bit_size, 8);
+    put_le(data, szstat.entropy_table_size, 8);
+    put_le(data, szstat.func_table_size, 8);
+    put_le(data, szstat.block_map_size, 8);
+    put_le(data, szstat.hot_table_size, 8);
+    put_le(data, szstat.hot_dict_hits, 8);
+    put_le(data, szstat.cold_dict_hits, 8);
+    put_le(data, szstat.short_index_hits, 8);
+
+    put_le(data, dict_infos.size(), 4);
+    for (const auto &info : dict_infos)
+        put_blob(data, info.data(), info.size());
+
+    put_blob(data, image.code.data(), image.code.size());
+    put_le(data, image.get_dicts().size(), 4);
+    for (const auto &dict : image.get_dicts())
+    {
+        put_blob(data, dict.first.data(), dict.first.size());
+        put_blob(data, dict.second.data(), dict.second.size());
+    }
+
+    sha256 hasher;
+    hasher.update(data.data(), data.size());
+    std::string digest = hasher.hex_digest();
+    data.insert(data.end(), digest.begin(), digest.end());
+
+    std::filesystem::path path = get_entry_path(key);
+    std::filesystem::create_directories(path.parent_path());
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp" + std::to_string(std::random_device()());
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), data.size()))
+            throw std::runtime_error("Can't write cache entry " + tmp_path.string());
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "code_image.h"
+#include "size_stat.h"
+
+namespace utils
+{
+
+// SHA-256 for content addressed names of cache entries
+class sha256
+{
+public:
+    sha256();
+
+    void update(const void *data, size_t size);
+    void update_u64(uint64_t value);
+
+    // Lowercase hex, hasher can't be updated after that
+    std::string hex_digest();
+
+private:
+    void transform(const uint8_t *block);
+
+    uint32_t _state[8];
+    uint8_t _block[64];
+    size_t _block_len { 0 };
+    uint64_t _total_len { 0 };
+};
+
+// Directory of compression results named by key (hex hash of everything
+// compressed output depends on). Entries are written to temporary file and
+// renamed, so concurrent runs see either nothing or whole entry
+class result_cache
+{
+public:
+    explicit result_cache(std::string dir);
+
+    // False if there is no entry or it's damaged, then it will be rewritten
+    bool load(const std::string &key, code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos) const;
+    void store(const std::string &key, const code_image &image, const size_stat &szstat, const std::vector<std::string> &dict_infos) const;
+
+    std::string get_entry_path(const std::string &key) const;
+
+private:
+    std::string _dir;
+};
+
+}
@@ -0,0 +1,138 @@
+#include "rv32i_format.h"
+
+namespace utils
+{
+
+const uint32_t RV32I_OPCODE_MASK = 0x0000007f;
+const uint32_t RV32I_RD_MASK     = 0x00000f80;
+const uint32_t RV32I_FUNCT3_MASK = 0x00007000;
+const uint32_t RV32I_RS1_MASK    = 0x000f8000;
+const uint32_t RV32I_RS2_MASK    = 0x01f00000;
+const uint32_t RV32I_FUNCT7_MASK = 0xfe000000;
+
+// Indexed by rv32i_format
+static const rv32i_layout layouts[] = {
+    // R
+    { RV32I_OPCODE_MASK | RV32I_FUNCT3_MASK | RV32I_FUNCT7_MASK,
+      RV32I_RD_MASK | RV32I_RS1_MASK | RV32I_RS2_MASK,
+      0x00000000,
+      0x00000000 },
+    // I
+    { RV32I_OPCODE_MASK | RV32I_FUNCT3_MASK,
+      RV32I_RD_MASK | RV32I_RS1_MASK,
+      0xfff00000,
+      0x00000000 },
+    // S
+    { RV32I_OPCODE_MASK | RV32I_FUNCT3_MASK,
+      RV32I_RS1_MASK | RV32I_RS2_MASK,
+      RV32I_FUNCT7_MASK | RV32I_RD_MASK,
+      0x00000000 },
+    // B
+    { RV32I_OPCODE_MASK | RV32I_FUNCT3_MASK,
+      RV32I_RS1_MASK | RV32I_RS2_MASK,
+      RV32I_FUNCT7_MASK | RV32I_RD_MASK,
+      0x00000000 },
+    // U
+    { RV32I_OPCODE_MASK,
+      RV32I_RD_MASK,
+      0xfffff000,
+      0x00000000 },
+    // J
+    { RV32I_OPCODE_MASK,
+      RV32I_RD_MASK,
+      0xfffff000,
+      0x00000000 },
+    // X
+    { RV32I_OPCODE_MASK,
+      0x00000000,
+      0x00000000,
+      0xffffff80 },
+};
+
+// Indexed by opcode[6:2], valid for opcode[1:0] == 0b11
+static const rv32i_format formats[32] = {
+    rv32i_format::I,    // 0x03 LOAD
+    rv32i_format::I,    // 0x07 LOAD-FP
+    rv32i_format::X,    // 0x0b custom-0
+    rv32i_format::I,    // 0x0f MISC-MEM
+    rv32i_format::I,    // 0x13 OP-IMM
+    rv32i_format::U,    // 0x17 AUIPC
+    rv32i_format::I,    // 0x1b OP-IMM-32
+    rv32i_format::X,    // 0x1f 48-bit
+    rv32i_format::S,    // 0x23 STORE
+    rv32i_format::S,    // 0x27 STORE-FP
+    rv32i_format::X,    // 0x2b custom-1
+    rv32i_format::R,    // 0x2f AMO
+    rv32i_format::R,    // 0x33 OP
+    rv32i_format::U,    // 0x37 LUI
+    rv32i_format::R,    // 0x3b OP-32
+    rv32i_format::X,    // 0x3f 64-bit
+    rv32i_format::X,    // 0x43 MADD
+    rv32i_format::X,    // 0x47 MSUB
+    rv32i_format::X,    // 0x4b NMSUB
+    rv32i_format::X,    // 0x4f NMADD
+    rv32i_format::R,    // 0x53 OP-FP
+    rv32i_format::X,    // 0x57 OP-V
+    rv32i_format::X,    // 0x5b custom-2
+    rv32i_format::X,    // 0x5f 48-bit
+    rv32i_format::B,    // 0x63 BRANCH
+    rv32i_format::I,    // 0x67 JALR
+    rv32i_format::X,    // 0x6b reserved
+    rv32i_format::J,    // 0x6f JAL
+    rv32i_format::I,    // 0x73 SYSTEM
+    rv32i_format::X,    // 0x77 reserved
+    rv32i_format::X,    // 0x7b custom-3
+    rv32i_format::X,    // 0x7f 80-bit
+};
+
+rv32i_format rv32i_get_format(uint32_t opcode)
+{
+    if ((opcode & 0x3) != 0x3)
+        return rv32i_format::X;
+    return formats[(opcode >> 2) & 0x1f];
+}
+
+const rv32i_layout &rv32i_get_layout(rv32i_format fmt)
+{
+    return layouts[(size_t)fmt];
+}
+
+size_t count_bits(uint32_t mask)
+{
+    size_t cnt = 0;
+    for (; mask != 0; mask &= mask - 1)
+        cnt++;
+    return cnt;
+}
+
+uint32_t extract_bits(uint32_t value, uint32_t mask)
+{
+    uint32_t retval = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < 32; ++i)
+    {
+        if ((mask >> i) & 0x1)
+        {
+            retval |= ((value >> i) & 0x1) << j;
+            j++;
+        }
+    }
+    return retval;
+}
+
+uint32_t deposit_bits(uint32_t value, uint32_t mask)
+{
+    uint32_t retval = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < 32; ++i)
+    {
+        if ((mask >> i) & 0x1)
+        {
+            retval |= ((value >> j) & 0x1) << i;
+            j++;
+        }
+    }
+    return retval;
+}
+
+}
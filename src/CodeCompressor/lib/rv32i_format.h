@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils
+{
+
+enum class rv32i_format
+{
+    R,
+    I,
+    S,
+    B,
+    U,
+    J,
+    X   // unknown opcode: only opcode goes through dictionary, rest is raw
+};
+
+// Every bit of an instruction belongs to exactly one field class
+// of its format: funct (opcode, funct3, funct7), regs (rd, rs1, rs2),
+// imm or raw
+struct rv32i_layout
+{
+    uint32_t funct_mask;
+    uint32_t regs_mask;
+    uint32_t imm_mask;
+    uint32_t raw_mask;
+};
+
+rv32i_format rv32i_get_format(uint32_t opcode);
+
+const rv32i_layout &rv32i_get_layout(rv32i_format fmt);
+
+size_t count_bits(uint32_t mask);
+
+// Gathers bits selected by mask into low bits of result (as pext)
+uint32_t extract_bits(uint32_t value, uint32_t mask);
+
+// Scatters low bits of value into positions selected by mask (as pdep)
+uint32_t deposit_bits(uint32_t value, uint32_t mask);
+
+}
@@ -0,0 +1,381 @@
+#include "rv32i_interp.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "utils.h"
+
+namespace utils
+{
+
+double interp_stat::hit_rate() const
+{
+    uint64_t fetches = cache_hits + cache_misses;
+    return fetches != 0 ? (double)cache_hits / fetches : 0;
+}
+
+double interp_stat::bits_per_instruction() const
+{
+    return instructions != 0 ? (double)work.bits / instructions : 0;
+}
+
+double interp_stat::dict_reads_per_instruction() const
+{
+    return instructions != 0 ? (double)work.dict_reads / instructions : 0;
+}
+
+// Syscall numbers of riscv libgloss
+enum rv_syscall
+{
+    SYS_CLOSE = 57,
+    SYS_LSEEK = 62,
+    SYS_READ = 63,
+    SYS_WRITE = 64,
+    SYS_FSTAT = 80,
+    SYS_EXIT = 93,
+    SYS_EXIT_GROUP = 94,
+    SYS_GETTIMEOFDAY = 169,
+    SYS_BRK = 214
+};
+
+const uint32_t RV_ENOSYS = 38;
+
+// Heap grows up to the stack
+const size_t STACK_SIZE = 1 << 20;
+
+static bool is_compressed(const ELFIO::elfio *file)
+{
+    for (size_t i = 0; i < file->sections.size(); ++i)
+    {
+        if (file->sections[i]->get_name().starts_with(".dict"))
+            return true;
+    }
+    return false;
+}
+
+class rv32i_machine
+{
+public:
+    rv32i_machine(const ELFIO::elfio *file, const interp_params &params)
+        : _params(params), _memory(params.memory_size, 0)
+    {
+        if (file->get_class() != ELFIO::ELFCLASS32 || file->get_machine() != ELFIO::EM_RISCV)
+            throw std::runtime_error("Not rv32 executable");
+        if (params.cache_sets == 0 || params.cache_ways == 0)
+            throw std::runtime_error("Empty line cache");
+
+        // Sections, not segments: compressed file is not laid out again
+        uint64_t end = 0;
+        for (size_t i = 0; i < file->sections.size(); ++i)
+        {
+            const ELFIO::section *sec = file->sections[i];
+            if (!(sec->get_flags() & ELFIO::SHF_ALLOC) || sec->get_size() == 0)
+                continue;
+            if (sec->get_address() + sec->get_size() > _memory.size())
+                throw std::runtime_error("Section " + sec->get_name() + " is out of memory");
+            if (sec->get_type() != ELFIO::SHT_NOBITS && sec->get_data() != nullptr)
+                std::memcpy(_memory.data() + sec->get_address(), sec->get_data(), sec->get_size());
+            end = std::max<uint64_t>(end, sec->get_address() + sec->get_size());
+        }
+        _brk = (end + 15) & ~(uint64_t)15;
+
+        if (is_compressed(file))
+        {
+            _decoder = std::make_unique<fetch_decoder>(file);
+            _lines.resize(params.cache_sets * params.cache_ways);
+        }
+
+        _pc = file->get_entry();
+        // argc = 0 and argv = NULL for crt0 at the top of stack
+        _regs[2] = (params.memory_size - 16) & ~(size_t)15;
+    }
+
+    interp_stat run()
+    {
+        while (!_exited)
+        {
+            if (_stat.instructions == _params.max_instructions)
+                throw std::runtime_error("Instruction limit is exceeded");
+            execute(fetch(_pc));
+            _regs[0] = 0;
+            _stat.instructions++;
+        }
+        return _stat;
+    }
+
+private:
+    struct cache_line
+    {
+        bool valid { false };
+        uint64_t tag { 0 };
+        uint64_t last_use { 0 };
+        uint32_t first { 0 };               // address of cmds[0]
+        std::vector<uint32_t> cmds;
+    };
+
+    uint32_t fetch(uint32_t pc)
+    {
+        if (pc % 4 != 0)
+            throw std::runtime_error("Misaligned fetch at " + std::to_string(pc));
+        if (_decoder == nullptr || pc < _decoder->get_text_addr() || pc >= _decoder->get_text_addr() + _decoder->get_text_size())
+            return load(pc, 4);
+
+        // Lines of .dict.addr table, counted from the start of .text
+        uint64_t tag = (pc - _decoder->get_text_addr()) >> addr_table::LINE_SHIFT;
+        cache_line *set = &_lines[(tag % _params.cache_sets) * _params.cache_ways];
+        cache_line *line = nullptr;
+        for (size_t i = 0; i < _params.cache_ways; ++i)
+        {
+            if (set[i].valid && set[i].tag == tag)
+            {
+                line = &set[i];
+                break;
+            }
+        }
+
+        if (line != nullptr)
+        {
+            _stat.cache_hits++;
+        }
+        else
+        {
+            _stat.cache_misses++;
+            line = &set[0];
+            for (size_t i = 1; i < _params.cache_ways && line->valid; ++i)
+            {
+                if (!set[i].valid || set[i].last_use < line->last_use)
+                    line = &set[i];
+            }
+
+            uint32_t first = _decoder->get_text_addr() + (tag << addr_table::LINE_SHIFT);
+            block_trace work;
+            std::vector<command> cmds = _decoder->decode(first, (1 << addr_table::LINE_SHIFT) / 4, work);
+            _stat.decoded += cmds.size();
+            _stat.work.bits += work.bits;
+            _stat.work.dict_reads += work.dict_reads;
+            _stat.work.dict_levels += work.dict_levels;
+            _stat.work.mask_applies += work.mask_applies;
+            _stat.work.entropy_symbols += work.entropy_symbols;
+
+            line->valid = true;
+            line->tag = tag;
+            line->first = first;
+            line->cmds.clear();
+            for (const auto &cmd : cmds)
+                line->cmds.push_back(cmd.to_size_t());
+        }
+
+        line->last_use = _stat.instructions;
+        size_t indx = (pc - line->first) / 4;
+        if (indx >= line->cmds.size())
+            throw std::runtime_error("Fetch is out of code section at " + std::to_string(pc));
+        return line->cmds[indx];
+    }
+
+    void check_access(uint32_t addr, size_t bytes) const
+    {
+        if ((uint64_t)addr + bytes > _memory.size())
+            throw std::runtime_error("Memory access out of range at " + std::to_string(_pc) + ": " + std::to_string(addr));
+    }
+
+    uint32_t load(uint32_t addr, size_t bytes) const
+    {
+        check_access(addr, bytes);
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= (uint32_t)_memory[addr + i] << (i * 8);
+        return value;
+    }
+
+    void store(uint32_t addr, uint32_t value, size_t bytes)
+    {
+        check_access(addr, bytes);
+        for (size_t i = 0; i < bytes; ++i)
+            _memory[addr + i] = value >> (i * 8);
+    }
+
+    uint32_t syscall(uint32_t num, uint32_t a0, uint32_t a1, uint32_t a2)
+    {
+        switch (num)
+        {
+            case SYS_EXIT:
+            case SYS_EXIT_GROUP:
+                _exited = true;
+                _stat.exit_code = (int32_t)a0;
+                return 0;
+            case SYS_WRITE:
+                if (a0 != 1 && a0 != 2)
+                    return -RV_ENOSYS;
+                check_access(a1, a2);
+                _stat.output.append((const char *)_memory.data() + a1, a2);
+                return a2;
+            case SYS_READ:
+                return 0;
+            case SYS_CLOSE:
+            case SYS_LSEEK:
+                return 0;
+            case SYS_GETTIMEOFDAY:
+                store(a0, 0, 4);
+                store(a0 + 4, 0, 4);
+                return 0;
+            case SYS_BRK:
+                if (a0 >= _brk && a0 < _params.memory_size - STACK_SIZE)
+                    _brk = a0;
+                return _brk;
+            case SYS_FSTAT:
+            default:
+                return -RV_ENOSYS;
+        }
+    }
+
+    void execute(uint32_t instr)
+    {
+        uint32_t opcode = instr & 0x7f;
+        uint32_t rd = (instr >> 7) & 0x1f;
+        uint32_t funct3 = (instr >> 12) & 0x7;
+        uint32_t rs1 = _regs[(instr >> 15) & 0x1f];
+        uint32_t rs2 = _regs[(instr >> 20) & 0x1f];
+        uint32_t funct7 = instr >> 25;
+        uint32_t imm_i = (int32_t)instr >> 20;
+        uint32_t imm_s = ((int32_t)instr >> 25 << 5) | ((instr >> 7) & 0x1f);
+        uint32_t imm_b = ((int32_t)instr >> 31 << 12) | (((instr >> 7) & 0x1) << 11) | (((instr >> 25) & 0x3f) << 5) | (((instr >> 8) & 0xf) << 1);
+        uint32_t imm_u = instr & 0xfffff000;
+        uint32_t imm_j = ((int32_t)instr >> 31 << 20) | (((instr >> 12) & 0xff) << 12) | (((instr >> 20) & 0x1) << 11) | (((instr >> 21) & 0x3ff) << 1);
+        uint32_t next = _pc + 4;
+
+        switch (opcode)
+        {
+            case 0x37:      // lui
+                _regs[rd] = imm_u;
+                break;
+            case 0x17:      // auipc
+                _regs[rd] = _pc + imm_u;
+                break;
+            case 0x6f:      // jal
+                _regs[rd] = next;
+                next = _pc + imm_j;
+                break;
+            case 0x67:      // jalr
+                next = (rs1 + imm_i) & ~(uint32_t)1;
+                _regs[rd] = _pc + 4;
+                break;
+            case 0x63:      // branches
+            {
+                bool taken = false;
+                switch (funct3)
+                {
+                    case 0: taken = rs1 == rs2; break;
+                    case 1: taken = rs1 != rs2; break;
+                    case 4: taken = (int32_t)rs1 < (int32_t)rs2; break;
+                    case 5: taken = (int32_t)rs1 >= (int32_t)rs2; break;
+                    case 6: taken = rs1 < rs2; break;
+                    case 7: taken = rs1 >= rs2; break;
+                    default: illegal(instr);
+                }
+                if (taken)
+                    next = _pc + imm_b;
+                break;
+            }
+            case 0x03:      // loads
+            {
+                uint32_t addr = rs1 + imm_i;
+                switch (funct3)
+                {
+                    case 0: _regs[rd] = (int8_t)load(addr, 1); break;
+                    case 1: _regs[rd] = (int16_t)load(addr, 2); break;
+                    case 2: _regs[rd] = load(addr, 4); break;
+                    case 4: _regs[rd] = load(addr, 1); break;
+                    case 5: _regs[rd] = load(addr, 2); break;
+                    default: illegal(instr);
+                }
+                break;
+            }
+            case 0x23:      // stores
+                if (funct3 > 2)
+                    illegal(instr);
+                store(rs1 + imm_s, rs2, 1 << funct3);
+                break;
+            case 0x13:      // ALU with immediate
+            {
+                uint32_t shamt = imm_i & 0x1f;
+                switch (funct3)
+                {
+                    case 0: _regs[rd] = rs1 + imm_i; break;
+                    case 1: _regs[rd] = rs1 << shamt; break;
+                    case 2: _regs[rd] = (int32_t)rs1 < (int32_t)imm_i; break;
+                    case 3: _regs[rd] = rs1 < imm_i; break;
+                    case 4: _regs[rd] = rs1 ^ imm_i; break;
+                    case 5: _regs[rd] = funct7 & 0x20 ? (uint32_t)((int32_t)rs1 >> shamt) : rs1 >> shamt; break;
+                    case 6: _regs[rd] = rs1 | imm_i; break;
+                    case 7: _regs[rd] = rs1 & imm_i; break;
+                }
+                break;
+            }
+            case 0x33:      // ALU with registers
+            {
+                if (funct7 != 0 && funct7 != 0x20)
+                    illegal(instr);
+                uint32_t shamt = rs2 & 0x1f;
+                switch (funct3)
+                {
+                    case 0: _regs[rd] = funct7 ? rs1 - rs2 : rs1 + rs2; break;
+                    case 1: _regs[rd] = rs1 << shamt; break;
+                    case 2: _regs[rd] = (int32_t)rs1 < (int32_t)rs2; break;
+                    case 3: _regs[rd] = rs1 < rs2; break;
+                    case 4: _regs[rd] = rs1 ^ rs2; break;
+                    case 5: _regs[rd] = funct7 ? (uint32_t)((int32_t)rs1 >> shamt) : rs1 >> shamt; break;
+                    case 6: _regs[rd] = rs1 | rs2; break;
+                    case 7: _regs[rd] = rs1 & rs2; break;
+                }
+                break;
+            }
+            case 0x0f:      // fence
+                break;
+            case 0x73:      // ecall, ebreak, counters
+                if (instr == 0x00000073)
+                    _regs[10] = syscall(_regs[17], _regs[10], _regs[11], _regs[12]);
+                else if (instr == 0x00100073)
+                    throw std::runtime_error("ebreak at " + std::to_string(_pc));
+                else if (funct3 != 0)
+                    _regs[rd] = (uint32_t)_stat.instructions;   // cycle, time and instret are the same
+                else
+                    illegal(instr);
+                break;
+            default:
+                illegal(instr);
+        }
+
+        _pc = next;
+    }
+
+    [[noreturn]] void illegal(uint32_t instr) const
+    {
+        throw std::runtime_error("Illegal instruction " + std::to_string(instr) + " at " + std::to_string(_pc));
+    }
+
+    interp_params _params;
+    std::vector<uint8_t> _memory;
+    uint32_t _regs[32] { };
+    uint32_t _pc { 0 };
+    uint64_t _brk { 0 };
+    bool _exited { false };
+    interp_stat _stat;
+
+    std::unique_ptr<fetch_decoder> _decoder;
+    std::vector<cache_line> _lines;
+};
+
+interp_stat rv32i_run(const ELFIO::elfio *file, const interp_params &params)
+{
+    auto start = std::chrono::steady_clock::now();
+    rv32i_machine machine(file, params);
+    interp_stat stat = machine.run();
+    stat.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stat;
+}
+
+}
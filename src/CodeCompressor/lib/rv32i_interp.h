@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "elfio/elfio.hpp"
+
+#include "fetch_model.h"
+
+namespace utils
+{
+
+class interp_params
+{
+public:
+    size_t memory_size { 64 << 20 };            // bytes from address 0, stack starts at the top
+    size_t cache_sets { 16 };                   // decoded line cache, lines of addr_table::LINE_SHIFT
+    size_t cache_ways { 4 };                    // LRU inside a set
+    uint64_t max_instructions { 1ull << 34 };
+};
+
+class interp_stat
+{
+public:
+    uint64_t instructions { 0 };    // retired
+    uint64_t cache_hits { 0 };      // fetches of compressed .text
+    uint64_t cache_misses { 0 };
+    uint64_t decoded { 0 };         // commands decoded on misses
+    block_trace work;               // decoder work of all misses
+    double seconds { 0 };           // with loading of dictionaries
+    int exit_code { 0 };
+    std::string output;             // written to stdout and stderr
+
+    double hit_rate() const;
+    double bits_per_instruction() const;
+    double dict_reads_per_instruction() const;
+};
+
+// RV32I interpreter of static newlib executables, ecalls of riscv libgloss
+// (exit, write, brk, ...) are served by host. Commands of compressed .text
+// are decoded on fetch by lines kept in set associative cache, the rest of
+// code is fetched from memory
+interp_stat rv32i_run(const ELFIO::elfio *file, const interp_params &params = interp_params());
+
+}
@@ -12,6 +12,30 @@ public:
     size_t final_code_size { 0 };
     size_t dict_32_bit_size { 0 };
     size_t dict_addr_bit_size { 0 };
+    size_t entropy_table_size { 0 };
+    size_t func_table_size { 0 };
+    size_t block_map_size { 0 };
+    size_t hot_table_size { 0 };
+
+    // Commands coded with hot and cold tier of DICT and MASK_SINGLE
+    // dictionary (mask codewords too), with one level dictionary every hit
+    // is cold. Not counted for entropy coding
+    size_t hot_dict_hits { 0 };
+    size_t cold_dict_hits { 0 };
+
+    // DICT commands coded with short code of index_coding, other hits of
+    // coded DICT are cold
+    size_t short_index_hits { 0 };
+
+    // Estimated peak working set of compressor, input .text included
+    size_t peak_histogram_memory { 0 };
+    size_t peak_dictionary_memory { 0 };
+    size_t peak_encode_memory { 0 };
+    size_t peak_memory { 0 };
+
+    // Result cache of config_builder::set_cache_dir, peaks are 0 on hit
+    size_t cache_hits { 0 };
+    size_t cache_misses { 0 };
 };
 
 }
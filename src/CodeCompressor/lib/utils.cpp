@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <iterator>
 #include <exception>
+#include <optional>
 #include <sstream>
 
 #include "elfio/elfio.hpp"
@@ -14,7 +15,20 @@
 #include "command.h"
 #include "size_stat.h"
 #include "dynbitset.h"
+#include "addr_table.h"
+#include "block_map.h"
+#include "code_header.h"
+#include "code_image.h"
+#include "codeword_map.h"
+#include "dict_batch.h"
 #include "encode_table.h"
+#include "func_table.h"
+#include "huffman_table.h"
+#include "index_coding.h"
+#include "mask_search.h"
+#include "memory_meter.h"
+#include "result_cache.h"
+#include "rv32i_format.h"
 #include "compressed_section.h"
 
 #include <iostream>
@@ -22,8 +36,6 @@
 namespace utils
 {
 
-const size_t RV64I_CMDLEN = 8;
-
 const size_t RV32I_CMDLEN = 4;
 const size_t RV32I_CMDLEN_O = 3;
 const size_t RV32I_CMDLEN_H = 2;
@@ -47,6 +59,30 @@ const size_t MASK_OPERS_POS_SIZE = 3;
 const size_t MASK_OPERS_MASK_SIZE = 3;
 const size_t MASK_OPERS_INDX_SIZE = 10; // 10
 
+const size_t FIELDS_FUNCT_CMDLEN = 3;
+const size_t FIELDS_FUNCT_BITS = 17;    // opcode + funct3 + funct7
+const size_t FIELDS_FUNCT_INDX_SIZE = 6;
+const size_t FIELDS_REGS_CMDLEN = 2;
+const size_t FIELDS_REGS_INDX_SIZE = 9;
+const size_t FIELDS_IMM_CMDLEN = 3;
+const size_t FIELDS_IMM_INDX_SIZE = 8;
+
+const size_t FIXED_INDX_SIZE = 15;      // 16 bit codewords
+const size_t FIXED_MAX_INDX_SIZE = 24;  // wider codewords if dictionary and overflow table don't fit 16 bits
+
+const size_t DICT_BLOCKS_INDX_SIZE = 12;
+const size_t DICT_BLOCKS_SHIFT = 8;     // 256 commands, 1 KiB of .text
+const size_t DICT_BLOCKS_ROUNDS = 2;    // retraining of dictionaries after reassignment of blocks
+
+const size_t HOT_DICT_MAX_ENTRIES = 256;
+
+// Predictor of coded DICT indices is reset at every addr_table line
+const size_t INDEX_LINE_CMDS = ((size_t)1 << addr_table::LINE_SHIFT) / RV32I_CMDLEN;
+
+const size_t MASK_MULTI_INDX_SIZE = 13;
+const size_t MASK_MULTI_WINDOWS = 2;    // more windows don't fit in 33 bits of literal
+
+
 /*
 bellman_ford            123997  108918  104473  112014  123186  105580
 dijkastra               124233  109175  104696  112255  123503  105756
@@ -124,10 +160,10 @@ std::vector<command> riscv64ci_get_commands(const ELFIO::section *sec_text, conf
 }
 
 template<size_t CMDLEN>
-std::vector<utils::command> get_commands(const ELFIO::section *sec_text)
+std::vector<utils::command> get_commands(std::span<const uint8_t> text)
 {
-    const char *data = sec_text->get_data();
-    ELFIO::Elf_Xword data_len = sec_text->get_size();
+    const char *data = (const char *)text.data();
+    size_t data_len = text.size();
 
     if (data_len % CMDLEN != 0) {
         throw std::runtime_error("Section size must be divided by cmdlen");
@@ -137,7 +173,7 @@ std::vector<utils::command> get_commands(const ELFIO::section *sec_text)
     std::vector<utils::command> commands;
     const size_t cmdlen_bits = CMDLEN << 3;
 
-    for (ELFIO::Elf_Xword i = 0; i < data_len; i += CMDLEN) {
+    for (size_t i = 0; i < data_len; i += CMDLEN) {
         command comm;
         comm.add(data + i, cmdlen_bits);
         commands.push_back(comm);
@@ -145,116 +181,308 @@ std::vector<utils::command> get_commands(const ELFIO::section *sec_text)
     return commands;
 }
 
-compressed_section get_compressed_section(const ELFIO::section *sec_text, encode_type &etype)
+static std::span<const uint8_t> get_section_bytes(const ELFIO::section *sec)
 {
-    const char *data = sec_text->get_data();
-    size_t code_sections_size = sec_text->get_size();
-    char *data_cpy = new char[code_sections_size];
-    size_t data_size = code_sections_size - sizeof(char);
-    char etype_data;
-    char metadata;
-
-    memcpy(&metadata, data, sizeof(char));
-    memcpy(data_cpy, data + sizeof(char), data_size);
+    return std::span<const uint8_t>((const uint8_t *)sec->get_data(), sec->get_size());
+}
+
+template<size_t CMDLEN>
+std::vector<utils::command> get_commands(const ELFIO::section *sec_text)
+{
+    return get_commands<CMDLEN>(get_section_bytes(sec_text));
+}
+
+// Used by unit tests
+template std::vector<utils::command> get_commands<RV32I_CMDLEN>(const ELFIO::section *sec_text);
+
+// Codeword layout of every part of command in stream order, it's recorded in
+// compressed section header and checked before decoding. FIXED16 index
+// width is chosen by encoder, fixed_indx_size is taken from header
+std::vector<codeword_part> get_codeword_parts(encode_type etype, size_t cmdlen, size_t fixed_indx_size = FIXED_INDX_SIZE)
+{
+    if (cmdlen != RV32I_CMDLEN)
+        throw std::runtime_error("Bad command length of compressed section");
+
+    const codeword_part mask_duo = { RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE };
+    const codeword_part mask_quad = { RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE };
+    switch (etype)
+    {
+        case encode_type::DICT:
+            return { { RV32I_CMDLEN, 0, 0, DICT_INDX_SIZE } };
+        case encode_type::MASK_SINGLE:
+            return { { RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE } };
+        case encode_type::MASK_DUO:
+            return { mask_duo, mask_duo };
+        case encode_type::MASK_QUAD:
+            return { mask_quad, mask_quad, mask_quad, mask_quad };
+        case encode_type::MASK_OPERANDS_OPCODE:
+            return { { RV32I_CMDLEN_O, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE }, mask_quad };
+        case encode_type::MASK_DUO_QUAD:
+            return { mask_duo, mask_quad, mask_quad };
+        case encode_type::RV32I_FIELDS:
+            return {
+                { FIELDS_FUNCT_CMDLEN, 0, 0, FIELDS_FUNCT_INDX_SIZE },
+                { FIELDS_REGS_CMDLEN, 0, 0, FIELDS_REGS_INDX_SIZE },
+                { FIELDS_IMM_CMDLEN, 0, 0, FIELDS_IMM_INDX_SIZE }
+            };
+        case encode_type::FIXED16:
+            if (fixed_indx_size < FIXED_INDX_SIZE || fixed_indx_size > FIXED_MAX_INDX_SIZE)
+                throw std::runtime_error("Bad fixed codeword width of compressed section");
+            return { { RV32I_CMDLEN, 0, 0, fixed_indx_size } };
+        case encode_type::DICT_BLOCKS:
+            return { { RV32I_CMDLEN, 0, 0, DICT_BLOCKS_INDX_SIZE } };
+        case encode_type::MASK_MULTI:
+            return { { RV32I_CMDLEN, 0, 0, MASK_MULTI_INDX_SIZE } };
+        default:
+            throw std::runtime_error("Not yet supported encoding type");
+    }
+}
+
+// Header with layout this build decodes, size of header goes to header_size
+static code_header read_code_header(std::span<const uint8_t> code, size_t &header_size)
+{
+    code_header header = code_header::deserialize(code, header_size);
+    size_t fixed_indx_size = header.etype == encode_type::FIXED16 && header.parts.size() == 1 ? header.parts[0].indx_size : FIXED_INDX_SIZE;
+    if (header.parts != get_codeword_parts(header.etype, header.cmdlen, fixed_indx_size))
+        throw std::runtime_error("Unsupported codeword layout of compressed section");
+    return header;
+}
+
+compressed_section get_compressed_section(std::span<const uint8_t> code, code_header &header)
+{
+    size_t header_size = 0;
+    header = read_code_header(code, header_size);
+
     compressed_section csec;
-    csec.add(data_cpy, (data_size << 3) - ((metadata >> 5) & 0x7));
-    delete[] data_cpy;
+    csec.add((const char *)code.data() + header_size, header.stream_bits);
+    return csec;
+}
 
-    etype_data = metadata & 0x1f;
-    etype = (encode_type)etype_data;
+compressed_section get_compressed_section(std::span<const uint8_t> code, encode_type &etype, size_t &cmds_cnt)
+{
+    code_header header;
+    compressed_section csec = get_compressed_section(code, header);
+    etype = header.etype;
+    cmds_cnt = header.cmds_cnt;
     return csec;
 }
 
+bool check_code(std::span<const uint8_t> code, const dict_views &dicts)
+{
+    try
+    {
+        size_t header_size = 0;
+        code_header header = read_code_header(code, header_size);
+        return header.check(code.subspan(header_size), dicts);
+    }
+    catch (std::runtime_error &)
+    {
+        return false;
+    }
+}
 
-template<size_t INDX_SIZE>
-void mask_single_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN, INDX_SIZE> &entab)
+compressed_section get_compressed_section(const ELFIO::section *sec_text, encode_type &etype, size_t &cmds_cnt)
 {
-    dict_make_encode_table(commands, cfg, entab);
+    return get_compressed_section(get_section_bytes(sec_text), etype, cmds_cnt);
 }
 
-template<size_t P1_SIZE, size_t P2_SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
-void mask_duo_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<P1_SIZE, INDX1_SIZE> &entab1, encode_table<P2_SIZE, INDX2_SIZE> &entab2)
+compressed_section get_compressed_section(const ELFIO::section *sec_text, encode_type &etype)
 {
-    std::vector<command> cmds1, cmds2;
+    size_t cmds_cnt = 0;
+    return get_compressed_section(sec_text, etype, cmds_cnt);
+}
 
-    for (const auto & cmd : commands)
-    {
-        command cmd1, cmd2;
-        
-        cmd.devide(cmd1, cmd2, P1_SIZE << 3);
 
-        cmds1.push_back(cmd1);
-        cmds2.push_back(cmd2);
-    }
+// Bitstream with offsets of its blocks and copy of it in code_image
+static size_t encoded_section_memory(const compressed_section &csec)
+{
+    return 2 * csec.get_data_sz() + csec.get_block_offsets().size() * sizeof(size_t);
+}
 
-    dict_make_encode_table(cmds1, cfg, entab1);
-    dict_make_encode_table(cmds2, cfg, entab2);
+size_t histogram_threads(const config &cfg, size_t cmds_cnt)
+{
+    size_t threads = cfg.get_histogram_threads();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (cfg.get_memory_budget() != 0)
+        threads = std::min(threads, cfg.get_memory_budget() / (HISTOGRAM_WINDOW * sizeof(flat_histogram::value_type)));
+    return std::max<size_t>(1, std::min(threads, cmds_cnt / HISTOGRAM_THREAD_CMDS));
 }
 
-template<size_t INDX_SIZE>
-void mask_quad_make_encode_table(const std::vector<command> &commands, const config &cfg, std::array<encode_table<RV32I_CMDLEN_Q, INDX_SIZE>, 4> &entabs)
+void flat_histogram_merge(flat_histogram &hist, flat_histogram &window, memory_meter *meter)
 {
-    std::vector<command> cmds11, cmds12, cmds21, cmds22;
+    std::sort(window.begin(), window.end(), [](const flat_histogram::value_type &p1, const flat_histogram::value_type &p2) {
+        return p1.first < p2.first;
+    });
+
+    flat_histogram merged;
+    memory_scope merged_memory(meter, (hist.size() + window.size()) * sizeof(flat_histogram::value_type));
+    merged.reserve(hist.size() + window.size());
 
-    for (const auto & cmd : commands)
+    auto hist_it = hist.begin();
+    for (size_t i = 0; i < window.size();)
     {
-        command cmd1, cmd2, cmd11, cmd12, cmd21, cmd22;
+        size_t value = window[i].first;
+        uint64_t count = 0;
+        for (; i < window.size() && window[i].first == value; ++i)
+            count += window[i].second;
+
+        for (; hist_it != hist.end() && hist_it->first < value; ++hist_it)
+            merged.push_back(*hist_it);
+        if (hist_it != hist.end() && hist_it->first == value)
+            count += (hist_it++)->second;
+        merged.emplace_back(value, count);
+    }
+    merged.insert(merged.end(), hist_it, hist.end());
 
-        cmd.devide_half(cmd1, cmd2);
-        cmd1.devide_half(cmd11, cmd12);
-        cmd2.devide_half(cmd21, cmd22);
+    hist.swap(merged);
+    window.clear();
+}
 
-        cmds11.push_back(cmd11);
-        cmds12.push_back(cmd12);
-        cmds21.push_back(cmd21);
-        cmds22.push_back(cmd22);
-    }
+template<size_t INDX_SIZE>
+void mask_single_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, memory_meter *meter)
+{
+    dict_make_encode_table(commands, cfg, entab, meter);
+}
 
-    dict_make_encode_table(cmds11, cfg, entabs[0]);
-    dict_make_encode_table(cmds12, cfg, entabs[1]);
-    dict_make_encode_table(cmds21, cfg, entabs[2]);
-    dict_make_encode_table(cmds22, cfg, entabs[3]);
+// Parts are counted straight from commands one dictionary at a time, no
+// vectors of split commands are kept
+template<size_t P1_SIZE, size_t P2_SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
+void mask_duo_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<P1_SIZE, INDX1_SIZE> &entab1, encode_table<P2_SIZE, INDX2_SIZE> &entab2, memory_meter *meter)
+{
+    dict_make_encode_table(commands, cfg, entab1, meter, [](const command &cmd, command &cmd1) {
+        command cmd2;
+        cmd.devide(cmd1, cmd2, P1_SIZE << 3);
+        return true;
+    });
+    dict_make_encode_table(commands, cfg, entab2, meter, [](const command &cmd, command &cmd2) {
+        command cmd1;
+        cmd.devide(cmd1, cmd2, P1_SIZE << 3);
+        return true;
+    });
 }
 
-template<size_t INDX_SIZE_H, size_t INDX_SIZE_Q>
-void mask_duo_quad_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN_H, INDX_SIZE_H> &entab1, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab21, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab22)
+// Quarter of command, quarters are numbered from the lowest byte
+static command command_quarter(const command &cmd, size_t quarter)
 {
-    std::vector<command> cmds1, cmds21, cmds22;
+    command cmd1, cmd2, cmd_q1, cmd_q2;
+
+    cmd.devide_half(cmd1, cmd2);
+    (quarter < 2 ? cmd1 : cmd2).devide_half(cmd_q1, cmd_q2);
+    return quarter % 2 == 0 ? cmd_q1 : cmd_q2;
+}
 
-    for (const auto & cmd : commands)
+template<size_t INDX_SIZE>
+void mask_quad_make_encode_table(const std::vector<command> &commands, const config &cfg, std::array<encode_table<RV32I_CMDLEN_Q, INDX_SIZE>, 4> &entabs, memory_meter *meter)
+{
+    for (size_t quarter = 0; quarter < entabs.size(); ++quarter)
     {
-        command cmd1, cmd2, cmd21, cmd22;
+        dict_make_encode_table(commands, cfg, entabs[quarter], meter, [quarter](const command &cmd, command &part) {
+            part = command_quarter(cmd, quarter);
+            return true;
+        });
+    }
+}
 
+template<size_t INDX_SIZE_H, size_t INDX_SIZE_Q>
+void mask_duo_quad_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN_H, INDX_SIZE_H> &entab1, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab21, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab22, memory_meter *meter)
+{
+    dict_make_encode_table(commands, cfg, entab1, meter, [](const command &cmd, command &cmd1) {
+        command cmd2;
         cmd.devide_half(cmd1, cmd2);
-        cmd2.devide_half(cmd21, cmd22);
+        return true;
+    });
+    dict_make_encode_table(commands, cfg, entab21, meter, [](const command &cmd, command &part) {
+        part = command_quarter(cmd, 2);
+        return true;
+    });
+    dict_make_encode_table(commands, cfg, entab22, meter, [](const command &cmd, command &part) {
+        part = command_quarter(cmd, 3);
+        return true;
+    });
+}
 
-        cmds1.push_back(cmd1);
-        cmds21.push_back(cmd21);
-        cmds22.push_back(cmd22);
-    }
+template<size_t INDX_SIZE_O, size_t INDX_SIZE_Q>
+void mask_operands_opcode_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN_O, INDX_SIZE_O> &entab_operands, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab_opcode, memory_meter *meter)
+{
+    dict_make_encode_table(commands, cfg, entab_operands, meter, [](const command &cmd, command &cmd_operands) {
+        command cmd_opcode;
+        cmd.devide(cmd_opcode, cmd_operands, RV32I_CMDLEN_Q << 3);
+        return true;
+    });
+    dict_make_encode_table(commands, cfg, entab_opcode, meter, [](const command &cmd, command &cmd_opcode) {
+        command cmd_operands;
+        cmd.devide(cmd_opcode, cmd_operands, RV32I_CMDLEN_Q << 3);
+        return true;
+    });
+}
 
-    dict_make_encode_table(cmds1, cfg, entab1);
-    dict_make_encode_table(cmds21, cfg, entab21);
-    dict_make_encode_table(cmds22, cfg, entab22);
+// Narrow fields (e.g. rd of U/J) are cheaper as plain bits than as flag + index
+static bool field_uses_dictionary(uint32_t mask, size_t indx_size)
+{
+    return count_bits(mask) > indx_size + 1;
 }
 
-template<size_t INDX_SIZE_O, size_t INDX_SIZE_Q>
-void mask_operands_opcode_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN_O, INDX_SIZE_O> &entab_operands, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab_opcode)
+template<size_t CMDLEN, size_t INDX_SIZE>
+void compress_field_bits(command &ccmd, const encode_table<CMDLEN, INDX_SIZE> &entab, uint32_t value, uint32_t mask)
 {
-    std::vector<command> cmds_operands, cmds_opcode;
+    if (mask == 0)
+        return;
 
-    for (const auto & cmd : commands)
-    {
-        command cmd_operands, cmd_opcode;
+    if (field_uses_dictionary(mask, INDX_SIZE))
+        ccmd.add(compress_field_with_dictionary(entab, extract_bits(value, mask), count_bits(mask)));
+    else
+        ccmd.add(extract_bits(value, mask), count_bits(mask));
+}
 
-        cmd.devide(cmd_opcode, cmd_operands, RV32I_CMDLEN_Q << 3);
+template<size_t CMDLEN, size_t INDX_SIZE>
+uint32_t restore_field_bits(const compressed_section &csec, size_t &pos, const encode_table<CMDLEN, INDX_SIZE> &entab, uint32_t mask)
+{
+    if (mask == 0)
+        return 0;
 
-        cmds_operands.push_back(cmd_operands);
-        cmds_opcode.push_back(cmd_opcode);
+    size_t field_bits = count_bits(mask);
+    uint32_t field = 0;
+    if (field_uses_dictionary(mask, INDX_SIZE))
+    {
+        field = restore_field(csec, pos, entab, field_bits);
+    }
+    else
+    {
+        field = csec.getseq(pos, pos + field_bits).to_size_t();
+        pos += field_bits;
     }
 
-    dict_make_encode_table(cmds_operands, cfg, entab_operands);
-    dict_make_encode_table(cmds_opcode, cfg, entab_opcode);
+    return deposit_bits(field, mask);
+}
+
+template<size_t INDX_SIZE_F, size_t INDX_SIZE_R, size_t INDX_SIZE_I>
+void fields_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<FIELDS_FUNCT_CMDLEN, INDX_SIZE_F> &entab_funct, encode_table<FIELDS_REGS_CMDLEN, INDX_SIZE_R> &entab_regs, encode_table<FIELDS_IMM_CMDLEN, INDX_SIZE_I> &entab_imm, memory_meter *meter)
+{
+    dict_make_encode_table(commands, cfg, entab_funct, meter, [](const command &cmd, command &cmd_funct) {
+        uint32_t value = cmd.to_size_t();
+        const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(value));
+        cmd_funct.add(extract_bits(value, layout.funct_mask), FIELDS_FUNCT_CMDLEN << 3);
+        return true;
+    });
+
+    dict_make_encode_table(commands, cfg, entab_regs, meter, [](const command &cmd, command &cmd_regs) {
+        uint32_t value = cmd.to_size_t();
+        const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(value));
+        if (!field_uses_dictionary(layout.regs_mask, INDX_SIZE_R))
+            return false;
+        cmd_regs.add(extract_bits(value, layout.regs_mask), FIELDS_REGS_CMDLEN << 3);
+        return true;
+    });
+
+    dict_make_encode_table(commands, cfg, entab_imm, meter, [](const command &cmd, command &cmd_imm) {
+        uint32_t value = cmd.to_size_t();
+        const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(value));
+        if (!field_uses_dictionary(layout.imm_mask, INDX_SIZE_I))
+            return false;
+        cmd_imm.add(extract_bits(value, layout.imm_mask), FIELDS_IMM_CMDLEN << 3);
+        return true;
+    });
 }
 
 
@@ -281,9 +509,10 @@ void update_counters(const comp_cmd_type &tp, int &dict_cnt, int &notc_cnt)
 #endif
 
 template<size_t INDX_SIZE>
-compressed_section encode_code_section_dictionary(std::vector<command> commands, encode_table<RV32I_CMDLEN, INDX_SIZE> entab)
+compressed_section encode_code_section_dictionary(std::vector<command> commands, encode_table<RV32I_CMDLEN, INDX_SIZE> entab, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict_cnt = 0;
@@ -292,6 +521,7 @@ compressed_section encode_code_section_dictionary(std::vector<command> commands,
 
     for (auto comm : commands)
     {
+        csec.mark_block();
 #ifdef BENCH_COVERAGE
         comp_cmd_type tp;
         csec.add(compress_command_with_dictionary(entab, comm, tp));
@@ -306,9 +536,10 @@ compressed_section encode_code_section_dictionary(std::vector<command> commands,
 }
 
 template<size_t INDX_SIZE>
-compressed_section encode_code_section_mask_single(std::vector<command> commands, encode_table<RV32I_CMDLEN, INDX_SIZE> entab)
+compressed_section encode_code_section_mask_single(std::vector<command> commands, encode_table<RV32I_CMDLEN, INDX_SIZE> entab, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict_cnt = 0;
@@ -318,6 +549,7 @@ compressed_section encode_code_section_mask_single(std::vector<command> commands
 
     for (auto comm : commands)
     {
+        csec.mark_block();
 #ifdef BENCH_COVERAGE
         comp_cmd_type tp;
         csec.add(compress_command_with_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(entab, comm, tp));
@@ -331,10 +563,55 @@ compressed_section encode_code_section_mask_single(std::vector<command> commands
     return csec;
 }
 
+// Every command takes the shortest of exact entry, masked entry of any
+// shape and literal, masked candidates come from mask_index
+template<size_t INDX_SIZE>
+compressed_section encode_code_section_mask_multi(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, const progress_callback &progress)
+{
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
+
+    std::vector<uint32_t> values;
+    for (const auto &entry : entab.get_entries())
+        values.push_back(entry.to_size_t());
+    mask_index index(values, MASK_MULTI_WINDOWS);
+
+    const size_t literal_bits = 1 + (RV32I_CMDLEN << 3);
+    for (const auto &comm : commands)
+    {
+        csec.mark_block();
+        command ccmd;
+        int indx = entab.find(comm);
+        mask_match match;
+        if (indx != -1)
+        {
+            ccmd.add(true);
+            ccmd.add(true);
+            ccmd.add(indx, INDX_SIZE);
+        }
+        else if (index.find(comm.to_size_t(), match) && 2 + mask_windows_bits(match, MASK_MULTI_WINDOWS) + INDX_SIZE < literal_bits)
+        {
+            ccmd.add(true);
+            ccmd.add(false);
+            add_mask_windows(ccmd, match, MASK_MULTI_WINDOWS);
+            ccmd.add(match.indx, INDX_SIZE);
+        }
+        else
+        {
+            ccmd.add(false);
+            ccmd.add(comm);
+        }
+        csec.add(ccmd);
+    }
+
+    return csec;
+}
+
 template<size_t INDX_SIZE>
-compressed_section encode_code_section_mask_duo(std::vector<command> commands, encode_table<RV32I_CMDLEN_H, INDX_SIZE> entab1, encode_table<RV32I_CMDLEN_H, INDX_SIZE> entab2)
+compressed_section encode_code_section_mask_duo(std::vector<command> commands, encode_table<RV32I_CMDLEN_H, INDX_SIZE> entab1, encode_table<RV32I_CMDLEN_H, INDX_SIZE> entab2, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict1_cnt = 0, dict2_cnt = 0;
@@ -344,6 +621,7 @@ compressed_section encode_code_section_mask_duo(std::vector<command> commands, e
 
     for (auto comm : commands)
     {
+        csec.mark_block();
         command ccmd1, ccmd2;
 
         comm.devide_half(ccmd1, ccmd2);
@@ -365,9 +643,10 @@ compressed_section encode_code_section_mask_duo(std::vector<command> commands, e
 }
 
 template<size_t INDX_SIZE>
-compressed_section encode_code_section_mask_quad(std::vector<command> commands, std::array<encode_table<RV32I_CMDLEN_Q, INDX_SIZE>, 4> entabs)
+compressed_section encode_code_section_mask_quad(std::vector<command> commands, std::array<encode_table<RV32I_CMDLEN_Q, INDX_SIZE>, 4> entabs, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict1_cnt = 0, dict2_cnt = 0, dict3_cnt = 0, dict4_cnt = 0;
@@ -377,6 +656,7 @@ compressed_section encode_code_section_mask_quad(std::vector<command> commands,
 
     for (auto comm : commands)
     {
+        csec.mark_block();
         command ccmd1, ccmd2, ccmd11, ccmd12, ccmd21, ccmd22;
 
         comm.devide_half(ccmd1, ccmd2);
@@ -406,9 +686,10 @@ compressed_section encode_code_section_mask_quad(std::vector<command> commands,
 }
 
 template<size_t INDX_SIZE_H, size_t INDX_SIZE_Q>
-compressed_section encode_code_section_mask_duo_quad(std::vector<command> commands, encode_table<RV32I_CMDLEN_H, INDX_SIZE_H> entab1, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab2, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab3)
+compressed_section encode_code_section_mask_duo_quad(std::vector<command> commands, encode_table<RV32I_CMDLEN_H, INDX_SIZE_H> entab1, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab2, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab3, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict1_cnt = 0, dict2_cnt = 0, dict3_cnt = 0;
@@ -418,6 +699,7 @@ compressed_section encode_code_section_mask_duo_quad(std::vector<command> comman
 
     for (auto comm : commands)
     {
+        csec.mark_block();
         command ccmd1, ccmd2, ccmd21, ccmd22;
 
         comm.devide_half(ccmd1, ccmd2);
@@ -443,9 +725,10 @@ compressed_section encode_code_section_mask_duo_quad(std::vector<command> comman
 }
 
 template<size_t INDX_SIZE_O, size_t INDX_SIZE_Q>
-compressed_section encode_code_section_operands_opcode(std::vector<command> commands, encode_table<RV32I_CMDLEN_O, INDX_SIZE_O> entab_operands, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab_opcode)
+compressed_section encode_code_section_operands_opcode(std::vector<command> commands, encode_table<RV32I_CMDLEN_O, INDX_SIZE_O> entab_operands, encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> entab_opcode, const progress_callback &progress)
 {
     compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
 #ifdef BENCH_COVERAGE
     int dict1_cnt = 0, dict2_cnt = 0;
@@ -455,6 +738,7 @@ compressed_section encode_code_section_operands_opcode(std::vector<command> comm
 
     for (auto comm : commands)
     {
+        csec.mark_block();
         command cmd_operands, cmd_opcode;
         comm.devide(cmd_opcode, cmd_operands, RV32I_CMDLEN_Q << 3);
 #ifdef BENCH_COVERAGE
@@ -472,705 +756,2511 @@ compressed_section encode_code_section_operands_opcode(std::vector<command> comm
     return csec;
 }
 
-template<size_t P1SIZE, size_t P2SIZE, size_t POS1_SIZE, size_t POS2_SIZE, size_t MASK1_SIZE, size_t MASK2_SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
-compressed_section encode_code_section_mask_duo_p(std::vector<command> commands, encode_table<P1SIZE, INDX1_SIZE> entab1, encode_table<P2SIZE, INDX2_SIZE> entab2)
+template<size_t INDX_SIZE>
+compressed_section entropy_encode_code_section_dictionary(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, huffman_table &htab, const progress_callback &progress)
 {
-    compressed_section csec;
-
-#ifdef BENCH_COVERAGE
-    int dict1_cnt = 0, dict2_cnt = 0;
-    int mask1_cnt = 0, mask2_cnt = 0;
-    int notc1_cnt = 0, notc2_cnt = 0;
-#endif
+    const size_t notc_sym = entab.get_entries_cnt();
 
-    for (auto comm : commands)
+    std::vector<size_t> syms;
+    std::vector<size_t> freqs(notc_sym + 1, 0);
+    for (const auto &comm : commands)
     {
-        command ccmd1, ccmd2;
-
-        comm.devide(ccmd1, ccmd2, P1SIZE << 3);
-
-#ifdef BENCH_COVERAGE
-        comp_cmd_type tp;
+        int indx = entab.find(comm);
+        size_t sym = (indx != -1) ? indx : notc_sym;
+        syms.push_back(sym);
+        freqs[sym]++;
+    }
 
-        csec.add(compress_command_with_mask<P1SIZE, POS1_SIZE, MASK1_SIZE, INDX1_SIZE>(entab1, ccmd1, tp));
-        update_counters(tp, dict1_cnt, mask1_cnt, notc1_cnt);
+    htab = huffman_table(freqs);
 
-        csec.add(compress_command_with_mask<P2SIZE, POS2_SIZE, MASK2_SIZE, INDX2_SIZE>(entab2, ccmd2, tp));
-        update_counters(tp, dict2_cnt, mask2_cnt, notc2_cnt);
-#else
-        csec.add(compress_command_with_mask<P1SIZE, POS1_SIZE, MASK1_SIZE, INDX1_SIZE>(entab1, ccmd1));
-        csec.add(compress_command_with_mask<P2SIZE, POS2_SIZE, MASK2_SIZE, INDX2_SIZE>(entab2, ccmd2));
-#endif
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        csec.mark_block();
+        htab.encode(csec, syms[i]);
+        if (syms[i] == notc_sym)
+            csec.add(commands[i].data(), commands[i].get_data_sz_bits());
     }
 
     return csec;
 }
 
-
 template<size_t INDX_SIZE>
-std::vector<command> rv32i_dict_restore_section_commands(const compressed_section &csec, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab)
+compressed_section entropy_encode_code_section_mask_single(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, huffman_table &htab, huffman_table &mask_htab, const progress_callback &progress)
 {
-    std::vector<command> retval;
+    const size_t mask_sym = entab.get_entries_cnt();
+    const size_t notc_sym = mask_sym + 1;
 
-    size_t csec_end = csec.get_data_sz_bits();
-    for (size_t pos = 0; pos < csec_end;)
+    struct block
+    {
+        size_t sym;
+        size_t pos;
+        size_t mask;
+        size_t indx;
+    };
+
+    std::vector<block> blocks;
+    std::vector<size_t> freqs(notc_sym + 1, 0);
+    std::vector<size_t> mask_freqs(entab.get_entries_cnt(), 0);
+    for (const auto &comm : commands)
     {
-        command cmd = restore_block_dict<RV32I_CMDLEN, DICT_INDX_SIZE>(csec, pos, entab);
-        retval.push_back(cmd);
+        block b { notc_sym, 0, 0, 0 };
+        int indx = entab.find(comm);
+        dynbitset mask;
+        if (indx != -1)
+        {
+            b.sym = indx;
+        }
+        else if (find_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, INDX_SIZE>(mask, b.pos, b.indx, entab, comm))
+        {
+            b.sym = mask_sym;
+            b.mask = mask.to_size_t();
+            mask_freqs[b.indx]++;
+        }
+        blocks.push_back(b);
+        freqs[b.sym]++;
+    }
+
+    htab = huffman_table(freqs);
+    mask_htab = huffman_table(mask_freqs);
 
-        // Сделать проверку, если невозможно восстановить команду по оставшемуся количеству бит,
-        // то отбросить их (чтобы невелировать добавление лишних команд)
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        csec.mark_block();
+        const block &b = blocks[i];
+        htab.encode(csec, b.sym);
+        if (b.sym == mask_sym)
+        {
+            csec.add(b.pos, MASK_SINGLE_POS_SIZE);
+            csec.add(b.mask, MASK_SINGLE_MASK_SIZE);
+            mask_htab.encode(csec, b.indx);
+        }
+        else if (b.sym == notc_sym)
+        {
+            csec.add(commands[i].data(), commands[i].get_data_sz_bits());
+        }
     }
 
-    return retval;
+    return csec;
 }
 
-template<size_t INDX_SIZE>
-std::vector<command> rv32i_mask_single_restore_section_commands(const compressed_section &csec, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab)
+// Two-level dictionary: hot table holds copies of the most used entries,
+// every dictionary index is coded as 1 and position in hot table or as 0 and
+// index of the whole dictionary. uses - weight of commands coded with every
+// entry, hot_entries gets indices of hot entries, most used first. Positions
+// of entries in hot table are returned, -1 for cold ones. Hot table of less
+// than 2 entries isn't worth a prefix bit, it stays empty
+static std::vector<int> make_hot_positions(const std::vector<uint64_t> &uses, size_t hot_cnt, std::vector<size_t> &hot_entries)
 {
-    std::vector<command> retval;
-
-    size_t csec_end = csec.get_data_sz_bits();
-    for (size_t pos = 0; pos < csec_end;)
+    hot_entries.clear();
+    for (size_t i = 0; i < uses.size(); ++i)
     {
-        command cmd = restore_block_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, entab);
+        if (uses[i] != 0)
+            hot_entries.push_back(i);
+    }
+    std::stable_sort(hot_entries.begin(), hot_entries.end(), [&](size_t a, size_t b) { return uses[a] > uses[b]; });
+    hot_entries.resize(std::min(hot_cnt, hot_entries.size()));
+    if (hot_entries.size() < 2)
+        hot_entries.clear();
+
+    std::vector<int> positions(uses.size(), -1);
+    for (size_t i = 0; i < hot_entries.size(); ++i)
+        positions[hot_entries[i]] = i;
+    return positions;
+}
 
-        retval.push_back(cmd);
+template<size_t INDX_SIZE>
+void add_tiered_index(command &ccmd, size_t indx, const std::vector<int> &hot_positions, size_t hot_indx_size, size_stat &szstat)
+{
+    if (hot_indx_size == 0)
+    {
+        ccmd.add(indx, INDX_SIZE);
+        szstat.cold_dict_hits++;
+    }
+    else if (hot_positions[indx] != -1)
+    {
+        ccmd.add(true);
+        ccmd.add(hot_positions[indx], hot_indx_size);
+        szstat.hot_dict_hits++;
+    }
+    else
+    {
+        ccmd.add(false);
+        ccmd.add(indx, INDX_SIZE);
+        szstat.cold_dict_hits++;
     }
+}
 
-    return retval;
+static uint64_t command_weight(const config &cfg, size_t i)
+{
+    std::span<const uint64_t> exec_counts = cfg.get_exec_counts();
+    return i < exec_counts.size() ? 1 + exec_counts[i] : 1;
 }
 
 template<size_t INDX_SIZE>
-std::vector<command> rv32i_mask_duo_restore_section_commands(const compressed_section &csec, const encode_table<RV32I_CMDLEN_H, INDX_SIZE> &entab1, const encode_table<RV32I_CMDLEN_H, INDX_SIZE> &entab2)
+compressed_section hot_encode_code_section_dictionary(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, const config &cfg, std::vector<size_t> &hot_entries, size_stat &szstat)
 {
-    std::vector<command> retval;
+    std::vector<int> indices;
+    std::vector<uint64_t> uses(entab.get_entries_cnt(), 0);
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        int indx = entab.find(commands[i]);
+        indices.push_back(indx);
+        if (indx != -1)
+            uses[indx] += command_weight(cfg, i);
+    }
 
-    size_t csec_end = csec.get_data_sz_bits();
+    std::vector<int> hot_positions = make_hot_positions(uses, cfg.get_hot_dict(), hot_entries);
+    size_t hot_indx_size = hot_entries.empty() ? 0 : std::bit_width(hot_entries.size() - 1);
 
-    for (size_t pos = 0; pos < csec_end;)
+    compressed_section csec;
+    csec.set_progress(cfg.get_progress(), commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
     {
-        command cmd1 = restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, entab1);
-        command cmd2 = restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, entab2);
-
-        cmd1.add(cmd2);
-        
-        retval.push_back(cmd1);
+        csec.mark_block();
+        command ccmd;
+        if (indices[i] != -1)
+        {
+            ccmd.add(true);
+            add_tiered_index<INDX_SIZE>(ccmd, indices[i], hot_positions, hot_indx_size, szstat);
+        }
+        else
+        {
+            ccmd.add(false);
+            ccmd.add(commands[i].data(), commands[i].get_data_sz_bits());
+        }
+        csec.add(ccmd);
     }
 
-    return retval;
+    return csec;
 }
 
+// Dictionary is renumbered in order of cfg, order[i] - old index of entry
+// i. Codeword: 1 1 short code or 1 0 index with coding of cfg, 1 index
+// without short codes (FIXED), 0 u32 - literal
 template<size_t INDX_SIZE>
-std::vector<command> rv32i_mask_quad_restore_section_commands(const compressed_section &csec, const std::array<encode_table<RV32I_CMDLEN_Q, INDX_SIZE>, 4> &entabs)
+compressed_section ordered_encode_code_section_dictionary(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, const config &cfg,
+    std::vector<size_t> &order, size_t &short_size, size_stat &szstat)
 {
-    std::vector<command> retval;
-
-    size_t csec_end = csec.get_data_sz_bits();
-    for (size_t pos = 0; pos < csec_end;)
+    std::vector<int> indices;
+    std::vector<uint64_t> weights;
+    for (size_t i = 0; i < commands.size(); ++i)
     {
-        command cmd11 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entabs[0]);
-        command cmd12 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entabs[1]);
-        command cmd21 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entabs[2]);
-        command cmd22 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entabs[3]);
-        cmd11.add(cmd12);
-        cmd11.add(cmd21);
-        cmd11.add(cmd22);
-        retval.push_back(cmd11);
+        indices.push_back(entab.find(commands[i]));
+        weights.push_back(command_weight(cfg, i));
     }
 
-    return retval;
-}
+    order = order_dict_entries(indices, weights, entab.get_entries_cnt(), cfg.get_dict_order());
+    std::vector<int> new_indices(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        new_indices[order[i]] = i;
+    for (auto &indx : indices)
+    {
+        if (indx != -1)
+            indx = new_indices[indx];
+    }
 
-template<size_t INDX_SIZE_H, size_t INDX_SIZE_Q>
-std::vector<command> rv32i_mask_duo_quad_restore_section_commands(const compressed_section &csec, const encode_table<RV32I_CMDLEN_H, INDX_SIZE_H> &entab1, const encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab21, const encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab22)
-{
-    std::vector<command> retval;
+    short_size = choose_short_size(indices, cfg.get_index_coding(), INDX_SIZE, INDEX_LINE_CMDS);
+    index_predictor predictor(cfg.get_index_coding(), short_size);
 
-    size_t csec_end = csec.get_data_sz_bits();
-    for (size_t pos = 0; pos < csec_end;)
+    compressed_section csec;
+    csec.set_progress(cfg.get_progress(), commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
     {
-        command cmd1 = restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, entab1);
-        command cmd21 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entab21);
-        command cmd22 = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entab22);
-        cmd1.add(cmd21);
-        cmd1.add(cmd22);
-        retval.push_back(cmd1);
+        if (i % INDEX_LINE_CMDS == 0)
+            predictor.reset();
+        csec.mark_block();
+        command ccmd;
+        if (indices[i] != -1)
+        {
+            ccmd.add(true);
+            int code = predictor.find_short(indices[i]);
+            if (predictor.get_coding() != index_coding::FIXED)
+                ccmd.add(code != -1);
+            if (code != -1)
+            {
+                ccmd.add((size_t)code, short_size);
+                szstat.short_index_hits++;
+            }
+            else
+            {
+                ccmd.add(indices[i], INDX_SIZE);
+                szstat.cold_dict_hits++;
+            }
+            predictor.update(indices[i]);
+        }
+        else
+        {
+            ccmd.add(false);
+            ccmd.add(commands[i].data(), commands[i].get_data_sz_bits());
+        }
+        csec.add(ccmd);
     }
 
-    return retval;
+    return csec;
 }
 
-template<size_t INDX_SIZE_O, size_t INDX_SIZE_Q>
-std::vector<command> rv32i_operands_opcode_restore_section_commands(const compressed_section &csec, const encode_table<RV32I_CMDLEN_O, INDX_SIZE_O> &entab_operands, const encode_table<RV32I_CMDLEN_Q, INDX_SIZE_Q> &entab_opcode)
+template<size_t INDX_SIZE>
+compressed_section hot_encode_code_section_mask_single(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, const config &cfg, std::vector<size_t> &hot_entries, size_stat &szstat)
 {
-    std::vector<command> retval;
-
-    size_t csec_end = csec.get_data_sz_bits();
-    for (size_t pos = 0; pos < csec_end;)
+    struct block
     {
-        command cmd_operands = restore_block_mask<RV32I_CMDLEN_O, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE>(csec, pos, entab_operands);
-        command cmd_opcode = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, entab_opcode);
+        int indx;
+        bool masked;
+        size_t pos;
+        size_t mask;
+    };
+
+    std::vector<block> blocks;
+    std::vector<uint64_t> uses(entab.get_entries_cnt(), 0);
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        block b { entab.find(commands[i]), false, 0, 0 };
+        dynbitset mask;
+        size_t indx = 0;
+        if (b.indx == -1 && find_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, INDX_SIZE>(mask, b.pos, indx, entab, commands[i]))
+        {
+            b.indx = indx;
+            b.masked = true;
+            b.mask = mask.to_size_t();
+        }
+        if (b.indx != -1)
+            uses[b.indx] += command_weight(cfg, i);
+        blocks.push_back(b);
+    }
 
-        cmd_opcode.add(cmd_operands);
-        retval.push_back(cmd_opcode);
+    std::vector<int> hot_positions = make_hot_positions(uses, cfg.get_hot_dict(), hot_entries);
+    size_t hot_indx_size = hot_entries.empty() ? 0 : std::bit_width(hot_entries.size() - 1);
+
+    compressed_section csec;
+    csec.set_progress(cfg.get_progress(), commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        csec.mark_block();
+        const block &b = blocks[i];
+        command ccmd;
+        if (b.indx == -1)
+        {
+            ccmd.add(false);
+            ccmd.add(commands[i].data(), commands[i].get_data_sz_bits());
+        }
+        else
+        {
+            ccmd.add(true);
+            ccmd.add(!b.masked);
+            if (b.masked)
+            {
+                ccmd.add(b.pos, MASK_SINGLE_POS_SIZE);
+                ccmd.add(b.mask, MASK_SINGLE_MASK_SIZE);
+            }
+            add_tiered_index<INDX_SIZE>(ccmd, b.indx, hot_positions, hot_indx_size, szstat);
+        }
+        csec.add(ccmd);
     }
 
-    return retval;
+    return csec;
 }
 
-template<size_t P1SIZE, size_t P2SIZE, size_t POS1_SIZE, size_t POS2_SIZE, size_t MASK1_SIZE, size_t MASK2_SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
-std::vector<command> rv64i_mask_duo_restore_section_commands(const compressed_section &csec, const encode_table<P1SIZE, INDX1_SIZE> &entab1, const encode_table<P2SIZE, INDX2_SIZE> &entab2)
+// Dictionary hits of one level DICT (masks is false) and MASK_SINGLE stream
+static size_t count_dict_hits(const compressed_section &csec, bool masks, size_t indx_size)
 {
-    std::vector<command> retval;
-
+    size_t hits = 0;
     size_t csec_end = csec.get_data_sz_bits();
-
     for (size_t pos = 0; pos < csec_end;)
     {
-        command cmd1 = restore_block_mask<P1SIZE, POS1_SIZE, MASK1_SIZE, INDX1_SIZE>(csec, pos, entab1);
-        command cmd2 = restore_block_mask<P2SIZE, POS2_SIZE, MASK2_SIZE, INDX2_SIZE>(csec, pos, entab2);
-
-        cmd1.add(cmd2);
-        
-        retval.push_back(cmd1);
+        if (!csec.getbit(pos++))
+        {
+            pos += RV32I_CMDLEN << 3;
+            continue;
+        }
+        if (masks && !csec.getbit(pos++))
+            pos += MASK_SINGLE_POS_SIZE + MASK_SINGLE_MASK_SIZE;
+        pos += indx_size;
+        hits++;
     }
-
-    return retval;
+    return hits;
 }
 
-
-ELFIO::section* modify_code_section(ELFIO::section *sec_text, compressed_section csec, encode_type etype)
+template<size_t INDX_SIZE_F, size_t INDX_SIZE_R, size_t INDX_SIZE_I>
+command compress_command_with_fields(const encode_table<FIELDS_FUNCT_CMDLEN, INDX_SIZE_F> &entab_funct, const encode_table<FIELDS_REGS_CMDLEN, INDX_SIZE_R> &entab_regs, const encode_table<FIELDS_IMM_CMDLEN, INDX_SIZE_I> &entab_imm, const command &comm)
 {
-    size_t data_size = csec.get_data_sz();
-    char last_free_bits = (8 - (csec.get_data_sz_bits() % 8)) % 8;
+    command ccmd;
+    uint32_t value = comm.to_size_t();
+    const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(value));
 
-    size_t metadata_size = sizeof(char);
-    char etype_data = (char)etype & 0x1f;
-    char metadata = (last_free_bits << 5) | etype_data;
+    ccmd.add(compress_field_with_dictionary(entab_funct, extract_bits(value, layout.funct_mask), FIELDS_FUNCT_BITS));
+    compress_field_bits(ccmd, entab_regs, value, layout.regs_mask);
+    compress_field_bits(ccmd, entab_imm, value, layout.imm_mask);
+    if (layout.raw_mask != 0)
+        ccmd.add(extract_bits(value, layout.raw_mask), count_bits(layout.raw_mask));
 
-    char *data = new char[data_size + metadata_size];
-    memcpy(data, &metadata, sizeof(char));
-    memcpy(data + sizeof(char), csec.data(), data_size * sizeof(char));
-    sec_text->set_data(data, data_size + metadata_size);
-    sec_text->set_size(data_size + metadata_size);
-    delete[] data;
-    return sec_text;
+    return ccmd;
 }
 
-ELFIO::section* restore_code_section(ELFIO::section *sec_text, const std::vector<command> &dcmds)
+template<size_t INDX_SIZE_F, size_t INDX_SIZE_R, size_t INDX_SIZE_I>
+compressed_section encode_code_section_fields(const std::vector<command> &commands, const encode_table<FIELDS_FUNCT_CMDLEN, INDX_SIZE_F> &entab_funct, const encode_table<FIELDS_REGS_CMDLEN, INDX_SIZE_R> &entab_regs, const encode_table<FIELDS_IMM_CMDLEN, INDX_SIZE_I> &entab_imm, const progress_callback &progress)
 {
-    size_t data_size = 0;
-    for (const auto &cmd : dcmds)
-        data_size += cmd.get_data_sz();
-
-    size_t init_size = sec_text->get_size();
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
-    char *data = new char[data_size];
-    size_t pos = 0;
-    for (const auto &cmd : dcmds)
+    for (const auto &comm : commands)
     {
-        const char *cmd_data = cmd.data();
-        memcpy(data + pos, cmd_data, cmd.get_data_sz());
-        pos += cmd.get_data_sz();
+        csec.mark_block();
+        csec.add(compress_command_with_fields(entab_funct, entab_regs, entab_imm, comm));
     }
-    sec_text->set_data(data, init_size);
-    sec_text->append_data(data + init_size, data_size - init_size);
 
-    delete[] data;
-    return sec_text;
+    return csec;
 }
 
-ELFIO::elfio* build_exec_file(ELFIO::elfio *file, ELFIO::section* code_section)
+// Index width is FIXED_INDX_SIZE or the least one up to INDX_SIZE that fits
+// every unique command into dictionary and overflow table, it's returned
+template<size_t INDX_SIZE>
+size_t fixed_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, encode_table<RV32I_CMDLEN, INDX_SIZE> &overflow, memory_meter *meter)
 {
-    return file;
-}
-
+    size_t indx_size = FIXED_INDX_SIZE;
+    {
+        std::vector<command> unique(commands);
+        memory_scope unique_memory(meter, commands_memory(unique.size(), RV32I_CMDLEN));
+        std::sort(unique.begin(), unique.end());
+        size_t unique_cnt = std::unique(unique.begin(), unique.end()) - unique.begin();
+        while (indx_size < INDX_SIZE && unique_cnt > ((size_t)2 << indx_size))
+            indx_size++;
+    }
 
-template<size_t CMDLEN, size_t INDX_SIZE>
-std::vector<char> form_inst_dict_data(const encode_table<CMDLEN, INDX_SIZE> &entab)
-{
-    std::vector<char> data;
-    std::vector<command> entries = entab.get_entries();
-    for (const auto & cmd : entries)
+    dict_make_encode_table(commands, cfg, entab, meter, (size_t)1 << indx_size);
+
+    std::vector<command> rest;
+    for (const auto &comm : commands)
     {
-        const char *cmd_data = cmd.data();
-        for (size_t i = 0; i < CMDLEN; ++i)
-            data.push_back(cmd_data[i]);
+        if (entab.find(comm) == -1)
+            rest.push_back(comm);
     }
-    return data;
+    memory_scope rest_memory(meter, commands_memory(rest.size(), RV32I_CMDLEN));
+    std::sort(rest.begin(), rest.end());
+    rest.erase(std::unique(rest.begin(), rest.end()), rest.end());
+
+    if (rest.size() > ((size_t)1 << indx_size))
+        throw std::runtime_error("Too many unique commands for fixed length codewords");
+    overflow = encode_table<RV32I_CMDLEN, INDX_SIZE>(rest);
+    return indx_size;
 }
 
-template<size_t CMDLEN, size_t INDX_SIZE>
-ELFIO::elfio* write_instr_dictionary(ELFIO::elfio *file, const encode_table<CMDLEN, INDX_SIZE> &entab, const std::string &section_name)
+template<size_t INDX_SIZE>
+compressed_section encode_code_section_fixed(const std::vector<command> &commands, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab, const encode_table<RV32I_CMDLEN, INDX_SIZE> &overflow, size_t indx_size, const progress_callback &progress)
 {
-    ELFIO::section *dict_sec = file->sections.add(section_name);
-    dict_sec->set_type( ELFIO::SHT_PROGBITS );
-    dict_sec->set_addr_align( 0x1 );
-    auto text_32 = form_inst_dict_data(entab);
-    dict_sec->append_data(text_32.data(), text_32.size());
-    return file;
-}
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
-template<size_t CMDLEN, size_t INDX_SIZE>
-void read_instr_dictionary(const ELFIO::elfio *file, encode_table<CMDLEN, INDX_SIZE> &entab, const std::string &section_name)
-{
-    ELFIO::section *dict_section = get_section_with_name(file, section_name);
-    if (dict_section == nullptr)
+    for (const auto &comm : commands)
     {
-        throw std::runtime_error("No section with name: " + section_name);
+        csec.mark_block();
+        int indx = 0;
+        if ((indx = entab.find(comm)) != -1)
+            csec.add(indx, indx_size + 1);
+        else
+            csec.add(((size_t)1 << indx_size) | overflow.find(comm), indx_size + 1);
     }
 
-    std::vector<command> entries;
-    const size_t cmdlen_bits = CMDLEN << 3;
-    const char *section_data = dict_section->get_data();
-    size_t dict_section_sz = dict_section->get_size();
-    for (size_t i = 0; i < dict_section_sz; i += CMDLEN)
-    {
-        command cmd;
-        cmd.add(section_data + i, cmdlen_bits);
-        entries.push_back(cmd);
-    }
+    return csec;
+}
 
-    entab = encode_table<CMDLEN, INDX_SIZE>(entries);
+// Codeword bits of commands [first, last) encoded with entab
+template<size_t INDX_SIZE>
+size_t dict_block_bits(const std::vector<command> &commands, size_t first, size_t last, const encode_table<RV32I_CMDLEN, INDX_SIZE> &entab)
+{
+    size_t bits = 0;
+    for (size_t i = first; i < last; ++i)
+        bits += 1 + (entab.find(commands[i]) != -1 ? INDX_SIZE : RV32I_CMDLEN << 3);
+    return bits;
 }
 
-ELFIO::elfio* write_addr_dictionary(ELFIO::elfio *file, std::vector<command> commands)
+// Blocks start in clusters of similar instruction statistics, then every
+// block moves to the dictionary encoding it in fewest bits and dictionaries
+// are trained again. Unused dictionaries are dropped
+template<size_t INDX_SIZE>
+void dict_blocks_make_encode_tables(const std::vector<command> &commands, const config &cfg, std::vector<encode_table<RV32I_CMDLEN, INDX_SIZE>> &entabs, std::vector<uint8_t> &block_dicts, memory_meter *meter)
 {
-    ELFIO::section* text_sec = file->sections.add( ".dict.addr" );
-    text_sec->set_type( ELFIO::SHT_PROGBITS );
+    block_dicts = cluster_blocks(commands, DICT_BLOCKS_SHIFT, cfg.get_block_dicts());
+    size_t dicts_cnt = block_dicts.empty() ? 0 : *std::max_element(block_dicts.begin(), block_dicts.end()) + 1;
+    memory_scope map_memory(meter, block_dicts.size());
 
-    return file;
-}
+    for (size_t round = 0; ; ++round)
+    {
+        entabs.assign(dicts_cnt, encode_table<RV32I_CMDLEN, INDX_SIZE>());
+        for (size_t d = 0; d < dicts_cnt; ++d)
+        {
+            // Parts are taken from elements of commands, so index is known from address
+            dict_make_encode_table(commands, cfg, entabs[d], meter, [&](const command &cmd, command &part) {
+                part = cmd;
+                return block_dicts[(&cmd - commands.data()) >> DICT_BLOCKS_SHIFT] == d;
+            });
+        }
+        if (round == DICT_BLOCKS_ROUNDS)
+            break;
 
+        bool changed = false;
+        for (size_t b = 0; b < block_dicts.size(); ++b)
+        {
+            size_t first = b << DICT_BLOCKS_SHIFT;
+            size_t last = std::min(commands.size(), first + ((size_t)1 << DICT_BLOCKS_SHIFT));
+            size_t best = block_dicts[b];
+            size_t best_bits = dict_block_bits(commands, first, last, entabs[best]);
+            for (size_t d = 0; d < dicts_cnt; ++d)
+            {
+                size_t bits = dict_block_bits(commands, first, last, entabs[d]);
+                if (bits < best_bits)
+                {
+                    best = d;
+                    best_bits = bits;
+                }
+            }
+            changed |= best != block_dicts[b];
+            block_dicts[b] = best;
+        }
+        if (!changed)
+            break;
+    }
 
-template<size_t CMDLEN, size_t INDX_SIZE>
-std::string entab_to_string(const encode_table<CMDLEN, INDX_SIZE> &entab)
-{
-    auto entries = entab.get_entries();
-    std::stringstream dict_stream;
-    int indx = 1;
-    for (const auto &e : entries)
+    std::vector<size_t> renumber(dicts_cnt, SIZE_MAX);
+    std::vector<encode_table<RV32I_CMDLEN, INDX_SIZE>> used;
+    for (auto &dict : block_dicts)
     {
-        std::string tmp = std::to_string(indx);
-        tmp += ") ";
-        dict_stream << tmp;
-        dict_stream << e;
-        dict_stream << "\n";
-        indx++;
+        if (renumber[dict] == SIZE_MAX)
+        {
+            renumber[dict] = used.size();
+            used.push_back(std::move(entabs[dict]));
+        }
+        dict = renumber[dict];
     }
-    return dict_stream.str();
+    entabs = std::move(used);
 }
 
-void rv32i_dict_compress_section(ELFIO::elfio *&file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const config &cfg)
+template<size_t INDX_SIZE>
+compressed_section encode_code_section_dict_blocks(const std::vector<command> &commands, const std::vector<encode_table<RV32I_CMDLEN, INDX_SIZE>> &entabs, const std::vector<uint8_t> &block_dicts, const progress_callback &progress)
 {
-    encode_table<RV32I_CMDLEN, DICT_INDX_SIZE> entab;
-    dict_make_encode_table(section_commands, cfg, entab);
-
-    compressed_section encoded_data = encode_code_section_dictionary(section_commands, entab);
-    
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab));
-    dict_infos = dicts;
+    compressed_section csec;
+    csec.set_progress(progress, commands.size());
 
-    szstat.dict_32_bit_size = entab.get_entries_cnt() * RV32I_CMDLEN;
-    szstat.final_code_size = encoded_data.get_data_sz() + 1;
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        csec.mark_block();
+        int indx = entabs[block_dicts[i >> DICT_BLOCKS_SHIFT]].find(commands[i]);
+        if (indx != -1)
+        {
+            csec.add(true);
+            csec.add(indx, INDX_SIZE);
+        }
+        else
+        {
+            csec.add(false);
+            csec.add(commands[i].data(), commands[i].get_data_sz_bits());
+        }
+    }
 
-    section = modify_code_section(section, encoded_data, encode_type::DICT);
-    file = write_instr_dictionary(file, entab, ".dict");
+    return csec;
 }
 
-void rv32i_mask_single_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const config &cfg)
+template<size_t INDX_SIZE_F, size_t INDX_SIZE_R, size_t INDX_SIZE_I>
+command restore_block_fields(const compressed_section &csec, size_t &pos, const encode_table<FIELDS_FUNCT_CMDLEN, INDX_SIZE_F> &entab_funct, const encode_table<FIELDS_REGS_CMDLEN, INDX_SIZE_R> &entab_regs, const encode_table<FIELDS_IMM_CMDLEN, INDX_SIZE_I> &entab_imm)
 {
-    encode_table<RV32I_CMDLEN, MASK_SINGLE_INDX_SIZE> entab;
-    mask_single_make_encode_table(section_commands, cfg, entab);
-
-    compressed_section encoded_data = encode_code_section_mask_single(section_commands, entab);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab));
-    dict_infos = dicts;
+    uint32_t funct = restore_field(csec, pos, entab_funct, FIELDS_FUNCT_BITS);
+    const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(funct));
 
-    szstat.dict_32_bit_size = entab.get_entries_cnt() * RV32I_CMDLEN;
-    szstat.final_code_size = encoded_data.get_data_sz();
+    uint32_t value = deposit_bits(funct, layout.funct_mask);
+    value |= restore_field_bits(csec, pos, entab_regs, layout.regs_mask);
+    value |= restore_field_bits(csec, pos, entab_imm, layout.imm_mask);
+    if (layout.raw_mask != 0)
+    {
+        size_t raw_bits = count_bits(layout.raw_mask);
+        value |= deposit_bits(csec.getseq(pos, pos + raw_bits).to_size_t(), layout.raw_mask);
+        pos += raw_bits;
+    }
 
-    section = modify_code_section(section, encoded_data, encode_type::MASK_SINGLE);
-    file = write_instr_dictionary(file, entab, ".dict");
+    command cmd;
+    cmd.add(value, RV32I_CMDLEN << 3);
+    return cmd;
 }
 
-void rv32i_mask_duo_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, std::vector<command> section_commands, config cfg)
+static uint32_t restore_value_field_bits(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, size_t indx_size, uint32_t mask)
 {
-    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1, entab2;
-    mask_duo_make_encode_table(section_commands, cfg, entab1, entab2);
-
-    compressed_section encoded_data = encode_code_section_mask_duo(section_commands, entab1, entab2);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab1));
-    dicts.push_back(entab_to_string(entab2));
-    dict_infos = dicts;
+    if (mask == 0)
+        return 0;
 
-    szstat.dict_32_bit_size = (entab1.get_entries_cnt() + entab2.get_entries_cnt()) * RV32I_CMDLEN_H;
-    szstat.final_code_size = encoded_data.get_data_sz();
+    size_t field_bits = count_bits(mask);
+    uint32_t field = 0;
+    if (field_uses_dictionary(mask, indx_size))
+    {
+        if (csec.getbit(pos++))
+        {
+            field = values.at(csec.getbits(pos, indx_size));
+            pos += indx_size;
+        }
+        else
+        {
+            field = csec.getbits(pos, field_bits);
+            pos += field_bits;
+        }
+    }
+    else
+    {
+        field = csec.getbits(pos, field_bits);
+        pos += field_bits;
+    }
 
-    section = modify_code_section(section, encoded_data, encode_type::MASK_DUO);
-    file = write_instr_dictionary(file, entab1, ".dict.1");
-    file = write_instr_dictionary(file, entab2, ".dict.2");
+    return deposit_bits(field, mask);
 }
 
-void rv32i_mask_quad_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, std::vector<command> section_commands, config cfg)
+static uint32_t restore_value_fixed(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const std::vector<uint32_t> &overflow, size_t indx_size)
 {
-    std::array<encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>, 4> entabs;
-    mask_quad_make_encode_table(section_commands, cfg, entabs);
-
-    compressed_section encoded_data = encode_code_section_mask_quad(section_commands, entabs);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entabs[0]));
-    dicts.push_back(entab_to_string(entabs[1]));
-    dicts.push_back(entab_to_string(entabs[2]));
-    dicts.push_back(entab_to_string(entabs[3]));
-    dict_infos = dicts;
-
-    szstat.dict_32_bit_size = (entabs[0].get_entries_cnt() + entabs[1].get_entries_cnt() 
-        + entabs[2].get_entries_cnt() + entabs[3].get_entries_cnt()) * RV32I_CMDLEN_Q;
-    szstat.final_code_size = encoded_data.get_data_sz();
-
-    section = modify_code_section(section, encoded_data, encode_type::MASK_QUAD);
-    file = write_instr_dictionary(file, entabs[0], ".dict.11");
-    file = write_instr_dictionary(file, entabs[1], ".dict.12");
-    file = write_instr_dictionary(file, entabs[2], ".dict.21");
-    file = write_instr_dictionary(file, entabs[3], ".dict.22");
+    size_t codeword = csec.getbits(pos, indx_size + 1);
+    pos += indx_size + 1;
+
+    size_t indx = codeword & (((size_t)1 << indx_size) - 1);
+    const std::vector<uint32_t> &table = (codeword >> indx_size) != 0 ? overflow : values;
+    if (indx >= table.size())
+        throw std::runtime_error("Bad fixed codeword in compressed section");
+    return table[indx];
 }
 
-void rv32i_mask_duo_quad_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const config &cfg)
+uint32_t restore_value_fields(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &funct_values, const std::vector<uint32_t> &regs_values, const std::vector<uint32_t> &imm_values)
 {
-    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1;
-    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab21, entab22;
-    mask_duo_quad_make_encode_table(section_commands, cfg, entab1, entab21, entab22);
-
-    compressed_section encoded_data = encode_code_section_mask_duo_quad(section_commands, entab1, entab21, entab22);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab1));
-    dicts.push_back(entab_to_string(entab21));
-    dicts.push_back(entab_to_string(entab22));
-    dict_infos = dicts;
+    uint32_t funct = restore_field_value<FIELDS_FUNCT_INDX_SIZE>(csec, pos, funct_values, FIELDS_FUNCT_BITS);
+    const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(funct));
 
-    szstat.dict_32_bit_size = entab1.get_entries_cnt() * RV32I_CMDLEN_H + (entab21.get_entries_cnt() + entab22.get_entries_cnt()) * RV32I_CMDLEN_Q;
-    szstat.final_code_size = encoded_data.get_data_sz();
+    uint32_t value = deposit_bits(funct, layout.funct_mask);
+    value |= restore_value_field_bits(csec, pos, regs_values, FIELDS_REGS_INDX_SIZE, layout.regs_mask);
+    value |= restore_value_field_bits(csec, pos, imm_values, FIELDS_IMM_INDX_SIZE, layout.imm_mask);
+    if (layout.raw_mask != 0)
+    {
+        size_t raw_bits = count_bits(layout.raw_mask);
+        value |= deposit_bits(csec.getbits(pos, raw_bits), layout.raw_mask);
+        pos += raw_bits;
+    }
 
-    section = modify_code_section(section, encoded_data, encode_type::MASK_DUO_QUAD);
-    file = write_instr_dictionary(file, entab1, ".dict.1");
-    file = write_instr_dictionary(file, entab21, ".dict.21");
-    file = write_instr_dictionary(file, entab22, ".dict.22");
+    return value;
 }
 
-void rv32i_mask_operands_opcode_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const config &cfg)
+// Header describes stream and dictionaries, so it's formed after all of them
+std::vector<uint8_t> form_code_data(const compressed_section &csec, encode_type etype, size_t cmdlen, const dict_views &dicts, size_t fixed_indx_size = FIXED_INDX_SIZE)
 {
-    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab_opcode;
-    encode_table<RV32I_CMDLEN_O, MASK_OPERS_INDX_SIZE> entab_operands;
-    mask_operands_opcode_make_encode_table(section_commands, cfg, entab_operands, entab_opcode);
-
-    compressed_section encoded_data = encode_code_section_operands_opcode(section_commands, entab_operands, entab_opcode);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab_operands));
-    dicts.push_back(entab_to_string(entab_opcode));
-    dict_infos = dicts;
-
-    szstat.dict_32_bit_size = (entab_opcode.get_entries_cnt() * RV32I_CMDLEN_Q + entab_operands.get_entries_cnt() * RV32I_CMDLEN_O);
-    szstat.final_code_size = encoded_data.get_data_sz();
-
-    section = modify_code_section(section, encoded_data, encode_type::MASK_OPERANDS_OPCODE);
-    file = write_instr_dictionary(file, entab_operands, ".dict.operands");
-    file = write_instr_dictionary(file, entab_opcode, ".dict.opcode");
+    std::span<const uint8_t> stream((const uint8_t *)csec.data(), csec.get_data_sz());
+
+    code_header header;
+    header.etype = etype;
+    header.cmdlen = cmdlen;
+    header.cmds_cnt = csec.get_block_offsets().size();
+    header.stream_bits = csec.get_data_sz_bits();
+    header.stream_checksum = adler32(stream);
+    header.parts = get_codeword_parts(etype, cmdlen, fixed_indx_size);
+    header.add_dicts(dicts);
+
+    std::vector<uint8_t> data = header.serialize();
+    data.insert(data.end(), stream.begin(), stream.end());
+    return data;
 }
 
-template<size_t P1SIZE, size_t P2SIZE, size_t POS1_SIZE, size_t POS2_SIZE, size_t MASK1_SIZE, size_t MASK2_SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
-void rv64i_mask_duo_compress_section(ELFIO::elfio *file, ELFIO::section *&section, size_stat &szstat, std::vector<std::string> &dict_infos, std::vector<command> section_commands, config cfg)
+// rv32i instructions are little endian whatever the host is
+static void put_word_le(uint8_t *data, uint32_t value)
 {
-    encode_table<P1SIZE, INDX1_SIZE> entab1;
-    encode_table<P2SIZE, INDX2_SIZE> entab2;
-    mask_duo_make_encode_table(section_commands, cfg, entab1, entab2);
-
-    compressed_section encoded_data = encode_code_section_mask_duo_p<P1SIZE, P2SIZE, POS1_SIZE, POS2_SIZE, MASK1_SIZE, MASK2_SIZE, INDX1_SIZE, INDX2_SIZE>(section_commands, entab1, entab2);
-
-    std::vector<std::string> dicts;
-    dicts.push_back(entab_to_string(entab1));
-    dicts.push_back(entab_to_string(entab2));
-    dict_infos = dicts;
-
-    szstat.dict_32_bit_size = (entab1.get_entries_cnt() * P1SIZE + entab2.get_entries_cnt() * P2SIZE);
-    szstat.final_code_size = encoded_data.get_data_sz();
-
-    section = modify_code_section(section, encoded_data, encode_type::MASK_DUO);
-    file = write_instr_dictionary(file, entab1, ".dict.1");
-    file = write_instr_dictionary(file, entab2, ".dict.2");
+    for (size_t j = 0; j < RV32I_CMDLEN; ++j)
+        data[j] = (uint8_t)(value >> (j * 8));
 }
 
-
-void rv32i_dict_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+// Decoded instructions are written to one buffer of known size,
+// restore(pos) returns the next instruction
+template<typename RESTORE>
+std::vector<uint8_t> restore_code_values(const compressed_section &csec, size_t cmds_cnt, const config &cfg, RESTORE restore)
 {
-    encode_table<RV32I_CMDLEN, DICT_INDX_SIZE> entab;
-    read_instr_dictionary<RV32I_CMDLEN>(file, entab, ".dict");
-
-    std::vector<command> section_commands = rv32i_dict_restore_section_commands(csec, entab);
+    std::vector<uint8_t> text(cmds_cnt * RV32I_CMDLEN);
+    size_t pos = 0;
+    for (size_t i = 0; i < cmds_cnt; ++i)
+    {
+        if (i % PROGRESS_STEP == 0)
+            cfg.report_progress(progress_phase::DECODE, i, cmds_cnt);
+        put_word_le(text.data() + i * RV32I_CMDLEN, restore(pos));
+    }
 
-    section = restore_code_section(section, section_commands);
+    if (pos > csec.get_data_sz_bits())
+        throw std::runtime_error("Compressed section is truncated");
+    return text;
 }
 
-void rv32i_mask_single_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+ELFIO::elfio* build_exec_file(ELFIO::elfio *file, ELFIO::section* code_section)
 {
-    encode_table<RV32I_CMDLEN, MASK_SINGLE_INDX_SIZE> entab;
-    read_instr_dictionary<RV32I_CMDLEN>(file, entab, ".dict");
+    return file;
+}
 
-    std::vector<command> section_commands = rv32i_mask_single_restore_section_commands(csec, entab);
 
-    section = restore_code_section(section, section_commands);
+template<size_t CMDLEN>
+std::vector<uint8_t> form_entries_data(const std::vector<command> &entries)
+{
+    std::vector<uint8_t> data;
+    for (const auto & cmd : entries)
+    {
+        const char *cmd_data = cmd.data();
+        for (size_t i = 0; i < CMDLEN; ++i)
+            data.push_back(cmd_data[i]);
+    }
+    return data;
 }
 
-void rv32i_mask_duo_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+template<size_t CMDLEN, size_t INDX_SIZE>
+std::vector<uint8_t> form_inst_dict_data(const encode_table<CMDLEN, INDX_SIZE> &entab)
 {
-    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1, entab2;
-    read_instr_dictionary<RV32I_CMDLEN_H>(file, entab1, ".dict.1");
-    read_instr_dictionary<RV32I_CMDLEN_H>(file, entab2, ".dict.2");
-
-    std::vector<command> section_commands = rv32i_mask_duo_restore_section_commands(csec, entab1, entab2);
-
-    section = restore_code_section(section, section_commands);
+    return form_entries_data<CMDLEN>(entab.get_entries());
 }
 
-void rv32i_mask_quad_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+template<size_t CMDLEN, size_t INDX_SIZE>
+void write_instr_dictionary(code_image &image, const encode_table<CMDLEN, INDX_SIZE> &entab, const std::string &dict_name)
 {
-    std::array<encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>, 4> entabs;
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entabs[0], ".dict.11");
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entabs[1], ".dict.12");
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entabs[2], ".dict.21");
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entabs[3], ".dict.22");
-
-    std::vector<command> section_commands = rv32i_mask_quad_restore_section_commands(csec, entabs);
-
-    section = restore_code_section(section, section_commands);
+    image.add_dict(dict_name, form_inst_dict_data(entab));
 }
 
-void rv32i_mask_duo_quad_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+static std::span<const uint8_t> find_dict_view(const dict_views &dicts, const std::string &dict_name)
 {
-    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1;
-    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab21, entab22;
-    read_instr_dictionary<RV32I_CMDLEN_H>(file, entab1, ".dict.1");
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entab21, ".dict.21");
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entab22, ".dict.22");
-
-    std::vector<command> section_commands = rv32i_mask_duo_quad_restore_section_commands(csec, entab1, entab21, entab22);
-
-    section = restore_code_section(section, section_commands);
+    auto it = dicts.find(dict_name);
+    if (it == dicts.end())
+        throw std::runtime_error("No section with name: " + dict_name);
+    return it->second;
 }
 
-void rv32i_mask_operands_opcode_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, const compressed_section &csec)
+template<size_t CMDLEN, size_t INDX_SIZE>
+void read_instr_dictionary(const ELFIO::elfio *file, encode_table<CMDLEN, INDX_SIZE> &entab, const std::string &section_name)
 {
-    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab_opcode;
-    encode_table<RV32I_CMDLEN_O, MASK_OPERS_INDX_SIZE> entab_operands;
-    read_instr_dictionary<RV32I_CMDLEN_Q>(file, entab_opcode, ".dict.opcode");
-    read_instr_dictionary<RV32I_CMDLEN_O>(file, entab_operands, ".dict.operands");
+    ELFIO::section *dict_section = get_section_with_name(file, section_name);
+    if (dict_section == nullptr)
+    {
+        throw std::runtime_error("No section with name: " + section_name);
+    }
 
-    std::vector<command> section_commands = rv32i_operands_opcode_restore_section_commands(csec, entab_operands, entab_opcode);
+    std::vector<command> entries;
+    const size_t cmdlen_bits = CMDLEN << 3;
+    const char *section_data = dict_section->get_data();
+    size_t dict_section_sz = dict_section->get_size();
+    for (size_t i = 0; i < dict_section_sz; i += CMDLEN)
+    {
+        command cmd;
+        cmd.add(section_data + i, cmdlen_bits);
+        entries.push_back(cmd);
+    }
 
-    section = restore_code_section(section, section_commands);
+    entab = encode_table<CMDLEN, INDX_SIZE>(entries);
 }
 
-template<size_t P1SIZE, size_t P2SIZE, size_t INDX1_SIZE, size_t INDX2_SIZE>
-void rv64i_mask_duo_decompress_section(const ELFIO::elfio *file, ELFIO::section *&section, compressed_section csec)
+// Dictionary entries as integers for allocation free decoders, file order
+// is index order
+template<size_t CMDLEN, size_t INDX_SIZE>
+std::vector<uint32_t> read_dict_values(const dict_views &dicts, const std::string &dict_name)
 {
-    encode_table<P1SIZE, INDX1_SIZE> entab1;
-    encode_table<P2SIZE, INDX2_SIZE> entab2;
-    read_instr_dictionary<P1SIZE>(file, entab1, ".dict.1");
-    read_instr_dictionary<P2SIZE>(file, entab2, ".dict.2");
+    std::span<const uint8_t> dict_data = find_dict_view(dicts, dict_name);
+    size_t entries_cnt = dict_data.size() / CMDLEN;
+    if (entries_cnt > ((size_t)1 << INDX_SIZE))
+        throw std::runtime_error("Entries cnt must be less than INDX_SIZE");
 
-    constexpr size_t p1_size = 1, p2_size = 7;
-    constexpr size_t pos1_size = 2, pos2_size = 8;
-    constexpr size_t mask1_size = 2, mask2_size = 8;
-    constexpr size_t indx1_size = 2, indx2_size = 8;
+    std::vector<uint32_t> values(entries_cnt);
+    for (size_t i = 0; i < entries_cnt; ++i)
+    {
+        for (size_t j = 0; j < CMDLEN; ++j)
+            values[i] |= (uint32_t)dict_data[i * CMDLEN + j] << (j * 8);
+    }
+    return values;
+}
 
-    std::vector<command> section_commands = rv64i_mask_duo_restore_section_commands<p1_size, p2_size, pos1_size, pos2_size, mask1_size, mask2_size, indx1_size, indx2_size>(csec, entab1, entab2);
+// .dict.hot holds copies of hot entries in hot table order, it's written only
+// if the table isn't empty
+template<size_t CMDLEN, size_t INDX_SIZE>
+void write_hot_dictionary(code_image &image, const encode_table<CMDLEN, INDX_SIZE> &entab, const std::vector<size_t> &hot_entries, size_stat &szstat)
+{
+    if (hot_entries.empty())
+        return;
 
-    section = restore_code_section(section, section_commands);
+    std::vector<uint8_t> data;
+    for (size_t indx : hot_entries)
+    {
+        const char *entry = entab[indx].data();
+        data.insert(data.end(), entry, entry + CMDLEN);
+    }
+    szstat.hot_table_size = data.size();
+    image.add_dict(".dict.hot", std::move(data));
 }
 
-
-ELFIO::elfio* rv64i_compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg)
+// Empty if dictionary has one level
+static std::vector<uint32_t> read_hot_values(const dict_views &dicts)
 {
-    szstat = size_stat { };
-    ELFIO::section * code_section = get_section_with_name(file, ".text");
-    if (code_section == nullptr)
-        throw std::runtime_error("No code section in file");
+    if (dicts.find(".dict.hot") == dicts.end())
+        return {};
 
-    szstat.initial_code_size += code_section->get_size();
-    std::vector<command> section_commands = get_commands<RV64I_CMDLEN>(code_section);
+    std::vector<uint32_t> hot_values = read_dict_values<RV32I_CMDLEN, 8>(dicts, ".dict.hot");
+    if (hot_values.size() < 2)
+        throw std::runtime_error("Bad .dict.hot section");
+    return hot_values;
+}
 
-    encode_type etype = cfg.get_etype();
+// .dict.idx is written with dictionary post-pass of DICT: u8 dict_order,
+// u8 index_coding, u8 bits of short code. .dict has entries in new order
+template<size_t CMDLEN>
+void write_ordered_dictionary(code_image &image, const std::vector<command> &entries, const config &cfg, size_t short_size)
+{
+    image.add_dict(".dict", form_entries_data<CMDLEN>(entries));
+    image.add_dict(".dict.idx", { (uint8_t)cfg.get_dict_order(), (uint8_t)cfg.get_index_coding(), (uint8_t)short_size });
+}
 
-    /* 8/56 -> 129476
-    constexpr size_t p1_size = 1, p2_size = 7;
-    constexpr size_t pos1_size = 2, pos2_size = 3;
-    constexpr size_t mask1_size = 2, mask2_size = 7;
-    constexpr size_t indx1_size = 2, indx2_size = 11;
-    */
-
-    /* 16/48 -> 117633
-    constexpr size_t p1_size = 2, p2_size = 6;
-    constexpr size_t pos1_size = 2, pos2_size = 3;
-    constexpr size_t mask1_size = 4, mask2_size = 6;
-    constexpr size_t indx1_size = 6, indx2_size = 11;
-    */
-
-    // 32/32 -> 99094
-    constexpr size_t p1_size = 4, p2_size = 4;
-    constexpr size_t pos1_size = 3, pos2_size = 3;
-    constexpr size_t mask1_size = 4, mask2_size = 4;
-    constexpr size_t indx1_size = 10, indx2_size = 10;  // 2048 * 4
-    //
-
-    /* 48/16 -> 116570
-    constexpr size_t p1_size = 6, p2_size = 2;
-    constexpr size_t pos1_size = 3, pos2_size = 2;
-    constexpr size_t mask1_size = 6, mask2_size = 4;
-    constexpr size_t indx1_size = 11, indx2_size = 6;
-    */
-
-    /* 56/8 -> 121577
-    constexpr size_t p1_size = 7, p2_size = 1;
-    constexpr size_t pos1_size = 3, pos2_size = 2;
-    constexpr size_t mask1_size = 7, mask2_size = 2;
-    constexpr size_t indx1_size = 11, indx2_size = 2;  // 4096 * 7
-    */
+// Empty if there is no .dict.idx
+static std::optional<index_predictor> read_index_predictor(const dict_views &dicts)
+{
+    auto idx_dict = dicts.find(".dict.idx");
+    if (idx_dict == dicts.end())
+        return std::nullopt;
+
+    std::span<const uint8_t> data = idx_dict->second;
+    if (data.size() != 3 || data[0] > (uint8_t)dict_order::ADJACENCY || data[1] > (uint8_t)index_coding::MTF)
+        throw std::runtime_error("Bad .dict.idx section");
+    return index_predictor((index_coding)data[1], data[2]);
+}
 
-    switch (etype)
+// Index of ordered_encode_code_section_dictionary codeword, predictor is
+// updated with it
+static size_t read_coded_index(const compressed_section &csec, size_t &pos, index_predictor &predictor)
+{
+    size_t indx = 0;
+    if (predictor.get_coding() != index_coding::FIXED && csec.getbit(pos++))
     {
-        case encode_type::MASK_DUO:
-            rv64i_mask_duo_compress_section<p1_size, p2_size, pos1_size, pos2_size, mask1_size, mask2_size, indx1_size, indx2_size>(file, code_section, szstat, dict_infos, section_commands, cfg);
-            break;
-        default:
-            throw std::runtime_error("Not yet supported encoding type");
+        indx = predictor.restore_short(csec.getbits(pos, predictor.get_short_size()));
+        pos += predictor.get_short_size();
     }
-
-    return build_exec_file(file, code_section);
+    else
+    {
+        indx = csec.getbits(pos, DICT_INDX_SIZE);
+        pos += DICT_INDX_SIZE;
+    }
+    predictor.update(indx);
+    return indx;
 }
 
-ELFIO::elfio* rv64i_decompress_executable(ELFIO::elfio *file)
+static uint32_t restore_value_dict_coded(const compressed_section &csec, size_t &pos, std::span<const uint32_t> values, index_predictor &predictor)
 {
-    ELFIO::section * code_section = get_section_with_name(file, ".text");
-    if (code_section == nullptr)
-        throw std::runtime_error("No code section in file");
-
-    encode_type etype;
-    compressed_section csec = get_compressed_section(code_section, etype);
-
-    switch (etype)
+    if (!csec.getbit(pos++))
     {
-        case encode_type::MASK_DUO:
-            rv64i_mask_duo_decompress_section<1, 7, 2, 8>(file, code_section, csec);
-            break;
-        default:
-            throw std::runtime_error("Not yet supported encoding type");
+        uint32_t value = csec.getbits(pos, RV32I_CMDLEN << 3);
+        pos += RV32I_CMDLEN << 3;
+        return value;
     }
 
-    return file;
+    size_t indx = read_coded_index(csec, pos, predictor);
+    if (indx >= values.size())
+        throw std::runtime_error("Dictionary index is out of range");
+    return values[indx];
 }
 
-ELFIO::elfio* rv32i_compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg)
+void write_huffman_tables(code_image &image, const std::vector<const huffman_table *> &htabs, size_t &tables_size)
 {
-    szstat = size_stat { };
-    ELFIO::section * code_section = get_section_with_name(file, ".text");
-    if (code_section == nullptr)
-        throw std::runtime_error("No code section in file");
+    std::vector<uint8_t> tables_data;
+    for (const auto htab : htabs)
+    {
+        auto data = htab->serialize();
+        tables_data.insert(tables_data.end(), data.begin(), data.end());
+    }
+    tables_size = tables_data.size();
+    image.add_dict(".dict.huff", std::move(tables_data));
+}
+
+std::vector<huffman_table> read_huffman_tables(std::span<const uint8_t> huff_data)
+{
+    std::vector<huffman_table> htabs;
+    const char *data = (const char *)huff_data.data();
+    size_t size = huff_data.size();
+    for (size_t pos = 0; pos < size;)
+    {
+        size_t readed = 0;
+        htabs.push_back(huffman_table::deserialize(data + pos, size - pos, readed));
+        pos += readed;
+    }
+    return htabs;
+}
+
+std::vector<huffman_table> read_huffman_tables(const ELFIO::section *huff_sec)
+{
+    return read_huffman_tables(get_section_bytes(huff_sec));
+}
+
+static int32_t sign_extend(uint32_t value, size_t bits)
+{
+    uint32_t sign = (uint32_t)1 << (bits - 1);
+    return (int32_t)((value ^ sign) - sign);
+}
+
+// Offsets in original section where control can arrive not from the previous
+// instruction: branch/jump targets, return sites and entry points (symbols)
+std::vector<size_t> find_jump_targets(const std::vector<command> &commands, const std::vector<size_t> &entry_points)
+{
+    std::vector<uint32_t> words;
+    for (const auto &cmd : commands)
+    {
+        const char *data = cmd.data();
+        for (size_t i = 0; i + RV32I_CMDLEN <= cmd.get_data_sz(); i += RV32I_CMDLEN)
+        {
+            uint32_t word = 0;
+            for (size_t j = 0; j < RV32I_CMDLEN; ++j)
+                word |= (uint32_t)(unsigned char)data[i + j] << (j * 8);
+            words.push_back(word);
+        }
+    }
+
+    std::vector<int64_t> targets = { 0 };
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        int64_t pc = i * RV32I_CMDLEN;
+        uint32_t word = words[i];
+        uint32_t opcode = word & 0x7f;
+        uint32_t rd = (word >> 7) & 0x1f;
+
+        if (opcode == 0x6f)         // JAL
+        {
+            uint32_t imm = ((word >> 31) & 0x1) << 20 | ((word >> 12) & 0xff) << 12
+                | ((word >> 20) & 0x1) << 11 | ((word >> 21) & 0x3ff) << 1;
+            targets.push_back(pc + sign_extend(imm, 21));
+            if (rd != 0)
+                targets.push_back(pc + RV32I_CMDLEN);
+        }
+        else if (opcode == 0x63)    // BRANCH
+        {
+            uint32_t imm = ((word >> 31) & 0x1) << 12 | ((word >> 7) & 0x1) << 11
+                | ((word >> 25) & 0x3f) << 5 | ((word >> 8) & 0xf) << 1;
+            targets.push_back(pc + sign_extend(imm, 13));
+        }
+        else if (opcode == 0x67)    // JALR
+        {
+            uint32_t rs1 = (word >> 15) & 0x1f;
+            uint32_t prev = i > 0 ? words[i - 1] : 0;
+            if (i > 0 && (prev & 0x7f) == 0x17 && ((prev >> 7) & 0x1f) == rs1)
+            {
+                int64_t hi = sign_extend(prev & 0xfffff000, 32);
+                targets.push_back(pc - RV32I_CMDLEN + hi + sign_extend(word >> 20, 12));
+            }
+            if (rd != 0)
+                targets.push_back(pc + RV32I_CMDLEN);
+        }
+    }
+
+    targets.insert(targets.end(), entry_points.begin(), entry_points.end());
+
+    std::vector<size_t> retval;
+    int64_t text_size = words.size() * RV32I_CMDLEN;
+    for (auto target : targets)
+    {
+        if (target >= 0 && target < text_size && target % RV32I_CMDLEN == 0)
+            retval.push_back(target);
+    }
+    std::sort(retval.begin(), retval.end());
+    retval.erase(std::unique(retval.begin(), retval.end()), retval.end());
+    return retval;
+}
+
+// Offsets of .text symbols, entry points for find_jump_targets
+std::vector<size_t> find_symbol_offsets(const ELFIO::elfio *file, const ELFIO::section *sec_text)
+{
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < file->sections.size(); ++i)
+    {
+        const ELFIO::section *sec = file->sections[i];
+        if (sec->get_type() != ELFIO::SHT_SYMTAB)
+            continue;
+
+        ELFIO::const_symbol_section_accessor symbols(*file, sec);
+        for (ELFIO::Elf_Xword j = 0; j < symbols.get_symbols_num(); ++j)
+        {
+            std::string name;
+            ELFIO::Elf64_Addr value = 0;
+            ELFIO::Elf_Xword size = 0;
+            unsigned char bind = 0, type = 0, other = 0;
+            ELFIO::Elf_Half section_index = 0;
+            symbols.get_symbol(j, name, value, size, bind, type, section_index, other);
+            if (section_index != sec_text->get_index() || type == ELFIO::STT_SECTION || type == ELFIO::STT_FILE)
+                continue;
+            if (value >= sec_text->get_address())
+                offsets.push_back(value - sec_text->get_address());
+        }
+    }
+    return offsets;
+}
+
+// Named functions of .text of text_size bytes, .text of compressed file
+// isn't of original size
+static std::vector<codeword_func> find_function_symbols(const ELFIO::elfio *file, const ELFIO::section *sec_text, size_t text_size)
+{
+    std::vector<codeword_func> functions;
+    for (size_t i = 0; i < file->sections.size(); ++i)
+    {
+        const ELFIO::section *sec = file->sections[i];
+        if (sec->get_type() != ELFIO::SHT_SYMTAB)
+            continue;
+
+        ELFIO::const_symbol_section_accessor symbols(*file, sec);
+        for (ELFIO::Elf_Xword j = 0; j < symbols.get_symbols_num(); ++j)
+        {
+            std::string name;
+            ELFIO::Elf64_Addr value = 0;
+            ELFIO::Elf_Xword size = 0;
+            unsigned char bind = 0, type = 0, other = 0;
+            ELFIO::Elf_Half section_index = 0;
+            symbols.get_symbol(j, name, value, size, bind, type, section_index, other);
+            if (section_index != sec_text->get_index() || type != ELFIO::STT_FUNC)
+                continue;
+            if (value >= sec_text->get_address() && value < sec_text->get_address() + text_size)
+                functions.push_back({ value - sec_text->get_address(), size, name });
+        }
+    }
+
+    // Assembler functions often have no size, they last up to the next one
+    std::sort(functions.begin(), functions.end(), [](const codeword_func &f1, const codeword_func &f2) {
+        return f1.offset < f2.offset;
+    });
+    for (size_t i = 0; i < functions.size(); ++i)
+    {
+        if (functions[i].size != 0)
+            continue;
+        size_t next = i + 1;
+        while (next < functions.size() && functions[next].offset == functions[i].offset)
+            next++;
+        size_t end = next < functions.size() ? functions[next].offset : text_size;
+        functions[i].size = end - functions[i].offset;
+    }
+    return functions;
+}
+
+std::vector<func_range> find_function_ranges(const ELFIO::elfio *file, const ELFIO::section *sec_text)
+{
+    std::vector<func_range> functions;
+    for (const auto &f : find_function_symbols(file, sec_text, sec_text->get_size()))
+        functions.push_back({ f.offset, f.size });
+    return functions;
+}
+
+std::vector<uint8_t> form_addr_dict_data(const std::vector<command> &commands, const std::vector<size_t> &entry_points, const compressed_section &csec)
+{
+    size_t cmdlen = commands.empty() ? RV32I_CMDLEN : commands.front().get_data_sz();
+    addr_table atab(csec.get_block_offsets(), find_jump_targets(commands, entry_points), cmdlen);
+    std::vector<char> data = atab.serialize();
+    return std::vector<uint8_t>(data.begin(), data.end());
+}
+
+void write_addr_dictionary(code_image &image, const std::vector<command> &commands, const std::vector<size_t> &entry_points, const compressed_section &csec, size_stat &szstat)
+{
+    std::vector<uint8_t> data = form_addr_dict_data(commands, entry_points, csec);
+    szstat.dict_addr_bit_size = data.size();
+    image.add_dict(".dict.addr", std::move(data));
+}
+
+// No table if there are no functions, code is one unit then
+void write_func_table(code_image &image, const std::vector<func_range> &functions, const compressed_section &csec, size_stat &szstat)
+{
+    if (functions.empty())
+        return;
+
+    func_table ftab(functions, csec.get_block_offsets(), csec.get_data_sz_bits(), RV32I_CMDLEN);
+    std::vector<char> data = ftab.serialize();
+    szstat.func_table_size = data.size();
+    image.add_dict(".dict.func", std::vector<uint8_t>(data.begin(), data.end()));
+}
+
+func_table get_func_table(const dict_views &dicts)
+{
+    auto func_dict = dicts.find(".dict.func");
+    if (func_dict == dicts.end())
+        return func_table();
+    return func_table::deserialize((const char *)func_dict->second.data(), func_dict->second.size());
+}
+
+addr_table read_addr_dictionary(const ELFIO::elfio *file)
+{
+    const ELFIO::section *addr_sec = get_section_with_name(file, ".dict.addr");
+    if (addr_sec == nullptr)
+        throw std::runtime_error("No section with name: .dict.addr");
+    return addr_table::deserialize(addr_sec->get_data(), addr_sec->get_size());
+}
+
+
+static std::string entries_to_string(const std::vector<command> &entries)
+{
+    std::stringstream dict_stream;
+    int indx = 1;
+    for (const auto &e : entries)
+    {
+        std::string tmp = std::to_string(indx);
+        tmp += ") ";
+        dict_stream << tmp;
+        dict_stream << e;
+        dict_stream << "\n";
+        indx++;
+    }
+    return dict_stream.str();
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+std::string entab_to_string(const encode_table<CMDLEN, INDX_SIZE> &entab)
+{
+    return entries_to_string(entab.get_entries());
+}
+
+void rv32i_dict_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN, DICT_INDX_SIZE> entab;
+    dict_make_encode_table(section_commands, cfg, entab, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data;
+    huffman_table htab;
+    std::vector<size_t> hot_entries;
+    std::vector<size_t> order;
+    size_t short_size = 0;
+    bool ordered = cfg.get_dict_order() != dict_order::VALUE || cfg.get_index_coding() != index_coding::FIXED;
+    if (cfg.get_entropy_coding())
+    {
+        encoded_data = entropy_encode_code_section_dictionary(section_commands, entab, htab, cfg.get_progress());
+    }
+    else if (cfg.get_hot_dict() != 0)
+    {
+        encoded_data = hot_encode_code_section_dictionary(section_commands, entab, cfg, hot_entries, szstat);
+    }
+    else if (ordered)
+    {
+        encoded_data = ordered_encode_code_section_dictionary(section_commands, entab, cfg, order, short_size, szstat);
+    }
+    else
+    {
+        encoded_data = encode_code_section_dictionary(section_commands, entab, cfg.get_progress());
+        szstat.cold_dict_hits = count_dict_hits(encoded_data, false, DICT_INDX_SIZE);
+    }
+    
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<command> ordered_entries;
+    for (size_t indx : order)
+        ordered_entries.push_back(entab[indx]);
+
+    std::vector<std::string> dicts;
+    dicts.push_back(ordered ? entries_to_string(ordered_entries) : entab_to_string(entab));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = entab.get_entries_cnt() * RV32I_CMDLEN;
+    szstat.final_code_size = encoded_data.get_data_sz() + 1;
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    if (ordered)
+        write_ordered_dictionary<RV32I_CMDLEN>(image, ordered_entries, cfg, short_size);
+    else
+        write_instr_dictionary(image, entab, ".dict");
+    write_hot_dictionary(image, entab, hot_entries, szstat);
+    if (cfg.get_entropy_coding())
+        write_huffman_tables(image, { &htab }, szstat.entropy_table_size);
+    image.code = form_code_data(encoded_data, encode_type::DICT, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_single_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN, MASK_SINGLE_INDX_SIZE> entab;
+    mask_single_make_encode_table(section_commands, cfg, entab, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data;
+    huffman_table htab, mask_htab;
+    std::vector<size_t> hot_entries;
+    if (cfg.get_entropy_coding())
+    {
+        encoded_data = entropy_encode_code_section_mask_single(section_commands, entab, htab, mask_htab, cfg.get_progress());
+    }
+    else if (cfg.get_hot_dict() != 0)
+    {
+        encoded_data = hot_encode_code_section_mask_single(section_commands, entab, cfg, hot_entries, szstat);
+    }
+    else
+    {
+        encoded_data = encode_code_section_mask_single(section_commands, entab, cfg.get_progress());
+        szstat.cold_dict_hits = count_dict_hits(encoded_data, true, MASK_SINGLE_INDX_SIZE);
+    }
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = entab.get_entries_cnt() * RV32I_CMDLEN;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab, ".dict");
+    write_hot_dictionary(image, entab, hot_entries, szstat);
+    if (cfg.get_entropy_coding())
+        write_huffman_tables(image, { &htab, &mask_htab }, szstat.entropy_table_size);
+    image.code = form_code_data(encoded_data, encode_type::MASK_SINGLE, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_multi_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN, MASK_MULTI_INDX_SIZE> entab;
+    dict_make_encode_table(section_commands, cfg, entab, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_mask_multi(section_commands, entab, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = entab.get_entries_cnt() * RV32I_CMDLEN;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab, ".dict");
+    image.code = form_code_data(encoded_data, encode_type::MASK_MULTI, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_duo_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1, entab2;
+    mask_duo_make_encode_table(section_commands, cfg, entab1, entab2, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_mask_duo(section_commands, entab1, entab2, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab1));
+    dicts.push_back(entab_to_string(entab2));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = (entab1.get_entries_cnt() + entab2.get_entries_cnt()) * RV32I_CMDLEN_H;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab1, ".dict.1");
+    write_instr_dictionary(image, entab2, ".dict.2");
+    image.code = form_code_data(encoded_data, encode_type::MASK_DUO, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_quad_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    std::array<encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>, 4> entabs;
+    mask_quad_make_encode_table(section_commands, cfg, entabs, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_mask_quad(section_commands, entabs, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entabs[0]));
+    dicts.push_back(entab_to_string(entabs[1]));
+    dicts.push_back(entab_to_string(entabs[2]));
+    dicts.push_back(entab_to_string(entabs[3]));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = (entabs[0].get_entries_cnt() + entabs[1].get_entries_cnt() 
+        + entabs[2].get_entries_cnt() + entabs[3].get_entries_cnt()) * RV32I_CMDLEN_Q;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entabs[0], ".dict.11");
+    write_instr_dictionary(image, entabs[1], ".dict.12");
+    write_instr_dictionary(image, entabs[2], ".dict.21");
+    write_instr_dictionary(image, entabs[3], ".dict.22");
+    image.code = form_code_data(encoded_data, encode_type::MASK_QUAD, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_duo_quad_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> entab1;
+    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab21, entab22;
+    mask_duo_quad_make_encode_table(section_commands, cfg, entab1, entab21, entab22, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_mask_duo_quad(section_commands, entab1, entab21, entab22, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab1));
+    dicts.push_back(entab_to_string(entab21));
+    dicts.push_back(entab_to_string(entab22));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = entab1.get_entries_cnt() * RV32I_CMDLEN_H + (entab21.get_entries_cnt() + entab22.get_entries_cnt()) * RV32I_CMDLEN_Q;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab1, ".dict.1");
+    write_instr_dictionary(image, entab21, ".dict.21");
+    write_instr_dictionary(image, entab22, ".dict.22");
+    image.code = form_code_data(encoded_data, encode_type::MASK_DUO_QUAD, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_mask_operands_opcode_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE> entab_opcode;
+    encode_table<RV32I_CMDLEN_O, MASK_OPERS_INDX_SIZE> entab_operands;
+    mask_operands_opcode_make_encode_table(section_commands, cfg, entab_operands, entab_opcode, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_operands_opcode(section_commands, entab_operands, entab_opcode, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab_operands));
+    dicts.push_back(entab_to_string(entab_opcode));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = (entab_opcode.get_entries_cnt() * RV32I_CMDLEN_Q + entab_operands.get_entries_cnt() * RV32I_CMDLEN_O);
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab_operands, ".dict.operands");
+    write_instr_dictionary(image, entab_opcode, ".dict.opcode");
+    image.code = form_code_data(encoded_data, encode_type::MASK_OPERANDS_OPCODE, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_fields_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<FIELDS_FUNCT_CMDLEN, FIELDS_FUNCT_INDX_SIZE> entab_funct;
+    encode_table<FIELDS_REGS_CMDLEN, FIELDS_REGS_INDX_SIZE> entab_regs;
+    encode_table<FIELDS_IMM_CMDLEN, FIELDS_IMM_INDX_SIZE> entab_imm;
+    fields_make_encode_table(section_commands, cfg, entab_funct, entab_regs, entab_imm, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_fields(section_commands, entab_funct, entab_regs, entab_imm, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab_funct));
+    dicts.push_back(entab_to_string(entab_regs));
+    dicts.push_back(entab_to_string(entab_imm));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = entab_funct.get_entries_cnt() * FIELDS_FUNCT_CMDLEN + entab_regs.get_entries_cnt() * FIELDS_REGS_CMDLEN
+        + entab_imm.get_entries_cnt() * FIELDS_IMM_CMDLEN;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    write_instr_dictionary(image, entab_funct, ".dict.funct");
+    write_instr_dictionary(image, entab_regs, ".dict.regs");
+    write_instr_dictionary(image, entab_imm, ".dict.imm");
+    image.code = form_code_data(encoded_data, encode_type::RV32I_FIELDS, RV32I_CMDLEN, image.get_dict_views());
+}
+
+void rv32i_fixed_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    encode_table<RV32I_CMDLEN, FIXED_MAX_INDX_SIZE> entab, overflow;
+    size_t indx_size = fixed_make_encode_table(section_commands, cfg, entab, overflow, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_fixed(section_commands, entab, overflow, indx_size, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    std::vector<std::string> dicts;
+    dicts.push_back(entab_to_string(entab));
+    dicts.push_back(entab_to_string(overflow));
+    dict_infos = dicts;
+
+    szstat.dict_32_bit_size = (entab.get_entries_cnt() + overflow.get_entries_cnt()) * RV32I_CMDLEN;
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    // Position of every instruction is known, no .dict.addr needed
+    write_instr_dictionary(image, entab, ".dict");
+    write_instr_dictionary(image, overflow, ".dict.ovf");
+    write_func_table(image, functions, encoded_data, szstat);
+    image.code = form_code_data(encoded_data, encode_type::FIXED16, RV32I_CMDLEN, image.get_dict_views(), indx_size);
+}
+
+void rv32i_dict_blocks_compress_section(code_image &image, size_stat &szstat, std::vector<std::string> &dict_infos, const std::vector<command> &section_commands, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions, const config &cfg, memory_meter &meter)
+{
+    std::vector<encode_table<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE>> entabs;
+    std::vector<uint8_t> block_dicts;
+    dict_blocks_make_encode_tables(section_commands, cfg, entabs, block_dicts, &meter);
+    cfg.report_progress(progress_phase::DICTIONARY, section_commands.size(), section_commands.size());
+    meter.set_phase(progress_phase::ENCODE);
+
+    compressed_section encoded_data = encode_code_section_dict_blocks(section_commands, entabs, block_dicts, cfg.get_progress());
+
+    memory_scope encoded_memory(&meter, encoded_section_memory(encoded_data));
+
+    // Dictionaries one after another in .dict, .dict.blocks splits them
+    std::vector<std::string> dicts;
+    std::vector<uint8_t> dict_data;
+    std::vector<size_t> dict_sizes;
+    for (const auto &entab : entabs)
+    {
+        dicts.push_back(entab_to_string(entab));
+        std::vector<uint8_t> data = form_inst_dict_data(entab);
+        dict_data.insert(dict_data.end(), data.begin(), data.end());
+        dict_sizes.push_back(entab.get_entries_cnt());
+    }
+    dict_infos = dicts;
+    std::vector<char> map_data = block_map(DICT_BLOCKS_SHIFT, dict_sizes, block_dicts).serialize();
+
+    szstat.dict_32_bit_size = dict_data.size();
+    szstat.block_map_size = map_data.size();
+    szstat.final_code_size = encoded_data.get_data_sz();
+
+    write_addr_dictionary(image, section_commands, entry_points, encoded_data, szstat);
+    write_func_table(image, functions, encoded_data, szstat);
+    image.add_dict(".dict", std::move(dict_data));
+    image.add_dict(".dict.blocks", std::vector<uint8_t>(map_data.begin(), map_data.end()));
+    image.code = form_code_data(encoded_data, encode_type::DICT_BLOCKS, RV32I_CMDLEN, image.get_dict_views());
+}
+
+std::vector<uint8_t> rv32i_dict_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict = read_dict_values<RV32I_CMDLEN, DICT_INDX_SIZE>(dicts, ".dict");
+
+    auto huff_dict = dicts.find(".dict.huff");
+    if (huff_dict != dicts.end())
+    {
+        std::vector<huffman_table> htabs = read_huffman_tables(huff_dict->second);
+        if (htabs.size() != 1)
+            throw std::runtime_error("Bad .dict.huff section");
+        return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+            return restore_value_dict_entropy<RV32I_CMDLEN>(csec, pos, dict, htabs[0]);
+        });
+    }
+
+    std::vector<uint32_t> hot_values = read_hot_values(dicts);
+    if (!hot_values.empty())
+    {
+        return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+            return restore_value_dict_hot<RV32I_CMDLEN, DICT_INDX_SIZE>(csec, pos, dict, hot_values);
+        });
+    }
+
+    // Reordered dictionary without short codes is read by batch decoder too
+    std::optional<index_predictor> predictor = read_index_predictor(dicts);
+    if (predictor && predictor->get_coding() != index_coding::FIXED)
+    {
+        size_t i = 0;
+        return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+            if (i++ % INDEX_LINE_CMDS == 0)
+                predictor->reset();
+            return restore_value_dict_coded(csec, pos, dict, *predictor);
+        });
+    }
+
+    // Batch decoder writes instructions straight into words buffer, it's
+    // fast enough to check cancellation only before it
+    cfg.report_progress(progress_phase::DECODE, 0, cmds_cnt);
+    std::vector<uint32_t> words(cmds_cnt);
+    size_t cnt = dict_decode_batch(csec.data(), csec.get_data_sz_bits(), dict.data(), dict.size(), DICT_INDX_SIZE, words.data(), cmds_cnt);
+    if (cnt != cmds_cnt)
+        throw std::runtime_error("Compressed section is truncated");
+
+    std::vector<uint8_t> text(cmds_cnt * RV32I_CMDLEN);
+    for (size_t i = 0; i < cmds_cnt; ++i)
+        put_word_le(text.data() + i * RV32I_CMDLEN, words[i]);
+    return text;
+}
+
+std::vector<uint8_t> rv32i_mask_single_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict = read_dict_values<RV32I_CMDLEN, MASK_SINGLE_INDX_SIZE>(dicts, ".dict");
+
+    auto huff_dict = dicts.find(".dict.huff");
+    if (huff_dict != dicts.end())
+    {
+        std::vector<huffman_table> htabs = read_huffman_tables(huff_dict->second);
+        if (htabs.size() != 2)
+            throw std::runtime_error("Bad .dict.huff section");
+        return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+            return restore_value_mask_entropy<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE>(csec, pos, dict, htabs[0], htabs[1]);
+        });
+    }
+
+    std::vector<uint32_t> hot_values = read_hot_values(dicts);
+    if (!hot_values.empty())
+    {
+        return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+            return restore_value_mask_hot<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, dict, hot_values);
+        });
+    }
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        return restore_value_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, dict);
+    });
+}
+
+std::vector<uint8_t> rv32i_mask_duo_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict1 = read_dict_values<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE>(dicts, ".dict.1");
+    std::vector<uint32_t> dict2 = read_dict_values<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE>(dicts, ".dict.2");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        uint32_t lo = restore_value_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, dict1);
+        uint32_t hi = restore_value_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, dict2);
+        return lo | (hi << 16);
+    });
+}
+
+std::vector<uint8_t> rv32i_mask_quad_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::array<std::vector<uint32_t>, 4> quad_dicts = {
+        read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.11"),
+        read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.12"),
+        read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.21"),
+        read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.22")
+    };
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < quad_dicts.size(); ++i)
+            value |= restore_value_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, quad_dicts[i]) << (i * 8);
+        return value;
+    });
+}
+
+std::vector<uint8_t> rv32i_mask_duo_quad_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict1 = read_dict_values<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE>(dicts, ".dict.1");
+    std::vector<uint32_t> dict21 = read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.21");
+    std::vector<uint32_t> dict22 = read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.22");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        uint32_t value = restore_value_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, dict1);
+        value |= restore_value_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, dict21) << 16;
+        value |= restore_value_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, dict22) << 24;
+        return value;
+    });
+}
+
+std::vector<uint8_t> rv32i_mask_operands_opcode_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict_opcode = read_dict_values<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>(dicts, ".dict.opcode");
+    std::vector<uint32_t> dict_operands = read_dict_values<RV32I_CMDLEN_O, MASK_OPERS_INDX_SIZE>(dicts, ".dict.operands");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        uint32_t operands = restore_value_mask<RV32I_CMDLEN_O, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE>(csec, pos, dict_operands);
+        uint32_t opcode = restore_value_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, dict_opcode);
+        return opcode | (operands << 8);
+    });
+}
+
+std::vector<uint8_t> rv32i_fields_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict_funct = read_dict_values<FIELDS_FUNCT_CMDLEN, FIELDS_FUNCT_INDX_SIZE>(dicts, ".dict.funct");
+    std::vector<uint32_t> dict_regs = read_dict_values<FIELDS_REGS_CMDLEN, FIELDS_REGS_INDX_SIZE>(dicts, ".dict.regs");
+    std::vector<uint32_t> dict_imm = read_dict_values<FIELDS_IMM_CMDLEN, FIELDS_IMM_INDX_SIZE>(dicts, ".dict.imm");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        return restore_value_fields(csec, pos, dict_funct, dict_regs, dict_imm);
+    });
+}
+
+std::vector<uint8_t> rv32i_fixed_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, size_t indx_size, const config &cfg)
+{
+    std::vector<uint32_t> dict = read_dict_values<RV32I_CMDLEN, FIXED_MAX_INDX_SIZE>(dicts, ".dict");
+    std::vector<uint32_t> dict_overflow = read_dict_values<RV32I_CMDLEN, FIXED_MAX_INDX_SIZE>(dicts, ".dict.ovf");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        return restore_value_fixed(csec, pos, dict, dict_overflow, indx_size);
+    });
+}
+
+static block_map read_block_map(const dict_views &dicts)
+{
+    std::span<const uint8_t> map_data = find_dict_view(dicts, ".dict.blocks");
+    return block_map::deserialize((const char *)map_data.data(), map_data.size());
+}
+
+// Dictionaries of every block as parts of .dict, up to 255 of them
+static std::vector<std::span<const uint32_t>> split_block_dicts(const block_map &bmap, const std::vector<uint32_t> &dict)
+{
+    std::vector<std::span<const uint32_t>> tables;
+    for (size_t d = 0; d < bmap.get_dict_sizes().size(); ++d)
+    {
+        size_t start = bmap.get_dict_start(d), size = bmap.get_dict_sizes()[d];
+        if (start + size > dict.size() || size > ((size_t)1 << DICT_BLOCKS_INDX_SIZE))
+            throw std::runtime_error("Bad .dict.blocks section");
+        tables.push_back(std::span<const uint32_t>(dict).subspan(start, size));
+    }
+    return tables;
+}
+
+// first_cmd - index of the first command of csec in original section, it selects blocks
+std::vector<uint8_t> rv32i_dict_blocks_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, size_t first_cmd, const config &cfg)
+{
+    block_map bmap = read_block_map(dicts);
+    std::vector<uint32_t> dict = read_dict_values<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE + 8>(dicts, ".dict");
+    std::vector<std::span<const uint32_t>> tables = split_block_dicts(bmap, dict);
+
+    size_t indx = first_cmd;
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        return restore_value_dict<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE>(csec, pos, tables[bmap.get_dict(indx++)]);
+    });
+}
+
+std::vector<uint8_t> rv32i_mask_multi_decompress_section(const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, const config &cfg)
+{
+    std::vector<uint32_t> dict = read_dict_values<RV32I_CMDLEN, MASK_MULTI_INDX_SIZE>(dicts, ".dict");
+
+    return restore_code_values(csec, cmds_cnt, cfg, [&](size_t &pos) {
+        return restore_value_mask_multi(csec, pos, dict, MASK_MULTI_INDX_SIZE, MASK_MULTI_WINDOWS);
+    });
+}
+
+// Everything compressed output depends on: input, options and codeword
+// layout of this build
+static std::string make_cache_key(std::span<const uint8_t> text, const config &cfg, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions)
+{
+    sha256 hasher;
+    const size_t layout[] = {
+        LIBCOMPRESS_VERSION, CODE_HEADER_VERSION, addr_table::LINE_SHIFT, DICT_INDX_SIZE,
+        MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE,
+        MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE,
+        FIELDS_FUNCT_INDX_SIZE, FIELDS_REGS_INDX_SIZE, FIELDS_IMM_INDX_SIZE, FIXED_INDX_SIZE, FIXED_MAX_INDX_SIZE,
+        DICT_BLOCKS_INDX_SIZE, DICT_BLOCKS_SHIFT, DICT_BLOCKS_ROUNDS, MASK_MULTI_INDX_SIZE, MASK_MULTI_WINDOWS,
+        INDEX_SHORT_MAX_SIZE
+    };
+    for (size_t value : layout)
+        hasher.update_u64(value);
+
+    hasher.update_u64((uint64_t)cfg.get_etype());
+    hasher.update_u64(cfg.get_entropy_coding());
+    hasher.update_u64(cfg.get_block_dicts());
+    hasher.update_u64(cfg.get_hot_dict());
+    hasher.update_u64((uint64_t)cfg.get_dict_order());
+    hasher.update_u64((uint64_t)cfg.get_index_coding());
+    hasher.update_u64(cfg.get_exec_counts().size());
+    for (uint64_t count : cfg.get_exec_counts())
+        hasher.update_u64(count);
+    hasher.update_u64(entry_points.size());
+    for (size_t offset : entry_points)
+        hasher.update_u64(offset);
+    hasher.update_u64(functions.size());
+    for (const auto &f : functions)
+    {
+        hasher.update_u64(f.offset);
+        hasher.update_u64(f.size);
+    }
+    hasher.update_u64(text.size());
+    hasher.update(text.data(), text.size());
+    return hasher.hex_digest();
+}
+
+code_image rv32i_compress_code(size_stat &szstat, std::vector<std::string> &dict_infos, std::span<const uint8_t> text, config cfg, const std::vector<size_t> &entry_points, const std::vector<func_range> &functions)
+{
+    szstat = size_stat { };
+    szstat.initial_code_size += text.size();
 
-    szstat.initial_code_size += code_section->get_size();
-    std::vector<command> section_commands = get_commands<RV32I_CMDLEN>(code_section);
+    // Input stays alive for the whole run, commands too
+    memory_meter meter;
+    memory_scope text_memory(&meter, text.size());
+    std::vector<command> section_commands = get_commands<RV32I_CMDLEN>(text);
+    memory_scope commands_scope(&meter, commands_memory(section_commands.size(), RV32I_CMDLEN));
+    if (!cfg.get_exec_counts().empty() && cfg.get_exec_counts().size() != section_commands.size())
+        throw std::runtime_error("Execution counts don't match instructions of .text");
 
     encode_type etype = cfg.get_etype();
+    if (cfg.get_entropy_coding() && etype != encode_type::DICT && etype != encode_type::MASK_SINGLE)
+        throw std::runtime_error("Entropy coding is not supported for this encoding type");
+    if (etype == encode_type::DICT_BLOCKS && (cfg.get_block_dicts() == 0 || cfg.get_block_dicts() > 0xff))
+        throw std::runtime_error("Block dictionaries count must be from 1 to 255");
+    if (cfg.get_hot_dict() != 0)
+    {
+        if (etype != encode_type::DICT && etype != encode_type::MASK_SINGLE)
+            throw std::runtime_error("Hot dictionary is not supported for this encoding type");
+        if (cfg.get_entropy_coding())
+            throw std::runtime_error("Hot dictionary is not supported with entropy coding");
+        if (cfg.get_hot_dict() < 2 || cfg.get_hot_dict() > HOT_DICT_MAX_ENTRIES)
+            throw std::runtime_error("Hot dictionary entries must be from 2 to 256");
+    }
+    if (cfg.get_dict_order() != dict_order::VALUE || cfg.get_index_coding() != index_coding::FIXED)
+    {
+        if (etype != encode_type::DICT)
+            throw std::runtime_error("Dictionary order and index coding are supported only for DICT");
+        if (cfg.get_entropy_coding() || cfg.get_hot_dict() != 0)
+            throw std::runtime_error("Dictionary order and index coding are not supported with entropy coding or hot dictionary");
+        if (!functions.empty() && cfg.get_index_coding() != index_coding::FIXED)
+            throw std::runtime_error("Coded indices are not supported with function units");
+    }
+
+    code_image image;
+    std::optional<result_cache> cache;
+    std::string cache_key;
+    size_t infos_start = dict_infos.size();
+    if (!cfg.get_cache_dir().empty())
+    {
+        cache.emplace(cfg.get_cache_dir());
+        cache_key = make_cache_key(text, cfg, entry_points, functions);
+        if (cache->load(cache_key, image, szstat, dict_infos))
+        {
+            szstat.cache_hits = 1;
+            cfg.report_progress(progress_phase::ENCODE, section_commands.size(), section_commands.size());
+            return image;
+        }
+    }
+
     switch (etype)
     {
         case encode_type::DICT:
-            rv32i_dict_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_dict_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         case encode_type::MASK_DUO:
-            rv32i_mask_duo_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_mask_duo_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         case encode_type::MASK_QUAD:
-            rv32i_mask_quad_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_mask_quad_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         case encode_type::MASK_DUO_QUAD:
-            rv32i_mask_duo_quad_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_mask_duo_quad_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         case encode_type::MASK_SINGLE:
-            rv32i_mask_single_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_mask_single_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         case encode_type::MASK_OPERANDS_OPCODE:
-            rv32i_mask_operands_opcode_compress_section(file, code_section, szstat, dict_infos, section_commands, cfg);
+            rv32i_mask_operands_opcode_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
+            break;
+        case encode_type::RV32I_FIELDS:
+            rv32i_fields_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
+            break;
+        case encode_type::FIXED16:
+            rv32i_fixed_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
+            break;
+        case encode_type::DICT_BLOCKS:
+            rv32i_dict_blocks_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
+            break;
+        case encode_type::MASK_MULTI:
+            rv32i_mask_multi_compress_section(image, szstat, dict_infos, section_commands, entry_points, functions, cfg, meter);
             break;
         default:
             throw std::runtime_error("Not yet supported encoding type");
     }
+    cfg.report_progress(progress_phase::ENCODE, section_commands.size(), section_commands.size());
 
-    return build_exec_file(file, code_section);
-}
+    szstat.peak_histogram_memory = meter.get_peak(progress_phase::HISTOGRAM);
+    szstat.peak_dictionary_memory = meter.get_peak(progress_phase::DICTIONARY);
+    szstat.peak_encode_memory = meter.get_peak(progress_phase::ENCODE);
+    szstat.peak_memory = meter.get_peak();
 
-ELFIO::elfio* rv32i_decompress_executable(ELFIO::elfio *file)
-{
-    ELFIO::section * code_section = get_section_with_name(file, ".text");
-    if (code_section == nullptr)
-        throw std::runtime_error("No code section in file");
+    if (cache)
+    {
+        szstat.cache_misses = 1;
+        cache->store(cache_key, image, szstat, std::vector<std::string>(dict_infos.begin() + infos_start, dict_infos.end()));
+    }
 
-    encode_type etype;
-    compressed_section csec = get_compressed_section(code_section, etype);
+    return image;
+}
 
-    switch (etype)
+std::vector<uint8_t> rv32i_decompress_section(const code_header &header, const dict_views &dicts, const compressed_section &csec, size_t cmds_cnt, size_t first_cmd, const config &cfg)
+{
+    switch (header.etype)
     {
         case encode_type::DICT:
-            rv32i_dict_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_dict_decompress_section(dicts, csec, cmds_cnt, cfg);
         case encode_type::MASK_DUO:
-            rv32i_mask_duo_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_mask_duo_decompress_section(dicts, csec, cmds_cnt, cfg);
         case encode_type::MASK_QUAD:
-            rv32i_mask_quad_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_mask_quad_decompress_section(dicts, csec, cmds_cnt, cfg);
         case encode_type::MASK_DUO_QUAD:
-            rv32i_mask_duo_quad_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_mask_duo_quad_decompress_section(dicts, csec, cmds_cnt, cfg);
         case encode_type::MASK_SINGLE:
-            rv32i_mask_single_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_mask_single_decompress_section(dicts, csec, cmds_cnt, cfg);
         case encode_type::MASK_OPERANDS_OPCODE:
-            rv32i_mask_operands_opcode_decompress_section(file, code_section, csec);
-            break;
+            return rv32i_mask_operands_opcode_decompress_section(dicts, csec, cmds_cnt, cfg);
+        case encode_type::RV32I_FIELDS:
+            return rv32i_fields_decompress_section(dicts, csec, cmds_cnt, cfg);
+        case encode_type::FIXED16:
+            return rv32i_fixed_decompress_section(dicts, csec, cmds_cnt, header.parts[0].indx_size, cfg);
+        case encode_type::DICT_BLOCKS:
+            return rv32i_dict_blocks_decompress_section(dicts, csec, cmds_cnt, first_cmd, cfg);
+        case encode_type::MASK_MULTI:
+            return rv32i_mask_multi_decompress_section(dicts, csec, cmds_cnt, cfg);
         default:
             throw std::runtime_error("Not yet supported encoding type");
     }
+}
+
+std::vector<uint8_t> rv32i_decompress_code(std::span<const uint8_t> code, const dict_views &dicts, const config &cfg)
+{
+    code_header header;
+    compressed_section csec = get_compressed_section(code, header);
+    if (header.cmdlen != RV32I_CMDLEN)
+        throw std::runtime_error("Compressed section is not rv32i code");
+    if (!check_code(code, dicts))
+        throw std::runtime_error("Compressed section or its dictionaries are damaged");
+
+    size_t cmds_cnt = header.cmds_cnt;
+    std::vector<uint8_t> text = rv32i_decompress_section(header, dicts, csec, cmds_cnt, 0, cfg);
+    cfg.report_progress(progress_phase::DECODE, cmds_cnt, cmds_cnt);
+
+    return text;
+}
+
+// Bits of the unit are copied out of the stream and decoded as a section of its own
+std::vector<uint8_t> rv32i_decompress_function(std::span<const uint8_t> code, const dict_views &dicts, size_t offset, const config &cfg)
+{
+    size_t header_size = 0;
+    code_header header = read_code_header(code, header_size);
+    if (header.cmdlen != RV32I_CMDLEN)
+        throw std::runtime_error("Compressed section is not rv32i code");
+    header.check_dict_sizes(dicts);
+
+    func_unit unit;
+    if (!get_func_table(dicts).lookup(offset, unit))
+        throw std::runtime_error("No function at offset " + std::to_string(offset));
+    if (unit.bit_offset + unit.bit_size > header.stream_bits)
+        throw std::runtime_error("Compressed section is truncated");
+
+    compressed_section csec;
+    csec.add((const char *)code.data() + header_size + (unit.bit_offset >> 3), unit.bit_size, unit.bit_offset & 0x7);
+
+    size_t cmds_cnt = unit.text_size / RV32I_CMDLEN;
+    std::vector<uint8_t> text = rv32i_decompress_section(header, dicts, csec, cmds_cnt, unit.text_offset / RV32I_CMDLEN, cfg);
+    cfg.report_progress(progress_phase::DECODE, cmds_cnt, cmds_cnt);
+
+    return text;
+}
+
+ELFIO::elfio* rv32i_compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    std::vector<func_range> functions;
+    if (cfg.get_function_units())
+        functions = find_function_ranges(file, code_section);
+
+    code_image image = rv32i_compress_code(szstat, dict_infos, get_section_bytes(code_section), cfg, find_symbol_offsets(file, code_section), functions);
+
+    code_section->set_data((const char *)image.code.data(), image.code.size());
+    for (const auto &dict : image.get_dicts())
+    {
+        ELFIO::section *dict_sec = file->sections.add(dict.first);
+        dict_sec->set_type( ELFIO::SHT_PROGBITS );
+        dict_sec->set_addr_align( 0x1 );
+        dict_sec->set_data((const char *)dict.second.data(), dict.second.size());
+    }
+
+    return build_exec_file(file, code_section);
+}
+
+// Dictionaries of compressed file are viewed in place, without copies
+dict_views get_dict_views(const ELFIO::elfio *file)
+{
+    dict_views dicts;
+    for (size_t i = 0; i < file->sections.size(); ++i)
+    {
+        const ELFIO::section *sec = file->sections[i];
+        if (sec->get_name().rfind(".dict", 0) == 0)
+            dicts[sec->get_name()] = get_section_bytes(sec);
+    }
+    return dicts;
+}
+
+ELFIO::elfio* rv32i_decompress_executable(ELFIO::elfio *file, const config &cfg)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    std::vector<uint8_t> text = rv32i_decompress_code(get_section_bytes(code_section), get_dict_views(file), cfg);
+    code_section->set_data((const char *)text.data(), text.size());
 
     return file;
 }
 
+// rv64i instructions are 32 bit words as rv32i ones, its 64 bit operations
+// (OP-IMM-32, OP-32, LD, SD) have rv32i formats, so every encode type and
+// every split of rv32i codec works for them as is. Only ELF class differs
+ELFIO::elfio* rv64i_compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg)
+{
+    if (file->get_class() != ELFIO::ELFCLASS64)
+        throw std::runtime_error("Not rv64i executable");
+    return rv32i_compress_executable(szstat, dict_infos, file, cfg);
+}
+
+ELFIO::elfio* rv64i_decompress_executable(ELFIO::elfio *file, const config &cfg)
+{
+    if (file->get_class() != ELFIO::ELFCLASS64)
+        throw std::runtime_error("Not rv64i executable");
+    return rv32i_decompress_executable(file, cfg);
+}
+
+// Index of two-level dictionary if hot_indx_size isn't 0, position in
+// .dict.hot for hot entries
+template<size_t INDX_SIZE>
+size_t read_dict_index(const compressed_section &csec, size_t &pos, size_t hot_indx_size)
+{
+    size_t indx_size = INDX_SIZE;
+    if (hot_indx_size != 0 && csec.getbit(pos++))
+        indx_size = hot_indx_size;
+    size_t indx = csec.getbits(pos, indx_size);
+    pos += indx_size;
+    return indx;
+}
+
+// Codeword of instruction gets the worst class of its parts
+static void note_codeword(block_trace &trace, codeword_class cls, size_t mask_pos, size_t indx)
+{
+    if (trace.codeword_parts++ == 0 || cls > trace.codeword.cls)
+    {
+        trace.codeword.cls = cls;
+        trace.codeword.mask_pos = mask_pos;
+        trace.codeword.indx = indx;
+    }
+}
+
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE, size_t INDX_SIZE>
+void trace_block_mask(const compressed_section &csec, size_t &pos, block_trace &trace, size_t hot_indx_size = 0)
+{
+    bool cbit = csec.getbit(pos++);
+    if (cbit == true)
+    {
+        bool mbit = csec.getbit(pos++);
+        size_t mask_pos = 0;
+        if (mbit == false)
+        {
+            mask_pos = csec.getbits(pos, POS_SIZE);
+            pos += POS_SIZE + MASK_SIZE;
+            trace.mask_applies++;
+        }
+        size_t indx = read_dict_index<INDX_SIZE>(csec, pos, hot_indx_size);
+        note_codeword(trace, mbit ? codeword_class::DICT : codeword_class::MASK, mask_pos, indx);
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else
+    {
+        pos += CMDLEN << 3;
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+    }
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+void trace_block_dict(const compressed_section &csec, size_t &pos, block_trace &trace, size_t hot_indx_size = 0)
+{
+    bool cbit = csec.getbit(pos++);
+    if (cbit == true)
+    {
+        note_codeword(trace, codeword_class::DICT, 0, read_dict_index<INDX_SIZE>(csec, pos, hot_indx_size));
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else
+    {
+        pos += CMDLEN << 3;
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+    }
+}
+
+// indx - index of the command in original section
+void trace_block_dict_coded(const compressed_section &csec, size_t &pos, block_trace &trace, index_predictor &predictor, size_t indx)
+{
+    if (indx % INDEX_LINE_CMDS == 0)
+        predictor.reset();
+
+    if (csec.getbit(pos++))
+    {
+        note_codeword(trace, codeword_class::DICT, 0, read_coded_index(csec, pos, predictor));
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else
+    {
+        pos += RV32I_CMDLEN << 3;
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+    }
+}
+
+void trace_block_mask_multi(const compressed_section &csec, size_t &pos, block_trace &trace)
+{
+    if (!csec.getbit(pos++))
+    {
+        pos += RV32I_CMDLEN << 3;
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+        return;
+    }
+    mask_match match;
+    bool masked = !csec.getbit(pos++);
+    if (masked)
+    {
+        read_mask_windows(csec, pos, MASK_MULTI_WINDOWS, match);
+        trace.mask_applies += match.windows_cnt;
+    }
+    note_codeword(trace, masked ? codeword_class::MASK : codeword_class::DICT, masked ? match.windows[0].pos : 0, csec.getbits(pos, MASK_MULTI_INDX_SIZE));
+    pos += MASK_MULTI_INDX_SIZE;
+    trace.dict_reads++;
+    trace.dict_levels = 1;
+}
+
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE>
+void trace_block_entropy(const compressed_section &csec, size_t &pos, size_t entries_cnt, const huffman_table &htab, const huffman_table *mask_htab, block_trace &trace)
+{
+    size_t sym = htab.decode(csec, pos);
+    trace.entropy_symbols++;
+    if (sym < entries_cnt)
+    {
+        note_codeword(trace, codeword_class::DICT, 0, sym);
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else if (sym == entries_cnt && mask_htab != nullptr)
+    {
+        size_t mask_pos = csec.getbits(pos, POS_SIZE);
+        pos += POS_SIZE + MASK_SIZE;
+        note_codeword(trace, codeword_class::MASK, mask_pos, mask_htab->decode(csec, pos));
+        trace.entropy_symbols++;
+        trace.mask_applies++;
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else
+    {
+        pos += CMDLEN << 3;
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+    }
+}
+
+template<size_t INDX_SIZE_F>
+void trace_block_fields(const compressed_section &csec, size_t &pos, const encode_table<FIELDS_FUNCT_CMDLEN, INDX_SIZE_F> &entab_funct, block_trace &trace)
+{
+    if (csec.getbit(pos))
+    {
+        note_codeword(trace, codeword_class::DICT, 0, csec.getbits(pos + 1, INDX_SIZE_F));
+        trace.dict_reads++;
+        trace.dict_levels = 1;
+    }
+    else
+    {
+        note_codeword(trace, codeword_class::LITERAL, 0, 0);
+    }
+    uint32_t funct = restore_field(csec, pos, entab_funct, FIELDS_FUNCT_BITS);
+    const rv32i_layout &layout = rv32i_get_layout(rv32i_get_format(funct));
+
+    const std::pair<uint32_t, size_t> fields[] = {
+        { layout.regs_mask, FIELDS_REGS_INDX_SIZE },
+        { layout.imm_mask, FIELDS_IMM_INDX_SIZE },
+    };
+    for (const auto &field : fields)
+    {
+        if (field.first == 0)
+            continue;
+
+        if (field_uses_dictionary(field.first, field.second) && csec.getbit(pos++))
+        {
+            note_codeword(trace, codeword_class::DICT, 0, csec.getbits(pos, field.second));
+            pos += field.second;
+            trace.dict_reads++;
+            trace.dict_levels = 2;      // layout is known only after funct lookup
+        }
+        else
+        {
+            note_codeword(trace, codeword_class::LITERAL, 0, 0);
+            pos += count_bits(field.first);
+        }
+    }
+    pos += count_bits(layout.raw_mask);
+}
+
+std::vector<block_trace> trace_executable(const ELFIO::elfio *file)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    code_header header;
+    compressed_section csec = get_compressed_section(get_section_bytes(code_section), header);
+    encode_type etype = header.etype;
+    const ELFIO::section *huff_sec = get_section_with_name(file, ".dict.huff");
+    std::vector<huffman_table> htabs;
+    if (huff_sec != nullptr)
+        htabs = read_huffman_tables(huff_sec);
+
+    const ELFIO::section *hot_sec = get_section_with_name(file, ".dict.hot");
+    size_t hot_indx_size = hot_sec != nullptr ? std::bit_width(hot_sec->get_size() / RV32I_CMDLEN - 1) : 0;
+    std::optional<index_predictor> predictor;
+    if (etype == encode_type::DICT)
+        predictor = read_index_predictor(get_dict_views(file));
+
+    encode_table<FIELDS_FUNCT_CMDLEN, FIELDS_FUNCT_INDX_SIZE> entab_funct;
+    size_t entries_cnt = 0;
+    if (etype == encode_type::RV32I_FIELDS)
+    {
+        read_instr_dictionary<FIELDS_FUNCT_CMDLEN>(file, entab_funct, ".dict.funct");
+    }
+    else if (!htabs.empty())
+    {
+        const ELFIO::section *dict_sec = get_section_with_name(file, ".dict");
+        if (dict_sec == nullptr)
+            throw std::runtime_error("No section with name: .dict");
+        entries_cnt = dict_sec->get_size() / RV32I_CMDLEN;
+    }
+
+    std::vector<block_trace> traces;
+    size_t csec_end = csec.get_data_sz_bits();
+    for (size_t pos = 0; pos < csec_end;)
+    {
+        block_trace trace;
+        size_t start = pos;
+        switch (etype)
+        {
+            case encode_type::DICT:
+                if (predictor)
+                    trace_block_dict_coded(csec, pos, trace, *predictor, traces.size());
+                else if (htabs.empty())
+                    trace_block_dict<RV32I_CMDLEN, DICT_INDX_SIZE>(csec, pos, trace, hot_indx_size);
+                else
+                    trace_block_entropy<RV32I_CMDLEN, 0, 0>(csec, pos, entries_cnt, htabs[0], nullptr, trace);
+                break;
+            case encode_type::MASK_SINGLE:
+                if (htabs.empty())
+                    trace_block_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, trace, hot_indx_size);
+                else
+                    trace_block_entropy<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE>(csec, pos, entries_cnt, htabs[0], &htabs[1], trace);
+                break;
+            case encode_type::MASK_DUO:
+                trace_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, trace);
+                trace_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, trace);
+                break;
+            case encode_type::MASK_QUAD:
+                for (size_t i = 0; i < 4; ++i)
+                    trace_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, trace);
+                break;
+            case encode_type::MASK_DUO_QUAD:
+                trace_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, trace);
+                trace_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, trace);
+                trace_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, trace);
+                break;
+            case encode_type::MASK_OPERANDS_OPCODE:
+                trace_block_mask<RV32I_CMDLEN_O, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE>(csec, pos, trace);
+                trace_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, trace);
+                break;
+            case encode_type::RV32I_FIELDS:
+                trace_block_fields(csec, pos, entab_funct, trace);
+                break;
+            case encode_type::FIXED16:
+                note_codeword(trace, codeword_class::DICT, 0, csec.getbits(pos, header.parts[0].indx_size));
+                pos += header.parts[0].indx_size + 1;
+                trace.dict_reads = 1;
+                trace.dict_levels = 1;
+                break;
+            case encode_type::DICT_BLOCKS:
+                trace_block_dict<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE>(csec, pos, trace);
+                break;
+            case encode_type::MASK_MULTI:
+                trace_block_mask_multi(csec, pos, trace);
+                break;
+            default:
+                throw std::runtime_error("Not yet supported encoding type");
+        }
+        trace.bits = pos - start;
+        trace.codeword.bits = trace.bits;
+        traces.push_back(trace);
+    }
+
+    return traces;
+}
+
+codeword_map map_executable(const ELFIO::elfio *file)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    encode_type etype;
+    get_compressed_section(code_section, etype);
+    std::vector<block_trace> traces = trace_executable(file);
+    std::vector<uint8_t> text = decompress_code(get_section_bytes(code_section), get_dict_views(file));
+    if (text.size() != traces.size() * RV32I_CMDLEN)
+        throw std::runtime_error("Codewords don't match decompressed code");
+
+    std::vector<codeword_record> records;
+    records.reserve(traces.size());
+    for (size_t i = 0; i < traces.size(); ++i)
+    {
+        codeword_record rec = traces[i].codeword;
+        rec.opcode = text[i * RV32I_CMDLEN] & 0x7f;
+        records.push_back(rec);
+    }
+
+    return codeword_map(etype, code_section->get_address(), RV32I_CMDLEN, std::move(records), find_function_symbols(file, code_section, text.size()));
+}
+
+// Decoder of a single instruction at arbitrary block boundary, keeps
+// dictionaries of compressed file loaded
+class section_decoder
+{
+public:
+    section_decoder(const ELFIO::elfio *file, const code_header &header)
+        : _etype(header.etype), _fixed_indx_size(header.parts[0].indx_size)
+    {
+        const ELFIO::section *huff_sec = get_section_with_name(file, ".dict.huff");
+        if (huff_sec != nullptr)
+            _htabs = read_huffman_tables(huff_sec);
+
+        switch (_etype)
+        {
+            case encode_type::DICT:
+            {
+                dict_views dicts = get_dict_views(file);
+                std::optional<index_predictor> predictor = read_index_predictor(dicts);
+                if (predictor)
+                {
+                    _index_coding = predictor->get_coding();
+                    _short_size = predictor->get_short_size();
+                    _dict_values = read_dict_values<RV32I_CMDLEN, DICT_INDX_SIZE>(dicts, ".dict");
+                }
+                else
+                {
+                    read_instr_dictionary<RV32I_CMDLEN>(file, _entab_dict, ".dict");
+                }
+                read_hot_dictionary<DICT_INDX_SIZE>(file);
+                break;
+            }
+            case encode_type::MASK_SINGLE:
+                read_instr_dictionary<RV32I_CMDLEN>(file, _entab_single, ".dict");
+                read_hot_dictionary<MASK_SINGLE_INDX_SIZE>(file);
+                break;
+            case encode_type::MASK_DUO:
+                read_instr_dictionary<RV32I_CMDLEN_H>(file, _entab_duo1, ".dict.1");
+                read_instr_dictionary<RV32I_CMDLEN_H>(file, _entab_duo2, ".dict.2");
+                break;
+            case encode_type::MASK_QUAD:
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[0], ".dict.11");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[1], ".dict.12");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[2], ".dict.21");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[3], ".dict.22");
+                break;
+            case encode_type::MASK_DUO_QUAD:
+                read_instr_dictionary<RV32I_CMDLEN_H>(file, _entab_duo1, ".dict.1");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[2], ".dict.21");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[3], ".dict.22");
+                break;
+            case encode_type::MASK_OPERANDS_OPCODE:
+                read_instr_dictionary<RV32I_CMDLEN_O>(file, _entab_operands, ".dict.operands");
+                read_instr_dictionary<RV32I_CMDLEN_Q>(file, _entabs_quad[0], ".dict.opcode");
+                break;
+            case encode_type::RV32I_FIELDS:
+                read_instr_dictionary<FIELDS_FUNCT_CMDLEN>(file, _entab_funct, ".dict.funct");
+                read_instr_dictionary<FIELDS_REGS_CMDLEN>(file, _entab_regs, ".dict.regs");
+                read_instr_dictionary<FIELDS_IMM_CMDLEN>(file, _entab_imm, ".dict.imm");
+                break;
+            case encode_type::FIXED16:
+                read_instr_dictionary<RV32I_CMDLEN>(file, _entab_fixed, ".dict");
+                read_instr_dictionary<RV32I_CMDLEN>(file, _overflow_fixed, ".dict.ovf");
+                break;
+            case encode_type::DICT_BLOCKS:
+            {
+                dict_views dicts = get_dict_views(file);
+                _bmap = read_block_map(dicts);
+                _blocks_values = read_dict_values<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE + 8>(dicts, ".dict");
+                _blocks_tables = split_block_dicts(_bmap, _blocks_values);
+                break;
+            }
+            case encode_type::MASK_MULTI:
+                _dict_values = read_dict_values<RV32I_CMDLEN, MASK_MULTI_INDX_SIZE>(get_dict_views(file), ".dict");
+                break;
+            default:
+                throw std::runtime_error("Not yet supported encoding type");
+        }
+    }
+
+    // State of coded DICT indices, empty for other streams. Every decode
+    // run has its own, so decoder is shared by threads
+    std::optional<index_predictor> make_predictor() const
+    {
+        if (!_index_coding)
+            return std::nullopt;
+        return index_predictor(*_index_coding, _short_size);
+    }
+
+    // indx - index of the command in original section. Coded DICT indices
+    // are decoded from line start with predictor of make_predictor, commands
+    // go one after another
+    command decode(const compressed_section &csec, size_t &pos, size_t indx, std::optional<index_predictor> &predictor) const
+    {
+        command cmd;
+        switch (_etype)
+        {
+            case encode_type::DICT:
+                if (predictor)
+                {
+                    if (indx % INDEX_LINE_CMDS == 0)
+                        predictor->reset();
+                    cmd.add(restore_value_dict_coded(csec, pos, _dict_values, *predictor), RV32I_CMDLEN << 3);
+                }
+                else if (!_hot_values.empty())
+                    cmd.add(restore_value_dict_hot<RV32I_CMDLEN, DICT_INDX_SIZE>(csec, pos, _dict_values, _hot_values), RV32I_CMDLEN << 3);
+                else if (_htabs.empty())
+                    cmd = restore_block_dict<RV32I_CMDLEN, DICT_INDX_SIZE>(csec, pos, _entab_dict);
+                else
+                    cmd = restore_block_dict_entropy(csec, pos, _entab_dict, _htabs[0]);
+                break;
+            case encode_type::MASK_SINGLE:
+                if (!_hot_values.empty())
+                    cmd.add(restore_value_mask_hot<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, _dict_values, _hot_values), RV32I_CMDLEN << 3);
+                else if (_htabs.empty())
+                    cmd = restore_block_mask<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, _entab_single);
+                else
+                    cmd = restore_block_mask_entropy<RV32I_CMDLEN, MASK_SINGLE_POS_SIZE, MASK_SINGLE_MASK_SIZE, MASK_SINGLE_INDX_SIZE>(csec, pos, _entab_single, _htabs[0], _htabs[1]);
+                break;
+            case encode_type::MASK_DUO:
+                cmd = restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, _entab_duo1);
+                cmd.add(restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, _entab_duo2));
+                break;
+            case encode_type::MASK_QUAD:
+                cmd = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, _entabs_quad[0]);
+                for (size_t i = 1; i < 4; ++i)
+                    cmd.add(restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, _entabs_quad[i]));
+                break;
+            case encode_type::MASK_DUO_QUAD:
+                cmd = restore_block_mask<RV32I_CMDLEN_H, MASK_DUO_POS_SIZE, MASK_DUO_MASK_SIZE, MASK_DUO_INDX_SIZE>(csec, pos, _entab_duo1);
+                cmd.add(restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, _entabs_quad[2]));
+                cmd.add(restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, _entabs_quad[3]));
+                break;
+            case encode_type::MASK_OPERANDS_OPCODE:
+            {
+                command cmd_operands = restore_block_mask<RV32I_CMDLEN_O, MASK_OPERS_POS_SIZE, MASK_OPERS_MASK_SIZE, MASK_OPERS_INDX_SIZE>(csec, pos, _entab_operands);
+                cmd = restore_block_mask<RV32I_CMDLEN_Q, MASK_QUAD_POS_SIZE, MASK_QUAD_MASK_SIZE, MASK_QUAD_INDX_SIZE>(csec, pos, _entabs_quad[0]);
+                cmd.add(cmd_operands);
+                break;
+            }
+            case encode_type::RV32I_FIELDS:
+                cmd = restore_block_fields(csec, pos, _entab_funct, _entab_regs, _entab_imm);
+                break;
+            case encode_type::FIXED16:
+                cmd = restore_block_fixed(csec, pos, _entab_fixed, _overflow_fixed, _fixed_indx_size);
+                break;
+            case encode_type::DICT_BLOCKS:
+                cmd.add(restore_value_dict<RV32I_CMDLEN, DICT_BLOCKS_INDX_SIZE>(csec, pos, _blocks_tables[_bmap.get_dict(indx)]), RV32I_CMDLEN << 3);
+                break;
+            case encode_type::MASK_MULTI:
+                cmd.add(restore_value_mask_multi(csec, pos, _dict_values, MASK_MULTI_INDX_SIZE, MASK_MULTI_WINDOWS), RV32I_CMDLEN << 3);
+                break;
+            default:
+                throw std::runtime_error("Not yet supported encoding type");
+        }
+        return cmd;
+    }
+
+private:
+    template<size_t INDX_SIZE>
+    void read_hot_dictionary(const ELFIO::elfio *file)
+    {
+        dict_views dicts = get_dict_views(file);
+        _hot_values = read_hot_values(dicts);
+        if (!_hot_values.empty())
+            _dict_values = read_dict_values<RV32I_CMDLEN, INDX_SIZE>(dicts, ".dict");
+    }
+
+    encode_type _etype;
+    size_t _fixed_indx_size;
+    std::vector<huffman_table> _htabs;
+    std::vector<uint32_t> _dict_values, _hot_values;
+    std::optional<index_coding> _index_coding;     // DICT with .dict.idx
+    size_t _short_size { 0 };
+    encode_table<RV32I_CMDLEN, DICT_INDX_SIZE> _entab_dict;
+    encode_table<RV32I_CMDLEN, MASK_SINGLE_INDX_SIZE> _entab_single;
+    encode_table<RV32I_CMDLEN_H, MASK_DUO_INDX_SIZE> _entab_duo1, _entab_duo2;
+    std::array<encode_table<RV32I_CMDLEN_Q, MASK_QUAD_INDX_SIZE>, 4> _entabs_quad;
+    encode_table<RV32I_CMDLEN_O, MASK_OPERS_INDX_SIZE> _entab_operands;
+    encode_table<FIELDS_FUNCT_CMDLEN, FIELDS_FUNCT_INDX_SIZE> _entab_funct;
+    encode_table<FIELDS_REGS_CMDLEN, FIELDS_REGS_INDX_SIZE> _entab_regs;
+    encode_table<FIELDS_IMM_CMDLEN, FIELDS_IMM_INDX_SIZE> _entab_imm;
+    encode_table<RV32I_CMDLEN, FIXED_MAX_INDX_SIZE> _entab_fixed, _overflow_fixed;
+    block_map _bmap;
+    std::vector<uint32_t> _blocks_values;
+    std::vector<std::span<const uint32_t>> _blocks_tables;
+};
+
+// Coded DICT index depends on indices before it in line, so decoding starts
+// only from line start
+static bool has_coded_indices(const ELFIO::elfio *file)
+{
+    std::optional<index_predictor> predictor = read_index_predictor(get_dict_views(file));
+    return predictor && predictor->get_coding() != index_coding::FIXED;
+}
+
+// Bit position of the command at offset of original section or of the first
+// command of its line with number of commands to skip
+static bool locate_command(const ELFIO::elfio *file, const code_header &header, size_t offset, size_t &bitpos, size_t &skip_cnt)
+{
+    skip_cnt = 0;
+    if (header.etype == encode_type::FIXED16)
+    {
+        bitpos = offset / RV32I_CMDLEN * (header.parts[0].indx_size + 1);
+        return offset % RV32I_CMDLEN == 0;
+    }
+
+    addr_table atab = read_addr_dictionary(file);
+    if (has_coded_indices(file))
+        return atab.lookup_line(offset, bitpos, skip_cnt);
+    return atab.lookup(offset, bitpos) || atab.lookup_line(offset, bitpos, skip_cnt);
+}
+
+bool find_compressed_position(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, size_t &bitpos)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    if (addr < code_section->get_address() || code_section->get_size() == 0)
+        return false;
+
+    size_t header_size = 0;
+    code_header header = read_code_header(get_section_bytes(code_section), header_size);
+    size_t skip_cnt = 0;
+    return locate_command(file, header, addr - code_section->get_address(), bitpos, skip_cnt) && skip_cnt == 0;
+}
+
+fetch_decoder::fetch_decoder(const ELFIO::elfio *file)
+{
+    const ELFIO::section *code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+
+    code_header header;
+    _csec = get_compressed_section(get_section_bytes(code_section), header);
+    _etype = header.etype;
+    _fixed_indx_size = header.parts[0].indx_size;
+    _decoder = std::make_unique<section_decoder>(file, header);
+    if (_etype != encode_type::FIXED16)
+        _atab = read_addr_dictionary(file);
+    _line_starts = has_coded_indices(file);
+    _traces = trace_executable(file);
+    _text_addr = code_section->get_address();
+    _text_size = header.cmds_cnt * RV32I_CMDLEN;
+}
+
+fetch_decoder::~fetch_decoder() { }
+
+ELFIO::Elf64_Addr fetch_decoder::get_text_addr() const
+{
+    return _text_addr;
+}
+
+size_t fetch_decoder::get_text_size() const
+{
+    return _text_size;
+}
+
+std::vector<command> fetch_decoder::decode(ELFIO::Elf64_Addr addr, size_t cnt, block_trace &work) const
+{
+    if (addr < _text_addr || addr >= _text_addr + _text_size)
+        throw std::runtime_error("Address is out of code section");
+
+    size_t offset = addr - _text_addr;
+    size_t pos = 0, skip_cnt = 0;
+    if (_etype == encode_type::FIXED16)
+    {
+        if (offset % RV32I_CMDLEN != 0)
+            throw std::runtime_error("Address is out of code section");
+        pos = offset / RV32I_CMDLEN * (_fixed_indx_size + 1);
+    }
+    else if ((_line_starts || !_atab.lookup(offset, pos)) && !_atab.lookup_line(offset, pos, skip_cnt))
+    {
+        throw std::runtime_error("Address is out of code section");
+    }
+
+    std::vector<command> retval;
+    std::optional<index_predictor> predictor = _decoder->make_predictor();
+    size_t csec_end = _csec.get_data_sz_bits();
+    size_t indx = offset / RV32I_CMDLEN - skip_cnt;
+    for (size_t i = 0; i < skip_cnt + cnt && pos < csec_end; ++i, ++indx)
+    {
+        command cmd = _decoder->decode(_csec, pos, indx, predictor);
+        if (i >= skip_cnt)
+            retval.push_back(cmd);
+        if (indx < _traces.size())
+        {
+            work.bits += _traces[indx].bits;
+            work.dict_reads += _traces[indx].dict_reads;
+            work.dict_levels += _traces[indx].dict_levels;
+            work.mask_applies += _traces[indx].mask_applies;
+            work.entropy_symbols += _traces[indx].entropy_symbols;
+        }
+    }
+    return retval;
+}
+
+std::vector<command> decompress_commands_at(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, size_t cnt)
+{
+    block_trace work;
+    return fetch_decoder(file).decode(addr, cnt, work);
+}
+
+code_image compress_code(size_stat &szstat, std::vector<std::string> &dict_infos, std::span<const uint8_t> text, config cfg, const std::vector<size_t> &entry_points,
+    const std::vector<func_range> &functions)
+{
+    return rv32i_compress_code(szstat, dict_infos, text, cfg, entry_points, functions);
+}
+
+std::vector<uint8_t> decompress_code(std::span<const uint8_t> code, const dict_views &dicts, const config &cfg)
+{
+    return rv32i_decompress_code(code, dicts, cfg);
+}
+
+std::vector<uint8_t> decompress_function(std::span<const uint8_t> code, const dict_views &dicts, size_t offset, const config &cfg)
+{
+    return rv32i_decompress_function(code, dicts, offset, cfg);
+}
+
+std::vector<uint8_t> decompress_function(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, const config &cfg)
+{
+    ELFIO::section * code_section = get_section_with_name(file, ".text");
+    if (code_section == nullptr)
+        throw std::runtime_error("No code section in file");
+    if (addr < code_section->get_address())
+        throw std::runtime_error("Address is out of code section");
+
+    return rv32i_decompress_function(get_section_bytes(code_section), get_dict_views(file), addr - code_section->get_address(), cfg);
+}
+
 ELFIO::elfio* compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg)
 {
     ELFIO::Elf_Half machine = file->get_machine();
     switch (machine)
     {
         case ELFIO::EM_RISCV:
+            if (file->get_class() == ELFIO::ELFCLASS64)
+                return rv64i_compress_executable(szstat, dict_infos, file, cfg);
             return rv32i_compress_executable(szstat, dict_infos, file, cfg);
         default:
             throw std::runtime_error("Not supported machine type");
     }
 }
 
-ELFIO::elfio* decompress_executable(ELFIO::elfio *file)
+ELFIO::elfio* decompress_executable(ELFIO::elfio *file, const config &cfg)
 {
     ELFIO::Elf_Half machine = file->get_machine();
     switch (machine)
     {
         case ELFIO::EM_RISCV:
-            return rv32i_decompress_executable(file);
+            if (file->get_class() == ELFIO::ELFCLASS64)
+                return rv64i_decompress_executable(file, cfg);
+            return rv32i_decompress_executable(file, cfg);
         default:
             throw std::runtime_error("Not supported machine type");
     }
@@ -1,15 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <bit>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <thread>
 
 #include "elfio/elfio.hpp"
 
+#include "addr_table.h"
+#include "code_image.h"
+#include "codeword_map.h"
 #include "command.h"
 #include "compressed_section.h"
 #include "config.h"
 #include "dynbitset.h"
 #include "encode_table.h"
+#include "fetch_model.h"
+#include "func_table.h"
+#include "huffman_table.h"
+#include "memory_meter.h"
+#include "rv32i_format.h"
 #include "size_stat.h"
 
 namespace utils
@@ -22,33 +34,284 @@ enum class comp_cmd_type
     NOT
 };
 
+// Container independent codec of rv32i .text bytes. entry_points are offsets
+// reachable not only from the previous instruction (e.g. symbols) for
+// .dict.addr table, branch targets are found by the codec itself. Functions
+// get .dict.func table, so every one of them can be decoded alone.
+// ELF functions below are wrappers around these
+code_image compress_code(size_stat &szstat, std::vector<std::string> &dict_infos, std::span<const uint8_t> text, config cfg,
+    const std::vector<size_t> &entry_points = {}, const std::vector<func_range> &functions = {});
+std::vector<uint8_t> decompress_code(std::span<const uint8_t> code, const dict_views &dicts, const config &cfg = config());
+
+// Cheap check before decoding: header describes layout of this build, stream
+// and dictionaries have sizes and checksums recorded in it
+bool check_code(std::span<const uint8_t> code, const dict_views &dicts);
+
+// Original bytes of function containing offset of .text, needs .dict.func
+std::vector<uint8_t> decompress_function(std::span<const uint8_t> code, const dict_views &dicts, size_t offset, const config &cfg = config());
+
+// Empty if code was compressed without functions
+func_table get_func_table(const dict_views &dicts);
+
+// Views of .dict* sections of compressed file for decompress_code
+dict_views get_dict_views(const ELFIO::elfio *file);
+
 ELFIO::elfio *compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg);
-ELFIO::elfio *decompress_executable(ELFIO::elfio *file);
+// Only progress callback and cancel token of cfg are used
+ELFIO::elfio *decompress_executable(ELFIO::elfio *file, const config &cfg = config());
+// Function containing addr of compressed file, file is not changed
+std::vector<uint8_t> decompress_function(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, const config &cfg = config());
+
+// Per instruction decoder work of compressed file, input for simulate_fetch
+std::vector<block_trace> trace_executable(const ELFIO::elfio *file);
+
+// Codeword class, table index and bits of every instruction of compressed
+// file with functions of original .text
+codeword_map map_executable(const ELFIO::elfio *file);
+
+// Jumps into compressed code via .dict.addr table. Position is known exactly
+// for jump targets, other addresses are reached by decoding from line start.
+// With coded DICT indices only line starts are known
+bool find_compressed_position(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, size_t &bitpos);
+std::vector<command> decompress_commands_at(const ELFIO::elfio *file, ELFIO::Elf64_Addr addr, size_t cnt);
+
+class section_decoder;
+
+// Decoder of compressed file for fetch at arbitrary addresses, dictionaries
+// and .dict.addr table are read once
+class fetch_decoder
+{
+public:
+    explicit fetch_decoder(const ELFIO::elfio *file);
+    ~fetch_decoder();
+
+    // Original .text
+    ELFIO::Elf64_Addr get_text_addr() const;
+    size_t get_text_size() const;
+
+    // cnt commands from addr, fewer at the end of section. Work of every
+    // decoded command, also of skipped ones from line start, is added to work
+    std::vector<command> decode(ELFIO::Elf64_Addr addr, size_t cnt, block_trace &work) const;
+
+private:
+    encode_type _etype;
+    size_t _fixed_indx_size { 0 };  // FIXED16 codewords are indices of this width and a table bit
+    compressed_section _csec;
+    std::unique_ptr<section_decoder> _decoder;
+    addr_table _atab;
+    bool _line_starts { false };    // coded DICT indices, every decode starts from line start
+    std::vector<block_trace> _traces;
+    ELFIO::Elf64_Addr _text_addr { 0 };
+    size_t _text_size { 0 };
+};
 
 ELFIO::section *get_section_with_name(const ELFIO::elfio *file, const std::string &name);
 
-template<size_t CMDLEN, size_t INDX_SIZE>
-void dict_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<CMDLEN, INDX_SIZE> &entab)
+// Flat histogram keeps HISTOGRAM_WINDOW unsorted values besides counts
+const size_t HISTOGRAM_WINDOW = 1 << 16;
+
+// Counts of values sorted by value
+using flat_histogram = std::vector<std::pair<size_t, uint64_t>>;
+
+// Sorts window of (value, count) and merges its counts into hist, window is emptied
+void flat_histogram_merge(flat_histogram &hist, flat_histogram &window, memory_meter *meter);
+
+// Histogram threads get at least HISTOGRAM_THREAD_CMDS commands each
+const size_t HISTOGRAM_THREAD_CMDS = 1 << 14;
+
+// Threads of dict_make_encode_table for cmds_cnt commands, at least 1. With
+// memory budget every thread's window has to fit it
+size_t histogram_threads(const config &cfg, size_t cmds_cnt);
+
+// Flat histogram of parts of commands [first, last) counted by windows,
+// width of parts goes to part_bits. Runs on histogram threads: commands are
+// added to processed once per PROGRESS_STEP, counting stops when cancelled
+// is set and the histogram is left incomplete
+template<typename PART>
+flat_histogram flat_histogram_count(const std::vector<command> &commands, size_t first, size_t last, std::span<const uint64_t> exec_counts, PART part, size_t &part_bits,
+    std::atomic<size_t> &processed, const std::atomic<bool> &cancelled)
 {
-    std::map<command, unsigned int> data;
+    flat_histogram hist, window;
+    size_t window_size = std::min(HISTOGRAM_WINDOW, last - first);
+    window.reserve(window_size);
+    size_t reported = first;
+    for (size_t i = first; i < last; ++i)
+    {
+        if (i - reported == PROGRESS_STEP)
+        {
+            processed.fetch_add(PROGRESS_STEP);
+            processed.notify_one();
+            reported = i;
+            if (cancelled.load(std::memory_order_relaxed))
+                return hist;
+        }
 
-    for (auto command : commands) {
-        if (data.find(command) != data.end())
-            data[command]++;
-        else
-            data[command] = 1;
+        command cmd;
+        if (!part(commands[i], cmd))
+            continue;
+        part_bits = cmd.get_data_sz_bits();
+        window.emplace_back(cmd.to_size_t(), i < exec_counts.size() ? 1 + exec_counts[i] : 1);
+        if (window.size() == window_size)
+            flat_histogram_merge(hist, window, nullptr);
+    }
+    if (!window.empty())
+        flat_histogram_merge(hist, window, nullptr);
+    processed.fetch_add(last - reported);
+    processed.notify_one();
+    return hist;
+}
+
+// Counts part of every command, part(cmd, out) returns false if cmd has no
+// such part. Command i counts 1 + its execution count if config has them.
+// Histogram is std::map until it exceeds memory budget, then it is moved to
+// flat sorted windows if they are smaller. With several histogram threads
+// every one counts flat windows of its range of commands, then their
+// histograms are merged in order. All of them give the same dictionary:
+// the most frequent parts, ties go to smaller value. Dictionary has up to
+// 2^INDX_SIZE entries or max_entries if it's less
+template<size_t CMDLEN, size_t INDX_SIZE, typename PART>
+void dict_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<CMDLEN, INDX_SIZE> &entab, memory_meter *meter, PART part, size_t max_entries = SIZE_MAX)
+{
+    if (meter != nullptr)
+        meter->set_phase(progress_phase::HISTOGRAM);
+
+    size_t window_size = std::min(HISTOGRAM_WINDOW, commands.size());
+    std::span<const uint64_t> exec_counts = cfg.get_exec_counts();
+    bool flat = false;
+
+    std::map<command, uint64_t> data;
+    flat_histogram hist;
+    size_t part_bits = 0;
+    memory_scope hist_memory(meter, 0);
+    size_t threads = histogram_threads(cfg, commands.size());
+    if (threads > 1)
+    {
+        std::vector<flat_histogram> hists(threads);
+        std::vector<size_t> bits(threads, 0);
+        std::atomic<size_t> processed(0);
+        std::atomic<bool> cancelled(false);
+        memory_scope windows_memory(meter, threads * window_size * sizeof(flat_histogram::value_type));
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                size_t first = commands.size() * t / threads, last = commands.size() * (t + 1) / threads;
+                hists[t] = flat_histogram_count(commands, first, last, exec_counts, part, bits[t], processed, cancelled);
+            });
+        }
+
+        // Calling thread reports progress while histograms are counted and
+        // stops them if operation is cancelled
+        try
+        {
+            for (size_t done = 0; done < commands.size(); done = processed.load())
+            {
+                cfg.report_progress(progress_phase::HISTOGRAM, done, commands.size());
+                processed.wait(done);
+            }
+        }
+        catch (...)
+        {
+            cancelled.store(true, std::memory_order_relaxed);
+            for (auto &worker : workers)
+                worker.join();
+            throw;
+        }
+        for (auto &worker : workers)
+            worker.join();
+        windows_memory.resize(0);
+
+        size_t hists_size = 0;
+        for (const auto &thread_hist : hists)
+            hists_size += thread_hist.size();
+        memory_scope hists_memory(meter, hists_size * sizeof(flat_histogram::value_type));
+        for (size_t t = 0; t < threads; ++t)
+        {
+            part_bits = std::max(part_bits, bits[t]);
+            flat_histogram_merge(hist, hists[t], meter);
+            flat_histogram().swap(hists[t]);
+        }
+        flat = true;
+    }
+    else
+    {
+        flat_histogram window;
+        memory_scope window_memory(meter, 0);
+
+        for (size_t i = 0; i < commands.size(); ++i) {
+            if (i % PROGRESS_STEP == 0)
+                cfg.report_progress(progress_phase::HISTOGRAM, i, commands.size());
+
+            command cmd;
+            if (!part(commands[i], cmd))
+                continue;
+            uint64_t weight = i < exec_counts.size() ? 1 + exec_counts[i] : 1;
+
+            if (flat) {
+                window.emplace_back(cmd.to_size_t(), weight);
+                if (window.size() == window_size)
+                {
+                    flat_histogram_merge(hist, window, meter);
+                    hist_memory.resize(hist.size() * sizeof(flat_histogram::value_type));
+                }
+                continue;
+            }
+
+            auto it = data.find(cmd);
+            if (it != data.end()) {
+                it->second += weight;
+                continue;
+            }
+            data[cmd] = weight;
+
+            size_t map_memory = data.size() * histogram_node_memory(CMDLEN);
+            size_t flat_memory = (window_size + 2 * data.size()) * sizeof(flat_histogram::value_type);
+            size_t allocated = meter != nullptr ? meter->get_allocated() : map_memory;
+            hist_memory.resize(map_memory);
+            if (cfg.get_memory_budget() == 0 || allocated <= cfg.get_memory_budget() || flat_memory >= map_memory)
+                continue;
+
+            // Map is ordered by command value, so it is a flat histogram already
+            {
+                memory_scope moved_memory(meter, data.size() * sizeof(flat_histogram::value_type));
+                hist.reserve(data.size());
+                for (const auto &p : data)
+                    hist.emplace_back(p.first.to_size_t(), p.second);
+                data.clear();
+            }
+            hist_memory.resize(hist.size() * sizeof(flat_histogram::value_type));
+            part_bits = cmd.get_data_sz_bits();
+            window.reserve(window_size);
+            window_memory.resize(window_size * sizeof(flat_histogram::value_type));
+            flat = true;
+        }
+        if (flat)
+            flat_histogram_merge(hist, window, meter);
     }
+    hist_memory.resize(flat ? hist.size() * sizeof(flat_histogram::value_type) : data.size() * histogram_node_memory(CMDLEN));
+    cfg.report_progress(progress_phase::HISTOGRAM, commands.size(), commands.size());
 
-    std::vector<std::pair<command, unsigned int>> most_freq_commands;
+    if (meter != nullptr)
+        meter->set_phase(progress_phase::DICTIONARY);
+
+    // Ties are ordered by value, so every histogram gives the same entries
+    std::vector<std::pair<command, uint64_t>> most_freq_commands;
+    memory_scope sorted_memory(meter, (flat ? hist.size() : data.size()) * (sizeof(std::pair<command, uint64_t>) + CMDLEN));
     for (auto p : data)
         most_freq_commands.push_back(p);
-    std::sort(most_freq_commands.begin(), most_freq_commands.end(),
-              [](std::pair<command, unsigned int> p1, std::pair<command, unsigned int> p2)
-              { return p1.second > p2.second; });
+    for (auto p : hist)
+    {
+        command cmd;
+        cmd.add(p.first, part_bits);
+        most_freq_commands.emplace_back(cmd, p.second);
+    }
+    size_t max_entab_size = std::min({ (size_t)1 << INDX_SIZE, max_entries, most_freq_commands.size() });
+    std::partial_sort(most_freq_commands.begin(), most_freq_commands.begin() + max_entab_size, most_freq_commands.end(),
+              [](const std::pair<command, uint64_t> &p1, const std::pair<command, uint64_t> &p2)
+              { return p1.second != p2.second ? p1.second > p2.second : p1.first < p2.first; });
 
     std::vector<command> entab_entries;
-    size_t max_entab_size = (1 << INDX_SIZE);
-    for (size_t i = 0; i < max_entab_size && i < most_freq_commands.size(); ++i)
+    for (size_t i = 0; i < max_entab_size; ++i)
     {
         entab_entries.push_back(most_freq_commands[i].first);
     }
@@ -56,6 +319,15 @@ void dict_make_encode_table(const std::vector<command> &commands, const config &
     entab = encode_table<CMDLEN, INDX_SIZE>(entab_entries);
 }
 
+template<size_t CMDLEN, size_t INDX_SIZE>
+void dict_make_encode_table(const std::vector<command> &commands, const config &cfg, encode_table<CMDLEN, INDX_SIZE> &entab, memory_meter *meter = nullptr, size_t max_entries = SIZE_MAX)
+{
+    dict_make_encode_table(commands, cfg, entab, meter, [](const command &cmd, command &part) {
+        part = cmd;
+        return true;
+    }, max_entries);
+}
+
 
 static bool find_single_missmatch(size_t &missmatch_pos, size_t poscnt, size_t mask_size, const command &entry, const command &cmd)
 {
@@ -268,4 +540,286 @@ command restore_block_dict(const compressed_section &csec, size_t &pos, const en
     return cmd;
 }
 
+// Entropy coded variants: dictionary index and codeword class are merged into
+// one huffman symbol: [0, entries_cnt) - index, entries_cnt - mask, next - literal
+template<size_t CMDLEN, size_t INDX_SIZE>
+command restore_block_dict_entropy(const compressed_section &csec, size_t &pos, const encode_table<CMDLEN, INDX_SIZE> &entab, const huffman_table &htab)
+{
+    command cmd;
+    size_t sym = htab.decode(csec, pos);
+    if (sym < entab.get_entries_cnt())
+    {
+        cmd = entab[sym];
+    }
+    else
+    {
+        constexpr size_t cmdlen_bits = CMDLEN << 3;
+        cmd.add(csec.getbits(pos, cmdlen_bits), cmdlen_bits);
+        pos += cmdlen_bits;
+    }
+
+    return cmd;
+}
+
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE, size_t INDX_SIZE>
+command restore_block_mask_entropy(const compressed_section &csec, size_t &pos, const encode_table<CMDLEN, INDX_SIZE> &entab, const huffman_table &htab, const huffman_table &mask_htab)
+{
+    command cmd;
+    size_t sym = htab.decode(csec, pos);
+    if (sym < entab.get_entries_cnt())
+    {
+        cmd = entab[sym];
+    }
+    else if (sym == entab.get_entries_cnt())
+    {
+        size_t mask_pos = csec.getbits(pos, POS_SIZE);
+        pos += POS_SIZE;
+        size_t mask = csec.getbits(pos, MASK_SIZE);
+        pos += MASK_SIZE;
+        size_t indx = mask_htab.decode(csec, pos);
+
+        cmd = entab[indx];
+        for (size_t j = 0; j < MASK_SIZE; ++j)
+        {
+            cmd.setbit((mask_pos * MASK_SIZE) + j, (mask >> j) & 0x1);
+        }
+    }
+    else
+    {
+        constexpr size_t cmdlen_bits = CMDLEN << 3;
+        cmd.add(csec.getbits(pos, cmdlen_bits), cmdlen_bits);
+        pos += cmdlen_bits;
+    }
+
+    return cmd;
+}
+
+// Allocation free decoders: dictionary entries as integers, restored command
+// is returned as value with bit j = bit j of command
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE, size_t INDX_SIZE>
+uint32_t restore_value_mask(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values)
+{
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    uint32_t value = 0;
+    if (csec.getbit(pos++))
+    {
+        if (!csec.getbit(pos++))
+        {
+            size_t mask_pos = csec.getbits(pos, POS_SIZE);
+            pos += POS_SIZE;
+            uint32_t mask = csec.getbits(pos, MASK_SIZE);
+            pos += MASK_SIZE;
+            size_t indx = csec.getbits(pos, INDX_SIZE);
+            pos += INDX_SIZE;
+
+            size_t shift = mask_pos * MASK_SIZE;
+            uint32_t field = (((uint32_t)1 << MASK_SIZE) - 1) << shift;
+            value = (values.at(indx) & ~field) | ((mask << shift) & field);
+        }
+        else
+        {
+            value = values.at(csec.getbits(pos, INDX_SIZE));
+            pos += INDX_SIZE;
+        }
+    }
+    else
+    {
+        value = csec.getbits(pos, cmdlen_bits);
+        pos += cmdlen_bits;
+    }
+
+    return value;
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+uint32_t restore_value_dict(const compressed_section &csec, size_t &pos, std::span<const uint32_t> values)
+{
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    uint32_t value = 0;
+    if (csec.getbit(pos++))
+    {
+        size_t indx = csec.getbits(pos, INDX_SIZE);
+        pos += INDX_SIZE;
+        if (indx >= values.size())
+            throw std::runtime_error("Dictionary index is out of range");
+        value = values[indx];
+    }
+    else
+    {
+        value = csec.getbits(pos, cmdlen_bits);
+        pos += cmdlen_bits;
+    }
+
+    return value;
+}
+
+// Index of two-level dictionary: 1 and position in hot table or 0 and index
+// of the whole dictionary. Hot table has at least 2 entries
+template<size_t INDX_SIZE>
+uint32_t restore_tiered_value(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const std::vector<uint32_t> &hot_values)
+{
+    if (csec.getbit(pos++))
+    {
+        size_t hot_indx_size = std::bit_width(hot_values.size() - 1);
+        size_t hot_indx = csec.getbits(pos, hot_indx_size);
+        pos += hot_indx_size;
+        return hot_values.at(hot_indx);
+    }
+
+    size_t indx = csec.getbits(pos, INDX_SIZE);
+    pos += INDX_SIZE;
+    return values.at(indx);
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+uint32_t restore_value_dict_hot(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const std::vector<uint32_t> &hot_values)
+{
+    if (csec.getbit(pos++))
+        return restore_tiered_value<INDX_SIZE>(csec, pos, values, hot_values);
+
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    uint32_t value = csec.getbits(pos, cmdlen_bits);
+    pos += cmdlen_bits;
+    return value;
+}
+
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE, size_t INDX_SIZE>
+uint32_t restore_value_mask_hot(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const std::vector<uint32_t> &hot_values)
+{
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    if (!csec.getbit(pos++))
+    {
+        uint32_t value = csec.getbits(pos, cmdlen_bits);
+        pos += cmdlen_bits;
+        return value;
+    }
+
+    if (csec.getbit(pos++))
+        return restore_tiered_value<INDX_SIZE>(csec, pos, values, hot_values);
+
+    size_t mask_pos = csec.getbits(pos, POS_SIZE);
+    pos += POS_SIZE;
+    uint32_t mask = csec.getbits(pos, MASK_SIZE);
+    pos += MASK_SIZE;
+
+    size_t shift = mask_pos * MASK_SIZE;
+    uint32_t field = (((uint32_t)1 << MASK_SIZE) - 1) << shift;
+    return (restore_tiered_value<INDX_SIZE>(csec, pos, values, hot_values) & ~field) | ((mask << shift) & field);
+}
+
+template<size_t CMDLEN>
+uint32_t restore_value_dict_entropy(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const huffman_table &htab)
+{
+    size_t sym = htab.decode(csec, pos);
+    if (sym < values.size())
+        return values[sym];
+
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    uint32_t value = csec.getbits(pos, cmdlen_bits);
+    pos += cmdlen_bits;
+    return value;
+}
+
+template<size_t CMDLEN, size_t POS_SIZE, size_t MASK_SIZE>
+uint32_t restore_value_mask_entropy(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, const huffman_table &htab, const huffman_table &mask_htab)
+{
+    size_t sym = htab.decode(csec, pos);
+    if (sym < values.size())
+        return values[sym];
+
+    if (sym == values.size())
+    {
+        size_t mask_pos = csec.getbits(pos, POS_SIZE);
+        pos += POS_SIZE;
+        uint32_t mask = csec.getbits(pos, MASK_SIZE);
+        pos += MASK_SIZE;
+        size_t indx = mask_htab.decode(csec, pos);
+
+        size_t shift = mask_pos * MASK_SIZE;
+        uint32_t field = (((uint32_t)1 << MASK_SIZE) - 1) << shift;
+        return (values.at(indx) & ~field) | ((mask << shift) & field);
+    }
+
+    constexpr size_t cmdlen_bits = CMDLEN << 3;
+    uint32_t value = csec.getbits(pos, cmdlen_bits);
+    pos += cmdlen_bits;
+    return value;
+}
+
+// Fixed width codeword: top bit selects dictionary or overflow table, the
+// rest is an index of indx_size bits, it's up to INDX_SIZE and recorded in
+// code header. Instruction i starts at bit i * (indx_size + 1)
+template<size_t CMDLEN, size_t INDX_SIZE>
+command restore_block_fixed(const compressed_section &csec, size_t &pos, const encode_table<CMDLEN, INDX_SIZE> &entab, const encode_table<CMDLEN, INDX_SIZE> &overflow, size_t indx_size = INDX_SIZE)
+{
+    size_t codeword = csec.getbits(pos, indx_size + 1);
+    pos += indx_size + 1;
+
+    size_t indx = codeword & (((size_t)1 << indx_size) - 1);
+    const encode_table<CMDLEN, INDX_SIZE> &table = (codeword >> indx_size) != 0 ? overflow : entab;
+    if (indx >= table.get_entries_cnt())
+        throw std::runtime_error("Bad fixed codeword in compressed section");
+    return table[indx];
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+command compress_field_with_dictionary(const encode_table<CMDLEN, INDX_SIZE> &entab, uint32_t value, size_t literal_bits)
+{
+    command field;
+    field.add(value, CMDLEN << 3);
+
+    command ccmd;
+    int indx = 0;
+    if ((indx = entab.find(field)) != -1)
+    {
+        ccmd.add(true);
+        ccmd.add(indx, INDX_SIZE);
+    }
+    else
+    {
+        ccmd.add(false);
+        ccmd.add(value, literal_bits);
+    }
+
+    return ccmd;
+}
+
+template<size_t CMDLEN, size_t INDX_SIZE>
+uint32_t restore_field(const compressed_section &csec, size_t &pos, const encode_table<CMDLEN, INDX_SIZE> &entab, size_t literal_bits)
+{
+    uint32_t value = 0;
+    bool cbit = csec.getbit(pos++);
+    if (cbit == true)
+    {
+        dynbitset indx_bitset = csec.getseq(pos, pos + INDX_SIZE);
+        pos += INDX_SIZE;
+        value = entab[indx_bitset.to_size_t()].to_size_t();
+    }
+    else
+    {
+        value = csec.getseq(pos, pos + literal_bits).to_size_t();
+        pos += literal_bits;
+    }
+
+    return value;
+}
+
+template<size_t INDX_SIZE>
+uint32_t restore_field_value(const compressed_section &csec, size_t &pos, const std::vector<uint32_t> &values, size_t literal_bits)
+{
+    uint32_t value = 0;
+    if (csec.getbit(pos++))
+    {
+        value = values.at(csec.getbits(pos, INDX_SIZE));
+        pos += INDX_SIZE;
+    }
+    else
+    {
+        value = csec.getbits(pos, literal_bits);
+        pos += literal_bits;
+    }
+
+    return value;
+}
+
 }
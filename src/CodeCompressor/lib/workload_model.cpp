@@ -0,0 +1,232 @@
+#include "workload_model.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "elfio/elfio.hpp"
+
+#include "rv32i_format.h"
+
+namespace utils
+{
+
+const size_t WORKLOAD_INSTR_SIZE = 4;
+const uint32_t WORKLOAD_RET = 0x00008067;   // jalr x0, 0(ra)
+const ELFIO::Elf64_Addr WORKLOAD_TEXT_ADDR = 0x10000;
+
+static uint32_t load_instruction(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const rv32i_layout &instruction_layout(uint32_t instr)
+{
+    return rv32i_get_layout(rv32i_get_format(instr));
+}
+
+static uint64_t context_key(uint32_t prev2, uint32_t prev1)
+{
+    return ((uint64_t)prev2 << 32) | prev1;
+}
+
+void workload_model::learn(std::span<const uint8_t> text)
+{
+    bool has_prev1 = false, has_prev2 = false;
+    uint32_t prev1 = 0, prev2 = 0;
+    for (size_t i = 0; i + WORKLOAD_INSTR_SIZE <= text.size(); i += WORKLOAD_INSTR_SIZE)
+    {
+        uint32_t instr = load_instruction(text.data() + i);
+        const rv32i_layout &layout = instruction_layout(instr);
+        uint32_t cls = instr & layout.funct_mask;
+
+        _order0[cls]++;
+        if (has_prev1)
+            _order1[prev1][cls]++;
+        if (has_prev2)
+            _order2[context_key(prev2, prev1)][cls]++;
+
+        // Fields are kept in place, instruction is their bitwise or
+        class_fields &fields = _fields[cls];
+        fields.regs[instr & layout.regs_mask]++;
+        fields.imm[instr & layout.imm_mask]++;
+        fields.raw[instr & layout.raw_mask]++;
+
+        prev2 = prev1;
+        prev1 = cls;
+        has_prev2 = has_prev1;
+        has_prev1 = true;
+        _learned_cnt++;
+    }
+}
+
+size_t workload_model::get_learned_cnt() const
+{
+    return _learned_cnt;
+}
+
+size_t workload_model::get_class_cnt() const
+{
+    return _order0.size();
+}
+
+// Values with cumulative counts, sampled by binary search
+class value_sampler
+{
+public:
+    value_sampler() = default;
+
+    explicit value_sampler(const std::map<uint32_t, uint64_t> &counts)
+    {
+        uint64_t total = 0;
+        for (const auto &p : counts)
+        {
+            total += p.second;
+            _values.push_back(p.first);
+            _cumulative.push_back(total);
+        }
+    }
+
+    bool empty() const
+    {
+        return _values.empty();
+    }
+
+    uint32_t sample(std::mt19937_64 &rng) const
+    {
+        // mt19937_64 output is fixed by the standard, distributions aren't
+        uint64_t u = rng() % _cumulative.back();
+        size_t indx = std::upper_bound(_cumulative.begin(), _cumulative.end(), u) - _cumulative.begin();
+        return _values[indx];
+    }
+
+private:
+    std::vector<uint32_t> _values;
+    std::vector<uint64_t> _cumulative;
+};
+
+// Chain counts with classes replaced by their numbers
+static std::map<uint32_t, uint64_t> class_numbers(const std::map<uint32_t, uint64_t> &counts, const std::map<uint32_t, size_t> &class_indx)
+{
+    std::map<uint32_t, uint64_t> numbered;
+    for (const auto &p : counts)
+        numbered[class_indx.at(p.first)] = p.second;
+    return numbered;
+}
+
+std::vector<uint8_t> workload_model::generate(size_t text_size, uint64_t seed) const
+{
+    if (_learned_cnt == 0)
+        throw std::runtime_error("Workload model has no instructions");
+
+    // Classes are numbered to keep chains in flat tables
+    std::vector<uint32_t> classes;
+    std::map<uint32_t, size_t> class_indx;
+    for (const auto &p : _order0)
+    {
+        class_indx[p.first] = classes.size();
+        classes.push_back(p.first);
+    }
+    size_t class_cnt = classes.size();
+
+    value_sampler order0(class_numbers(_order0, class_indx));
+    std::vector<value_sampler> order1(class_cnt);
+    for (const auto &p : _order1)
+        order1[class_indx[p.first]] = value_sampler(class_numbers(p.second, class_indx));
+    std::vector<value_sampler> order2(class_cnt * class_cnt);
+    for (const auto &p : _order2)
+        order2[class_indx[p.first >> 32] * class_cnt + class_indx[(uint32_t)p.first]] = value_sampler(class_numbers(p.second, class_indx));
+
+    std::vector<value_sampler> regs(class_cnt), imm(class_cnt), raw(class_cnt);
+    for (const auto &p : _fields)
+    {
+        size_t indx = class_indx[p.first];
+        regs[indx] = value_sampler(p.second.regs);
+        imm[indx] = value_sampler(p.second.imm);
+        raw[indx] = value_sampler(p.second.raw);
+    }
+
+    std::mt19937_64 rng(seed);
+    size_t instr_cnt = text_size / WORKLOAD_INSTR_SIZE;
+    std::vector<uint8_t> text(instr_cnt * WORKLOAD_INSTR_SIZE);
+
+    bool has_prev1 = false, has_prev2 = false;
+    size_t prev1 = 0, prev2 = 0;
+    for (size_t i = 0; i < instr_cnt; ++i)
+    {
+        const value_sampler *chain = &order0;
+        if (has_prev2 && !order2[prev2 * class_cnt + prev1].empty())
+            chain = &order2[prev2 * class_cnt + prev1];
+        else if (has_prev1 && !order1[prev1].empty())
+            chain = &order1[prev1];
+
+        size_t cls = chain->sample(rng);
+        uint32_t instr = classes[cls] | regs[cls].sample(rng) | imm[cls].sample(rng) | raw[cls].sample(rng);
+        for (size_t j = 0; j < WORKLOAD_INSTR_SIZE; ++j)
+            text[i * WORKLOAD_INSTR_SIZE + j] = (instr >> (j * 8)) & 0xff;
+
+        prev2 = prev1;
+        prev1 = cls;
+        has_prev2 = has_prev1;
+        has_prev1 = true;
+    }
+
+    return text;
+}
+
+void workload_write_elf(const std::string &path, std::span<const uint8_t> text)
+{
+    ELFIO::elfio writer;
+    writer.create(ELFIO::ELFCLASS32, ELFIO::ELFDATA2LSB);
+    writer.set_os_abi(ELFIO::ELFOSABI_NONE);
+    writer.set_type(ELFIO::ET_EXEC);
+    writer.set_machine(ELFIO::EM_RISCV);
+
+    ELFIO::section *text_sec = writer.sections.add(".text");
+    text_sec->set_type(ELFIO::SHT_PROGBITS);
+    text_sec->set_flags(ELFIO::SHF_ALLOC | ELFIO::SHF_EXECINSTR);
+    text_sec->set_addr_align(WORKLOAD_INSTR_SIZE);
+    text_sec->set_address(WORKLOAD_TEXT_ADDR);
+    text_sec->set_data((const char *)text.data(), text.size());
+
+    ELFIO::section *str_sec = writer.sections.add(".strtab");
+    str_sec->set_type(ELFIO::SHT_STRTAB);
+
+    ELFIO::section *sym_sec = writer.sections.add(".symtab");
+    sym_sec->set_type(ELFIO::SHT_SYMTAB);
+    sym_sec->set_info(1);
+    sym_sec->set_addr_align(4);
+    sym_sec->set_entry_size(writer.get_default_entry_size(ELFIO::SHT_SYMTAB));
+    sym_sec->set_link(str_sec->get_index());
+
+    ELFIO::string_section_accessor strings(str_sec);
+    ELFIO::symbol_section_accessor symbols(writer, sym_sec);
+    std::vector<size_t> func_starts;
+    for (size_t i = 0; i + WORKLOAD_INSTR_SIZE <= text.size(); i += WORKLOAD_INSTR_SIZE)
+    {
+        if (i == 0 || load_instruction(text.data() + i - WORKLOAD_INSTR_SIZE) == WORKLOAD_RET)
+            func_starts.push_back(i);
+    }
+    for (size_t i = 0; i < func_starts.size(); ++i)
+    {
+        size_t func_end = i + 1 < func_starts.size() ? func_starts[i + 1] : text.size();
+        std::string name = "f" + std::to_string(i);
+        symbols.add_symbol(strings, name.c_str(), WORKLOAD_TEXT_ADDR + func_starts[i], func_end - func_starts[i],
+            ELFIO::STB_GLOBAL, ELFIO::STT_FUNC, 0, text_sec->get_index());
+    }
+
+    ELFIO::segment *text_seg = writer.segments.add();
+    text_seg->set_type(ELFIO::PT_LOAD);
+    text_seg->set_virtual_address(WORKLOAD_TEXT_ADDR);
+    text_seg->set_physical_address(WORKLOAD_TEXT_ADDR);
+    text_seg->set_flags(ELFIO::PF_X | ELFIO::PF_R);
+    text_seg->set_align(0x1000);
+    text_seg->add_section(text_sec, text_sec->get_addr_align());
+
+    writer.set_entry(WORKLOAD_TEXT_ADDR);
+
+    if (!writer.save(path))
+        throw std::runtime_error("Can't write ELF file " + path);
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace utils
+{
+
+// Instruction statistics of rv32i .text sections for synthetic workloads.
+// Instruction class is its funct bits (opcode, funct3, funct7), classes
+// follow order-2 chain with fallback to shorter contexts. Registers,
+// immediates and raw bits are sampled per class, independently of each other
+class workload_model
+{
+public:
+    // Adds instructions of text, the tail shorter than an instruction is ignored
+    void learn(std::span<const uint8_t> text);
+
+    size_t get_learned_cnt() const;
+    size_t get_class_cnt() const;
+
+    // text_size bytes of instructions, rounded down to whole instructions.
+    // Same model and seed give the same text
+    std::vector<uint8_t> generate(size_t text_size, uint64_t seed) const;
+
+private:
+    struct class_fields
+    {
+        std::map<uint32_t, uint64_t> regs;
+        std::map<uint32_t, uint64_t> imm;
+        std::map<uint32_t, uint64_t> raw;
+    };
+
+    size_t _learned_cnt { 0 };
+    std::map<uint32_t, uint64_t> _order0;
+    std::map<uint32_t, std::map<uint32_t, uint64_t>> _order1;
+    std::map<uint64_t, std::map<uint32_t, uint64_t>> _order2;
+    std::map<uint32_t, class_fields> _fields;
+};
+
+// Executable rv32 ELF with text as its .text section and entry at its start.
+// Function symbols start at text begin and after every return
+void workload_write_elf(const std::string &path, std::span<const uint8_t> text);
+
+}
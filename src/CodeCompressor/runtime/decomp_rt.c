@@ -0,0 +1,895 @@
+#include "decomp_rt.h"
+
+/* Codeword widths come from the header, the rest must match lib/utils.cpp */
+#define RV32I_CMDLEN_BITS 32
+
+#define FIELDS_FUNCT_BITS 17
+
+#define HEADER_VERSION 1
+#define HEADER_MIN_SIZE 19     /* without parts and dictionaries */
+#define HUFF_MAX_CODE_LEN 15
+
+/* index_coding of lib/config.h, predictor is reset every line of .dict.addr */
+#define INDEX_CODING_FIXED 0
+#define INDEX_CODING_DELTA 1
+#define INDEX_CODING_MTF 2
+#define INDEX_SHORT_MAX_SIZE 6
+#define INDEX_LINE_CMDS 16
+
+/* LSB first bitstream as dynbitset, errors are sticky */
+struct drt_bits
+{
+    const uint8_t *data;
+    size_t bits;
+    size_t pos;
+    int err;
+};
+
+/* Canonical huffman decoder, symbols sorted by code length live in work */
+struct drt_huff
+{
+    const uint32_t *sorted_syms;
+    uint32_t syms_cnt;
+    uint32_t lens_cnt[HUFF_MAX_CODE_LEN + 1];
+    uint32_t first_code[HUFF_MAX_CODE_LEN + 1];
+    uint32_t first_indx[HUFF_MAX_CODE_LEN + 1];
+};
+
+static uint32_t get_bits(struct drt_bits *in, unsigned cnt)
+{
+    if (in->pos + cnt > in->bits)
+    {
+        in->err = DRT_ERR_TRUNCATED;
+        in->pos = in->bits;
+        return 0;
+    }
+
+    /* 32 bit arithmetic only, rv32i has no 64 bit shifts */
+    const uint8_t *p = in->data + (in->pos >> 3);
+    unsigned shift = in->pos & 0x7;
+    unsigned bytes = (shift + cnt + 7) >> 3;
+    uint32_t window = 0;
+    for (unsigned i = 0; i < bytes && i < 4; ++i)
+        window |= (uint32_t)p[i] << (i * 8);
+    window >>= shift;
+    if (bytes > 4)
+        window |= (uint32_t)p[4] << (32 - shift);
+
+    in->pos += cnt;
+    return cnt < 32 ? window & (((uint32_t)1 << cnt) - 1) : window;
+}
+
+static uint32_t get_bit(struct drt_bits *in)
+{
+    return get_bits(in, 1);
+}
+
+static uint32_t load_le(const uint8_t *p, unsigned bytes)
+{
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bytes; ++i)
+        value |= (uint32_t)p[i] << (i * 8);
+    return value;
+}
+
+static uint32_t dict_entry(struct drt_bits *in, const struct drt_blob *dict, unsigned cmdlen, uint32_t indx)
+{
+    if ((size_t)indx >= dict->size / cmdlen)
+    {
+        in->err = DRT_ERR_BAD_CODEWORD;
+        return 0;
+    }
+    return load_le(dict->data + (size_t)indx * cmdlen, cmdlen);
+}
+
+/* Flag 1: 1 - dictionary index, 0 - mask, position and index. Flag 0: literal */
+static uint32_t mask_value(struct drt_bits *in, const struct drt_blob *dict, const struct drt_part *p)
+{
+    if (!get_bit(in))
+        return get_bits(in, p->cmdlen * 8);
+
+    if (get_bit(in))
+        return dict_entry(in, dict, p->cmdlen, get_bits(in, p->indx_size));
+
+    uint32_t mask_pos = get_bits(in, p->pos_size);
+    uint32_t mask = get_bits(in, p->mask_size);
+    uint32_t value = dict_entry(in, dict, p->cmdlen, get_bits(in, p->indx_size));
+    unsigned shift = mask_pos * p->mask_size;
+    uint32_t field = (((uint32_t)1 << p->mask_size) - 1) << shift;
+    return (value & ~field) | ((mask << shift) & field);
+}
+
+int drt_decode_dict(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    const struct drt_blob *dict = &img->dicts[DRT_DICT];
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if (get_bit(in))
+            out[i] = dict_entry(in, dict, 4, get_bits(in, hdr->parts[0].indx_size));
+        else
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+    }
+    return in->err;
+}
+
+int drt_decode_mask_single(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+        out[i] = mask_value(in, &img->dicts[DRT_DICT], &hdr->parts[0]);
+    return in->err;
+}
+
+/* Two-level dictionary index. Flag 1: position in .dict.hot of hot_size bits, 0: index of .dict */
+static uint32_t tiered_entry(struct drt_bits *in, const struct drt_image *img, unsigned hot_size, unsigned indx_size)
+{
+    if (get_bit(in))
+        return dict_entry(in, &img->dicts[DRT_DICT_HOT], 4, get_bits(in, hot_size));
+    return dict_entry(in, &img->dicts[DRT_DICT], 4, get_bits(in, indx_size));
+}
+
+/* Bits of position in hot table, it has at least 2 entries */
+static unsigned hot_indx_size(const struct drt_image *img)
+{
+    size_t entries = img->dicts[DRT_DICT_HOT].size / 4;
+    unsigned bits = 1;
+    while (((size_t)1 << bits) < entries)
+        bits++;
+    return bits;
+}
+
+int drt_decode_dict_hot(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    unsigned hot_size = hot_indx_size(img);
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if (get_bit(in))
+            out[i] = tiered_entry(in, img, hot_size, hdr->parts[0].indx_size);
+        else
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+    }
+    return in->err;
+}
+
+/*
+ * .dict.idx: u8 dictionary order, u8 index coding, u8 bits of short code.
+ * Flag 1: short code, 0: index of .dict, FIXED has no flag. DELTA code is
+ * difference from the previous index, MTF code is position in the list of
+ * recently used indices
+ */
+int drt_decode_dict_coded(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, size_t first, uint32_t *out, size_t cnt)
+{
+    const struct drt_blob *idx = &img->dicts[DRT_DICT_IDX];
+    if (idx->size != 3 || idx->data[1] > INDEX_CODING_MTF)
+        return DRT_ERR_UNSUPPORTED;
+    unsigned coding = idx->data[1];
+    unsigned short_size = idx->data[2];
+    if (coding != INDEX_CODING_FIXED && (short_size == 0 || short_size > INDEX_SHORT_MAX_SIZE))
+        return DRT_ERR_UNSUPPORTED;
+
+    const struct drt_blob *dict = &img->dicts[DRT_DICT];
+    uint16_t recent[1 << INDEX_SHORT_MAX_SIZE];
+    unsigned recent_cnt = 1u << short_size;
+    uint32_t prev = 0;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if ((first + i) % INDEX_LINE_CMDS == 0)
+        {
+            prev = 0;
+            for (unsigned j = 0; j < recent_cnt; ++j)
+                recent[j] = j;
+        }
+        if (!get_bit(in))
+        {
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+            continue;
+        }
+
+        uint32_t indx = 0;
+        if (coding != INDEX_CODING_FIXED && get_bit(in))
+        {
+            uint32_t code = get_bits(in, short_size);
+            if (coding == INDEX_CODING_DELTA)
+                indx = prev + code - ((code >> (short_size - 1)) << short_size);
+            else
+                indx = recent[code];
+        }
+        else
+        {
+            indx = get_bits(in, hdr->parts[0].indx_size);
+        }
+
+        if (coding == INDEX_CODING_MTF)
+        {
+            unsigned j = 0;
+            while (j + 1 < recent_cnt && recent[j] != indx)
+                j++;
+            for (; j > 0; --j)
+                recent[j] = recent[j - 1];
+            recent[0] = (uint16_t)indx;
+        }
+        prev = indx;
+        out[i] = dict_entry(in, dict, 4, indx);
+    }
+    return in->err;
+}
+
+int drt_decode_mask_single_hot(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    const struct drt_part *p = &hdr->parts[0];
+    unsigned hot_size = hot_indx_size(img);
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if (!get_bit(in))
+        {
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+        }
+        else if (get_bit(in))
+        {
+            out[i] = tiered_entry(in, img, hot_size, p->indx_size);
+        }
+        else
+        {
+            uint32_t mask_pos = get_bits(in, p->pos_size);
+            uint32_t mask = get_bits(in, p->mask_size);
+            uint32_t value = tiered_entry(in, img, hot_size, p->indx_size);
+            unsigned shift = mask_pos * p->mask_size;
+            uint32_t field = (((uint32_t)1 << p->mask_size) - 1) << shift;
+            out[i] = (value & ~field) | ((mask << shift) & field);
+        }
+    }
+    return in->err;
+}
+
+int drt_decode_mask_duo(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t lo = mask_value(in, &img->dicts[DRT_DICT_1], &hdr->parts[0]);
+        uint32_t hi = mask_value(in, &img->dicts[DRT_DICT_2], &hdr->parts[1]);
+        out[i] = lo | (hi << 16);
+    }
+    return in->err;
+}
+
+int drt_decode_mask_quad(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    static const int slots[4] = { DRT_DICT_11, DRT_DICT_12, DRT_DICT_21, DRT_DICT_22 };
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t value = 0;
+        for (unsigned j = 0; j < 4; ++j)
+            value |= mask_value(in, &img->dicts[slots[j]], &hdr->parts[j]) << (j * 8);
+        out[i] = value;
+    }
+    return in->err;
+}
+
+int drt_decode_mask_duo_quad(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t value = mask_value(in, &img->dicts[DRT_DICT_1], &hdr->parts[0]);
+        value |= mask_value(in, &img->dicts[DRT_DICT_21], &hdr->parts[1]) << 16;
+        value |= mask_value(in, &img->dicts[DRT_DICT_22], &hdr->parts[2]) << 24;
+        out[i] = value;
+    }
+    return in->err;
+}
+
+int drt_decode_mask_operands_opcode(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t operands = mask_value(in, &img->dicts[DRT_DICT_OPERANDS], &hdr->parts[0]);
+        uint32_t opcode = mask_value(in, &img->dicts[DRT_DICT_OPCODE], &hdr->parts[1]);
+        out[i] = opcode | (operands << 8);
+    }
+    return in->err;
+}
+
+/* rv32i field layouts as lib/rv32i_format.cpp */
+#define OPCODE_MASK 0x0000007fu
+#define RD_MASK     0x00000f80u
+#define FUNCT3_MASK 0x00007000u
+#define RS1_MASK    0x000f8000u
+#define RS2_MASK    0x01f00000u
+#define FUNCT7_MASK 0xfe000000u
+
+enum { FMT_R, FMT_I, FMT_S, FMT_B, FMT_U, FMT_J, FMT_X };
+
+struct field_layout
+{
+    uint32_t funct_mask;
+    uint32_t regs_mask;
+    uint32_t imm_mask;
+    uint32_t raw_mask;
+};
+
+static const struct field_layout layouts[] = {
+    { OPCODE_MASK | FUNCT3_MASK | FUNCT7_MASK, RD_MASK | RS1_MASK | RS2_MASK, 0, 0 },   /* R */
+    { OPCODE_MASK | FUNCT3_MASK, RD_MASK | RS1_MASK, 0xfff00000u, 0 },                  /* I */
+    { OPCODE_MASK | FUNCT3_MASK, RS1_MASK | RS2_MASK, FUNCT7_MASK | RD_MASK, 0 },       /* S */
+    { OPCODE_MASK | FUNCT3_MASK, RS1_MASK | RS2_MASK, FUNCT7_MASK | RD_MASK, 0 },       /* B */
+    { OPCODE_MASK, RD_MASK, 0xfffff000u, 0 },                                           /* U */
+    { OPCODE_MASK, RD_MASK, 0xfffff000u, 0 },                                           /* J */
+    { OPCODE_MASK, 0, 0, 0xffffff80u },                                                 /* X */
+};
+
+/* Indexed by opcode[6:2], valid for opcode[1:0] == 0b11 */
+static const uint8_t formats[32] = {
+    FMT_I, FMT_I, FMT_X, FMT_I, FMT_I, FMT_U, FMT_I, FMT_X,
+    FMT_S, FMT_S, FMT_X, FMT_R, FMT_R, FMT_U, FMT_R, FMT_X,
+    FMT_X, FMT_X, FMT_X, FMT_X, FMT_R, FMT_X, FMT_X, FMT_X,
+    FMT_B, FMT_I, FMT_X, FMT_J, FMT_I, FMT_X, FMT_X, FMT_X,
+};
+
+static unsigned count_bits(uint32_t mask)
+{
+    unsigned cnt = 0;
+    for (; mask != 0; mask &= mask - 1)
+        cnt++;
+    return cnt;
+}
+
+static uint32_t deposit_bits(uint32_t value, uint32_t mask)
+{
+    uint32_t retval = 0;
+    for (uint32_t bit = 1; mask != 0; bit <<= 1)
+    {
+        uint32_t low = mask & -mask;
+        if (value & bit)
+            retval |= low;
+        mask &= mask - 1;
+    }
+    return retval;
+}
+
+/* Field goes through dictionary only when index is shorter than the field */
+static uint32_t field_bits(struct drt_bits *in, const struct drt_blob *dict, unsigned cmdlen, unsigned indx_size, uint32_t mask)
+{
+    if (mask == 0)
+        return 0;
+
+    unsigned bits = count_bits(mask);
+    uint32_t field;
+    if (bits > indx_size + 1 && get_bit(in))
+        field = dict_entry(in, dict, cmdlen, get_bits(in, indx_size));
+    else
+        field = get_bits(in, bits);
+    return deposit_bits(field, mask);
+}
+
+int drt_decode_fields(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    const struct drt_part *funct_part = &hdr->parts[0], *regs_part = &hdr->parts[1], *imm_part = &hdr->parts[2];
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t funct;
+        if (get_bit(in))
+            funct = dict_entry(in, &img->dicts[DRT_DICT_FUNCT], funct_part->cmdlen, get_bits(in, funct_part->indx_size));
+        else
+            funct = get_bits(in, FIELDS_FUNCT_BITS);
+
+        unsigned fmt = (funct & 0x3) == 0x3 ? formats[(funct >> 2) & 0x1f] : FMT_X;
+        const struct field_layout *layout = &layouts[fmt];
+
+        uint32_t value = deposit_bits(funct, layout->funct_mask);
+        value |= field_bits(in, &img->dicts[DRT_DICT_REGS], regs_part->cmdlen, regs_part->indx_size, layout->regs_mask);
+        value |= field_bits(in, &img->dicts[DRT_DICT_IMM], imm_part->cmdlen, imm_part->indx_size, layout->imm_mask);
+        if (layout->raw_mask != 0)
+            value |= deposit_bits(get_bits(in, count_bits(layout->raw_mask)), layout->raw_mask);
+        out[i] = value;
+    }
+    return in->err;
+}
+
+int drt_decode_fixed16(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    unsigned indx_size = hdr->parts[0].indx_size;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t codeword = get_bits(in, indx_size + 1);
+        int slot = (codeword >> indx_size) != 0 ? DRT_DICT_OVF : DRT_DICT;
+        out[i] = dict_entry(in, &img->dicts[slot], 4, codeword & ((1u << indx_size) - 1));
+    }
+    return in->err;
+}
+
+/* .dict.blocks: u8 block shift, u8 dictionaries count, u16 entries of every
+   dictionary, then u8 dictionary of every block. Dictionaries follow one
+   another in .dict */
+int drt_decode_dict_blocks(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, size_t first, uint32_t *out, size_t cnt)
+{
+    const struct drt_blob *map = &img->dicts[DRT_DICT_BLOCKS];
+    if (map->data == NULL || map->size < 2 || map->size < 2 + (size_t)map->data[1] * 2)
+        return DRT_ERR_TRUNCATED;
+    if (map->data[0] >= 32)
+        return DRT_ERR_UNSUPPORTED;
+
+    unsigned shift = map->data[0];
+    unsigned dicts_cnt = map->data[1];
+    const uint8_t *blocks = map->data + 2 + dicts_cnt * 2;
+    size_t blocks_cnt = map->size - 2 - dicts_cnt * 2;
+
+    struct drt_blob dict = { NULL, 0 };
+    size_t block = (size_t)-1;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if ((first + i) >> shift != block)
+        {
+            block = (first + i) >> shift;
+            if (block >= blocks_cnt || blocks[block] >= dicts_cnt)
+                return DRT_ERR_BAD_CODEWORD;
+
+            size_t start = 0;
+            for (unsigned d = 0; d < blocks[block]; ++d)
+                start += load_le(map->data + 2 + d * 2, 2);
+            size_t size = load_le(map->data + 2 + blocks[block] * 2, 2);
+            if ((start + size) * 4 > img->dicts[DRT_DICT].size)
+                return DRT_ERR_TRUNCATED;
+            dict.data = img->dicts[DRT_DICT].data + start * 4;
+            dict.size = size * 4;
+        }
+
+        if (get_bit(in))
+            out[i] = dict_entry(in, &dict, 4, get_bits(in, hdr->parts[0].indx_size));
+        else
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+    }
+    return in->err;
+}
+
+/* MASK_MULTI layout, must match lib/mask_search.cpp and lib/utils.cpp */
+#define MASK_MULTI_WINDOWS 2
+#define MASK_MULTI_COUNT_SIZE 1
+
+/* rv32i fields of FIELDS shape: opcode, rd, funct3, rs1, rs2, funct7 */
+static const uint8_t mask_fields[][2] = { { 0, 7 }, { 7, 5 }, { 12, 3 }, { 15, 5 }, { 20, 5 }, { 25, 7 } };
+
+/* Flag 1: 1 - dictionary index, 0 - u2 shape, windows count - 1, windows
+   and index. Flag 0: literal. Windows: nibbles (u3 number, u4 value), flipped
+   bits (u5 number), fields (u3 field, value) */
+int drt_decode_mask_multi(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt)
+{
+    const struct drt_blob *dict = &img->dicts[DRT_DICT];
+    unsigned indx_size = hdr->parts[0].indx_size;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        if (!get_bit(in))
+        {
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+            continue;
+        }
+        if (get_bit(in))
+        {
+            out[i] = dict_entry(in, dict, 4, get_bits(in, indx_size));
+            continue;
+        }
+
+        uint32_t shape = get_bits(in, 2);
+        uint32_t windows = get_bits(in, MASK_MULTI_COUNT_SIZE) + 1;
+        uint32_t field[MASK_MULTI_WINDOWS], value[MASK_MULTI_WINDOWS];
+        for (uint32_t w = 0; w < windows; ++w)
+        {
+            if (shape == 0)
+            {
+                unsigned shift = get_bits(in, 3) * 4;
+                field[w] = (uint32_t)0xf << shift;
+                value[w] = get_bits(in, 4) << shift;
+            }
+            else if (shape == 1)
+            {
+                field[w] = 0;
+                value[w] = (uint32_t)1 << get_bits(in, 5);
+            }
+            else if (shape == 2)
+            {
+                uint32_t f = get_bits(in, 3);
+                if (f >= sizeof(mask_fields) / sizeof(mask_fields[0]))
+                    return DRT_ERR_BAD_CODEWORD;
+                field[w] = (((uint32_t)1 << mask_fields[f][1]) - 1) << mask_fields[f][0];
+                value[w] = get_bits(in, mask_fields[f][1]) << mask_fields[f][0];
+            }
+            else
+            {
+                return DRT_ERR_BAD_CODEWORD;
+            }
+        }
+
+        /* Bits shape flips, the others replace */
+        uint32_t entry = dict_entry(in, dict, 4, get_bits(in, indx_size));
+        for (uint32_t w = 0; w < windows; ++w)
+            entry = (entry & ~field[w]) ^ value[w];
+        out[i] = entry;
+    }
+    return in->err;
+}
+
+/* Table format as huffman_table::serialize: u32 symbols count, 4 bit lengths */
+static int huff_init(struct drt_huff *htab, const uint8_t *data, size_t size, size_t *readed, uint32_t *work, size_t work_words)
+{
+    if (size < 4)
+        return DRT_ERR_TRUNCATED;
+
+    uint32_t cnt = load_le(data, 4);
+    if (size - 4 < ((size_t)cnt + 1) / 2)
+        return DRT_ERR_TRUNCATED;
+    if (cnt > work_words)
+        return DRT_ERR_NO_SPACE;
+    *readed = 4 + ((size_t)cnt + 1) / 2;
+
+    for (unsigned len = 0; len <= HUFF_MAX_CODE_LEN; ++len)
+        htab->lens_cnt[len] = 0;
+    for (uint32_t sym = 0; sym < cnt; ++sym)
+        htab->lens_cnt[(data[4 + sym / 2] >> ((sym % 2) * 4)) & 0xf]++;
+    htab->lens_cnt[0] = 0;
+
+    uint32_t code = 0, indx = 0;
+    htab->first_code[0] = htab->first_indx[0] = 0;
+    for (unsigned len = 1; len <= HUFF_MAX_CODE_LEN; ++len)
+    {
+        code = (code + htab->lens_cnt[len - 1]) << 1;
+        htab->first_code[len] = code;
+        htab->first_indx[len] = indx;
+        indx += htab->lens_cnt[len];
+    }
+
+    /* Counting sort of symbols by length, first_indx is restored after */
+    uint32_t next_indx[HUFF_MAX_CODE_LEN + 1];
+    for (unsigned len = 0; len <= HUFF_MAX_CODE_LEN; ++len)
+        next_indx[len] = htab->first_indx[len];
+    for (uint32_t sym = 0; sym < cnt; ++sym)
+    {
+        unsigned len = (data[4 + sym / 2] >> ((sym % 2) * 4)) & 0xf;
+        if (len != 0)
+            work[next_indx[len]++] = sym;
+    }
+
+    htab->sorted_syms = work;
+    htab->syms_cnt = indx;
+    return DRT_OK;
+}
+
+static uint32_t huff_decode(struct drt_bits *in, const struct drt_huff *htab)
+{
+    uint32_t code = 0;
+    for (unsigned len = 1; len <= HUFF_MAX_CODE_LEN && in->err == DRT_OK; ++len)
+    {
+        code = (code << 1) | get_bit(in);
+        if (code - htab->first_code[len] < htab->lens_cnt[len])
+            return htab->sorted_syms[htab->first_indx[len] + code - htab->first_code[len]];
+    }
+
+    if (in->err == DRT_OK)
+        in->err = DRT_ERR_BAD_CODEWORD;
+    return 0;
+}
+
+/* Symbols below dictionary size are indices, next one is a literal */
+int drt_decode_dict_entropy(struct drt_bits *in, const struct drt_image *img, const struct drt_huff *htab, uint32_t *out, size_t cnt)
+{
+    const struct drt_blob *dict = &img->dicts[DRT_DICT];
+    uint32_t entries_cnt = dict->size / 4;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t sym = huff_decode(in, htab);
+        out[i] = sym < entries_cnt ? dict_entry(in, dict, 4, sym) : get_bits(in, RV32I_CMDLEN_BITS);
+    }
+    return in->err;
+}
+
+/* Symbols: dictionary indices, then mask class, then literal class */
+int drt_decode_mask_single_entropy(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr,
+    const struct drt_huff *htab, const struct drt_huff *mask_htab, uint32_t *out, size_t cnt)
+{
+    const struct drt_part *p = &hdr->parts[0];
+    const struct drt_blob *dict = &img->dicts[DRT_DICT];
+    uint32_t entries_cnt = dict->size / 4;
+    for (size_t i = 0; i < cnt && in->err == DRT_OK; ++i)
+    {
+        uint32_t sym = huff_decode(in, htab);
+        if (sym < entries_cnt)
+        {
+            out[i] = dict_entry(in, dict, 4, sym);
+        }
+        else if (sym == entries_cnt)
+        {
+            uint32_t mask_pos = get_bits(in, p->pos_size);
+            uint32_t mask = get_bits(in, p->mask_size);
+            uint32_t value = dict_entry(in, dict, 4, huff_decode(in, mask_htab));
+            unsigned shift = mask_pos * p->mask_size;
+            uint32_t field = (((uint32_t)1 << p->mask_size) - 1) << shift;
+            out[i] = (value & ~field) | ((mask << shift) & field);
+        }
+        else
+        {
+            out[i] = get_bits(in, RV32I_CMDLEN_BITS);
+        }
+    }
+    return in->err;
+}
+
+/* Slot of name of len bytes, name isn't terminated in the header */
+static int dict_slot(const char *name, size_t len)
+{
+    static const char *const names[DRT_DICT_SLOTS] = {
+        ".dict", ".dict.1", ".dict.2", ".dict.11", ".dict.12", ".dict.21", ".dict.22",
+        ".dict.opcode", ".dict.operands", ".dict.funct", ".dict.regs", ".dict.imm", ".dict.ovf", ".dict.huff",
+        ".dict.func", ".dict.blocks", ".dict.hot", ".dict.idx"
+    };
+
+    for (int slot = 0; slot < DRT_DICT_SLOTS; ++slot)
+    {
+        const char *a = names[slot];
+        size_t i = 0;
+        while (i < len && a[i] != '\0' && a[i] == name[i])
+            i++;
+        if (i == len && a[i] == '\0')
+            return slot;
+    }
+    return -1;
+}
+
+int drt_dict_slot(const char *name)
+{
+    size_t len = 0;
+    while (name[len] != '\0')
+        len++;
+    return dict_slot(name, len);
+}
+
+/* Adler-32 as lib/code_header.cpp */
+static uint32_t adler32(const uint8_t *data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        size_t chunk = size < 5552 ? size : 5552;
+        size -= chunk;
+        while (chunk-- > 0)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+/* Parts of every encode type in stream order */
+static unsigned parts_count(unsigned etype)
+{
+    static const uint8_t counts[] = { 1, 1, 2, 4, 2, 3, 3, 1, 1, 1 };
+    return etype < sizeof(counts) ? counts[etype] : 0;
+}
+
+/* Widths are used as shifts of 32 bit values, mask positions stay inside the part */
+static int part_is_valid(const struct drt_part *p)
+{
+    if (p->cmdlen == 0 || p->cmdlen > 4 || p->indx_size == 0 || p->indx_size > 24 || p->pos_size > 8)
+        return 0;
+    if (p->mask_size == 0)
+        return p->pos_size == 0;
+    return (((uint32_t)1 << p->pos_size) - 1) * p->mask_size + p->mask_size <= (uint32_t)p->cmdlen * 8;
+}
+
+int drt_read_header(const struct drt_image *img, struct drt_header *hdr)
+{
+    const uint8_t *data = img->code.data;
+    if (data == NULL || img->code.size < HEADER_MIN_SIZE)
+        return DRT_ERR_TRUNCATED;
+    if (data[1] != HEADER_VERSION)
+        return DRT_ERR_UNSUPPORTED;
+
+    size_t size = load_le(data + 2, 2);
+    if (size < HEADER_MIN_SIZE || size > img->code.size)
+        return DRT_ERR_TRUNCATED;
+    if (adler32(data, size - 4) != load_le(data + size - 4, 4))
+        return DRT_ERR_CHECKSUM;
+
+    unsigned pad = data[0] >> 5;
+    size_t bytes = img->code.size - size;
+    if (bytes == 0 && pad != 0)
+        return DRT_ERR_TRUNCATED;
+
+    hdr->etype = data[0] & 0x1f;
+    hdr->size = size;
+    hdr->stream_bits = bytes * 8 - pad;
+    hdr->cmds_cnt = load_le(data + 4, 4);
+    hdr->stream_checksum = load_le(data + 8, 4);
+    hdr->parts_cnt = data[13];
+    if (data[12] != 4 || hdr->parts_cnt != parts_count(hdr->etype) || 15 + hdr->parts_cnt * 4 > size - 4)
+        return DRT_ERR_UNSUPPORTED;
+
+    for (unsigned i = 0; i < hdr->parts_cnt; ++i)
+    {
+        struct drt_part *p = &hdr->parts[i];
+        p->cmdlen = data[14 + i * 4];
+        p->pos_size = data[15 + i * 4];
+        p->mask_size = data[16 + i * 4];
+        p->indx_size = data[17 + i * 4];
+        if (!part_is_valid(p))
+            return DRT_ERR_UNSUPPORTED;
+    }
+    return DRT_OK;
+}
+
+int drt_check(const struct drt_image *img)
+{
+    struct drt_header hdr;
+    int status = drt_read_header(img, &hdr);
+    if (status != DRT_OK)
+        return status;
+    if (adler32(img->code.data + hdr.size, img->code.size - hdr.size) != hdr.stream_checksum)
+        return DRT_ERR_CHECKSUM;
+
+    /* u8 count, then u8 name length, name, u32 size, u32 checksum */
+    const uint8_t *data = img->code.data;
+    size_t end = hdr.size - 4;
+    size_t pos = 14 + hdr.parts_cnt * 4;
+    if (pos >= end)
+        return DRT_ERR_TRUNCATED;
+    unsigned dicts_cnt = data[pos++];
+    for (unsigned i = 0; i < dicts_cnt; ++i)
+    {
+        if (pos >= end || end - pos < 1 + (size_t)data[pos] + 8)
+            return DRT_ERR_TRUNCATED;
+        size_t name_len = data[pos];
+        int slot = dict_slot((const char *)data + pos + 1, name_len);
+        pos += 1 + name_len;
+        if (slot < 0)
+            return DRT_ERR_UNSUPPORTED;
+
+        const struct drt_blob *dict = &img->dicts[slot];
+        if (dict->size != load_le(data + pos, 4) || (dict->size != 0 && dict->data == NULL))
+            return DRT_ERR_CHECKSUM;
+        if (adler32(dict->data, dict->size) != load_le(data + pos + 4, 4))
+            return DRT_ERR_CHECKSUM;
+        pos += 8;
+    }
+    return DRT_OK;
+}
+
+size_t drt_work_words(const struct drt_image *img)
+{
+    const struct drt_blob *huff = &img->dicts[DRT_DICT_HUFF];
+    size_t words = 0;
+    for (size_t pos = 0; huff->data != NULL && pos + 4 <= huff->size;)
+    {
+        uint32_t cnt = load_le(huff->data + pos, 4);
+        words += cnt;
+        pos += 4 + ((size_t)cnt + 1) / 2;
+    }
+    return words;
+}
+
+static int decode_entropy(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt,
+    uint32_t *work, size_t work_words)
+{
+    const struct drt_blob *huff = &img->dicts[DRT_DICT_HUFF];
+    struct drt_huff htabs[2];
+    unsigned tables_cnt = hdr->etype == DRT_ETYPE_DICT ? 1 : 2;
+    size_t pos = 0;
+    for (unsigned i = 0; i < tables_cnt; ++i)
+    {
+        size_t readed = 0;
+        int status = huff_init(&htabs[i], huff->data + pos, huff->size - pos, &readed, work, work_words);
+        if (status != DRT_OK)
+            return status;
+        pos += readed;
+        work += htabs[i].syms_cnt;
+        work_words -= htabs[i].syms_cnt;
+    }
+
+    if (hdr->etype == DRT_ETYPE_DICT)
+        return drt_decode_dict_entropy(in, img, &htabs[0], out, cnt);
+    return drt_decode_mask_single_entropy(in, img, hdr, &htabs[0], &htabs[1], out, cnt);
+}
+
+/* first - index of the first decoded command in original .text */
+static int decode_stream(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, size_t first, uint32_t *out, size_t cnt,
+    uint32_t *work, size_t work_words)
+{
+    int entropy = img->dicts[DRT_DICT_HUFF].data != NULL;
+    int hot = img->dicts[DRT_DICT_HOT].data != NULL;
+    int coded = img->dicts[DRT_DICT_IDX].data != NULL;
+    switch (hdr->etype)
+    {
+        case DRT_ETYPE_DICT:
+            if (entropy)
+                return decode_entropy(in, img, hdr, out, cnt, work, work_words);
+            if (coded)
+                return drt_decode_dict_coded(in, img, hdr, first, out, cnt);
+            return hot ? drt_decode_dict_hot(in, img, hdr, out, cnt) : drt_decode_dict(in, img, hdr, out, cnt);
+        case DRT_ETYPE_MASK_SINGLE:
+            if (entropy)
+                return decode_entropy(in, img, hdr, out, cnt, work, work_words);
+            return hot ? drt_decode_mask_single_hot(in, img, hdr, out, cnt) : drt_decode_mask_single(in, img, hdr, out, cnt);
+        case DRT_ETYPE_MASK_DUO:
+            return drt_decode_mask_duo(in, img, hdr, out, cnt);
+        case DRT_ETYPE_MASK_QUAD:
+            return drt_decode_mask_quad(in, img, hdr, out, cnt);
+        case DRT_ETYPE_MASK_OPERANDS_OPCODE:
+            return drt_decode_mask_operands_opcode(in, img, hdr, out, cnt);
+        case DRT_ETYPE_MASK_DUO_QUAD:
+            return drt_decode_mask_duo_quad(in, img, hdr, out, cnt);
+        case DRT_ETYPE_RV32I_FIELDS:
+            return drt_decode_fields(in, img, hdr, out, cnt);
+        case DRT_ETYPE_FIXED16:
+            return drt_decode_fixed16(in, img, hdr, out, cnt);
+        case DRT_ETYPE_DICT_BLOCKS:
+            return drt_decode_dict_blocks(in, img, hdr, first, out, cnt);
+        case DRT_ETYPE_MASK_MULTI:
+            return drt_decode_mask_multi(in, img, hdr, out, cnt);
+        default:
+            return DRT_ERR_UNSUPPORTED;
+    }
+}
+
+int drt_decompress(const struct drt_image *img, uint32_t *out, size_t out_cap, size_t *out_cnt,
+    uint32_t *work, size_t work_words)
+{
+    struct drt_header hdr;
+    int status = drt_read_header(img, &hdr);
+    if (status != DRT_OK)
+        return status;
+    if (hdr.cmds_cnt > out_cap)
+        return DRT_ERR_NO_SPACE;
+    if (adler32(img->code.data + hdr.size, img->code.size - hdr.size) != hdr.stream_checksum)
+        return DRT_ERR_CHECKSUM;
+
+    struct drt_bits in = { img->code.data + hdr.size, hdr.stream_bits, 0, DRT_OK };
+    status = decode_stream(&in, img, &hdr, 0, out, hdr.cmds_cnt, work, work_words);
+    *out_cnt = status == DRT_OK ? hdr.cmds_cnt : 0;
+    return status;
+}
+
+int drt_decompress_function(const struct drt_image *img, size_t offset, uint32_t *out, size_t out_cap, size_t *out_cnt,
+    size_t *func_offset, uint32_t *work, size_t work_words)
+{
+    struct drt_header hdr;
+    int status = drt_read_header(img, &hdr);
+    if (status != DRT_OK)
+        return status;
+
+    /* u32 units count, u8 cmdlen, then 4 x u32 per unit sorted by offset */
+    const struct drt_blob *ftab = &img->dicts[DRT_DICT_FUNC];
+    if (ftab->data == NULL || ftab->size < 5)
+        return DRT_ERR_NO_FUNCTION;
+    size_t units_cnt = load_le(ftab->data, 4);
+    if (units_cnt > (ftab->size - 5) / 16)
+        return DRT_ERR_TRUNCATED;
+
+    size_t lo = 0, hi = units_cnt;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (load_le(ftab->data + 5 + mid * 16, 4) <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return DRT_ERR_NO_FUNCTION;
+
+    const uint8_t *unit = ftab->data + 5 + (lo - 1) * 16;
+    size_t text_offset = load_le(unit, 4);
+    size_t text_size = load_le(unit + 4, 4);
+    size_t bit_offset = load_le(unit + 8, 4);
+    size_t bit_size = load_le(unit + 12, 4);
+    if (offset >= text_offset + text_size)
+        return DRT_ERR_NO_FUNCTION;
+
+    size_t cnt = text_size / 4;
+    if (cnt > out_cap)
+        return DRT_ERR_NO_SPACE;
+    if (bit_offset + bit_size > hdr.stream_bits)
+        return DRT_ERR_TRUNCATED;
+
+    struct drt_bits in = { img->code.data + hdr.size, bit_offset + bit_size, bit_offset, DRT_OK };
+    status = decode_stream(&in, img, &hdr, text_offset / 4, out, cnt, work, work_words);
+    *out_cnt = status == DRT_OK ? cnt : 0;
+    *func_offset = status == DRT_OK ? text_offset : 0;
+    return status;
+}
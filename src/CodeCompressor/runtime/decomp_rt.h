@@ -0,0 +1,154 @@
+#ifndef DECOMP_RT_H
+#define DECOMP_RT_H
+
+/*
+ * Freestanding decompressor of rv32i code compressed by libcompress.
+ * No heap, no exceptions, no libc: caller provides compressed .text, the
+ * dictionary blobs (contents of .dict* sections) and the output buffer.
+ * Builds with -ffreestanding for host and rv32i.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Same values as encode_type of config.h */
+enum drt_etype
+{
+    DRT_ETYPE_DICT = 0,
+    DRT_ETYPE_MASK_SINGLE = 1,
+    DRT_ETYPE_MASK_DUO = 2,
+    DRT_ETYPE_MASK_QUAD = 3,
+    DRT_ETYPE_MASK_OPERANDS_OPCODE = 4,
+    DRT_ETYPE_MASK_DUO_QUAD = 5,
+    DRT_ETYPE_RV32I_FIELDS = 6,
+    DRT_ETYPE_FIXED16 = 7,
+    DRT_ETYPE_DICT_BLOCKS = 8,
+    DRT_ETYPE_MASK_MULTI = 9
+};
+
+enum drt_status
+{
+    DRT_OK = 0,
+    DRT_ERR_TRUNCATED,      /* compressed code or dictionary ends too early */
+    DRT_ERR_BAD_CODEWORD,   /* index out of dictionary, bad huffman code */
+    DRT_ERR_NO_SPACE,       /* output or work buffer is too small */
+    DRT_ERR_UNSUPPORTED,    /* unknown encode type, header version or codeword layout */
+    DRT_ERR_NO_FUNCTION,    /* offset is outside of every function of .dict.func */
+    DRT_ERR_CHECKSUM        /* header, stream or dictionary doesn't match its checksum */
+};
+
+/* Dictionary slots, each holds contents of the section of the same name */
+enum drt_dict_slot
+{
+    DRT_DICT,               /* .dict */
+    DRT_DICT_1,             /* .dict.1 */
+    DRT_DICT_2,             /* .dict.2 */
+    DRT_DICT_11,            /* .dict.11 */
+    DRT_DICT_12,            /* .dict.12 */
+    DRT_DICT_21,            /* .dict.21 */
+    DRT_DICT_22,            /* .dict.22 */
+    DRT_DICT_OPCODE,        /* .dict.opcode */
+    DRT_DICT_OPERANDS,      /* .dict.operands */
+    DRT_DICT_FUNCT,         /* .dict.funct */
+    DRT_DICT_REGS,          /* .dict.regs */
+    DRT_DICT_IMM,           /* .dict.imm */
+    DRT_DICT_OVF,           /* .dict.ovf */
+    DRT_DICT_HUFF,          /* .dict.huff, entropy coded DICT and MASK_SINGLE */
+    DRT_DICT_FUNC,          /* .dict.func, only for drt_decompress_function */
+    DRT_DICT_BLOCKS,        /* .dict.blocks, dictionary of every block of DICT_BLOCKS */
+    DRT_DICT_HOT,           /* .dict.hot, hot table of two-level DICT and MASK_SINGLE dictionary */
+    DRT_DICT_IDX,           /* .dict.idx, coding of DICT indices */
+    DRT_DICT_SLOTS
+};
+
+struct drt_blob
+{
+    const uint8_t *data;
+    size_t size;
+};
+
+struct drt_image
+{
+    struct drt_blob code;                       /* compressed .text with header */
+    struct drt_blob dicts[DRT_DICT_SLOTS];      /* missing dictionaries are empty */
+};
+
+#define DRT_MAX_PARTS 4
+
+/* Codeword of one part of command: bytes of part, widths of mask position, mask and index */
+struct drt_part
+{
+    uint8_t cmdlen;
+    uint8_t pos_size;
+    uint8_t mask_size;
+    uint8_t indx_size;
+};
+
+/* Compressed .text header as code_header of lib/code_header.h */
+struct drt_header
+{
+    unsigned etype;
+    size_t size;                                /* bytes before the stream */
+    size_t stream_bits;
+    size_t cmds_cnt;
+    uint32_t stream_checksum;
+    unsigned parts_cnt;
+    struct drt_part parts[DRT_MAX_PARTS];       /* codeword layout, in stream order */
+};
+
+/* Slot for .dict* section name, -1 if decoder doesn't need it (.dict.addr) */
+int drt_dict_slot(const char *name);
+
+/* Parses and checks header of compressed .text, stream isn't read */
+int drt_read_header(const struct drt_image *img, struct drt_header *hdr);
+
+/* Cheap check before decoding: stream and every dictionary match checksums of the header */
+int drt_check(const struct drt_image *img);
+
+/* Work buffer size in words needed by drt_decompress, 0 if not entropy coded */
+size_t drt_work_words(const struct drt_image *img);
+
+/*
+ * Restores all instructions to out (out_cap words), their count goes to
+ * out_cnt. work is scratch of drt_work_words() words, may be NULL if it's 0.
+ * Stream checksum is checked, dictionaries are not (see drt_check)
+ */
+int drt_decompress(const struct drt_image *img, uint32_t *out, size_t out_cap, size_t *out_cnt,
+    uint32_t *work, size_t work_words);
+
+/*
+ * Restores only the function containing offset of original .text, for lazy
+ * loading. Its start offset goes to func_offset, the rest is as drt_decompress
+ */
+int drt_decompress_function(const struct drt_image *img, size_t offset, uint32_t *out, size_t out_cap, size_t *out_cnt,
+    size_t *func_offset, uint32_t *work, size_t work_words);
+
+/* Per encode type decoders, separate symbols to see code size of each format */
+struct drt_bits;
+struct drt_huff;
+int drt_decode_dict(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_dict_entropy(struct drt_bits *in, const struct drt_image *img, const struct drt_huff *htab, uint32_t *out, size_t cnt);
+int drt_decode_mask_single(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_dict_hot(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_dict_coded(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, size_t first, uint32_t *out, size_t cnt);
+int drt_decode_mask_single_hot(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_mask_single_entropy(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr,
+    const struct drt_huff *htab, const struct drt_huff *mask_htab, uint32_t *out, size_t cnt);
+int drt_decode_mask_duo(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_mask_quad(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_mask_duo_quad(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_mask_operands_opcode(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_fields(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_fixed16(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+int drt_decode_dict_blocks(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, size_t first, uint32_t *out, size_t cnt);
+int drt_decode_mask_multi(struct drt_bits *in, const struct drt_image *img, const struct drt_header *hdr, uint32_t *out, size_t cnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
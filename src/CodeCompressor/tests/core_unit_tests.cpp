@@ -1,10 +1,25 @@
 #include <iostream>
+#include <fstream>
 #include <cassert>
+#include <filesystem>
+#include <random>
+#include <sstream>
 
 #include "elfio/elfio.hpp"
 
 #include "../lib/utils.h"
+#include "../lib/block_map.h"
+#include "../lib/code_header.h"
+#include "../lib/codeword_map.h"
+#include "../lib/mask_search.h"
 #include "../lib/encode_table.h"
+#include "../lib/dict_batch.h"
+#include "../lib/exec_profile.h"
+#include "../lib/index_coding.h"
+#include "../lib/workload_model.h"
+#include "../lib/rv32i_interp.h"
+#include "../lib/result_cache.h"
+#include "../runtime/decomp_rt.h"
 
 using namespace utils;
 
@@ -18,6 +33,9 @@ ELFIO::section *get_section_with_name(const ELFIO::elfio *file, const std::strin
 template<size_t CMDLEN>
 std::vector<command> get_commands(const ELFIO::section *sec_text);
 
+ELFIO::elfio* rv64i_compress_executable(size_stat &szstat, std::vector<std::string> &dict_infos, ELFIO::elfio *file, config cfg);
+ELFIO::elfio* rv64i_decompress_executable(ELFIO::elfio *file, const config &cfg);
+
 }
 
 /* Subroutines */
@@ -276,195 +294,1350 @@ bool test_mask_oper_compress_decompress_executable()
     DUMMY_TEST_PASS()
 }
 
-/* Модульные тесты */
-/* find_mask */
-bool test_find_mask_full_finded_in_dictionary()
+bool test_fields_compress_decompress_executable()
 {
-    utils::command cmd;
-    cmd.add(0xffff, 16);
-    std::vector<utils::command> entab_commands = { cmd };
-    utils::encode_table<2, 1> entab(entab_commands);
+    ELFIO::elfio reader;
+    ELFIO::elfio reader2;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    const std::string ofilename = "./tests/result.exe";
+    const std::string cofilename = "./tests/hello_world-rv32i-d.o";
 
-    dynbitset mask;
-    size_t pos, indx;
-    DUMMY_ASSERT(!(find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+    DUMMY_ASSERT(reader.load(ifilename))
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::RV32I_FIELDS);
 
-    DUMMY_TEST_PASS()
-}
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        config cfg = cfg_builder.build();
+        compress_executable(sz_stat, dict_infos, &reader, cfg);
 
-bool test_find_mask_find_single_1_diff()
-{
-    utils::command dict_cmd;
-    dict_cmd.add(0xffff, 16);
-    std::vector<utils::command> entab_commands = { dict_cmd };
-    utils::encode_table<2, 1> entab(entab_commands);
+        DUMMY_ASSERT(reader.save( ofilename ))
+        DUMMY_ASSERT(reader2.load(ofilename))
 
-    utils::command cmd;
-    cmd.add(0xafff, 16);
-    dynbitset mask;
-    size_t pos, indx;
-    DUMMY_ASSERT((find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+        decompress_executable(&reader2);
+        DUMMY_ASSERT(reader2.save( cofilename ))
+    } 
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
 
-    dynbitset target_mask;
-    target_mask.add(0xa, 4);
-    DUMMY_ASSERT(mask == target_mask)
-    DUMMY_ASSERT(pos == 3)
-    DUMMY_ASSERT(indx == 0)
+    DUMMY_ASSERT(reader.load(ifilename))
+    DUMMY_ASSERT(compare_by_text_section(&reader, &reader2))
 
     DUMMY_TEST_PASS()
 }
 
-bool test_find_mask_find_single_2_diff()
+bool test_fixed16_compress_decompress_executable()
 {
-    utils::command dict_cmd;
-    dict_cmd.add(0xffff, 16);
-    std::vector<utils::command> entab_commands = { dict_cmd };
-    utils::encode_table<2, 1> entab(entab_commands);
+    ELFIO::elfio reader;
+    ELFIO::elfio reader2;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    const std::string ofilename = "./tests/result.exe";
+    const std::string cofilename = "./tests/hello_world-rv32i-d.o";
 
-    utils::command cmd;
-    cmd.add(0xffaf, 16);
-    dynbitset mask;
-    size_t pos, indx;
-    DUMMY_ASSERT((find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+    DUMMY_ASSERT(reader.load(ifilename))
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::FIXED16);
 
-    dynbitset target_mask;
-    target_mask.add(0xa, 4);
-    DUMMY_ASSERT(mask == target_mask)
-    DUMMY_ASSERT(pos == 1)
-    DUMMY_ASSERT(indx == 0)
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        config cfg = cfg_builder.build();
+        compress_executable(sz_stat, dict_infos, &reader, cfg);
 
-    DUMMY_TEST_PASS()
-}
+        DUMMY_ASSERT(reader.save( ofilename ))
+        DUMMY_ASSERT(reader2.load(ofilename))
 
-bool test_find_mask_find_many_diff()
-{
-    utils::command dict_cmd;
-    dict_cmd.add(0xffff, 16);
-    std::vector<utils::command> entab_commands = { dict_cmd };
-    utils::encode_table<2, 1> entab(entab_commands);
+        decompress_executable(&reader2);
+        DUMMY_ASSERT(reader2.save( cofilename ))
+    } 
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
 
-    utils::command cmd;
-    cmd.add(0xafaf, 16);
-    dynbitset mask;
-    size_t pos, indx;
-    DUMMY_ASSERT((!find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+    DUMMY_ASSERT(reader.load(ifilename))
+    DUMMY_ASSERT(compare_by_text_section(&reader, &reader2))
 
     DUMMY_TEST_PASS()
 }
 
-/* make_encode_table */
-bool test_dict_make_encode_table_default()
+bool test_dict_entropy_compress_decompress_executable()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
-    cmd3.add(0xfffb, 16);
-    cmd4.add(0xfffa, 16);
+    ELFIO::elfio reader;
+    ELFIO::elfio reader2;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    const std::string ofilename = "./tests/result.exe";
+    const std::string cofilename = "./tests/hello_world-rv32i-d.o";
 
-    std::vector<utils::command> entab_commands = { cmd1, cmd1, cmd1, cmd2, cmd3, cmd3, cmd4 };
+    DUMMY_ASSERT(reader.load(ifilename))
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::DICT);
+    cfg_builder.set_entropy_coding(true);
 
-    config cfg;
-    encode_table<2, 1> entab;
-    dict_make_encode_table(entab_commands, cfg, entab);
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        config cfg = cfg_builder.build();
+        compress_executable(sz_stat, dict_infos, &reader, cfg);
 
-    auto entries = entab.get_entries();
-    DUMMY_ASSERT(entries.size() == 2);
-    DUMMY_ASSERT(entries[0] == cmd1 || entries[0] == cmd3);
-    DUMMY_ASSERT(entries[1] == cmd1 || entries[1] == cmd3);
+        DUMMY_ASSERT(reader.save( ofilename ))
+        DUMMY_ASSERT(reader2.load(ofilename))
+
+        decompress_executable(&reader2);
+        DUMMY_ASSERT(reader2.save( cofilename ))
+    } 
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+
+    DUMMY_ASSERT(reader.load(ifilename))
+    DUMMY_ASSERT(compare_by_text_section(&reader, &reader2))
 
     DUMMY_TEST_PASS()
 }
 
-/* compress */
-bool test_compress_command_with_mask_not_compressed()
+bool test_mask_single_entropy_compress_decompress_executable()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
-    cmd3.add(0xfffb, 16);
-    cmd4.add(0xfffa, 16);
+    ELFIO::elfio reader;
+    ELFIO::elfio reader2;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    const std::string ofilename = "./tests/result.exe";
+    const std::string cofilename = "./tests/hello_world-rv32i-d.o";
 
-    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
-    utils::encode_table<2, 1> entab(entab_commands);
+    DUMMY_ASSERT(reader.load(ifilename))
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::MASK_SINGLE);
+    cfg_builder.set_entropy_coding(true);
 
-    utils::command cmd;
-    cmd.add(0xaaaa, 16);
-    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
-    utils::command target_cmd;
-    target_cmd.add(0x15554, 17);
-    DUMMY_ASSERT(ccmd == target_cmd)
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        config cfg = cfg_builder.build();
+        compress_executable(sz_stat, dict_infos, &reader, cfg);
+
+        DUMMY_ASSERT(reader.save( ofilename ))
+        DUMMY_ASSERT(reader2.load(ofilename))
+
+        decompress_executable(&reader2);
+        DUMMY_ASSERT(reader2.save( cofilename ))
+    } 
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+
+    DUMMY_ASSERT(reader.load(ifilename))
+    DUMMY_ASSERT(compare_by_text_section(&reader, &reader2))
 
     DUMMY_TEST_PASS()
 }
 
-bool test_compress_command_with_mask_dict_compressed()
+bool test_trace_executable_covers_section()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
-    cmd3.add(0xfffb, 16);
-    cmd4.add(0xfffa, 16);
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
 
-    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
-    utils::encode_table<2, 1> entab(entab_commands);
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_DUO, encode_type::RV32I_FIELDS, encode_type::FIXED16, encode_type::DICT_BLOCKS, encode_type::MASK_MULTI };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        size_t cmds_cnt = get_section_with_name(&reader, ".text")->get_size() / RV32I_CMDLEN;
 
-    utils::command cmd;
-    cmd.add(0xfffd, 16);
-    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
-    utils::command target_cmd;
-    target_cmd.add(0b111, 3);
-    DUMMY_ASSERT(ccmd == target_cmd)
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+        std::vector<block_trace> traces = trace_executable(&reader);
+        DUMMY_ASSERT(traces.size() == cmds_cnt)
+
+        size_t bits = 0;
+        for (const auto &trace : traces)
+            bits += trace.bits;
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        size_t header_size = 0;
+        code_header::deserialize(std::span<const uint8_t>((const uint8_t *)code_sec->get_data(), code_sec->get_size()), header_size);
+        DUMMY_ASSERT((bits + 7) / 8 + header_size == code_sec->get_size())
+    }
 
     DUMMY_TEST_PASS()
 }
 
-bool test_compress_command_with_mask_mask_compressed()
+bool test_decompress_commands_at_matches_text()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
-    cmd3.add(0xfffb, 16);
-    cmd4.add(0xfffa, 16);
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
 
-    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
-    utils::encode_table<2, 1> entab(entab_commands);
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_SINGLE, encode_type::MASK_QUAD, encode_type::RV32I_FIELDS, encode_type::FIXED16, encode_type::DICT_BLOCKS, encode_type::MASK_MULTI };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        const ELFIO::section *text = get_section_with_name(&reader, ".text");
+        std::vector<command> commands = get_commands<RV32I_CMDLEN>(text);
+        ELFIO::Elf64_Addr text_addr = text->get_address();
 
-    utils::command cmd;
-    cmd.add(0xffff, 16);
-    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
-    utils::command target_cmd;
-    target_cmd.add(0b11110001, 8);      // 0 - признак сжатия, 0 - признак маски, 00 - позиция, 1111 - маска
-    DUMMY_ASSERT(ccmd == target_cmd)
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.dict_addr_bit_size != 0 || encode_types[i] == encode_type::FIXED16)
+
+        size_t bitpos = 1;
+        DUMMY_ASSERT(find_compressed_position(&reader, text_addr, bitpos))
+        DUMMY_ASSERT(bitpos == 0)
+
+        for (size_t j = 0; j < commands.size(); j += 7)
+        {
+            std::vector<command> restored = decompress_commands_at(&reader, text_addr + j * RV32I_CMDLEN, 3);
+            for (size_t k = 0; k < restored.size(); ++k)
+                DUMMY_ASSERT(restored[k] == commands[j + k])
+            DUMMY_ASSERT(restored.size() == std::min<size_t>(3, commands.size() - j))
+        }
+    }
 
     DUMMY_TEST_PASS()
 }
 
-bool compress_command_with_dictionary_not_compressed()
+bool test_compress_code_span_matches_executable()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
-    cmd3.add(0xfffb, 16);
-    cmd4.add(0xfffa, 16);
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
 
-    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
-    utils::encode_table<2, 1> entab(entab_commands);
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_DUO_QUAD, encode_type::RV32I_FIELDS, encode_type::FIXED16, encode_type::DICT_BLOCKS, encode_type::MASK_MULTI };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+        std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
 
-    utils::command cmd;
-    cmd.add(0xffff, 16);
-    command ccmd = compress_command_with_dictionary(entab, cmd);
-    utils::command target_cmd;
-    target_cmd.add(0x1fffe, 17);
-    DUMMY_ASSERT(ccmd == target_cmd)
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        cfg_builder.set_entropy_coding(encode_types[i] == encode_type::DICT);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.initial_code_size == text.size())
+        DUMMY_ASSERT(decompress_code(image.code, image.get_dict_views()) == text)
+
+        // ELF path gives the same bitstream and dictionaries, .dict.addr also
+        // has entry points of symbols
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        const ELFIO::section *ctext_sec = get_section_with_name(&reader, ".text");
+        DUMMY_ASSERT(ctext_sec->get_size() == image.code.size())
+        DUMMY_ASSERT(std::equal(image.code.begin(), image.code.end(), (const uint8_t *)ctext_sec->get_data()))
+        for (const auto &dict : image.get_dicts())
+        {
+            const ELFIO::section *dict_sec = get_section_with_name(&reader, dict.first);
+            DUMMY_ASSERT(dict_sec != nullptr && dict_sec->get_size() >= dict.second.size())
+            DUMMY_ASSERT(dict.first == ".dict.addr" || std::equal(dict.second.begin(), dict.second.end(), (const uint8_t *)dict_sec->get_data()))
+        }
+    }
 
     DUMMY_TEST_PASS()
 }
 
-bool compress_command_with_dictionary_compressed()
+bool test_compress_code_progress_and_cancel()
 {
-    utils::command cmd1, cmd2, cmd3, cmd4;
-    cmd1.add(0xfffd, 16);
-    cmd2.add(0xfffc, 16);
+    ELFIO::elfio reader;
+    DUMMY_ASSERT(reader.load("./tests/hello_world-rv32i.o"))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+    size_t cmds_cnt = text.size() / RV32I_CMDLEN;
+
+    struct progress_event
+    {
+        progress_phase phase;
+        size_t processed;
+        size_t total;
+    };
+
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_QUAD, encode_type::FIXED16 };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image expected = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+
+        std::vector<progress_event> events;
+        cfg_builder.set_progress([&events](progress_phase phase, size_t processed, size_t total)
+        {
+            events.push_back({ phase, processed, total });
+        });
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        DUMMY_ASSERT(image.code == expected.code)
+
+        // Histograms (one per dictionary) first, then encoding up to all instructions
+        DUMMY_ASSERT(events.size() >= 4)
+        DUMMY_ASSERT(events.front().phase == progress_phase::HISTOGRAM)
+        DUMMY_ASSERT(events.back().phase == progress_phase::ENCODE && events.back().processed == cmds_cnt)
+        for (size_t j = 0; j < events.size(); ++j)
+        {
+            DUMMY_ASSERT(events[j].total == cmds_cnt && events[j].processed <= cmds_cnt)
+            DUMMY_ASSERT(j == 0 || events[j - 1].phase <= events[j].phase)
+        }
+
+        events.clear();
+        DUMMY_ASSERT(decompress_code(image.code, image.get_dict_views(), cfg_builder.build()) == text)
+        DUMMY_ASSERT(!events.empty() && events.front().phase == progress_phase::DECODE && events.front().processed == 0)
+        DUMMY_ASSERT(events.back().phase == progress_phase::DECODE && events.back().processed == cmds_cnt)
+
+        // Token cancelled while encoding stops compression, cancelled token
+        // doesn't let decompression start
+        cancel_token cancel;
+        cfg_builder.set_cancel_token(cancel);
+        cfg_builder.set_progress([cancel](progress_phase phase, size_t, size_t) mutable
+        {
+            if (phase == progress_phase::ENCODE)
+                cancel.cancel();
+        });
+        bool aborted = false;
+        try {
+            compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        } catch (operation_cancelled &) {
+            aborted = true;
+        }
+        DUMMY_ASSERT(aborted && cancel.is_cancelled())
+
+        aborted = false;
+        try {
+            decompress_code(image.code, image.get_dict_views(), cfg_builder.build());
+        } catch (operation_cancelled &) {
+            aborted = true;
+        }
+        DUMMY_ASSERT(aborted)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_memory_budget_keeps_result()
+{
+    ELFIO::elfio reader;
+    DUMMY_ASSERT(reader.load("./tests/hello_world-rv32i.o"))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_QUAD, encode_type::RV32I_FIELDS, encode_type::FIXED16 };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image expected = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+
+        DUMMY_ASSERT(sz_stat.peak_histogram_memory > text.size())
+        DUMMY_ASSERT(sz_stat.peak_dictionary_memory > text.size())
+        DUMMY_ASSERT(sz_stat.peak_encode_memory > text.size() + sz_stat.final_code_size)
+        DUMMY_ASSERT(sz_stat.peak_memory == std::max({ sz_stat.peak_histogram_memory, sz_stat.peak_dictionary_memory, sz_stat.peak_encode_memory }))
+
+        // Budget too small for any histogram, flat ones are used where they are
+        // smaller and give the same dictionaries
+        cfg_builder.set_memory_budget(1);
+        utils::size_stat budget_stat;
+        code_image image = compress_code(budget_stat, dict_infos, text, cfg_builder.build());
+        DUMMY_ASSERT(image.code == expected.code)
+        DUMMY_ASSERT(image.get_dicts() == expected.get_dicts())
+        DUMMY_ASSERT(budget_stat.peak_histogram_memory <= sz_stat.peak_histogram_memory)
+        DUMMY_ASSERT(encode_types[i] != encode_type::DICT || budget_stat.peak_histogram_memory < sz_stat.peak_histogram_memory)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_runtime_matches_full_decoder()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+    const std::pair<encode_type, bool> configs[] = {
+        { encode_type::DICT, false }, { encode_type::DICT, true }, { encode_type::MASK_SINGLE, false }, { encode_type::MASK_SINGLE, true },
+        { encode_type::MASK_DUO, false }, { encode_type::MASK_QUAD, false }, { encode_type::MASK_OPERANDS_OPCODE, false },
+        { encode_type::MASK_DUO_QUAD, false }, { encode_type::RV32I_FIELDS, false }, { encode_type::FIXED16, false },
+        { encode_type::DICT_BLOCKS, false },
+        { encode_type::MASK_MULTI, false }
+    };
+    for (size_t i = 0; i < ARRLEN(configs); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(configs[i].first);
+        cfg_builder.set_entropy_coding(configs[i].second);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        std::vector<uint8_t> expected = decompress_code(image.code, image.get_dict_views());
+
+        drt_image img = { { image.code.data(), image.code.size() }, { } };
+        for (const auto &dict : image.get_dicts())
+        {
+            int slot = drt_dict_slot(dict.first.c_str());
+            if (slot >= 0)
+                img.dicts[slot] = { dict.second.data(), dict.second.size() };
+        }
+
+        drt_header hdr;
+        DUMMY_ASSERT(drt_read_header(&img, &hdr) == DRT_OK && drt_check(&img) == DRT_OK)
+        DUMMY_ASSERT(hdr.etype == (unsigned)configs[i].first && hdr.cmds_cnt * 4 == expected.size())
+        size_t cmds_cnt = hdr.cmds_cnt;
+
+        std::vector<uint32_t> work(drt_work_words(&img));
+        std::vector<uint32_t> out(cmds_cnt);
+        size_t out_cnt = 0;
+        DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, work.data(), work.size()) == DRT_OK)
+        DUMMY_ASSERT(out_cnt == cmds_cnt && memcmp(out.data(), expected.data(), expected.size()) == 0)
+
+        // Damaged input is reported, not read past the end
+        DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size() - 1, &out_cnt, work.data(), work.size()) == DRT_ERR_NO_SPACE)
+        img.code.size--;
+        DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, work.data(), work.size()) != DRT_OK)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_function_units_decode_independently()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+    ELFIO::Elf64_Addr text_addr = text_sec->get_address();
+
+    const std::pair<encode_type, bool> configs[] = {
+        { encode_type::DICT, false }, { encode_type::DICT, true }, { encode_type::MASK_SINGLE, true }, { encode_type::MASK_QUAD, false },
+        { encode_type::MASK_DUO_QUAD, false }, { encode_type::RV32I_FIELDS, false }, { encode_type::FIXED16, false },
+        { encode_type::DICT_BLOCKS, false },
+        { encode_type::MASK_MULTI, false }
+    };
+    for (size_t i = 0; i < ARRLEN(configs); ++i)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        config_builder cfg_builder;
+        cfg_builder.set_etype(configs[i].first);
+        cfg_builder.set_entropy_coding(configs[i].second);
+        cfg_builder.set_function_units(true);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.func_table_size != 0)
+
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        std::span<const uint8_t> code((const uint8_t *)code_sec->get_data(), code_sec->get_size());
+        dict_views dicts = get_dict_views(&reader);
+        func_table ftab = get_func_table(dicts);
+        DUMMY_ASSERT(ftab.get_units().size() > 1)
+
+        drt_image img = { { code.data(), code.size() }, { } };
+        for (const auto &dict : dicts)
+        {
+            int slot = drt_dict_slot(dict.first.c_str());
+            if (slot >= 0)
+                img.dicts[slot] = { dict.second.data(), dict.second.size() };
+        }
+        std::vector<uint32_t> work(drt_work_words(&img));
+
+        for (const auto &unit : ftab.get_units())
+        {
+            std::vector<uint8_t> expected(text.begin() + unit.text_offset, text.begin() + unit.text_offset + unit.text_size);
+            DUMMY_ASSERT(decompress_function(&reader, text_addr + unit.text_offset + unit.text_size - 4) == expected)
+
+            std::vector<uint32_t> out(unit.text_size / 4);
+            size_t out_cnt = 0, func_offset = 1;
+            DUMMY_ASSERT(drt_decompress_function(&img, unit.text_offset, out.data(), out.size(), &out_cnt, &func_offset,
+                work.data(), work.size()) == DRT_OK)
+            DUMMY_ASSERT(func_offset == unit.text_offset && out_cnt == out.size())
+            DUMMY_ASSERT(memcmp(out.data(), expected.data(), expected.size()) == 0)
+        }
+
+        size_t out_cnt = 0, func_offset = 0;
+        DUMMY_ASSERT(drt_decompress_function(&img, text.size(), nullptr, 0, &out_cnt, &func_offset, work.data(), work.size()) == DRT_ERR_NO_FUNCTION)
+    }
+
+    // Without function units there is nothing to look up
+    DUMMY_ASSERT(reader.load(ifilename))
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    compress_executable(sz_stat, dict_infos, &reader, config());
+    DUMMY_ASSERT(get_func_table(get_dict_views(&reader)).get_units().empty())
+    bool thrown = false;
+    try
+    {
+        decompress_function(&reader, text_addr);
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+    DUMMY_ASSERT(thrown)
+
+    DUMMY_TEST_PASS()
+}
+
+// Hand assembled rv32i for interpreter tests
+static uint32_t rv_r(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd)
+{
+    return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | 0x33;
+}
+
+static uint32_t rv_i(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+    return ((uint32_t)imm & 0xfff) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+static uint32_t rv_s(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3)
+{
+    uint32_t u = imm & 0xfff;
+    return (u >> 5) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (u & 0x1f) << 7 | 0x23;
+}
+
+static uint32_t rv_b(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3)
+{
+    uint32_t u = imm & 0x1fff;
+    return ((u >> 12) & 1) << 31 | ((u >> 5) & 0x3f) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | ((u >> 1) & 0xf) << 8 | ((u >> 11) & 1) << 7 | 0x63;
+}
+
+static uint32_t rv_j(int32_t imm, uint32_t rd)
+{
+    uint32_t u = imm & 0x1fffff;
+    return ((u >> 20) & 1) << 31 | ((u >> 1) & 0x3ff) << 21 | ((u >> 11) & 1) << 20 | ((u >> 12) & 0xff) << 12 | rd << 7 | 0x6f;
+}
+
+bool test_rv32i_run_compressed_matches_plain()
+{
+    // s0 = 0; for (s1 = 1; s1 < 101; ++s1) { s0 += s1; mix(); }
+    // write(1, &s0, 4); exit(s0 & 0xff)
+    const size_t mix = 47;
+    std::vector<uint32_t> program = {
+        rv_i(-64, 2, 0, 2, 0x13), rv_i(0, 0, 0, 8, 0x13), rv_i(1, 0, 0, 9, 0x13), rv_i(101, 0, 0, 18, 0x13),
+        rv_r(0, 9, 8, 0, 8), rv_j((mix - 5) * 4, 1), rv_i(1, 9, 0, 9, 0x13), rv_b(-3 * 4, 18, 9, 4),
+        rv_s(0, 8, 2, 2), rv_i(1, 0, 0, 10, 0x13), rv_i(0, 2, 0, 11, 0x13), rv_i(4, 0, 0, 12, 0x13), rv_i(64, 0, 0, 17, 0x13), 0x00000073,
+        rv_i(255, 8, 7, 10, 0x13), rv_i(93, 0, 0, 17, 0x13), 0x00000073
+    };
+    program.resize(mix, 0x00000013);
+    // mix: s0 ^= s1 << 3; s0 += (uint8_t)((int32_t)(s0 - s1) >> 1) through stack
+    const uint32_t mix_body[] = {
+        rv_i(3, 9, 1, 5, 0x13), rv_r(0, 5, 8, 4, 8), rv_r(0x20, 9, 8, 0, 6), rv_i(0x401, 6, 5, 6, 0x13),
+        rv_s(8, 6, 2, 0), rv_i(8, 2, 4, 7, 0x03), rv_r(0, 7, 8, 0, 8), 0x00008067
+    };
+    program.insert(program.end(), mix_body, mix_body + ARRLEN(mix_body));
+
+    uint32_t expected = 0;
+    for (uint32_t i = 1; i < 101; ++i)
+    {
+        expected += i;
+        expected ^= i << 3;
+        expected += (uint8_t)((int32_t)(expected - i) >> 1);
+    }
+
+    const std::string filename = "./tests/interp.exe";
+    workload_write_elf(filename, std::span<const uint8_t>((const uint8_t *)program.data(), program.size() * 4));
+    ELFIO::elfio reader;
+    DUMMY_ASSERT(reader.load(filename))
+    interp_stat base = rv32i_run(&reader);
+    DUMMY_ASSERT(base.exit_code == (int)(expected & 0xff))
+    DUMMY_ASSERT(base.output == std::string((const char *)&expected, 4))
+    DUMMY_ASSERT(base.cache_hits == 0 && base.cache_misses == 0)
+
+    const std::pair<encode_type, bool> configs[] = {
+        { encode_type::DICT, false }, { encode_type::DICT, true }, { encode_type::MASK_SINGLE, false },
+        { encode_type::MASK_QUAD, false }, { encode_type::RV32I_FIELDS, false }, { encode_type::FIXED16, false },
+        { encode_type::DICT_BLOCKS, false },
+        { encode_type::MASK_MULTI, false }
+    };
+    for (size_t i = 0; i < ARRLEN(configs); ++i)
+    {
+        DUMMY_ASSERT(reader.load(filename))
+        config_builder cfg_builder;
+        cfg_builder.set_etype(configs[i].first);
+        cfg_builder.set_entropy_coding(configs[i].second);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+        interp_stat stat = rv32i_run(&reader);
+        DUMMY_ASSERT(stat.exit_code == base.exit_code && stat.output == base.output && stat.instructions == base.instructions)
+        DUMMY_ASSERT(stat.cache_hits + stat.cache_misses == stat.instructions && stat.cache_misses == 4)
+        DUMMY_ASSERT(stat.decoded == program.size() && stat.bits_per_instruction() > 0)
+
+        // Loop and mix fight for the only line
+        interp_params params;
+        params.cache_sets = 1;
+        params.cache_ways = 1;
+        interp_stat thrash = rv32i_run(&reader, params);
+        DUMMY_ASSERT(thrash.output == base.output && thrash.cache_misses > 200)
+        DUMMY_ASSERT(thrash.work.bits > stat.work.bits && thrash.hit_rate() < stat.hit_rate())
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_result_cache_hit_matches_fresh()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    const std::string cache_dir = "./tests/cache";
+    std::filesystem::remove_all(cache_dir);
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::DICT);
+    cfg_builder.set_entropy_coding(true);
+    utils::size_stat fresh_stat;
+    std::vector<std::string> fresh_infos;
+    code_image fresh = compress_code(fresh_stat, fresh_infos, text, cfg_builder.build());
+    DUMMY_ASSERT(fresh_stat.cache_hits == 0 && fresh_stat.cache_misses == 0)
+
+    cfg_builder.set_cache_dir(cache_dir);
+    for (size_t run = 0; run < 2; ++run)
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.cache_hits == run && sz_stat.cache_misses == 1 - run)
+        DUMMY_ASSERT(image.code == fresh.code && image.get_dicts() == fresh.get_dicts() && dict_infos == fresh_infos)
+        DUMMY_ASSERT(sz_stat.final_code_size == fresh_stat.final_code_size && sz_stat.dict_32_bit_size == fresh_stat.dict_32_bit_size)
+        DUMMY_ASSERT(sz_stat.entropy_table_size == fresh_stat.entropy_table_size)
+    }
+
+    // Any option of the key misses
+    cfg_builder.set_etype(encode_type::MASK_SINGLE);
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+    DUMMY_ASSERT(sz_stat.cache_misses == 1)
+
+    // Damaged entry is recomputed and rewritten
+    size_t entries = 0;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(cache_dir))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        ++entries;
+        std::fstream f(entry.path(), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(16);
+        f.put('\x5a');
+    }
+    DUMMY_ASSERT(entries == 2)
+    cfg_builder.set_etype(encode_type::DICT);
+    for (size_t run = 0; run < 2; ++run)
+    {
+        std::vector<std::string> infos;
+        code_image image = compress_code(sz_stat, infos, text, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.cache_hits == run && image.code == fresh.code && image.get_dicts() == fresh.get_dicts())
+    }
+
+    // ELF path goes through the same cache, entry points are part of the key
+    for (size_t run = 0; run < 2; ++run)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.cache_hits == run)
+    }
+    ELFIO::elfio original;
+    DUMMY_ASSERT(original.load(ifilename))
+    decompress_executable(&reader);
+    DUMMY_ASSERT(compare_by_text_section(&reader, &original))
+
+    std::filesystem::remove_all(cache_dir);
+    DUMMY_TEST_PASS()
+}
+
+bool test_code_header_checks_before_decode()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+
+    const std::pair<encode_type, bool> configs[] = {
+        { encode_type::DICT, true }, { encode_type::MASK_DUO, false }, { encode_type::MASK_OPERANDS_OPCODE, false }, { encode_type::RV32I_FIELDS, false }
+    };
+    for (size_t i = 0; i < ARRLEN(configs); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(configs[i].first);
+        cfg_builder.set_entropy_coding(configs[i].second);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        DUMMY_ASSERT(check_code(image.code, image.get_dict_views()))
+
+        // Header lists dictionaries of the stream, not position tables
+        size_t header_size = 0;
+        code_header header = code_header::deserialize(image.code, header_size);
+        DUMMY_ASSERT(header.etype == configs[i].first && header.cmds_cnt * RV32I_CMDLEN == text.size())
+        DUMMY_ASSERT(header.dicts.size() + 1 == image.get_dicts().size())
+        for (const auto &dict : header.dicts)
+            DUMMY_ASSERT(image.find_dict(dict.name) != nullptr && image.find_dict(dict.name)->size() == dict.size)
+
+        // Damaged dictionary or stream is found before decoding
+        code_image damaged = image;
+        std::vector<uint8_t> dict = *image.find_dict(header.dicts[0].name);
+        dict[0] ^= 1;
+        dict_views views = image.get_dict_views();
+        views[header.dicts[0].name] = dict;
+        DUMMY_ASSERT(!check_code(image.code, views))
+        damaged.code.back() ^= 0x80;
+        DUMMY_ASSERT(!check_code(damaged.code, image.get_dict_views()))
+        bool thrown = false;
+        try
+        {
+            decompress_code(damaged.code, image.get_dict_views());
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+
+        drt_image img = { { image.code.data(), image.code.size() }, { } };
+        for (const auto &d : views)
+        {
+            int slot = drt_dict_slot(d.first.c_str());
+            if (slot >= 0)
+                img.dicts[slot] = { d.second.data(), d.second.size() };
+        }
+        DUMMY_ASSERT(drt_check(&img) == DRT_ERR_CHECKSUM)
+        img.dicts[drt_dict_slot(header.dicts[0].name.c_str())] = { image.find_dict(header.dicts[0].name)->data(), dict.size() };
+        DUMMY_ASSERT(drt_check(&img) == DRT_OK)
+
+        // Layout this build can't decode is rejected by both decoders
+        code_header tuned = header;
+        tuned.parts[0].indx_size++;
+        std::vector<uint8_t> tuned_code = tuned.serialize();
+        tuned_code.insert(tuned_code.end(), image.code.begin() + header_size, image.code.end());
+        DUMMY_ASSERT(!check_code(tuned_code, image.get_dict_views()))
+        thrown = false;
+        try
+        {
+            decompress_code(tuned_code, image.get_dict_views());
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+        tuned.parts.pop_back();
+        tuned_code = tuned.serialize();
+        tuned_code.insert(tuned_code.end(), image.code.begin() + header_size, image.code.end());
+        img.code = { tuned_code.data(), tuned_code.size() };
+        drt_header hdr;
+        DUMMY_ASSERT(drt_read_header(&img, &hdr) == DRT_ERR_UNSUPPORTED)
+        tuned_code[5] ^= 1;
+        DUMMY_ASSERT(drt_read_header(&img, &hdr) == DRT_ERR_CHECKSUM)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_dict_blocks_adapt_to_blocks()
+{
+    // Halves of .text with 3000 different commands each: together they don't
+    // fit one 12 bit dictionary, each half fits its own
+    std::vector<uint32_t> program;
+    for (uint32_t i = 0; i < 8192; ++i)
+        program.push_back(i < 4096 ? rv_i(i % 3000, 2, 0, 1, 0x13) : (i % 3000) << 12 | 5 << 7 | 0x37);
+    std::span<const uint8_t> text((const uint8_t *)program.data(), program.size() * 4);
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::DICT);
+    utils::size_stat dict_stat;
+    std::vector<std::string> dict_infos;
+    code_image dict_image = compress_code(dict_stat, dict_infos, text, cfg_builder.build());
+
+    cfg_builder.set_etype(encode_type::DICT_BLOCKS);
+    cfg_builder.set_block_dicts(1);
+    utils::size_stat single_stat;
+    code_image single = compress_code(single_stat, dict_infos, text, cfg_builder.build());
+
+    // Equal blocks end up in one cluster, so one dictionary per half is left
+    cfg_builder.set_block_dicts(4);
+    cfg_builder.set_function_units(true);
+    utils::size_stat sz_stat;
+    dict_infos.clear();
+    std::vector<func_range> functions = { { 4000 * 4, 200 * 4 } };
+    code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build(), {}, functions);
+    DUMMY_ASSERT(dict_infos.size() == 2)
+    DUMMY_ASSERT(sz_stat.dict_32_bit_size == 6000 * 4 && sz_stat.block_map_size == 2 + 2 * 2 + 32)
+    DUMMY_ASSERT(image.code.size() < single.code.size() && image.code.size() < dict_image.code.size())
+
+    const std::vector<uint8_t> *map_data = image.find_dict(".dict.blocks");
+    DUMMY_ASSERT(map_data != nullptr)
+    block_map bmap = block_map::deserialize((const char *)map_data->data(), map_data->size());
+    DUMMY_ASSERT(bmap.get_blocks_cnt() == 32 && bmap.get_dict(0) != bmap.get_dict(4096))
+    for (size_t b = 0; b < bmap.get_blocks_cnt(); ++b)
+        DUMMY_ASSERT(bmap.get_block_dicts()[b] == bmap.get_block_dicts()[b < 16 ? 0 : 16])
+
+    std::vector<uint8_t> expected(text.begin(), text.end());
+    dict_views dicts = image.get_dict_views();
+    DUMMY_ASSERT(decompress_code(image.code, dicts) == expected)
+    std::vector<uint8_t> func_expected(text.begin() + 4000 * 4, text.begin() + 4200 * 4);
+    DUMMY_ASSERT(decompress_function(image.code, dicts, 4100 * 4) == func_expected)
+
+    drt_image img = { { image.code.data(), image.code.size() }, { } };
+    for (const auto &dict : dicts)
+    {
+        int slot = drt_dict_slot(dict.first.c_str());
+        if (slot >= 0)
+            img.dicts[slot] = { dict.second.data(), dict.second.size() };
+    }
+    std::vector<uint32_t> out(program.size());
+    size_t out_cnt = 0, func_offset = 0;
+    DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, nullptr, 0) == DRT_OK && out == program)
+    DUMMY_ASSERT(drt_decompress_function(&img, 4100 * 4, out.data(), out.size(), &out_cnt, &func_offset, nullptr, 0) == DRT_OK)
+    DUMMY_ASSERT(func_offset == 4000 * 4 && out_cnt == 200 && memcmp(out.data(), func_expected.data(), func_expected.size()) == 0)
+
+    // Commands fetched from any address are decoded with dictionary of their block
+    const std::string filename = "./tests/blocks.exe";
+    workload_write_elf(filename, text);
+    ELFIO::elfio reader;
+    DUMMY_ASSERT(reader.load(filename))
+    cfg_builder.set_function_units(false);
+    compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+    ELFIO::Elf64_Addr text_addr = get_section_with_name(&reader, ".text")->get_address();
+    std::vector<command> restored = decompress_commands_at(&reader, text_addr + 4094 * 4, 4);
+    DUMMY_ASSERT(restored.size() == 4)
+    for (size_t i = 0; i < restored.size(); ++i)
+        DUMMY_ASSERT(restored[i].to_size_t() == program[4094 + i])
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_hot_dict_short_indices()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+    size_t cmds_cnt = text.size() / RV32I_CMDLEN;
+
+    const std::pair<encode_type, size_t> configs[] = {
+        { encode_type::DICT, 16 }, { encode_type::DICT, 64 }, { encode_type::MASK_SINGLE, 16 }, { encode_type::MASK_SINGLE, 64 }
+    };
+    for (size_t i = 0; i < ARRLEN(configs); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(configs[i].first);
+        utils::size_stat one_stat;
+        std::vector<std::string> dict_infos;
+        code_image one_level = compress_code(one_stat, dict_infos, text, cfg_builder.build());
+
+        // Same dictionary and hits, the most used entries get short indices
+        cfg_builder.set_hot_dict(configs[i].second);
+        utils::size_stat sz_stat;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        const std::vector<uint8_t> *hot_data = image.find_dict(".dict.hot");
+        DUMMY_ASSERT(hot_data != nullptr && hot_data->size() == sz_stat.hot_table_size)
+        DUMMY_ASSERT(sz_stat.hot_table_size <= configs[i].second * 4 && *image.find_dict(".dict") == *one_level.find_dict(".dict"))
+        DUMMY_ASSERT(one_stat.hot_dict_hits == 0 && one_stat.cold_dict_hits != 0)
+        DUMMY_ASSERT(sz_stat.hot_dict_hits + sz_stat.cold_dict_hits == one_stat.cold_dict_hits)
+        DUMMY_ASSERT(sz_stat.hot_dict_hits != 0 && sz_stat.final_code_size < one_stat.final_code_size)
+
+        dict_views dicts = image.get_dict_views();
+        DUMMY_ASSERT(decompress_code(image.code, dicts) == text)
+
+        drt_image img = { { image.code.data(), image.code.size() }, { } };
+        for (const auto &dict : dicts)
+        {
+            int slot = drt_dict_slot(dict.first.c_str());
+            if (slot >= 0)
+                img.dicts[slot] = { dict.second.data(), dict.second.size() };
+        }
+        std::vector<uint32_t> out(cmds_cnt);
+        size_t out_cnt = 0;
+        DUMMY_ASSERT(drt_check(&img) == DRT_OK)
+        DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, nullptr, 0) == DRT_OK)
+        DUMMY_ASSERT(out_cnt == cmds_cnt && memcmp(out.data(), text.data(), text.size()) == 0)
+
+        // Stream walkers skip codewords of both tiers
+        DUMMY_ASSERT(reader.load(ifilename))
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        std::vector<block_trace> traces = trace_executable(&reader);
+        size_t bits = 0;
+        for (const auto &trace : traces)
+            bits += trace.bits;
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        size_t header_size = 0;
+        code_header::deserialize(std::span<const uint8_t>((const uint8_t *)code_sec->get_data(), code_sec->get_size()), header_size);
+        DUMMY_ASSERT(traces.size() == cmds_cnt && (bits + 7) / 8 + header_size == code_sec->get_size())
+
+        std::vector<command> restored = decompress_commands_at(&reader, code_sec->get_address(), cmds_cnt);
+        DUMMY_ASSERT(restored.size() == cmds_cnt)
+        for (size_t j = 0; j < cmds_cnt; ++j)
+            DUMMY_ASSERT(restored[j].to_size_t() == ((const uint32_t *)text.data())[j])
+    }
+
+    const std::pair<encode_type, size_t> bad_configs[] = {
+        { encode_type::FIXED16, 16 }, { encode_type::DICT, 1 }, { encode_type::DICT, 512 }
+    };
+    for (size_t i = 0; i <= ARRLEN(bad_configs); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(i < ARRLEN(bad_configs) ? bad_configs[i].first : encode_type::MASK_SINGLE);
+        cfg_builder.set_hot_dict(i < ARRLEN(bad_configs) ? bad_configs[i].second : 16);
+        cfg_builder.set_entropy_coding(i == ARRLEN(bad_configs));
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        bool thrown = false;
+        try
+        {
+            compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_mask_multi_codes_two_window_changes()
+{
+    // 8192 entries used twice fill the dictionary, then commands that differ
+    // from them in rd and high bits of immediate
+    std::vector<uint32_t> program;
+    for (uint32_t r = 0; r < 2; ++r)
+    {
+        for (uint32_t i = 0; i < 8192; ++i)
+            program.push_back(rv_i(i % 256, i / 256, 0, 1, 0x13));
+    }
+    for (uint32_t i = 0; i < 2000; ++i)
+        program.push_back(rv_i((i % 256) | (1 + i % 15) << 8, i / 256, 0, 3, 0x13));
+    std::span<const uint8_t> text((const uint8_t *)program.data(), program.size() * 4);
+    std::vector<uint8_t> expected(text.begin(), text.end());
+
+    const std::string filename = "./tests/mask_multi.exe";
+    workload_write_elf(filename, text);
+    const encode_type encode_types[] = { encode_type::MASK_SINGLE, encode_type::MASK_MULTI };
+    size_t code_sizes[2], literals[2], masked[2];
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+        code_sizes[i] = image.code.size();
+        DUMMY_ASSERT(sz_stat.dict_32_bit_size == 8192 * 4)
+
+        dict_views dicts = image.get_dict_views();
+        DUMMY_ASSERT(decompress_code(image.code, dicts) == expected)
+
+        drt_image img = { { image.code.data(), image.code.size() }, { } };
+        for (const auto &dict : dicts)
+        {
+            int slot = drt_dict_slot(dict.first.c_str());
+            if (slot >= 0)
+                img.dicts[slot] = { dict.second.data(), dict.second.size() };
+        }
+        std::vector<uint32_t> out(program.size());
+        size_t out_cnt = 0;
+        DUMMY_ASSERT(drt_check(&img) == DRT_OK)
+        DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, nullptr, 0) == DRT_OK && out == program)
+
+        ELFIO::elfio reader;
+        DUMMY_ASSERT(reader.load(filename))
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        std::vector<block_trace> traces = trace_executable(&reader);
+        size_t bits = 0;
+        literals[i] = masked[i] = 0;
+        for (const auto &trace : traces)
+        {
+            bits += trace.bits;
+            literals[i] += trace.dict_reads == 0;
+            masked[i] += trace.mask_applies != 0;
+        }
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        size_t header_size = 0;
+        code_header::deserialize(std::span<const uint8_t>((const uint8_t *)code_sec->get_data(), code_sec->get_size()), header_size);
+        DUMMY_ASSERT(traces.size() == program.size() && (bits + 7) / 8 + header_size == code_sec->get_size())
+
+        std::vector<command> restored = decompress_commands_at(&reader, code_sec->get_address() + 16382 * 4, 4);
+        DUMMY_ASSERT(restored.size() == 4)
+        for (size_t j = 0; j < restored.size(); ++j)
+            DUMMY_ASSERT(restored[j].to_size_t() == program[16382 + j])
+    }
+
+    // One nibble mask can't restore both changes, two windows can
+    DUMMY_ASSERT(literals[0] == 2000 && masked[0] == 0)
+    DUMMY_ASSERT(literals[1] == 0 && masked[1] == 2000)
+    DUMMY_ASSERT(code_sizes[1] < code_sizes[0])
+
+    DUMMY_TEST_PASS()
+}
+
+/* Модульные тесты */
+/* find_mask */
+bool test_find_mask_full_finded_in_dictionary()
+{
+    utils::command cmd;
+    cmd.add(0xffff, 16);
+    std::vector<utils::command> entab_commands = { cmd };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    dynbitset mask;
+    size_t pos, indx;
+    DUMMY_ASSERT(!(find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_find_mask_find_single_1_diff()
+{
+    utils::command dict_cmd;
+    dict_cmd.add(0xffff, 16);
+    std::vector<utils::command> entab_commands = { dict_cmd };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xafff, 16);
+    dynbitset mask;
+    size_t pos, indx;
+    DUMMY_ASSERT((find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+
+    dynbitset target_mask;
+    target_mask.add(0xa, 4);
+    DUMMY_ASSERT(mask == target_mask)
+    DUMMY_ASSERT(pos == 3)
+    DUMMY_ASSERT(indx == 0)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_find_mask_find_single_2_diff()
+{
+    utils::command dict_cmd;
+    dict_cmd.add(0xffff, 16);
+    std::vector<utils::command> entab_commands = { dict_cmd };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xffaf, 16);
+    dynbitset mask;
+    size_t pos, indx;
+    DUMMY_ASSERT((find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+
+    dynbitset target_mask;
+    target_mask.add(0xa, 4);
+    DUMMY_ASSERT(mask == target_mask)
+    DUMMY_ASSERT(pos == 1)
+    DUMMY_ASSERT(indx == 0)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_find_mask_find_many_diff()
+{
+    utils::command dict_cmd;
+    dict_cmd.add(0xffff, 16);
+    std::vector<utils::command> entab_commands = { dict_cmd };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xafaf, 16);
+    dynbitset mask;
+    size_t pos, indx;
+    DUMMY_ASSERT((!find_mask<2, 2, 4, 1>(mask, pos, indx, entab, cmd)))
+
+    DUMMY_TEST_PASS()
+}
+
+/* make_encode_table */
+bool test_dict_make_encode_table_default()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+    cmd4.add(0xfffa, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd1, cmd1, cmd2, cmd3, cmd3, cmd4 };
+
+    config cfg;
+    encode_table<2, 1> entab;
+    dict_make_encode_table(entab_commands, cfg, entab);
+
+    auto entries = entab.get_entries();
+    DUMMY_ASSERT(entries.size() == 2);
+    DUMMY_ASSERT(entries[0] == cmd1 || entries[0] == cmd3);
+    DUMMY_ASSERT(entries[1] == cmd1 || entries[1] == cmd3);
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_dict_make_encode_table_exec_counts()
+{
+    utils::command cmd1, cmd2, cmd3;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd1, cmd1, cmd2, cmd3, cmd3 };
+
+    // cmd2 is executed 10 times, so it outweighs statically frequent ones
+    config_builder cfg_builder;
+    cfg_builder.set_exec_counts({ 0, 0, 0, 10, 0, 0 });
+    for (size_t budget : { 0, 1 })
+    {
+        cfg_builder.set_memory_budget(budget);
+        encode_table<2, 1> entab;
+        dict_make_encode_table(entab_commands, cfg_builder.build(), entab);
+
+        auto entries = entab.get_entries();
+        DUMMY_ASSERT(entries.size() == 2);
+        DUMMY_ASSERT(entries[0] == cmd2);
+        DUMMY_ASSERT(entries[1] == cmd1);
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_dict_make_encode_table_threads_match_serial()
+{
+    // Many values with equal counts around the dictionary size
+    std::vector<utils::command> commands;
+    for (size_t i = 0; i < 70000; ++i)
+    {
+        command cmd;
+        cmd.add((i * 2654435761u) % (i % 3 == 0 ? 300 : 40000), 32);
+        commands.push_back(cmd);
+    }
+    std::vector<uint64_t> exec_counts(commands.size());
+    for (size_t i = 0; i < exec_counts.size(); ++i)
+        exec_counts[i] = i % 7 == 0 ? i % 5 : 0;
+
+    for (bool profiled : { false, true })
+    {
+        config_builder cfg_builder;
+        if (profiled)
+            cfg_builder.set_exec_counts(exec_counts);
+        encode_table<4, 12> serial;
+        encode_table<2, 8> serial_half;
+        auto high_half = [](const command &cmd, command &part) {
+            part.add(cmd.to_size_t() >> 16, 16);
+            return true;
+        };
+        dict_make_encode_table(commands, cfg_builder.build(), serial);
+        dict_make_encode_table(commands, cfg_builder.build(), serial_half, nullptr, high_half);
+        DUMMY_ASSERT(serial.get_entries_cnt() == 1 << 12 && histogram_threads(cfg_builder.build(), commands.size()) == 1)
+
+        const std::pair<size_t, size_t> configs[] = { { 2, 0 }, { 3, 0 }, { 0, 0 }, { 16, 0 }, { 1, 1 }, { 4, 1 }, { 4, 2 << 20 } };
+        for (size_t i = 0; i < ARRLEN(configs); ++i)
+        {
+            cfg_builder.set_histogram_threads(configs[i].first);
+            cfg_builder.set_memory_budget(configs[i].second);
+            encode_table<4, 12> entab;
+            encode_table<2, 8> entab_half;
+            memory_meter meter;
+            dict_make_encode_table(commands, cfg_builder.build(), entab, &meter);
+            dict_make_encode_table(commands, cfg_builder.build(), entab_half, nullptr, high_half);
+            DUMMY_ASSERT(entab.get_entries() == serial.get_entries() && entab_half.get_entries() == serial_half.get_entries())
+            DUMMY_ASSERT(meter.get_allocated() == 0 && meter.get_peak(progress_phase::HISTOGRAM) != 0)
+        }
+        // 2 MiB budget holds windows of 2 threads
+        DUMMY_ASSERT(histogram_threads(cfg_builder.build(), commands.size()) == 2 && histogram_threads(cfg_builder.build(), 100) == 1)
+        cfg_builder.set_memory_budget(0);
+        DUMMY_ASSERT(histogram_threads(cfg_builder.build(), commands.size()) == 4)
+    }
+
+    // Calling thread reports progress of histogram threads and stops them
+    // when cancelled
+    config_builder cfg_builder;
+    cfg_builder.set_histogram_threads(4);
+    std::vector<size_t> reported;
+    cfg_builder.set_progress([&reported](progress_phase phase, size_t processed, size_t)
+    {
+        if (phase == progress_phase::HISTOGRAM)
+            reported.push_back(processed);
+    });
+    encode_table<4, 12> entab;
+    dict_make_encode_table(commands, cfg_builder.build(), entab);
+    DUMMY_ASSERT(std::is_sorted(reported.begin(), reported.end()) && reported.back() == commands.size())
+
+    cancel_token cancel;
+    cfg_builder.set_cancel_token(cancel);
+    cfg_builder.set_progress([cancel](progress_phase, size_t, size_t) mutable
+    {
+        cancel.cancel();
+    });
+    bool aborted = false;
+    try {
+        dict_make_encode_table(commands, cfg_builder.build(), entab);
+    } catch (operation_cancelled &) {
+        aborted = true;
+    }
+    DUMMY_ASSERT(aborted)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_exec_profile_load_default()
+{
+    const std::string filename = "./tests/profile.txt";
+    {
+        std::ofstream out(filename);
+        out << "# pc count\n"
+            << "10000 5\n"
+            << "0x10008\n"
+            << "\n"
+            << "10008   # trace line\n"
+            << "1000a 2\n"
+            << "20000 7\n";
+    }
+
+    exec_profile profile = exec_profile::load(filename);
+    DUMMY_ASSERT(profile.get_pc_cnt() == 4)
+    DUMMY_ASSERT(profile.get_count(0x10000) == 5)
+    DUMMY_ASSERT(profile.get_count(0x10004) == 0)
+
+    std::vector<uint64_t> expected = { 5, 0, 4 };
+    DUMMY_ASSERT(profile.get_counts(0x10000, 3) == expected)
+
+    {
+        std::ofstream out(filename);
+        out << "10000 x\n";
+    }
+    bool thrown = false;
+    try
+    {
+        exec_profile::load(filename);
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+    DUMMY_ASSERT(thrown)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_flat_histogram_merge_default()
+{
+    flat_histogram hist;
+    flat_histogram window = { { 5, 1 }, { 1, 1 }, { 5, 1 } };
+    flat_histogram_merge(hist, window, nullptr);
+    DUMMY_ASSERT(window.empty())
+    window = { { 7, 1 }, { 1, 3 }, { 0, 1 } };
+    flat_histogram_merge(hist, window, nullptr);
+
+    flat_histogram expected = { { 0, 1 }, { 1, 4 }, { 5, 2 }, { 7, 1 } };
+    DUMMY_ASSERT(hist == expected)
+
+    DUMMY_TEST_PASS()
+}
+
+/* compress */
+bool test_compress_command_with_mask_not_compressed()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+    cmd4.add(0xfffa, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xaaaa, 16);
+    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
+    utils::command target_cmd;
+    target_cmd.add(0x15554, 17);
+    DUMMY_ASSERT(ccmd == target_cmd)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_compress_command_with_mask_dict_compressed()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+    cmd4.add(0xfffa, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xfffd, 16);
+    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
+    utils::command target_cmd;
+    target_cmd.add(0b111, 3);
+    DUMMY_ASSERT(ccmd == target_cmd)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_compress_command_with_mask_mask_compressed()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+    cmd4.add(0xfffa, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xffff, 16);
+    command ccmd = compress_command_with_mask<2, 2, 4, 1>(entab, cmd);
+    utils::command target_cmd;
+    target_cmd.add(0b11110001, 8);      // 0 - признак сжатия, 0 - признак маски, 00 - позиция, 1111 - маска
+    DUMMY_ASSERT(ccmd == target_cmd)
+
+    DUMMY_TEST_PASS()
+}
+
+bool compress_command_with_dictionary_not_compressed()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
+    cmd3.add(0xfffb, 16);
+    cmd4.add(0xfffa, 16);
+
+    std::vector<utils::command> entab_commands = { cmd1, cmd3 };
+    utils::encode_table<2, 1> entab(entab_commands);
+
+    utils::command cmd;
+    cmd.add(0xffff, 16);
+    command ccmd = compress_command_with_dictionary(entab, cmd);
+    utils::command target_cmd;
+    target_cmd.add(0x1fffe, 17);
+    DUMMY_ASSERT(ccmd == target_cmd)
+
+    DUMMY_TEST_PASS()
+}
+
+bool compress_command_with_dictionary_compressed()
+{
+    utils::command cmd1, cmd2, cmd3, cmd4;
+    cmd1.add(0xfffd, 16);
+    cmd2.add(0xfffc, 16);
     cmd3.add(0xfffb, 16);
     cmd4.add(0xfffa, 16);
 
@@ -689,36 +1862,256 @@ bool test_command_devide_full_0()
     DUMMY_ASSERT(cmd11.get_data_sz() == 0)
     DUMMY_ASSERT(cmd12 == cmd1)
 
-    command cmd21, cmd22;
-    cmd2.devide(cmd21, cmd22, 0);
-    DUMMY_ASSERT(cmd21.get_data_sz_bits() == 0)
-    DUMMY_ASSERT(cmd21.get_data_sz() == 0)
-    DUMMY_ASSERT(cmd22 == cmd2)
+    command cmd21, cmd22;
+    cmd2.devide(cmd21, cmd22, 0);
+    DUMMY_ASSERT(cmd21.get_data_sz_bits() == 0)
+    DUMMY_ASSERT(cmd21.get_data_sz() == 0)
+    DUMMY_ASSERT(cmd22 == cmd2)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_command_devide_half_default()
+{
+    command cmd1, cmd2;
+    cmd1.add(0xaffa, 16);
+    cmd2.add(0xfa, 8);
+
+    command target_cmd11, target_cmd12, target_cmd21, target_cmd22;
+    target_cmd11.add(0xfa, 8);
+    target_cmd12.add(0xaf, 8);
+    target_cmd21.add(0xa, 4);
+    target_cmd22.add(0xf, 4);
+
+    command cmd11, cmd12;
+    cmd1.devide_half(cmd11, cmd12);
+    DUMMY_ASSERT(cmd11 == target_cmd11)
+    DUMMY_ASSERT(cmd12 == target_cmd12)
+
+    command cmd21, cmd22;
+    cmd2.devide_half(cmd21, cmd22);
+    DUMMY_ASSERT(cmd21 == target_cmd21)
+    DUMMY_ASSERT(cmd22 == target_cmd22)
+
+    DUMMY_TEST_PASS()
+}
+
+/* fetch_model */
+bool test_simulate_fetch_default()
+{
+    fetch_params params;
+    params.buffer_bits = 64;
+    params.bus_bits = 32;
+    params.refill_latency = 1;
+    params.dict_latency = 2;
+    params.mask_latency = 1;
+
+    // Dictionary hits only: one beat feeds two codewords
+    block_trace hit;
+    hit.bits = 16;
+    hit.dict_reads = 1;
+    hit.dict_levels = 1;
+    std::vector<block_trace> traces(100, hit);
+
+    fetch_stat stat = simulate_fetch(traces, params);
+    DUMMY_ASSERT(stat.instructions == 100)
+    DUMMY_ASSERT(stat.stall_cycles == 1)
+    DUMMY_ASSERT(stat.cycles == 1 + 100 * 3)
+    DUMMY_ASSERT(stat.refill_bits == 100 * 16)
+
+    // Literals need more bits than a beat delivers per decode
+    block_trace literal;
+    literal.bits = 33;
+    traces.assign(100, literal);
+    stat = simulate_fetch(traces, params);
+    DUMMY_ASSERT(stat.stall_cycles > 0)
+    DUMMY_ASSERT(stat.cpi() > 1.0)
+
+    // Entropy coded literals don't fit after a whole beat, stalled decoder
+    // gets a partial one. Bus as wide as buffer too
+    literal.bits = 47;
+    traces.assign(4, literal);
+    stat = simulate_fetch(traces, params);
+    DUMMY_ASSERT(stat.instructions == 4 && stat.refill_bits >= 4 * 47)
+    params.bus_bits = 64;
+    stat = simulate_fetch(traces, params);
+    DUMMY_ASSERT(stat.instructions == 4 && stat.refill_bits >= 4 * 47)
+
+    DUMMY_TEST_PASS()
+}
+
+/* huffman_table */
+bool test_huffman_table_encode_decode_default()
+{
+    std::vector<size_t> freqs = { 100, 1, 0, 50, 7, 7, 3, 1000 };
+    huffman_table htab(freqs);
+
+    DUMMY_ASSERT(htab.get_code_len(2) == 0)
+    DUMMY_ASSERT(htab.get_code_len(7) <= htab.get_code_len(0))
+    DUMMY_ASSERT(htab.get_code_len(0) <= htab.get_code_len(1))
+
+    const size_t syms[] = { 0, 7, 1, 3, 4, 5, 6, 7, 7, 0 };
+    dynbitset bits;
+    for (size_t i = 0; i < ARRLEN(syms); ++i)
+        htab.encode(bits, syms[i]);
+
+    size_t pos = 0;
+    for (size_t i = 0; i < ARRLEN(syms); ++i)
+        DUMMY_ASSERT(htab.decode(bits, pos) == syms[i])
+    DUMMY_ASSERT(pos == bits.get_data_sz_bits())
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_huffman_table_length_limited()
+{
+    // Fibonacci weights give the deepest possible huffman tree
+    std::vector<size_t> freqs = { 1, 1 };
+    for (size_t i = 2; i < 40; ++i)
+        freqs.push_back(freqs[i - 1] + freqs[i - 2]);
+    huffman_table htab(freqs);
+
+    dynbitset bits;
+    for (size_t sym = 0; sym < freqs.size(); ++sym)
+    {
+        DUMMY_ASSERT(htab.get_code_len(sym) <= huffman_table::MAX_CODE_LEN)
+        htab.encode(bits, sym);
+    }
+
+    size_t pos = 0;
+    for (size_t sym = 0; sym < freqs.size(); ++sym)
+        DUMMY_ASSERT(htab.decode(bits, pos) == sym)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_huffman_table_serialize_default()
+{
+    std::vector<size_t> freqs = { 5, 9, 12, 13, 16, 45, 0 };
+    huffman_table htab(freqs);
+
+    std::vector<char> data = htab.serialize();
+    size_t readed = 0;
+    huffman_table htab2 = huffman_table::deserialize(data.data(), data.size(), readed);
+
+    DUMMY_ASSERT(readed == data.size())
+    DUMMY_ASSERT(htab2.get_symbols_cnt() == freqs.size())
+    for (size_t sym = 0; sym < freqs.size(); ++sym)
+        DUMMY_ASSERT(htab2.get_code_len(sym) == htab.get_code_len(sym))
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_code_header_serialize_default()
+{
+    const std::string wiki = "Wikipedia";
+    DUMMY_ASSERT(adler32(std::span<const uint8_t>((const uint8_t *)wiki.data(), wiki.size())) == 0x11e60398)
+    DUMMY_ASSERT(adler32({}) == 1)
+
+    code_header header;
+    header.etype = encode_type::MASK_DUO_QUAD;
+    header.cmds_cnt = 1000;
+    header.stream_bits = 12345;
+    header.stream_checksum = 0xdeadbeef;
+    header.parts = { { 2, 2, 4, 6 }, { 1, 2, 2, 3 }, { 1, 2, 2, 3 } };
+    std::vector<uint8_t> blob = { 1, 2, 3 };
+    header.add_dicts({ { ".dict.1", blob }, { ".dict.addr", blob }, { ".dict.func", blob } });
+    DUMMY_ASSERT(header.dicts.size() == 1 && header.dicts[0].size == 3)
+
+    std::vector<uint8_t> code = header.serialize();
+    size_t header_size = code.size();
+    code.resize(header_size + (12345 + 7) / 8);
+    size_t readed = 0;
+    code_header restored = code_header::deserialize(code, readed);
+    DUMMY_ASSERT(readed == header_size && restored.etype == header.etype && restored.cmds_cnt == 1000)
+    DUMMY_ASSERT(restored.stream_bits == 12345 && restored.stream_checksum == 0xdeadbeef && restored.parts == header.parts)
+    DUMMY_ASSERT(restored.dicts.size() == 1 && restored.dicts[0].name == ".dict.1" && restored.dicts[0].checksum == header.dicts[0].checksum)
+
+    // Damaged byte, other version and truncated header are rejected
+    for (size_t i : { (size_t)5, (size_t)1, header_size })
+    {
+        std::vector<uint8_t> damaged = code;
+        if (i == header_size)
+            damaged.resize(header_size - 1);
+        else
+            damaged[i] ^= 1;
+        bool thrown = false;
+        try
+        {
+            code_header::deserialize(damaged, readed);
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_sha256_known_digest()
+{
+    sha256 empty;
+    DUMMY_ASSERT(empty.hex_digest() == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")
+
+    sha256 abc;
+    abc.update("abc", 3);
+    DUMMY_ASSERT(abc.hex_digest() == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+
+    // Two blocks, fed in uneven parts
+    const std::string msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha256 parts;
+    parts.update(msg.data(), 5);
+    parts.update(msg.data() + 5, msg.size() - 5);
+    DUMMY_ASSERT(parts.hex_digest() == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1")
 
     DUMMY_TEST_PASS()
 }
 
-bool test_command_devide_half_default()
+/* rv32i_format */
+bool test_rv32i_layouts_cover_instruction()
 {
-    command cmd1, cmd2;
-    cmd1.add(0xaffa, 16);
-    cmd2.add(0xfa, 8);
+    const rv32i_format formats[] = { rv32i_format::R, rv32i_format::I, rv32i_format::S, rv32i_format::B,
+                                     rv32i_format::U, rv32i_format::J, rv32i_format::X };
+    for (size_t i = 0; i < ARRLEN(formats); ++i)
+    {
+        const rv32i_layout &l = rv32i_get_layout(formats[i]);
+        DUMMY_ASSERT((l.funct_mask | l.regs_mask | l.imm_mask | l.raw_mask) == 0xffffffff)
+        DUMMY_ASSERT(count_bits(l.funct_mask) + count_bits(l.regs_mask) + count_bits(l.imm_mask) + count_bits(l.raw_mask) == 32)
+        DUMMY_ASSERT((l.funct_mask & 0x7f) == 0x7f)
+    }
 
-    command target_cmd11, target_cmd12, target_cmd21, target_cmd22;
-    target_cmd11.add(0xfa, 8);
-    target_cmd12.add(0xaf, 8);
-    target_cmd21.add(0xa, 4);
-    target_cmd22.add(0xf, 4);
+    DUMMY_TEST_PASS()
+}
 
-    command cmd11, cmd12;
-    cmd1.devide_half(cmd11, cmd12);
-    DUMMY_ASSERT(cmd11 == target_cmd11)
-    DUMMY_ASSERT(cmd12 == target_cmd12)
+bool test_rv32i_get_format_default()
+{
+    DUMMY_ASSERT(rv32i_get_format(0x33) == rv32i_format::R)     // add
+    DUMMY_ASSERT(rv32i_get_format(0x13) == rv32i_format::I)     // addi
+    DUMMY_ASSERT(rv32i_get_format(0x23) == rv32i_format::S)     // sw
+    DUMMY_ASSERT(rv32i_get_format(0x63) == rv32i_format::B)     // beq
+    DUMMY_ASSERT(rv32i_get_format(0x37) == rv32i_format::U)     // lui
+    DUMMY_ASSERT(rv32i_get_format(0x6f) == rv32i_format::J)     // jal
+    DUMMY_ASSERT(rv32i_get_format(0x01) == rv32i_format::X)     // rvc
 
-    command cmd21, cmd22;
-    cmd2.devide_half(cmd21, cmd22);
-    DUMMY_ASSERT(cmd21 == target_cmd21)
-    DUMMY_ASSERT(cmd22 == target_cmd22)
+    DUMMY_TEST_PASS()
+}
+
+bool test_extract_deposit_bits_default()
+{
+    DUMMY_ASSERT(extract_bits(0xabcd1234, 0x0000ff00) == 0x12)
+    DUMMY_ASSERT(extract_bits(0xf0f0f0f0, 0x00ff00ff) == 0xf0f0)
+    DUMMY_ASSERT(deposit_bits(0x12, 0x0000ff00) == 0x1200)
+    DUMMY_ASSERT(deposit_bits(0xf0f0, 0x00ff00ff) == 0x00f000f0)
+
+    const uint32_t value = 0x00a50513;     // addi a0, a0, 10
+    const rv32i_layout &l = rv32i_get_layout(rv32i_get_format(value));
+    uint32_t restored = deposit_bits(extract_bits(value, l.funct_mask), l.funct_mask)
+        | deposit_bits(extract_bits(value, l.regs_mask), l.regs_mask)
+        | deposit_bits(extract_bits(value, l.imm_mask), l.imm_mask);
+    DUMMY_ASSERT(restored == value)
+    DUMMY_ASSERT(extract_bits(value, l.imm_mask) == 10)
 
     DUMMY_TEST_PASS()
 }
@@ -849,6 +2242,794 @@ bool test_dynbitset_getseq_default()
     DUMMY_TEST_PASS()
 }
 
+bool test_dynbitset_getbits_default()
+{
+    dynbitset s;
+    s.add(0xaffa, 16);
+    s.add(0x5, 3);
+
+    DUMMY_ASSERT(s.getbits(4, 8) == s.getseq(4, 12).to_size_t())
+    DUMMY_ASSERT(s.getbits(0, 19) == s.getseq(0, 19).to_size_t())
+    DUMMY_ASSERT(s.getbits(13, 6) == s.getseq(13, 19).to_size_t())
+    DUMMY_ASSERT(s.getbits(16, 16) == 0x5)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_addr_table_lookup_default()
+{
+    std::vector<size_t> block_offsets;
+    for (size_t i = 0; i < 40; ++i)
+        block_offsets.push_back(i * 10);
+    std::vector<size_t> targets = { 0, 8, 20, 68 };
+    addr_table atab(block_offsets, targets, 4);
+    DUMMY_ASSERT(atab.get_lines_cnt() == 3)
+
+    std::vector<char> data = atab.serialize();
+    addr_table restored = addr_table::deserialize(data.data(), data.size());
+
+    const addr_table *tabs[] = { &atab, &restored };
+    for (size_t i = 0; i < ARRLEN(tabs); ++i)
+    {
+        size_t bitpos = 0, skip_cnt = 0;
+        DUMMY_ASSERT(tabs[i]->lookup(8, bitpos) && bitpos == 20)
+        DUMMY_ASSERT(tabs[i]->lookup(20, bitpos) && bitpos == 50)
+        DUMMY_ASSERT(tabs[i]->lookup(64, bitpos) && bitpos == 160)
+        DUMMY_ASSERT(tabs[i]->lookup(68, bitpos) && bitpos == 170)
+        DUMMY_ASSERT(!tabs[i]->lookup(12, bitpos))
+        DUMMY_ASSERT(!tabs[i]->lookup(160, bitpos))
+        DUMMY_ASSERT(tabs[i]->lookup_line(76, bitpos, skip_cnt) && bitpos == 160 && skip_cnt == 3)
+    }
+
+    // Line bases are stored in 32 bits
+    block_offsets[16] = 0x100000000;
+    bool thrown = false;
+    try
+    {
+        addr_table overflow(block_offsets, targets, 4);
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+    DUMMY_ASSERT(thrown)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_func_table_lookup_default()
+{
+    std::vector<size_t> block_offsets;
+    for (size_t i = 0; i < 40; ++i)
+        block_offsets.push_back(i * 10);
+    // Second function overlaps the first one, the last is unaligned
+    std::vector<func_range> functions = { { 40, 24 }, { 0, 32 }, { 16, 8 }, { 100, 6 }, { 128, 32 } };
+    func_table ftab(functions, block_offsets, 405, 4);
+    DUMMY_ASSERT(ftab.get_units().size() == 3)
+
+    std::vector<char> data = ftab.serialize();
+    func_table restored = func_table::deserialize(data.data(), data.size());
+
+    const func_table *tabs[] = { &ftab, &restored };
+    for (size_t i = 0; i < ARRLEN(tabs); ++i)
+    {
+        func_unit unit;
+        DUMMY_ASSERT(tabs[i]->lookup(20, unit) && unit.text_offset == 0 && unit.bit_offset == 0 && unit.bit_size == 80)
+        DUMMY_ASSERT(tabs[i]->lookup(63, unit) && unit.text_offset == 40 && unit.bit_offset == 100 && unit.bit_size == 60)
+        DUMMY_ASSERT(tabs[i]->lookup(128, unit) && unit.text_size == 32 && unit.bit_offset == 320 && unit.bit_size == 85)
+        DUMMY_ASSERT(!tabs[i]->lookup(32, unit))
+        DUMMY_ASSERT(!tabs[i]->lookup(100, unit))
+        DUMMY_ASSERT(!tabs[i]->lookup(160, unit))
+    }
+
+    bool truncated = false;
+    try
+    {
+        func_table::deserialize(data.data(), data.size() - 1);
+    }
+    catch (std::runtime_error &)
+    {
+        truncated = true;
+    }
+    DUMMY_ASSERT(truncated)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_block_map_cluster_default()
+{
+    // Blocks of 4 commands: loads and stores by turns
+    std::vector<command> commands;
+    for (uint32_t i = 0; i < 22; ++i)
+    {
+        command cmd;
+        cmd.add(i / 4 % 2 == 0 ? rv_i(i * 4, 2, 2, 5, 0x03) : rv_s(i * 4, 5, 2, 2), 32);
+        commands.push_back(cmd);
+    }
+
+    std::vector<uint8_t> clusters = cluster_blocks(commands, 2, 2);
+    DUMMY_ASSERT(clusters.size() == 6 && clusters[0] != clusters[1])
+    for (size_t b = 2; b < clusters.size(); ++b)
+        DUMMY_ASSERT(clusters[b] == clusters[b % 2])
+    DUMMY_ASSERT(cluster_blocks(commands, 2, 1) == std::vector<uint8_t>(6, 0))
+    DUMMY_ASSERT(cluster_blocks(commands, 5, 3) == std::vector<uint8_t>(1, 0))
+
+    block_map bmap(2, { 3, 5 }, clusters);
+    std::vector<char> data = bmap.serialize();
+    block_map restored = block_map::deserialize(data.data(), data.size());
+    const block_map *maps[] = { &bmap, &restored };
+    for (size_t i = 0; i < ARRLEN(maps); ++i)
+    {
+        DUMMY_ASSERT(maps[i]->get_block_shift() == 2 && maps[i]->get_blocks_cnt() == 6)
+        DUMMY_ASSERT(maps[i]->get_dict(9) == clusters[2] && maps[i]->get_dict_start(1) == 3)
+        DUMMY_ASSERT(maps[i]->get_dict_sizes() == std::vector<size_t>({ 3, 5 }))
+    }
+
+    // Truncated map, map referring to missing dictionary
+    const std::vector<char> bad_maps[] = { std::vector<char>(data.begin(), data.begin() + 5), { 2, 1, 3, 0, 0, 1 } };
+    for (size_t i = 0; i < ARRLEN(bad_maps); ++i)
+    {
+        bool thrown = false;
+        try
+        {
+            block_map::deserialize(bad_maps[i].data(), bad_maps[i].size());
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+template<size_t INDX_SIZE>
+bool dict_decode_batch_matches_restore_block()
+{
+    std::vector<command> entries;
+    for (uint32_t i = 0; i < 300; ++i)
+    {
+        command cmd;
+        cmd.add(0x00000013 | (i << 20), 32);
+        entries.push_back(cmd);
+    }
+    encode_table<4, INDX_SIZE> entab(entries);
+    std::vector<uint32_t> dict;
+    for (size_t i = 0; i < entab.get_entries_cnt(); ++i)
+        dict.push_back(entab[i].to_size_t());
+
+    // Long runs of hits with literals in between
+    compressed_section csec;
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint32_t value = (i % 37 == 0) ? 0xdeadbeef ^ i : 0x00000013 | ((i * 7 % 300) << 20);
+        command cmd;
+        cmd.add(value, 32);
+        csec.add(compress_command_with_dictionary(entab, cmd));
+        expected.push_back(value);
+    }
+
+    std::vector<uint32_t> out(expected.size());
+    size_t cnt = dict_decode_batch_scalar(csec.data(), csec.get_data_sz_bits(), dict.data(), dict.size(), INDX_SIZE, out.data(), out.size());
+    if (cnt != expected.size() || out != expected)
+        return false;
+
+    out.assign(expected.size() + 8, 0);
+    cnt = dict_decode_batch(csec.data(), csec.get_data_sz_bits(), dict.data(), dict.size(), INDX_SIZE, out.data(), out.size());
+    out.resize(cnt);
+    if (out != expected)
+        return false;
+
+    size_t pos = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (restore_block_dict<4, INDX_SIZE>(csec, pos, entab).to_size_t() != expected[i])
+            return false;
+    }
+    return true;
+}
+
+bool test_dict_decode_batch_matches_restore_block()
+{
+    // 14 bit indices fit one vector load, 20 bit ones need gather
+    DUMMY_ASSERT(dict_decode_batch_matches_restore_block<14>())
+    DUMMY_ASSERT(dict_decode_batch_matches_restore_block<20>())
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_codeword_map_serialize_default()
+{
+    std::vector<codeword_record> records(6);
+    records[1] = { codeword_class::MASK, 5, 0x13, 20, 77 };
+    records[2] = { codeword_class::LITERAL, 0, 0x6f, 33, 0 };
+    records[3] = { codeword_class::DICT, 0, 0x33, 13, 8191 };
+    records[5] = { codeword_class::LITERAL, 0, 0x67, 33, 0 };
+    codeword_map map(encode_type::MASK_SINGLE, 0x10000, 4, records, { { 12, 12, "f1" }, { 0, 8, "f0" } });
+
+    std::vector<char> data = map.serialize();
+    codeword_map restored = codeword_map::deserialize(data.data(), data.size());
+    DUMMY_ASSERT(restored.get_etype() == encode_type::MASK_SINGLE && restored.get_text_addr() == 0x10000 && restored.get_cmdlen() == 4)
+    DUMMY_ASSERT(restored.get_records().size() == records.size())
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const auto &rec = restored.get_records()[i];
+        DUMMY_ASSERT(rec.cls == records[i].cls && rec.mask_pos == records[i].mask_pos && rec.opcode == records[i].opcode)
+        DUMMY_ASSERT(rec.bits == records[i].bits && rec.indx == records[i].indx)
+    }
+
+    // Functions are sorted, gaps between them belong to none
+    DUMMY_ASSERT(restored.get_functions().size() == 2 && restored.get_functions()[0].name == "f0")
+    DUMMY_ASSERT(restored.find_function(4)->name == "f0" && restored.find_function(8) == nullptr)
+    DUMMY_ASSERT(restored.find_function(20)->name == "f1" && restored.find_function(24) == nullptr)
+
+    std::vector<codeword_bucket> buckets = restored.get_buckets(4);
+    DUMMY_ASSERT(buckets.size() == 2 && buckets[1].offset == 16 && buckets[1].cmds == 2)
+    DUMMY_ASSERT(buckets[0].counts[(size_t)codeword_class::LITERAL] == 1 && buckets[0].counts[(size_t)codeword_class::MASK] == 1)
+    DUMMY_ASSERT(buckets[0].bits == 66 && buckets[1].counts[(size_t)codeword_class::LITERAL] == 1)
+
+    std::ostringstream csv;
+    restored.write_csv(csv);
+    std::istringstream lines(csv.str());
+    std::string line;
+    std::vector<std::string> rows;
+    while (std::getline(lines, line))
+        rows.push_back(line);
+    DUMMY_ASSERT(rows.size() == records.size() + 1 && rows[0] == "address,function,opcode,class,mask_pos,index,bits")
+    DUMMY_ASSERT(rows[2] == "0x10004,f0,0x13,MASK,5,77,20" && rows[3] == "0x10008,,0x6f,LITERAL,0,0,33")
+
+    // Truncated and foreign data are refused
+    const size_t bad_sizes[] = { 3, 20, data.size() - 1 };
+    for (size_t i = 0; i <= ARRLEN(bad_sizes); ++i)
+    {
+        std::vector<char> bad = data;
+        if (i < ARRLEN(bad_sizes))
+            bad.resize(bad_sizes[i]);
+        else
+            bad[0] = 'X';
+        bool thrown = false;
+        try
+        {
+            codeword_map::deserialize(bad.data(), bad.size());
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_index_predictor_round_trip()
+{
+    const int indices[] = { 3, 5, 4, 100, 3, 100, 101, 7, 0, 4095, 4094, 3 };
+    const index_coding codings[] = { index_coding::DELTA, index_coding::MTF };
+    for (size_t i = 0; i < ARRLEN(codings); ++i)
+    {
+        // Decoder restores every short code with the same state
+        index_predictor encoder(codings[i], 3), decoder(codings[i], 3);
+        size_t shorts = 0;
+        for (size_t j = 0; j < ARRLEN(indices); ++j)
+        {
+            int code = encoder.find_short(indices[j]);
+            if (code != -1)
+            {
+                DUMMY_ASSERT(code < 8 && decoder.restore_short(code) == (size_t)indices[j])
+                shorts++;
+            }
+            encoder.update(indices[j]);
+            decoder.update(indices[j]);
+        }
+        DUMMY_ASSERT(shorts != 0 && shorts < ARRLEN(indices))
+
+        // Reset state: previous index is 0, recent list is 0..7
+        encoder.reset();
+        DUMMY_ASSERT(encoder.find_short(3) == 3 && encoder.find_short(8) == -1)
+    }
+
+    index_predictor delta(index_coding::DELTA, 3);
+    delta.update(100);
+    DUMMY_ASSERT(delta.find_short(96) == 4 && delta.find_short(103) == 3 && delta.find_short(104) == -1 && delta.find_short(95) == -1)
+
+    // Used index goes to front, the last one drops out
+    index_predictor mtf(index_coding::MTF, 2);
+    mtf.update(100);
+    DUMMY_ASSERT(mtf.find_short(100) == 0 && mtf.find_short(0) == 1 && mtf.find_short(3) == -1)
+    mtf.update(1);
+    DUMMY_ASSERT(mtf.find_short(1) == 0 && mtf.find_short(100) == 1 && mtf.find_short(0) == 2 && mtf.find_short(2) == 3)
+
+    DUMMY_ASSERT(index_predictor(index_coding::FIXED, 0).find_short(0) == -1)
+
+    // Entries 0 and 3 follow each other, so chain of 0 takes 3 before
+    // entry 2 of the same uses
+    const int used[] = { 1, 1, 1, 0, 3, 0, 3, 2, 2 };
+    std::vector<uint64_t> weights(ARRLEN(used), 1);
+    DUMMY_ASSERT(order_dict_entries(used, weights, 5, dict_order::VALUE) == std::vector<size_t>({ 0, 1, 2, 3, 4 }))
+    DUMMY_ASSERT(order_dict_entries(used, weights, 5, dict_order::FREQUENCY) == std::vector<size_t>({ 1, 0, 2, 3, 4 }))
+    DUMMY_ASSERT(order_dict_entries(used, weights, 5, dict_order::ADJACENCY) == std::vector<size_t>({ 1, 0, 3, 2, 4 }))
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_mask_index_matches_brute_force()
+{
+    // addi x1, x2, 5 and addi x3, x2, 6: rd and immediate differ
+    uint32_t entry = rv_i(5, 2, 0, 1, 0x13), value = rv_i(6, 2, 0, 3, 0x13);
+    mask_match match;
+    DUMMY_ASSERT(get_mask_windows(entry, value, mask_shape::NIBBLES, 2, match))
+    DUMMY_ASSERT(match.windows_cnt == 2 && match.windows[0].pos == 2 && match.windows[1].pos == 5)
+    DUMMY_ASSERT(apply_mask_windows(entry, match) == value && mask_windows_bits(match, 2) == 3 + 2 * 7)
+    DUMMY_ASSERT(!get_mask_windows(entry, value, mask_shape::BITS, 2, match))
+    DUMMY_ASSERT(get_mask_windows(entry, value, mask_shape::FIELDS, 2, match))
+    DUMMY_ASSERT(match.windows_cnt == 2 && match.windows[0].pos == 1 && match.windows[1].pos == 4)
+    DUMMY_ASSERT(apply_mask_windows(entry, match) == value && mask_windows_bits(match, 2) == 3 + 8 + 8)
+    DUMMY_ASSERT(!get_mask_windows(entry, value, mask_shape::NIBBLES, 1, match) && !get_mask_windows(entry, entry, mask_shape::BITS, 2, match))
+
+    // Windows are read back as written
+    DUMMY_ASSERT(get_mask_windows(entry, entry ^ 0x80000100, mask_shape::BITS, 2, match))
+    command ccmd;
+    add_mask_windows(ccmd, match, 2);
+    compressed_section csec;
+    csec.add(ccmd);
+    size_t pos = 0;
+    mask_match restored;
+    read_mask_windows(csec, pos, 2, restored);
+    DUMMY_ASSERT(pos == mask_windows_bits(match, 2) && pos == ccmd.get_data_sz_bits())
+    DUMMY_ASSERT(restored.shape == mask_shape::BITS && restored.windows_cnt == 2 && apply_mask_windows(entry, restored) == (entry ^ 0x80000100))
+
+    // Values near random entries: one or two changed nibbles, fields or bits
+    std::mt19937 gen(42);
+    std::vector<uint32_t> entries(2000);
+    for (auto &e : entries)
+        e = gen();
+    mask_index index(entries, 2);
+    for (size_t i = 0; i < 3000; ++i)
+    {
+        uint32_t value = entries[gen() % entries.size()];
+        for (size_t w = 0; w < 1 + i % 2; ++w)
+            value ^= i % 3 == 0 ? 1u << (gen() % 32) : (gen() & 0xf) << (gen() % 8 * 4);
+        if (i % 5 == 0)
+            value = gen();
+
+        bool expected = false;
+        size_t best_bits = SIZE_MAX, best_indx = 0;
+        for (size_t e = 0; e < entries.size(); ++e)
+        {
+            for (size_t shape = 0; shape < MASK_SHAPES_CNT; ++shape)
+            {
+                mask_match candidate;
+                if (get_mask_windows(entries[e], value, (mask_shape)shape, 2, candidate) && mask_windows_bits(candidate, 2) < best_bits)
+                {
+                    expected = true;
+                    best_bits = mask_windows_bits(candidate, 2);
+                    best_indx = e;
+                }
+            }
+        }
+
+        DUMMY_ASSERT(index.find(value, match) == expected)
+        if (expected)
+        {
+            DUMMY_ASSERT(match.indx == best_indx && mask_windows_bits(match, 2) == best_bits)
+            DUMMY_ASSERT(apply_mask_windows(entries[match.indx], match) == value)
+        }
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_restore_block_fixed_random_access()
+{
+    std::vector<command> entries, overflow_entries;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        command cmd;
+        cmd.add(0x13 | (i << 20), 32);
+        entries.push_back(cmd);
+        command ovf;
+        ovf.add(0xdead0000 | i, 32);
+        overflow_entries.push_back(ovf);
+    }
+    encode_table<4, 7> entab(entries), overflow(overflow_entries);
+
+    // dict 2, overflow 1, dict 0, overflow 3
+    compressed_section csec;
+    csec.add((size_t)2, 8);
+    csec.add((size_t)0x81, 8);
+    csec.add((size_t)0, 8);
+    csec.add((size_t)0x83, 8);
+
+    size_t pos = 3 * 8;
+    DUMMY_ASSERT((restore_block_fixed(csec, pos, entab, overflow) == overflow[3]))
+    DUMMY_ASSERT(pos == 4 * 8)
+    pos = 8;
+    DUMMY_ASSERT((restore_block_fixed(csec, pos, entab, overflow) == overflow[1]))
+    DUMMY_ASSERT((restore_block_fixed(csec, pos, entab, overflow) == entab[0]))
+    pos = 0;
+    DUMMY_ASSERT((restore_block_fixed(csec, pos, entab, overflow) == entab[2]))
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_fixed_codewords_widen_for_many_words()
+{
+    // More unique words than 16 bit codewords address
+    const size_t words_cnt = 100000;
+    std::vector<uint8_t> text(words_cnt * RV32I_CMDLEN);
+    for (size_t i = 0; i < words_cnt; ++i)
+    {
+        uint32_t word = 0x13 | (uint32_t)i << 12;
+        for (size_t j = 0; j < RV32I_CMDLEN; ++j)
+            text[i * RV32I_CMDLEN + j] = (uint8_t)(word >> (j * 8));
+    }
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::FIXED16);
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+    DUMMY_ASSERT(sz_stat.final_code_size == (words_cnt * 17 + 7) / 8)
+    DUMMY_ASSERT(decompress_code(image.code, image.get_dict_views()) == text)
+
+    drt_image img = { { image.code.data(), image.code.size() }, { } };
+    for (const auto &dict : image.get_dicts())
+    {
+        int slot = drt_dict_slot(dict.first.c_str());
+        if (slot >= 0)
+            img.dicts[slot] = { dict.second.data(), dict.second.size() };
+    }
+    drt_header hdr;
+    DUMMY_ASSERT(drt_read_header(&img, &hdr) == DRT_OK && hdr.parts[0].indx_size == 16)
+    std::vector<uint32_t> work(drt_work_words(&img));
+    std::vector<uint32_t> out(words_cnt);
+    size_t out_cnt = 0;
+    DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, work.data(), work.size()) == DRT_OK)
+    DUMMY_ASSERT(out_cnt == words_cnt && memcmp(out.data(), text.data(), text.size()) == 0)
+
+    DUMMY_TEST_PASS()
+}
+
+
+bool test_workload_model_generates_executable()
+{
+    ELFIO::elfio reader;
+    DUMMY_ASSERT(reader.load("./tests/hello_world-rv32i.o"))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::span<const uint8_t> corpus((const uint8_t *)text_sec->get_data(), text_sec->get_size());
+
+    workload_model model;
+    model.learn(corpus);
+    DUMMY_ASSERT(model.get_learned_cnt() == corpus.size() / 4)
+
+    const size_t text_size = 1 << 16;
+    std::vector<uint8_t> text = model.generate(text_size, 1);
+    DUMMY_ASSERT(text.size() == text_size)
+    DUMMY_ASSERT(text == model.generate(text_size, 1))
+    DUMMY_ASSERT(text != model.generate(text_size, 2))
+
+    // Only classes seen in corpus are generated
+    workload_model generated;
+    generated.learn(text);
+    workload_model both = model;
+    both.learn(text);
+    DUMMY_ASSERT(generated.get_class_cnt() <= model.get_class_cnt())
+    DUMMY_ASSERT(both.get_class_cnt() == model.get_class_cnt())
+
+    const std::string ofilename = "./tests/workload.exe";
+    workload_write_elf(ofilename, text);
+
+    ELFIO::elfio workload;
+    DUMMY_ASSERT(workload.load(ofilename))
+    DUMMY_ASSERT(workload.get_machine() == ELFIO::EM_RISCV)
+    DUMMY_ASSERT(workload.get_class() == ELFIO::ELFCLASS32)
+    const ELFIO::section *workload_text = get_section_with_name(&workload, ".text");
+    DUMMY_ASSERT(workload.get_entry() == workload_text->get_address())
+    DUMMY_ASSERT(std::vector<uint8_t>((const uint8_t *)workload_text->get_data(), (const uint8_t *)workload_text->get_data() + workload_text->get_size()) == text)
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::DICT);
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+    DUMMY_ASSERT(decompress_code(image.code, image.get_dict_views()) == text)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_exec_counts_reduce_dynamic_work()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    size_t cmds_cnt = get_section_with_name(&reader, ".text")->get_size() / RV32I_CMDLEN;
+
+    // One hot loop in the middle of the code
+    std::vector<uint64_t> counts(cmds_cnt, 1);
+    for (size_t i = cmds_cnt / 2; i < cmds_cnt / 2 + 32; ++i)
+        counts[i] = 1000000;
+
+    const encode_type encode_types[] = { encode_type::MASK_QUAD, encode_type::RV32I_FIELDS };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        size_t dynamic_bits[2] = { 0, 0 };
+        for (bool with_profile : { false, true })
+        {
+            DUMMY_ASSERT(reader.load(ifilename))
+            config_builder cfg_builder;
+            cfg_builder.set_etype(encode_types[i]);
+            if (with_profile)
+                cfg_builder.set_exec_counts(counts);
+            utils::size_stat sz_stat;
+            std::vector<std::string> dict_infos;
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+            dynamic_bits[with_profile] = total_decode_work(trace_executable(&reader), counts).bits;
+
+            ELFIO::elfio original;
+            DUMMY_ASSERT(original.load(ifilename))
+            decompress_executable(&reader);
+            DUMMY_ASSERT(compare_by_text_section(&reader, &original))
+        }
+        DUMMY_ASSERT(dynamic_bits[1] < dynamic_bits[0])
+    }
+
+    // Counts must cover every instruction
+    config_builder cfg_builder;
+    cfg_builder.set_exec_counts({ 1, 2, 3 });
+    DUMMY_ASSERT(reader.load(ifilename))
+    bool thrown = false;
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+    DUMMY_ASSERT(thrown)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_map_executable_matches_traces()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+
+    const encode_type encode_types[] = { encode_type::DICT, encode_type::MASK_SINGLE, encode_type::MASK_DUO, encode_type::RV32I_FIELDS, encode_type::MASK_MULTI };
+    for (size_t i = 0; i < ARRLEN(encode_types); ++i)
+    {
+        DUMMY_ASSERT(reader.load(ifilename))
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        std::vector<uint8_t> text((const uint8_t *)code_sec->get_data(), (const uint8_t *)code_sec->get_data() + code_sec->get_size());
+        size_t cmds_cnt = text.size() / RV32I_CMDLEN;
+
+        config_builder cfg_builder;
+        cfg_builder.set_etype(encode_types[i]);
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+
+        codeword_map map = map_executable(&reader);
+        std::vector<block_trace> traces = trace_executable(&reader);
+        DUMMY_ASSERT(map.get_etype() == encode_types[i] && map.get_text_addr() == code_sec->get_address())
+        DUMMY_ASSERT(map.get_records().size() == cmds_cnt && traces.size() == cmds_cnt)
+
+        // Every instruction of original .text is within some function
+        DUMMY_ASSERT(!map.get_functions().empty())
+        for (size_t j = 0; j < cmds_cnt; ++j)
+        {
+            const auto &rec = map.get_records()[j];
+            DUMMY_ASSERT(map.find_function(j * RV32I_CMDLEN) != nullptr)
+            DUMMY_ASSERT(rec.opcode == (text[j * RV32I_CMDLEN] & 0x7f) && rec.bits == traces[j].bits)
+            if (traces[j].dict_reads == 0)
+                DUMMY_ASSERT(rec.cls == codeword_class::LITERAL)
+            if (rec.cls != codeword_class::LITERAL)
+                DUMMY_ASSERT((rec.cls == codeword_class::MASK) == (traces[j].mask_applies != 0))
+
+            // Single part codewords: literal has no dictionary read
+            if (encode_types[i] != encode_type::MASK_DUO && encode_types[i] != encode_type::RV32I_FIELDS)
+                DUMMY_ASSERT((rec.cls == codeword_class::LITERAL) == (traces[j].dict_reads == 0))
+            if (encode_types[i] == encode_type::DICT && rec.cls == codeword_class::LITERAL)
+                DUMMY_ASSERT(rec.bits == 33)
+        }
+
+        // Binary map survives a file round trip
+        const std::string mapname = "./tests/codeword_map.cwm";
+        map.save(mapname);
+        codeword_map loaded = codeword_map::load(mapname);
+        std::filesystem::remove(mapname);
+        DUMMY_ASSERT(loaded.serialize() == map.serialize())
+    }
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_rv64i_compress_decompress_every_etype()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv64i.o";
+    const std::string ofilename = "./tests/result64.exe";
+
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+    size_t cmds_cnt = text.size() / RV32I_CMDLEN;
+    DUMMY_ASSERT(reader.get_class() == ELFIO::ELFCLASS64 && text.size() % 8 != 0)
+
+    const encode_type encode_types[] = {
+        encode_type::DICT, encode_type::MASK_SINGLE, encode_type::MASK_DUO, encode_type::MASK_QUAD, encode_type::MASK_OPERANDS_OPCODE,
+        encode_type::MASK_DUO_QUAD, encode_type::RV32I_FIELDS, encode_type::FIXED16, encode_type::DICT_BLOCKS, encode_type::MASK_MULTI
+    };
+    for (size_t i = 0; i < ARRLEN(encode_types) + 3; ++i)
+    {
+        // Entropy coding, hot dictionary and functions go on top of every type
+        config_builder cfg_builder;
+        cfg_builder.set_etype(i < ARRLEN(encode_types) ? encode_types[i] : encode_type::MASK_SINGLE);
+        cfg_builder.set_entropy_coding(i == ARRLEN(encode_types));
+        cfg_builder.set_hot_dict(i == ARRLEN(encode_types) + 1 ? 16 : 0);
+        cfg_builder.set_function_units(i == ARRLEN(encode_types) + 2);
+
+        DUMMY_ASSERT(reader.load(ifilename))
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+        DUMMY_ASSERT(sz_stat.initial_code_size == text.size() && sz_stat.final_code_size < text.size())
+
+        // Header records width of instruction, not of register
+        const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+        size_t header_size = 0;
+        code_header header = code_header::deserialize(std::span<const uint8_t>((const uint8_t *)code_sec->get_data(), code_sec->get_size()), header_size);
+        DUMMY_ASSERT(header.cmdlen == RV32I_CMDLEN && header.cmds_cnt == cmds_cnt)
+        DUMMY_ASSERT(trace_executable(&reader).size() == cmds_cnt)
+
+        std::vector<command> restored = decompress_commands_at(&reader, code_sec->get_address() + (cmds_cnt - 1) * RV32I_CMDLEN, 1);
+        DUMMY_ASSERT(restored.size() == 1 && restored[0].to_size_t() == ((const uint32_t *)text.data())[cmds_cnt - 1])
+
+        DUMMY_ASSERT(reader.save(ofilename))
+        ELFIO::elfio compressed;
+        DUMMY_ASSERT(compressed.load(ofilename) && compressed.get_class() == ELFIO::ELFCLASS64)
+        decompress_executable(&compressed);
+        const ELFIO::section *restored_sec = get_section_with_name(&compressed, ".text");
+        DUMMY_ASSERT(restored_sec->get_size() == text.size() && memcmp(restored_sec->get_data(), text.data(), text.size()) == 0)
+    }
+
+    // ELF class is checked by rv64i entry points
+    DUMMY_ASSERT(reader.load("./tests/hello_world-rv32i.o"))
+    bool thrown = false;
+    try
+    {
+        utils::size_stat sz_stat;
+        std::vector<std::string> dict_infos;
+        rv64i_compress_executable(sz_stat, dict_infos, &reader, config());
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+    DUMMY_ASSERT(thrown)
+
+    DUMMY_TEST_PASS()
+}
+
+bool test_dict_order_index_coding_round_trip()
+{
+    ELFIO::elfio reader;
+    const std::string ifilename = "./tests/hello_world-rv32i.o";
+    DUMMY_ASSERT(reader.load(ifilename))
+    const ELFIO::section *text_sec = get_section_with_name(&reader, ".text");
+    std::vector<uint8_t> text((const uint8_t *)text_sec->get_data(), (const uint8_t *)text_sec->get_data() + text_sec->get_size());
+    size_t cmds_cnt = text.size() / RV32I_CMDLEN;
+
+    config_builder cfg_builder;
+    cfg_builder.set_etype(encode_type::DICT);
+    utils::size_stat one_stat;
+    std::vector<std::string> dict_infos;
+    code_image plain = compress_code(one_stat, dict_infos, text, cfg_builder.build());
+    std::vector<uint8_t> plain_dict = *plain.find_dict(".dict");
+    std::vector<uint32_t> plain_values(plain_dict.size() / 4);
+    memcpy(plain_values.data(), plain_dict.data(), plain_dict.size());
+
+    const dict_order orders[] = { dict_order::VALUE, dict_order::FREQUENCY, dict_order::ADJACENCY };
+    const index_coding codings[] = { index_coding::FIXED, index_coding::DELTA, index_coding::MTF };
+    for (size_t i = 0; i < ARRLEN(orders); ++i)
+    {
+        for (size_t j = 0; j < ARRLEN(codings); ++j)
+        {
+            cfg_builder.set_dict_order(orders[i]);
+            cfg_builder.set_index_coding(codings[j]);
+            utils::size_stat sz_stat;
+            code_image image = compress_code(sz_stat, dict_infos, text, cfg_builder.build());
+            dict_views dicts = image.get_dict_views();
+            DUMMY_ASSERT(decompress_code(image.code, dicts) == text)
+
+            // Same entries and hits, defaults give the same output
+            const std::vector<uint8_t> *idx_data = image.find_dict(".dict.idx");
+            std::vector<uint32_t> values(image.find_dict(".dict")->size() / 4);
+            memcpy(values.data(), image.find_dict(".dict")->data(), values.size() * 4);
+            std::sort(values.begin(), values.end());
+            DUMMY_ASSERT(values == plain_values)
+            DUMMY_ASSERT(sz_stat.short_index_hits + sz_stat.cold_dict_hits == one_stat.cold_dict_hits)
+            bool defaults = i == 0 && j == 0;
+            DUMMY_ASSERT(defaults ? idx_data == nullptr && image.code == plain.code : idx_data != nullptr && idx_data->size() == 3)
+            bool fixed = codings[j] == index_coding::FIXED;
+            DUMMY_ASSERT(fixed == (sz_stat.short_index_hits == 0))
+            // Short codes pay off once entries are renumbered
+            DUMMY_ASSERT(fixed ? sz_stat.final_code_size == one_stat.final_code_size : orders[i] == dict_order::VALUE || sz_stat.final_code_size < one_stat.final_code_size)
+
+            drt_image img = { { image.code.data(), image.code.size() }, { } };
+            for (const auto &dict : dicts)
+            {
+                int slot = drt_dict_slot(dict.first.c_str());
+                if (slot >= 0)
+                    img.dicts[slot] = { dict.second.data(), dict.second.size() };
+            }
+            std::vector<uint32_t> out(cmds_cnt);
+            size_t out_cnt = 0;
+            DUMMY_ASSERT(drt_check(&img) == DRT_OK)
+            DUMMY_ASSERT(drt_decompress(&img, out.data(), out.size(), &out_cnt, nullptr, 0) == DRT_OK)
+            DUMMY_ASSERT(out_cnt == cmds_cnt && memcmp(out.data(), text.data(), text.size()) == 0)
+
+            // Walkers resolve short codes, fetch starts from line start
+            DUMMY_ASSERT(reader.load(ifilename))
+            compress_executable(sz_stat, dict_infos, &reader, cfg_builder.build());
+            const ELFIO::section *code_sec = get_section_with_name(&reader, ".text");
+            std::vector<block_trace> traces = trace_executable(&reader);
+            codeword_map map = map_executable(&reader);
+            size_t bits = 0;
+            for (size_t k = 0; k < traces.size(); ++k)
+            {
+                bits += traces[k].bits;
+                const auto &rec = map.get_records()[k];
+                if (rec.cls == codeword_class::DICT)
+                    DUMMY_ASSERT(memcmp(image.find_dict(".dict")->data() + rec.indx * 4, text.data() + k * 4, 4) == 0)
+            }
+            size_t header_size = 0;
+            code_header::deserialize(std::span<const uint8_t>((const uint8_t *)code_sec->get_data(), code_sec->get_size()), header_size);
+            DUMMY_ASSERT(traces.size() == cmds_cnt && (bits + 7) / 8 + header_size == code_sec->get_size())
+
+            for (size_t k = 0; k < cmds_cnt; k += 7)
+            {
+                std::vector<command> restored = decompress_commands_at(&reader, code_sec->get_address() + k * RV32I_CMDLEN, 3);
+                DUMMY_ASSERT(restored.size() == std::min<size_t>(3, cmds_cnt - k))
+                for (size_t l = 0; l < restored.size(); ++l)
+                    DUMMY_ASSERT(restored[l].to_size_t() == ((const uint32_t *)text.data())[k + l])
+            }
+        }
+    }
+
+    // Post-pass is for plain DICT only, coded indices need line starts
+    for (size_t i = 0; i < 4; ++i)
+    {
+        config_builder bad_builder;
+        bad_builder.set_etype(i == 0 ? encode_type::MASK_SINGLE : encode_type::DICT);
+        bad_builder.set_index_coding(index_coding::MTF);
+        bad_builder.set_entropy_coding(i == 1);
+        bad_builder.set_hot_dict(i == 2 ? 16 : 0);
+        std::vector<func_range> functions;
+        if (i == 3)
+            functions.push_back({ 0, text.size() });
+        utils::size_stat sz_stat;
+        bool thrown = false;
+        try
+        {
+            compress_code(sz_stat, dict_infos, text, bad_builder.build(), { }, functions);
+        }
+        catch (std::runtime_error &)
+        {
+            thrown = true;
+        }
+        DUMMY_ASSERT(thrown)
+    }
+
+    DUMMY_TEST_PASS()
+}
 
 bool (*unit_tests[])(void) = {
     test_rv32i_get_commands,
@@ -869,6 +3050,8 @@ bool (*unit_tests[])(void) = {
     test_restore_block_mask_mask_compressed,
     test_restore_block_dict_not_compressed,
     test_restore_block_dict_compressed,
+    test_restore_block_fixed_random_access,
+    test_fixed_codewords_widen_for_many_words,
 
     test_compress_command_with_mask_not_compressed,
     test_compress_command_with_mask_dict_compressed,
@@ -878,6 +3061,10 @@ bool (*unit_tests[])(void) = {
 
     test_restore_block_dict_compressed,
 
+    test_rv32i_layouts_cover_instruction,
+    test_rv32i_get_format_default,
+    test_extract_deposit_bits_default,
+
     test_dynbitset_add_bool_default,
     test_dynbitset_add_size_t_default,
     test_dynbitset_add_byte_vector_default,
@@ -886,7 +3073,31 @@ bool (*unit_tests[])(void) = {
     test_dynbitset_to_size_t_default,
     test_dynbitset_lt_operator_default,
     test_dynbitset_eq_operator_default,
-    test_dynbitset_getseq_default
+    test_dynbitset_getseq_default,
+    test_dynbitset_getbits_default,
+
+    test_simulate_fetch_default,
+
+    test_addr_table_lookup_default,
+    test_func_table_lookup_default,
+
+    test_dict_decode_batch_matches_restore_block,
+
+    test_dict_make_encode_table_exec_counts,
+    test_dict_make_encode_table_threads_match_serial,
+    test_exec_profile_load_default,
+    test_flat_histogram_merge_default,
+
+    test_huffman_table_encode_decode_default,
+    test_huffman_table_length_limited,
+    test_huffman_table_serialize_default,
+
+    test_code_header_serialize_default,
+    test_sha256_known_digest,
+    test_block_map_cluster_default,
+    test_mask_index_matches_brute_force,
+    test_codeword_map_serialize_default,
+    test_index_predictor_round_trip
 };
 
 bool (*integrational_tests[])(void) = {
@@ -896,7 +3107,29 @@ bool (*integrational_tests[])(void) = {
     test_mask_single_compress_decompress_executable,
     test_mask_duo_compress_decompress_executable,
     test_mask_quad_compress_decompress_executable,
-    test_mask_oper_compress_decompress_executable
+    test_mask_oper_compress_decompress_executable,
+    test_fields_compress_decompress_executable,
+    test_fixed16_compress_decompress_executable,
+    test_dict_entropy_compress_decompress_executable,
+    test_mask_single_entropy_compress_decompress_executable,
+    test_trace_executable_covers_section,
+    test_decompress_commands_at_matches_text,
+    test_compress_code_span_matches_executable,
+    test_compress_code_progress_and_cancel,
+    test_memory_budget_keeps_result,
+    test_workload_model_generates_executable,
+    test_exec_counts_reduce_dynamic_work,
+    test_runtime_matches_full_decoder,
+    test_function_units_decode_independently,
+    test_rv32i_run_compressed_matches_plain,
+    test_result_cache_hit_matches_fresh,
+    test_code_header_checks_before_decode,
+    test_dict_blocks_adapt_to_blocks,
+    test_hot_dict_short_indices,
+    test_mask_multi_codes_two_window_changes,
+    test_map_executable_matches_traces,
+    test_rv64i_compress_decompress_every_etype,
+    test_dict_order_index_coding_round_trip
 };
 
 int main(int argc, char *argv[])
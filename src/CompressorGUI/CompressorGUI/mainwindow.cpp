@@ -1,9 +1,13 @@
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <future>
 
+#include <QColor>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QDebug>
+#include <QtConcurrent>
 
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
@@ -19,6 +23,74 @@
 #define DUMP_STR_FORMAT( width ) \
     std::setw( width ) << std::setfill( ' ' ) << std::hex << std::left
 
+// Encode types in order of maskFormatComboBox items
+static const encode_type FORMAT_ETYPES[] = {
+    encode_type::DICT,
+    encode_type::MASK_SINGLE,
+    encode_type::MASK_DUO,
+    encode_type::MASK_OPERANDS_OPCODE,
+    encode_type::MASK_DUO_QUAD,
+    encode_type::MASK_QUAD,
+};
+static const size_t FORMATS_CNT = sizeof(FORMAT_ETYPES) / sizeof(FORMAT_ETYPES[0]);
+
+// Instructions per row of codeword heatmap
+static const size_t HEATMAP_BUCKET_CMDS = 16;
+
+// Dictionary building is fast compared to encoding, gets first 10 percents
+static int progress_percent(utils::progress_phase phase, size_t processed, size_t total)
+{
+    int part = total == 0 ? 100 : int(processed * 100 / total);
+    switch (phase)
+    {
+        case utils::progress_phase::HISTOGRAM:
+            return part / 10;
+        case utils::progress_phase::DICTIONARY:
+            return 10;
+        case utils::progress_phase::ENCODE:
+            return 10 + part * 9 / 10;
+        default:
+            return part;
+    }
+}
+
+// Loads file and compresses it, runs on worker thread
+static compress_result compress_file(const QString &pathToFile, const QString &saveTo, encode_type etype,
+    const utils::progress_callback &progress, const utils::cancel_token &cancel, bool withMap = false)
+{
+    compress_result res;
+    res.etype = etype;
+
+    utils::config_builder cfg_builder;
+    cfg_builder.set_etype(etype);
+    cfg_builder.set_progress(progress);
+    cfg_builder.set_cancel_token(cancel);
+    utils::config cfg = cfg_builder.build();
+
+    ELFIO::elfio writer;
+    if (!writer.load(pathToFile.toStdString()))
+    {
+        res.error = "Выбранный файл недоступен";
+        return res;
+    }
+
+    try {
+        utils::compress_executable(res.sz_stat, res.dict_infos, &writer, cfg);
+        if (withMap)
+            res.map = utils::map_executable(&writer);
+    } catch (utils::operation_cancelled &) {
+        res.cancelled = true;
+        return res;
+    } catch (std::exception &ex) {
+        res.error = "Ошибка при сжатии: \n" + QString::fromStdString(ex.what());
+        return res;
+    }
+
+    if (!saveTo.isEmpty() && !writer.save(saveTo.toStdString()))
+        res.error = "Ошибка при сохранении файла: \n" + QString::fromStdString(writer.validate());
+    return res;
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -26,13 +98,69 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
 
     _readerLoaded = false;
+    _compressFormatIndex = 0;
+    _runsCnt = 0;
+
+    ui->compareTableWidget->setRowCount(FORMATS_CNT);
+    for (size_t i = 0; i < FORMATS_CNT; ++i)
+        ui->compareTableWidget->setItem(i, 0, new QTableWidgetItem(ui->maskFormatComboBox->itemText(i)));
+
+    connect(&_compressWatcher, &QFutureWatcher<compress_result>::finished, this, &MainWindow::compressFinished);
+    connect(&_decompressWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::decompressFinished);
+    connect(&_compareWatcher, &QFutureWatcher<std::vector<compress_result>>::finished, this, &MainWindow::compareFinished);
+
+    setBusy(false);
 }
 
 MainWindow::~MainWindow()
 {
+    // Workers post progress to this window, let them stop first
+    _cancel.cancel();
+    _compressWatcher.waitForFinished();
+    _decompressWatcher.waitForFinished();
+    _compareWatcher.waitForFinished();
     delete ui;
 }
 
+void MainWindow::setBusy(bool busy, size_t runs)
+{
+    ui->chooseFileBtn->setEnabled(!busy);
+    ui->compressFileBtn->setEnabled(!busy);
+    ui->decompressFileBtn->setEnabled(!busy);
+    ui->compareAllBtn->setEnabled(!busy);
+    ui->cancelBtn->setEnabled(busy);
+    if (busy)
+    {
+        _cancel = utils::cancel_token();
+        _runsCnt = runs;
+        for (auto &percent : _runPercents)
+            percent = 0;
+        ui->progressBar->setRange(0, 100);
+        ui->progressBar->setValue(0);
+    }
+}
+
+// Called on worker thread, posts new progress to UI thread
+utils::progress_callback MainWindow::makeProgress(size_t run)
+{
+    return [this, run](utils::progress_phase phase, size_t processed, size_t total)
+    {
+        _runPercents[run] = progress_percent(phase, processed, total);
+        QMetaObject::invokeMethod(this, [this]()
+        {
+            ui->progressBar->setValue(progressValue());
+        }, Qt::QueuedConnection);
+    };
+}
+
+int MainWindow::progressValue() const
+{
+    int sum = 0;
+    for (size_t i = 0; i < _runsCnt; ++i)
+        sum += _runPercents[i];
+    return _runsCnt == 0 ? 0 : sum / int(_runsCnt);
+}
+
 void section_data(std::ostream &out, const ELFIO::section *sec)
 {
     const char* pdata = sec->get_data();
@@ -122,49 +250,41 @@ void MainWindow::on_compressFileBtn_clicked()
     if (fileName.isEmpty())
         return;
 
-    utils::config_builder cfg_builder;
-    switch (ui->maskFormatComboBox->currentIndex())
-    {
-        case 0:
-            cfg_builder.set_etype(encode_type::DICT);
-            break;
-        case 1:
-            cfg_builder.set_etype(encode_type::MASK_SINGLE);
-            break;
-        case 2:
-            cfg_builder.set_etype(encode_type::MASK_DUO);
-            break;
-        case 3:
-            cfg_builder.set_etype(encode_type::MASK_OPERANDS_OPCODE);
-            break;
-        case 4:
-            cfg_builder.set_etype(encode_type::MASK_DUO_QUAD);
-            break;
-        case 5:
-            cfg_builder.set_etype(encode_type::MASK_QUAD);
-            break;
-    }
+    _compressFormatIndex = ui->maskFormatComboBox->currentIndex();
+    encode_type etype = FORMAT_ETYPES[_compressFormatIndex];
+    utils::progress_callback progress = makeProgress(0);
+    QString pathToFile = _pathToFile;
 
-    utils::size_stat sz_stat;
-    std::vector<std::string> dict_infos;
-    utils::config cfg = cfg_builder.build();
+    setBusy(true);
+    utils::cancel_token cancel = _cancel;
+    _compressWatcher.setFuture(QtConcurrent::run([pathToFile, fileName, etype, progress, cancel]()
+    {
+        return compress_file(pathToFile, fileName, etype, progress, cancel, true);
+    }));
+}
 
-    ELFIO::elfio writer;
-    if (!writer.load(_pathToFile.toStdString()) ) {
-        QMessageBox msg;
-        msg.setText("Выбранный файл недоступен");
-        msg.exec();
+void MainWindow::compressFinished()
+{
+    setBusy(false);
+    compress_result res = _compressWatcher.result();
+    if (res.cancelled)
+    {
+        ui->progressBar->setValue(0);
         return;
     }
-    utils::compress_executable(sz_stat, dict_infos, &writer, cfg);
-
-    bool v = writer.save(fileName.toStdString());
-    if (!v) {
+    if (!res.error.isEmpty())
+    {
         QMessageBox msg;
-        msg.setText("Ошибка при сохранении файла: \n" + QString::fromStdString(writer.validate()));
+        msg.setText(res.error);
         msg.exec();
         return;
     }
+    ui->progressBar->setValue(100);
+
+    const utils::size_stat &sz_stat = res.sz_stat;
+    const std::vector<std::string> &dict_infos = res.dict_infos;
+    _map = std::move(res.map);
+    showHeatmap();
 
     ui->startTextSizeLineEdit->setText(QString::number(sz_stat.initial_code_size));
     ui->cmprTextSizeLineEdit->setText(QString::number(sz_stat.final_code_size));
@@ -180,7 +300,7 @@ void MainWindow::on_compressFileBtn_clicked()
     ui->dict2TextEdit->setText("");
     ui->dict3TextEdit->setText("");
     ui->dict4TextEdit->setText("");
-    switch (ui->maskFormatComboBox->currentIndex())
+    switch (_compressFormatIndex)
     {
         case 0:
             ui->dict1TextEdit->setText(QString::fromStdString(dict_infos[0]));
@@ -241,29 +361,178 @@ void MainWindow::on_decompressFileBtn_clicked()
     if (fileName.isEmpty())
         return;
 
-    ELFIO::elfio writer;
-    if (!writer.load(_pathToFile.toStdString()) ) {
+    QString pathToFile = _pathToFile;
+
+    setBusy(true);
+    utils::config_builder cfg_builder;
+    cfg_builder.set_progress(makeProgress(0));
+    cfg_builder.set_cancel_token(_cancel);
+    utils::config cfg = cfg_builder.build();
+    _decompressWatcher.setFuture(QtConcurrent::run([pathToFile, fileName, cfg]() -> QString
+    {
+        ELFIO::elfio writer;
+        if (!writer.load(pathToFile.toStdString()))
+            return "Выбранный файл недоступен";
+
+        try {
+            utils::decompress_executable(&writer, cfg);
+        }  catch (utils::operation_cancelled &) {
+            return QString();
+        }  catch (std::exception &ex) {
+            return "Невозможно выполнить декомпрессию (убедитесь, что выбран сжатый файл)";
+        }
+
+        if (!writer.save(fileName.toStdString()))
+            return "Ошибка при сохранении файла: \n" + QString::fromStdString(writer.validate());
+        return QString();
+    }));
+}
+
+void MainWindow::decompressFinished()
+{
+    setBusy(false);
+
+    QString error = _decompressWatcher.result();
+    if (!error.isEmpty())
+    {
+        ui->progressBar->setValue(0);
         QMessageBox msg;
-        msg.setText("Выбранный файл недоступен");
+        msg.setText(error);
         msg.exec();
         return;
     }
+    ui->progressBar->setValue(_cancel.is_cancelled() ? 0 : 100);
+}
 
-    try {
-        utils::decompress_executable(&writer);
-    }  catch (std::runtime_error &ex) {
+
+void MainWindow::on_compareAllBtn_clicked()
+{
+    if (!_readerLoaded)
+    {
         QMessageBox msg;
-        msg.setText("Невозможно выполнить декомпрессию (убедитесь, что выбран сжатый файл)");
+        msg.setText("Исходный файл не выбран");
         msg.exec();
         return;
     }
 
-    bool v = writer.save(fileName.toStdString());
-    if (!v) {
+    std::vector<utils::progress_callback> progresses;
+    for (size_t i = 0; i < FORMATS_CNT; ++i)
+        progresses.push_back(makeProgress(i));
+    QString pathToFile = _pathToFile;
+
+    for (size_t i = 0; i < FORMATS_CNT; ++i)
+        for (int col = 1; col < ui->compareTableWidget->columnCount(); ++col)
+            ui->compareTableWidget->setItem(i, col, new QTableWidgetItem(""));
+
+    // Every format gets its own thread and copy of the file, compress_executable
+    // shares no state between calls
+    setBusy(true, FORMATS_CNT);
+    utils::cancel_token cancel = _cancel;
+    _compareWatcher.setFuture(QtConcurrent::run([pathToFile, progresses, cancel]()
+    {
+        std::vector<std::future<compress_result>> runs;
+        for (size_t i = 0; i < FORMATS_CNT; ++i)
+        {
+            runs.push_back(std::async(std::launch::async, [pathToFile, etype = FORMAT_ETYPES[i], progress = progresses[i], cancel]()
+            {
+                return compress_file(pathToFile, QString(), etype, progress, cancel);
+            }));
+        }
+
+        std::vector<compress_result> results;
+        for (auto &run : runs)
+            results.push_back(run.get());
+        return results;
+    }));
+}
+
+void MainWindow::compareFinished()
+{
+    setBusy(false);
+    std::vector<compress_result> results = _compareWatcher.result();
+
+    bool cancelled = false;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const compress_result &res = results[i];
+        cancelled |= res.cancelled;
+        if (res.cancelled || !res.error.isEmpty())
+        {
+            ui->compareTableWidget->setItem(i, 1, new QTableWidgetItem(res.cancelled ? "Отменено" : res.error));
+            continue;
+        }
+
+        const utils::size_stat &sz_stat = res.sz_stat;
+        size_t total = sz_stat.final_code_size + sz_stat.dict_32_bit_size;
+        ui->compareTableWidget->setItem(i, 1, new QTableWidgetItem(QString::number(sz_stat.final_code_size)));
+        ui->compareTableWidget->setItem(i, 2, new QTableWidgetItem(QString::number(sz_stat.dict_32_bit_size)));
+        ui->compareTableWidget->setItem(i, 3, new QTableWidgetItem(QString::number(total)));
+        ui->compareTableWidget->setItem(i, 4, new QTableWidgetItem(QString::number(double(sz_stat.initial_code_size) / total)));
+    }
+    ui->progressBar->setValue(cancelled ? 0 : 100);
+    ui->tabWidget->setCurrentWidget(ui->compareTab);
+}
+
+
+void MainWindow::on_cancelBtn_clicked()
+{
+    _cancel.cancel();
+    ui->cancelBtn->setEnabled(false);
+}
+
+// Bucket color goes from green to red with share of literals
+void MainWindow::showHeatmap()
+{
+    std::vector<utils::codeword_bucket> buckets = _map.get_buckets(HEATMAP_BUCKET_CMDS);
+    ui->heatmapTableWidget->setRowCount(buckets.size());
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        const utils::codeword_bucket &bucket = buckets[i];
+        const utils::codeword_func *func = _map.find_function(bucket.offset);
+        double literals = double(bucket.counts[(size_t)utils::codeword_class::LITERAL]) / bucket.cmds;
+        QColor color = QColor::fromHsvF((1.0 - literals) / 3, 0.6, 1.0);
+
+        const QString cells[] = {
+            "0x" + QString::number(_map.get_text_addr() + bucket.offset, 16),
+            func != nullptr ? QString::fromStdString(func->name) : QString(),
+            QString::number(bucket.counts[(size_t)utils::codeword_class::DICT]),
+            QString::number(bucket.counts[(size_t)utils::codeword_class::MASK]),
+            QString::number(bucket.counts[(size_t)utils::codeword_class::LITERAL]),
+            QString::number(double(bucket.bits) / bucket.cmds, 'f', 1),
+        };
+        for (int col = 0; col < ui->heatmapTableWidget->columnCount(); ++col)
+        {
+            QTableWidgetItem *item = new QTableWidgetItem(cells[col]);
+            item->setBackground(color);
+            ui->heatmapTableWidget->setItem(i, col, item);
+        }
+    }
+    ui->saveMapBtn->setEnabled(!buckets.empty());
+}
+
+void MainWindow::on_saveMapBtn_clicked()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save File"),
+                                                    "/home/user/Documents",
+                                                    tr("Codeword Maps (*.cwm);;All Files (*)"));
+    if (fileName.isEmpty())
+        return;
+
+    QString csvName = fileName;
+    if (csvName.endsWith(".cwm"))
+        csvName.chop(4);
+    csvName += ".csv";
+
+    try {
+        _map.save(fileName.toStdString());
+        std::ofstream csv(csvName.toStdString(), std::ios::trunc);
+        _map.write_csv(csv);
+        if (!csv)
+            throw std::runtime_error("Can't write " + csvName.toStdString());
+    } catch (std::exception &ex) {
         QMessageBox msg;
-        msg.setText("Ошибка при сохранении файла: \n" + QString::fromStdString(writer.validate()));
+        msg.setText("Ошибка при сохранении карты: \n" + QString::fromStdString(ex.what()));
         msg.exec();
-        return;
     }
 }
-
@@ -1,14 +1,34 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
 #include <QMainWindow>
+#include <QFutureWatcher>
 
 #include "elfio/elfio.hpp"
+#include "codeword_map.h"
+#include "config.h"
+#include "size_stat.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+// Outcome of one compression run on worker thread
+struct compress_result
+{
+    encode_type etype;
+    utils::size_stat sz_stat;
+    std::vector<std::string> dict_infos;
+    utils::codeword_map map;    // only for single file compression
+    bool cancelled { false };
+    QString error;
+};
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -24,10 +44,37 @@ private slots:
 
     void on_decompressFileBtn_clicked();
 
+    void on_compareAllBtn_clicked();
+
+    void on_cancelBtn_clicked();
+
+    void on_saveMapBtn_clicked();
+
+    void compressFinished();
+
+    void decompressFinished();
+
+    void compareFinished();
+
 private:
+    void setBusy(bool busy, size_t runs = 1);
+    utils::progress_callback makeProgress(size_t run);
+    int progressValue() const;
+    void showHeatmap();
+
     Ui::MainWindow *ui;
     bool _readerLoaded;
     QString _pathToFile;
     ELFIO::elfio _reader;
+
+    int _compressFormatIndex;
+    utils::codeword_map _map;
+    utils::cancel_token _cancel;
+    // Percent done of every parallel run, progress bar shows their average
+    std::array<std::atomic<int>, 8> _runPercents;
+    size_t _runsCnt;
+    QFutureWatcher<compress_result> _compressWatcher;
+    QFutureWatcher<QString> _decompressWatcher;
+    QFutureWatcher<std::vector<compress_result>> _compareWatcher;
 };
 #endif // MAINWINDOW_H